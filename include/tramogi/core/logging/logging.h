@@ -1,28 +1,118 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <format>
 #include <string_view>
 
 namespace tramogi::core::logging {
 
+enum class Level : uint8_t {
+	Trace,
+	Debug,
+	Info,
+	Warning,
+	Error,
+	Off,
+};
+
+enum class Category : uint8_t {
+	General,
+	Graphics,
+	Io,
+	Input,
+	Platform,
+	Count,
+};
+
+// Messages below this level are removed at compile time. Override with
+// -DTRAMOGI_LOG_MIN_LEVEL=<0..5> (values follow the Level enum).
+#ifndef TRAMOGI_LOG_MIN_LEVEL
 #ifndef NDEBUG
-constexpr bool enable_debug_log = true;
+#define TRAMOGI_LOG_MIN_LEVEL 0
 #else
-constexpr bool enable_debug_log = false;
+#define TRAMOGI_LOG_MIN_LEVEL 2
+#endif
 #endif
 
+constexpr Level min_compiled_level = static_cast<Level>(TRAMOGI_LOG_MIN_LEVEL);
+
+constexpr bool is_compiled(Level level) {
+	return level >= min_compiled_level && level != Level::Off;
+}
+
+constexpr bool enable_debug_log = is_compiled(Level::Debug);
+
 namespace intern {
-void log_impl(std::string_view format, std::format_args args);
+
+extern std::atomic<Level> category_levels[static_cast<size_t>(Category::Count)];
+
+void log_impl(Level level, Category category, std::string_view format, std::format_args args);
+
+} // namespace intern
+
+// Runtime filter, a single relaxed load per message.
+inline bool is_enabled(Level level, Category category) {
+	return level >= intern::category_levels[static_cast<size_t>(category)].load(
+						std::memory_order_relaxed
+					);
 }
 
-template <typename... Args> void debug_log(std::format_string<Args...> format, Args &&...args) {
-	if constexpr (enable_debug_log) {
-		intern::log_impl(format.get(), std::make_format_args(args...));
+void set_level(Level level);
+void set_level(Category category, Level level);
+Level get_level(Category category);
+
+std::string_view to_string(Level level);
+std::string_view to_string(Category category);
+
+// Formats and emits without checking filters. Use the macros below or log_at
+// unless the check has already been done.
+template <typename... Args>
+void emit(Level level, Category category, std::format_string<Args...> format, Args &&...args) {
+	intern::log_impl(level, category, format.get(), std::make_format_args(args...));
+}
+
+// Arguments are evaluated by the caller, but are only formatted when the message passes both
+// filters. Prefer the TRAMOGI_LOG_* macros where argument evaluation itself is not free.
+template <Level level, Category category = Category::General, typename... Args>
+void log_at(std::format_string<Args...> format, Args &&...args) {
+	if constexpr (is_compiled(level)) {
+		if (is_enabled(level, category)) {
+			emit(level, category, format, std::forward<Args>(args)...);
+		}
 	}
 }
 
+template <typename... Args> void debug_log(std::format_string<Args...> format, Args &&...args) {
+	log_at<Level::Debug>(format, std::forward<Args>(args)...);
+}
+
 template <typename... Args> void log(std::format_string<Args...> format, Args &&...args) {
-	intern::log_impl(format.get(), std::make_format_args(args...));
+	log_at<Level::Info>(format, std::forward<Args>(args)...);
 }
 
 } // namespace tramogi::core::logging
+
+// Argument expressions are only evaluated when the message passes both the compile-time and
+// runtime filters.
+#define TRAMOGI_LOG(level, category, ...)                                                          \
+	do {                                                                                           \
+		if constexpr (::tramogi::core::logging::is_compiled(level)) {                              \
+			if (::tramogi::core::logging::is_enabled(level, category)) {                           \
+				::tramogi::core::logging::emit(level, category, __VA_ARGS__);                      \
+			}                                                                                      \
+		}                                                                                          \
+	} while (0)
+
+#define TRAMOGI_LOG_AT(level, category, ...)                                                       \
+	TRAMOGI_LOG(                                                                                   \
+		::tramogi::core::logging::Level::level,                                                    \
+		::tramogi::core::logging::Category::category,                                              \
+		__VA_ARGS__                                                                                \
+	)
+
+#define TRAMOGI_LOG_TRACE(category, ...) TRAMOGI_LOG_AT(Trace, category, __VA_ARGS__)
+#define TRAMOGI_LOG_DEBUG(category, ...) TRAMOGI_LOG_AT(Debug, category, __VA_ARGS__)
+#define TRAMOGI_LOG_INFO(category, ...) TRAMOGI_LOG_AT(Info, category, __VA_ARGS__)
+#define TRAMOGI_LOG_WARNING(category, ...) TRAMOGI_LOG_AT(Warning, category, __VA_ARGS__)
+#define TRAMOGI_LOG_ERROR(category, ...) TRAMOGI_LOG_AT(Error, category, __VA_ARGS__)
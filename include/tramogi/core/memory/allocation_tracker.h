@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace tramogi::core::memory {
+
+#ifdef TRAMOGI_ENABLE_MEMORY_TRACKING
+constexpr bool enable_memory_tracking = true;
+#else
+constexpr bool enable_memory_tracking = false;
+#endif
+
+enum class AllocationCategory : uint8_t {
+	General,
+	Model,
+	Image,
+	Logging,
+	Vulkan,
+	Count,
+};
+
+constexpr size_t allocation_category_count = static_cast<size_t>(AllocationCategory::Count);
+
+struct AllocationStats {
+	uint64_t live_bytes = 0;
+	uint64_t peak_bytes = 0;
+	uint64_t allocation_count = 0;
+	uint64_t free_count = 0;
+};
+
+struct FrameAllocationStats {
+	std::array<uint64_t, allocation_category_count> allocated_bytes {};
+	std::array<uint64_t, allocation_category_count> allocation_count {};
+	uint64_t total_bytes = 0;
+	uint64_t total_count = 0;
+	bool is_heavy = false;
+};
+
+std::string_view to_string(AllocationCategory category);
+
+AllocationStats get_stats(AllocationCategory category);
+
+// A frame is flagged as heavy once it crosses either threshold.
+void set_frame_thresholds(uint64_t allocation_count, uint64_t allocated_bytes);
+void begin_frame();
+FrameAllocationStats end_frame();
+
+void log_report();
+
+// Heap functions for code that cannot go through operator new (C libraries, Vulkan host
+// callbacks). Sizes are kept in a small header, so blocks must be released with tracked_free.
+void *tracked_malloc(size_t size, AllocationCategory category);
+void *tracked_aligned_malloc(size_t size, size_t alignment, AllocationCategory category);
+void *tracked_realloc(void *pointer, size_t size, AllocationCategory category);
+void *tracked_aligned_realloc(
+	void *pointer,
+	size_t size,
+	size_t alignment,
+	AllocationCategory category
+);
+void tracked_free(void *pointer);
+
+// For memory the tracker does not own but should still account for, e.g. driver-internal
+// allocations reported through Vulkan's notification callbacks.
+void record_allocation(AllocationCategory category, size_t size);
+void record_free(AllocationCategory category, size_t size);
+
+AllocationCategory get_current_category();
+
+// Tags every operator new on this thread with `category` until the scope ends.
+class ScopedAllocationCategory {
+public:
+#ifdef TRAMOGI_ENABLE_MEMORY_TRACKING
+	explicit ScopedAllocationCategory(AllocationCategory category);
+	~ScopedAllocationCategory();
+#else
+	explicit ScopedAllocationCategory(AllocationCategory) {}
+#endif
+
+	ScopedAllocationCategory(const ScopedAllocationCategory &) = delete;
+	ScopedAllocationCategory &operator=(const ScopedAllocationCategory &) = delete;
+
+#ifdef TRAMOGI_ENABLE_MEMORY_TRACKING
+private:
+	AllocationCategory previous;
+#endif
+};
+
+} // namespace tramogi::core::memory
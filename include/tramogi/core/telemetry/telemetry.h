@@ -0,0 +1,114 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tramogi::core::telemetry {
+
+// Log-linear histogram in the spirit of HdrHistogram. Values below 128 are exact, larger values
+// land in one of 128 linear sub-buckets per power of two, keeping the relative error under 1%.
+class Histogram {
+public:
+	static constexpr uint32_t sub_bucket_bits = 7;
+	static constexpr uint32_t sub_bucket_count = 1u << sub_bucket_bits;
+	static constexpr uint32_t max_value_bits = 40;
+
+	Histogram();
+
+	void add(uint64_t value);
+	void remove(uint64_t value);
+	void clear();
+
+	uint64_t get_count() const {
+		return count;
+	}
+
+	// `percentile` in [0, 100]. Returns the midpoint of the matching bucket.
+	uint64_t get_percentile(double percentile) const;
+	uint64_t get_max() const;
+
+	static uint32_t get_bucket_index(uint64_t value);
+	static uint64_t get_bucket_lower_bound(uint32_t index);
+	static uint64_t get_bucket_upper_bound(uint32_t index);
+
+private:
+	std::vector<uint32_t> buckets;
+	uint64_t count = 0;
+};
+
+struct PercentileSummary {
+	uint64_t count = 0;
+	double mean_ms = 0.0;
+	double p50_ms = 0.0;
+	double p95_ms = 0.0;
+	double p99_ms = 0.0;
+	double max_ms = 0.0;
+};
+
+// Records the CPU time of every frame plus a caller-defined set of phases. Metric 0 is the whole
+// frame, metric `i + 1` is phase `i`. Each metric keeps a histogram over the last `window_size`
+// frames and one over the whole session.
+class FrameTelemetry {
+public:
+	FrameTelemetry(std::vector<std::string> phase_names, uint32_t window_size = 600);
+
+	void begin_frame();
+	void end_frame();
+	void add_phase_time(uint32_t phase, uint64_t nanoseconds);
+
+	uint64_t get_frame_count() const {
+		return frame_count;
+	}
+	uint32_t get_metric_count() const {
+		return static_cast<uint32_t>(metrics.size());
+	}
+	std::string_view get_metric_name(uint32_t metric) const {
+		return metrics[metric].name;
+	}
+
+	PercentileSummary get_window_summary(uint32_t metric) const;
+	PercentileSummary get_session_summary(uint32_t metric) const;
+
+	Result<> export_json(const char *filepath) const;
+	Result<> export_csv(const char *filepath) const;
+
+	class ScopedPhase {
+	public:
+		ScopedPhase(FrameTelemetry &telemetry, uint32_t phase);
+		~ScopedPhase();
+
+		ScopedPhase(const ScopedPhase &) = delete;
+		ScopedPhase &operator=(const ScopedPhase &) = delete;
+
+	private:
+		FrameTelemetry &telemetry;
+		uint32_t phase;
+		uint64_t begin_ns;
+	};
+
+private:
+	struct Metric {
+		std::string name;
+		Histogram window;
+		Histogram session;
+		std::vector<uint64_t> window_samples;
+		uint64_t window_sum = 0;
+		uint64_t window_max = 0;
+		uint64_t session_sum = 0;
+		uint64_t session_max = 0;
+	};
+
+	std::vector<Metric> metrics;
+	std::vector<uint64_t> current_phases;
+	uint32_t window_size;
+	uint32_t window_cursor = 0;
+	uint64_t frame_count = 0;
+	uint64_t frame_begin_ns = 0;
+
+	void push_sample(Metric &metric, uint64_t value);
+};
+
+} // namespace tramogi::core::telemetry
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tramogi::core::threading {
+
+// Fixed set of worker threads running tasks in submission order. Tasks still queued when the
+// pool is destroyed are run before the workers exit, so no future is ever left broken.
+class ThreadPool {
+public:
+	// One less than the hardware threads, leaving one for the main thread, and at least one.
+	static uint32_t get_default_thread_count();
+
+	explicit ThreadPool(uint32_t thread_count = get_default_thread_count());
+	~ThreadPool();
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	void enqueue(std::move_only_function<void()> task);
+
+	template <typename Fn> auto submit(Fn &&fn) -> std::future<std::invoke_result_t<Fn>> {
+		std::packaged_task<std::invoke_result_t<Fn>()> task(std::forward<Fn>(fn));
+		auto future = task.get_future();
+		enqueue(std::move(task));
+		return future;
+	}
+
+	// Calls `fn(i)` for every i in [0, count), spread over the workers and the calling thread,
+	// and returns once all calls have. If any call throws, the others still run and the first
+	// exception is rethrown once they have returned.
+	void parallel_for(uint32_t count, const std::function<void(uint32_t)> &fn);
+
+	uint32_t get_thread_count() const {
+		return static_cast<uint32_t>(workers.size());
+	}
+
+	// 0 on threads that are not workers of any pool, `i + 1` on worker `i`. Meant for indexing
+	// per-thread resources with `get_thread_count() + 1` slots.
+	static uint32_t get_thread_index();
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::move_only_function<void()>> tasks;
+	bool is_stopping = false;
+
+	void run_worker(uint32_t index);
+};
+
+} // namespace tramogi::core::threading
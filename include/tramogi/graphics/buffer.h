@@ -1,8 +1,10 @@
 #pragma once
 
 #include "tramogi/core/errors.h"
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <span>
 
 namespace vk {
 namespace raii {
@@ -23,12 +25,24 @@ public:
 
 	virtual core::Result<> init(const Device &device, uint64_t size) = 0;
 
+	// Host visible buffers are mapped for their whole lifetime. Writes through the mapped memory
+	// must be followed by `flush`, which `upload_data` and `write` already do.
 	void upload_data(const void *data);
+	// Copies and flushes only `data.size()` bytes at `offset`.
+	void write(uint64_t offset, std::span<const std::byte> data);
+	template <typename T> void write(uint64_t offset, std::span<const T> data) {
+		write(offset, std::as_bytes(data));
+	}
+
+	// No-ops on coherent memory.
+	void flush(uint64_t offset, uint64_t size);
+	void invalidate(uint64_t offset, uint64_t size);
 
 	void map();
 	void unmap();
 	void *get_mapped_memory();
 	vk::raii::Buffer &get_buffer();
+	uint64_t get_size() const;
 
 	Buffer(const Buffer &) = delete;
 	Buffer &operator=(const Buffer &) = delete;
@@ -38,6 +52,8 @@ public:
 protected:
 	struct Impl;
 	std::unique_ptr<Impl> impl;
+
+	friend class Defragmenter;
 };
 
 class StagingBuffer : public Buffer {
@@ -79,6 +95,61 @@ public:
 	IndexBuffer &operator=(IndexBuffer &&) = default;
 };
 
+class StorageBuffer : public Buffer {
+public:
+	StorageBuffer() = default;
+	~StorageBuffer() = default;
+
+	core::Result<> init(const Device &device, uint64_t size);
+
+	StorageBuffer(const StorageBuffer &) = delete;
+	StorageBuffer &operator=(const StorageBuffer &) = delete;
+	StorageBuffer(StorageBuffer &&) = default;
+	StorageBuffer &operator=(StorageBuffer &&) = default;
+};
+
+// Host visible storage buffer, read by shaders straight from the memory the CPU writes to.
+class HostStorageBuffer : public Buffer {
+public:
+	HostStorageBuffer() = default;
+	~HostStorageBuffer() = default;
+
+	core::Result<> init(const Device &device, uint64_t size);
+
+	HostStorageBuffer(const HostStorageBuffer &) = delete;
+	HostStorageBuffer &operator=(const HostStorageBuffer &) = delete;
+	HostStorageBuffer(HostStorageBuffer &&) = default;
+	HostStorageBuffer &operator=(HostStorageBuffer &&) = default;
+};
+
+// Storage buffer that can also source indirect draw parameters, written on the GPU.
+class IndirectBuffer : public Buffer {
+public:
+	IndirectBuffer() = default;
+	~IndirectBuffer() = default;
+
+	core::Result<> init(const Device &device, uint64_t size);
+
+	IndirectBuffer(const IndirectBuffer &) = delete;
+	IndirectBuffer &operator=(const IndirectBuffer &) = delete;
+	IndirectBuffer(IndirectBuffer &&) = default;
+	IndirectBuffer &operator=(IndirectBuffer &&) = default;
+};
+
+// Host visible copy destination for reading GPU results back. Call `invalidate` before reading.
+class ReadbackBuffer : public Buffer {
+public:
+	ReadbackBuffer() = default;
+	~ReadbackBuffer() = default;
+
+	core::Result<> init(const Device &device, uint64_t size);
+
+	ReadbackBuffer(const ReadbackBuffer &) = delete;
+	ReadbackBuffer &operator=(const ReadbackBuffer &) = delete;
+	ReadbackBuffer(ReadbackBuffer &&) = default;
+	ReadbackBuffer &operator=(ReadbackBuffer &&) = default;
+};
+
 class UniformBuffer : public Buffer {
 public:
 	UniformBuffer() = default;
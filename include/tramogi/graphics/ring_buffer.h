@@ -0,0 +1,70 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace vk {
+namespace raii {
+class Buffer;
+} // namespace raii
+} // namespace vk
+
+namespace tramogi::graphics {
+
+class Device;
+
+struct RingAllocation {
+	void *data = nullptr;
+	// Offset from the start of the ring buffer, usable as a dynamic or binding offset.
+	uint64_t offset = 0;
+	uint64_t size = 0;
+};
+
+// Persistently mapped host buffer split into one region per frame in flight. Transient data of a
+// frame (uniforms, dynamic vertices, staging) is bump allocated from that frame's region, which is
+// recycled as a whole once the frame has completed.
+class FrameRingBuffer {
+public:
+	FrameRingBuffer();
+	~FrameRingBuffer();
+	FrameRingBuffer(const FrameRingBuffer &) = delete;
+	FrameRingBuffer &operator=(const FrameRingBuffer &) = delete;
+	FrameRingBuffer(FrameRingBuffer &&);
+	FrameRingBuffer &operator=(FrameRingBuffer &&);
+
+	core::Result<> init(const Device &device, uint32_t frame_count, uint64_t frame_size);
+
+	// Discards everything allocated for `frame_index`. Only call once the frame has completed.
+	void begin_frame(uint32_t frame_index);
+
+	[[nodiscard]] core::Option<RingAllocation> allocate(uint64_t size, uint64_t alignment);
+	// Aligned to minUniformBufferOffsetAlignment.
+	[[nodiscard]] core::Option<RingAllocation> allocate_uniform(uint64_t size);
+
+	template <typename T> [[nodiscard]] core::Option<RingAllocation> push_uniform(const T &value) {
+		auto allocation = allocate_uniform(sizeof(T));
+		if (allocation) {
+			std::memcpy(allocation->data, &value, sizeof(T));
+		}
+		return allocation;
+	}
+
+	// Makes this frame's writes visible to the device on non-coherent memory. Call once all of
+	// them are done, before submitting.
+	void flush();
+
+	vk::raii::Buffer &get_buffer();
+	uint64_t get_frame_size() const;
+	// Bytes allocated so far from the current frame's region.
+	uint64_t get_frame_usage() const;
+	// Highest usage of a single frame since `init`.
+	uint64_t get_peak_usage() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
@@ -7,6 +7,7 @@
 #include <glm/gtx/hash.hpp>
 
 #include "tramogi/core/logging/logging.h"
+#include "tramogi/core/memory/allocation_tracker.h"
 
 namespace std {
 
@@ -25,13 +26,15 @@ bool Vertex::operator==(const Vertex &other) const {
 }
 
 bool Model::load_from_obj_file(const char *filepath) {
+	memory::ScopedAllocationCategory allocation_category(memory::AllocationCategory::Model);
+
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
 	std::string warn;
 	std::string err;
 	bool res = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath);
-	logging::debug_log("{}", warn + err);
+	TRAMOGI_LOG_DEBUG(Io, "{}", warn + err);
 
 	std::unordered_map<Vertex, uint32_t> unique_vertices;
 	for (const auto &shape : shapes) {
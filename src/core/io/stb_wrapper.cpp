@@ -1,6 +1,19 @@
 #include "tramogi/core/io/image_data.h"
 #include <cstdint>
 
+#ifdef TRAMOGI_ENABLE_MEMORY_TRACKING
+#include "tramogi/core/memory/allocation_tracker.h"
+#define STBI_MALLOC(size)                                                                          \
+	tramogi::core::memory::tracked_malloc(size, tramogi::core::memory::AllocationCategory::Image)
+#define STBI_REALLOC(pointer, size)                                                                \
+	tramogi::core::memory::tracked_realloc(                                                        \
+		pointer,                                                                                   \
+		size,                                                                                      \
+		tramogi::core::memory::AllocationCategory::Image                                           \
+	)
+#define STBI_FREE(pointer) tramogi::core::memory::tracked_free(pointer)
+#endif
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
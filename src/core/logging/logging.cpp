@@ -1,4 +1,7 @@
 #include "tramogi/core/logging/logging.h"
+#include "tramogi/core/memory/allocation_tracker.h"
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <format>
 #include <print>
@@ -7,19 +10,73 @@ namespace tramogi::core::logging {
 
 const auto log_start_time = std::chrono::high_resolution_clock::now();
 
+#ifndef NDEBUG
+constexpr Level default_runtime_level = Level::Debug;
+#else
+constexpr Level default_runtime_level = Level::Info;
+#endif
+
+constexpr std::array<std::string_view, 6> level_names {
+	"T",
+	"D",
+	"I",
+	"W",
+	"E",
+	"-",
+};
+
+constexpr std::array<std::string_view, static_cast<size_t>(Category::Count)> category_names {
+	"general",
+	"graphics",
+	"io",
+	"input",
+	"platform",
+};
+
 namespace intern {
 
-void log_impl(std::string_view format, std::format_args args) {
+std::atomic<Level> category_levels[static_cast<size_t>(Category::Count)] {
+	default_runtime_level,
+	default_runtime_level,
+	default_runtime_level,
+	default_runtime_level,
+	default_runtime_level,
+};
+
+void log_impl(Level level, Category category, std::string_view format, std::format_args args) {
+	memory::ScopedAllocationCategory allocation_category(memory::AllocationCategory::Logging);
+
 	float time = std::chrono::duration_cast<std::chrono::duration<float>>(
 					 std::chrono::high_resolution_clock::now() - log_start_time
 	)
 					 .count();
 	std::string formatted = std::vformat(format, args);
 
-	std::println("[{:10.6f}] {}", time, formatted);
+	std::println("[{:10.6f}] [{}] [{}] {}", time, to_string(level), to_string(category), formatted);
 }
 
 } // namespace intern
 
-} // namespace tramogi::core::logging
+void set_level(Level level) {
+	for (auto &category_level : intern::category_levels) {
+		category_level.store(level, std::memory_order_relaxed);
+	}
+}
+
+void set_level(Category category, Level level) {
+	intern::category_levels[static_cast<size_t>(category)].store(level, std::memory_order_relaxed);
+}
+
+Level get_level(Category category) {
+	return intern::category_levels[static_cast<size_t>(category)].load(std::memory_order_relaxed);
+}
+
+std::string_view to_string(Level level) {
+	return level_names[static_cast<size_t>(level)];
+}
+
+std::string_view to_string(Category category) {
+	return category_names[static_cast<size_t>(category)];
+}
 
+} // namespace tramogi::core::logging
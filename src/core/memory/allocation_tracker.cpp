@@ -0,0 +1,304 @@
+#include "tramogi/core/memory/allocation_tracker.h"
+#include "tramogi/core/logging/logging.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace tramogi::core::memory {
+
+namespace {
+
+struct alignas(16) AllocationHeader {
+	uint64_t size;
+	uint32_t offset;
+	AllocationCategory category;
+};
+static_assert(sizeof(AllocationHeader) == 16);
+
+constexpr size_t min_alignment = alignof(AllocationHeader);
+
+struct CategoryCounters {
+	std::atomic<uint64_t> live_bytes {0};
+	std::atomic<uint64_t> peak_bytes {0};
+	std::atomic<uint64_t> allocation_count {0};
+	std::atomic<uint64_t> free_count {0};
+	std::atomic<uint64_t> frame_bytes {0};
+	std::atomic<uint64_t> frame_count {0};
+};
+
+std::array<CategoryCounters, allocation_category_count> counters;
+std::atomic<uint64_t> heavy_frame_count_threshold {256};
+std::atomic<uint64_t> heavy_frame_bytes_threshold {1024 * 1024};
+
+thread_local AllocationCategory current_category = AllocationCategory::General;
+
+constexpr std::array<std::string_view, allocation_category_count> category_names {
+	"general",
+	"model",
+	"image",
+	"logging",
+	"vulkan",
+};
+
+CategoryCounters &get_counters(AllocationCategory category) {
+	return counters[static_cast<size_t>(category)];
+}
+
+void *allocate_with_header(size_t size, size_t alignment, AllocationCategory category) {
+	alignment = std::max(alignment, min_alignment);
+	size_t total = size + alignment + sizeof(AllocationHeader);
+	auto *raw = static_cast<std::byte *>(std::malloc(total));
+	if (!raw) {
+		return nullptr;
+	}
+
+	auto address = reinterpret_cast<uintptr_t>(raw + sizeof(AllocationHeader));
+	address = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+	auto *user = reinterpret_cast<std::byte *>(address);
+
+	auto *header = reinterpret_cast<AllocationHeader *>(user) - 1;
+	header->size = size;
+	header->offset = static_cast<uint32_t>(user - raw);
+	header->category = category;
+
+	record_allocation(category, size);
+	return user;
+}
+
+AllocationHeader *get_header(void *pointer) {
+	return static_cast<AllocationHeader *>(pointer) - 1;
+}
+
+} // namespace
+
+std::string_view to_string(AllocationCategory category) {
+	return category_names[static_cast<size_t>(category)];
+}
+
+void record_allocation([[maybe_unused]] AllocationCategory category, [[maybe_unused]] size_t size) {
+	if constexpr (enable_memory_tracking) {
+		CategoryCounters &entry = get_counters(category);
+		uint64_t live = entry.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+		uint64_t peak = entry.peak_bytes.load(std::memory_order_relaxed);
+		while (live > peak &&
+			   !entry.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+		}
+		entry.allocation_count.fetch_add(1, std::memory_order_relaxed);
+		entry.frame_bytes.fetch_add(size, std::memory_order_relaxed);
+		entry.frame_count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void record_free([[maybe_unused]] AllocationCategory category, [[maybe_unused]] size_t size) {
+	if constexpr (enable_memory_tracking) {
+		CategoryCounters &entry = get_counters(category);
+		entry.live_bytes.fetch_sub(size, std::memory_order_relaxed);
+		entry.free_count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void *tracked_malloc(size_t size, AllocationCategory category) {
+	return allocate_with_header(size, min_alignment, category);
+}
+
+void *tracked_aligned_malloc(size_t size, size_t alignment, AllocationCategory category) {
+	return allocate_with_header(size, alignment, category);
+}
+
+void *tracked_realloc(void *pointer, size_t size, AllocationCategory category) {
+	return tracked_aligned_realloc(pointer, size, min_alignment, category);
+}
+
+void *tracked_aligned_realloc(
+	void *pointer,
+	size_t size,
+	size_t alignment,
+	AllocationCategory category
+) {
+	if (!pointer) {
+		return allocate_with_header(size, alignment, category);
+	}
+	if (size == 0) {
+		tracked_free(pointer);
+		return nullptr;
+	}
+
+	void *new_pointer = allocate_with_header(size, alignment, category);
+	if (!new_pointer) {
+		return nullptr;
+	}
+	std::memcpy(new_pointer, pointer, std::min<size_t>(get_header(pointer)->size, size));
+	tracked_free(pointer);
+	return new_pointer;
+}
+
+void tracked_free(void *pointer) {
+	if (!pointer) {
+		return;
+	}
+	AllocationHeader *header = get_header(pointer);
+	record_free(header->category, header->size);
+	std::free(static_cast<std::byte *>(pointer) - header->offset);
+}
+
+AllocationStats get_stats(AllocationCategory category) {
+	const CategoryCounters &entry = get_counters(category);
+	return {
+		.live_bytes = entry.live_bytes.load(std::memory_order_relaxed),
+		.peak_bytes = entry.peak_bytes.load(std::memory_order_relaxed),
+		.allocation_count = entry.allocation_count.load(std::memory_order_relaxed),
+		.free_count = entry.free_count.load(std::memory_order_relaxed),
+	};
+}
+
+void set_frame_thresholds(uint64_t allocation_count, uint64_t allocated_bytes) {
+	heavy_frame_count_threshold.store(allocation_count, std::memory_order_relaxed);
+	heavy_frame_bytes_threshold.store(allocated_bytes, std::memory_order_relaxed);
+}
+
+void begin_frame() {
+	for (auto &entry : counters) {
+		entry.frame_bytes.store(0, std::memory_order_relaxed);
+		entry.frame_count.store(0, std::memory_order_relaxed);
+	}
+}
+
+FrameAllocationStats end_frame() {
+	FrameAllocationStats stats;
+	if constexpr (!enable_memory_tracking) {
+		return stats;
+	}
+
+	for (size_t i = 0; i < allocation_category_count; ++i) {
+		stats.allocated_bytes[i] = counters[i].frame_bytes.load(std::memory_order_relaxed);
+		stats.allocation_count[i] = counters[i].frame_count.load(std::memory_order_relaxed);
+		stats.total_bytes += stats.allocated_bytes[i];
+		stats.total_count += stats.allocation_count[i];
+	}
+	stats.is_heavy =
+		stats.total_count >= heavy_frame_count_threshold.load(std::memory_order_relaxed) ||
+		stats.total_bytes >= heavy_frame_bytes_threshold.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+void log_report() {
+	if constexpr (!enable_memory_tracking) {
+		return;
+	}
+
+	logging::log("Heap allocations:");
+	for (size_t i = 0; i < allocation_category_count; ++i) {
+		auto category = static_cast<AllocationCategory>(i);
+		AllocationStats stats = get_stats(category);
+		logging::log(
+			"  - {:8}: live {} B, peak {} B, {} allocations, {} frees",
+			to_string(category),
+			stats.live_bytes,
+			stats.peak_bytes,
+			stats.allocation_count,
+			stats.free_count
+		);
+	}
+}
+
+AllocationCategory get_current_category() {
+	return current_category;
+}
+
+#ifdef TRAMOGI_ENABLE_MEMORY_TRACKING
+ScopedAllocationCategory::ScopedAllocationCategory(AllocationCategory category)
+	: previous(current_category) {
+	current_category = category;
+}
+
+ScopedAllocationCategory::~ScopedAllocationCategory() {
+	current_category = previous;
+}
+#endif
+
+} // namespace tramogi::core::memory
+
+#ifdef TRAMOGI_ENABLE_MEMORY_TRACKING
+
+// Replacing the global allocation functions routes every operator new in the process through the
+// tracker, tagged with the category of the calling thread.
+
+namespace {
+
+using tramogi::core::memory::get_current_category;
+using tramogi::core::memory::tracked_aligned_malloc;
+using tramogi::core::memory::tracked_free;
+
+void *tracked_new(size_t size, size_t alignment) {
+	void *pointer = tracked_aligned_malloc(size == 0 ? 1 : size, alignment, get_current_category());
+	if (!pointer) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+} // namespace
+
+void *operator new(size_t size) {
+	return tracked_new(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new[](size_t size) {
+	return tracked_new(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+	return tracked_new(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+	return tracked_new(size, static_cast<size_t>(alignment));
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+	return tracked_aligned_malloc(size == 0 ? 1 : size, 0, get_current_category());
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+	return tracked_aligned_malloc(size == 0 ? 1 : size, 0, get_current_category());
+}
+
+void operator delete(void *pointer) noexcept {
+	tracked_free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+	tracked_free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+	tracked_free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+	tracked_free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+	tracked_free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+	tracked_free(pointer);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept {
+	tracked_free(pointer);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept {
+	tracked_free(pointer);
+}
+
+#endif
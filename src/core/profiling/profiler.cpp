@@ -0,0 +1,264 @@
+#include "tramogi/core/profiling/profiler.h"
+#include "tramogi/core/errors.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tramogi::core::profiling {
+
+namespace {
+
+struct ZoneEvent {
+	const char *name;
+	uint64_t begin_ns;
+	uint64_t end_ns;
+};
+
+constexpr uint32_t chunk_capacity = 4096;
+
+constexpr uint32_t get_chunk_count(uint32_t zone_count) {
+	return std::max((zone_count + chunk_capacity - 1) / chunk_capacity, 1u);
+}
+
+constinit std::atomic<uint32_t> max_chunks_per_thread {
+	get_chunk_count(default_max_zones_per_thread)
+};
+
+struct Chunk {
+	ZoneEvent events[chunk_capacity];
+	std::atomic<uint32_t> count {0};
+	std::atomic<Chunk *> next {nullptr};
+};
+
+// Single producer (the owning thread), any number of readers. Events are published with a
+// release store on the chunk count, new chunks are linked the same way, and nothing is ever
+// removed while the profiler is alive, so writers never lock. Once the buffer has
+// `max_chunks_per_thread` full chunks, events are counted instead of kept.
+class ThreadBuffer {
+public:
+	ThreadBuffer() : head(std::make_unique<Chunk>()), tail(head.get()) {}
+
+	~ThreadBuffer() {
+		Chunk *chunk = head->next.load(std::memory_order_relaxed);
+		while (chunk) {
+			Chunk *next = chunk->next.load(std::memory_order_relaxed);
+			delete chunk;
+			chunk = next;
+		}
+	}
+
+	ThreadBuffer(const ThreadBuffer &) = delete;
+	ThreadBuffer &operator=(const ThreadBuffer &) = delete;
+
+	void push(const ZoneEvent &event) {
+		uint32_t count = tail->count.load(std::memory_order_relaxed);
+		if (count == chunk_capacity) {
+			if (chunk_count >= max_chunks_per_thread.load(std::memory_order_relaxed)) {
+				dropped_count.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			Chunk *chunk = new Chunk();
+			tail->next.store(chunk, std::memory_order_release);
+			tail = chunk;
+			++chunk_count;
+			count = 0;
+		}
+		tail->events[count] = event;
+		tail->count.store(count + 1, std::memory_order_release);
+	}
+
+	template <typename Fn> void for_each(Fn &&fn) const {
+		for (const Chunk *chunk = head.get(); chunk;
+			 chunk = chunk->next.load(std::memory_order_acquire)) {
+			uint32_t count = chunk->count.load(std::memory_order_acquire);
+			for (uint32_t i = 0; i < count; ++i) {
+				fn(chunk->events[i]);
+			}
+		}
+	}
+
+	uint32_t thread_id = 0;
+	std::string name;
+	std::atomic<uint64_t> dropped_count {0};
+
+private:
+	std::unique_ptr<Chunk> head;
+	Chunk *tail;
+	uint32_t chunk_count = 1;
+};
+
+struct Registry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+Registry &get_registry() {
+	static Registry registry;
+	return registry;
+}
+
+// Buffers are owned by the registry so zones recorded by threads that already exited still
+// make it into the trace.
+ThreadBuffer &get_thread_buffer() {
+	thread_local ThreadBuffer *buffer = nullptr;
+	if (!buffer) {
+		Registry &registry = get_registry();
+		std::lock_guard lock(registry.mutex);
+		auto &owned = registry.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+		owned->thread_id = static_cast<uint32_t>(registry.buffers.size());
+		owned->name = std::format("thread {}", owned->thread_id);
+		buffer = owned.get();
+	}
+	return *buffer;
+}
+
+void append_json_string(std::string &out, std::string_view value) {
+	out += '"';
+	for (char c : value) {
+		switch (c) {
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		default:
+			out += c;
+			break;
+		}
+	}
+	out += '"';
+}
+
+} // namespace
+
+void set_thread_name(const char *name) {
+	ThreadBuffer &buffer = get_thread_buffer();
+	std::lock_guard lock(get_registry().mutex);
+	buffer.name = name;
+}
+
+void set_max_zones_per_thread(uint32_t count) {
+	max_chunks_per_thread.store(get_chunk_count(count), std::memory_order_relaxed);
+}
+
+uint64_t get_dropped_zone_count() {
+	Registry &registry = get_registry();
+	std::lock_guard lock(registry.mutex);
+	uint64_t dropped_count = 0;
+	for (const auto &buffer : registry.buffers) {
+		dropped_count += buffer->dropped_count.load(std::memory_order_relaxed);
+	}
+	return dropped_count;
+}
+
+void record_zone(const char *name, uint64_t begin_ns, uint64_t end_ns) {
+	get_thread_buffer().push({name, begin_ns, end_ns});
+}
+
+uint32_t create_track(const char *name) {
+	Registry &registry = get_registry();
+	std::lock_guard lock(registry.mutex);
+	auto &owned = registry.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+	owned->thread_id = static_cast<uint32_t>(registry.buffers.size());
+	owned->name = name;
+	return owned->thread_id;
+}
+
+void record_track_zone(uint32_t track, const char *name, uint64_t begin_ns, uint64_t end_ns) {
+	Registry &registry = get_registry();
+	std::lock_guard lock(registry.mutex);
+	registry.buffers[track - 1]->push({name, begin_ns, end_ns});
+}
+
+Result<> write_chrome_trace(const char *filepath) {
+	Registry &registry = get_registry();
+	std::lock_guard lock(registry.mutex);
+
+	uint64_t origin_ns = std::numeric_limits<uint64_t>::max();
+	for (const auto &buffer : registry.buffers) {
+		buffer->for_each([&origin_ns](const ZoneEvent &event) {
+			origin_ns = std::min(origin_ns, event.begin_ns);
+		});
+	}
+
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	auto separator = [&json, &first]() {
+		if (!first) {
+			json += ",\n";
+		}
+		first = false;
+	};
+
+	for (const auto &buffer : registry.buffers) {
+		separator();
+		json += std::format(
+			"{{\"ph\":\"M\",\"pid\":1,\"tid\":{},\"name\":\"thread_name\",\"args\":{{\"name\":",
+			buffer->thread_id
+		);
+		uint64_t dropped_count = buffer->dropped_count.load(std::memory_order_relaxed);
+		if (dropped_count > 0) {
+			append_json_string(
+				json,
+				std::format("{} ({} zones dropped)", buffer->name, dropped_count)
+			);
+		} else {
+			append_json_string(json, buffer->name);
+		}
+		json += "}}";
+
+		buffer->for_each([&](const ZoneEvent &event) {
+			separator();
+			json += "{\"ph\":\"X\",\"pid\":1,\"name\":";
+			append_json_string(json, event.name);
+			json += std::format(
+				",\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+				buffer->thread_id,
+				static_cast<double>(event.begin_ns - origin_ns) / 1000.0,
+				static_cast<double>(event.end_ns - event.begin_ns) / 1000.0
+			);
+		});
+	}
+	json += "]}\n";
+
+	std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		return Error("Failed to open trace file");
+	}
+	file.write(json.data(), static_cast<std::streamsize>(json.size()));
+	if (!file) {
+		return Error("Failed to write trace file");
+	}
+
+	return {};
+}
+
+double measure_zone_overhead(uint32_t iterations) {
+	if (iterations == 0) {
+		return 0.0;
+	}
+
+	ThreadBuffer scratch;
+	uint64_t start = now_ns();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		uint64_t begin = now_ns();
+		scratch.push({"overhead", begin, now_ns()});
+	}
+	uint64_t end = now_ns();
+
+	return static_cast<double>(end - start) / iterations;
+}
+
+} // namespace tramogi::core::profiling
@@ -0,0 +1,270 @@
+#include "tramogi/core/telemetry/telemetry.h"
+#include "tramogi/core/errors.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tramogi::core::telemetry {
+
+constexpr uint64_t max_trackable_value = (uint64_t(1) << Histogram::max_value_bits) - 1;
+constexpr uint32_t bucket_total =
+	(Histogram::max_value_bits - Histogram::sub_bucket_bits + 1) * Histogram::sub_bucket_count;
+
+static uint64_t steady_now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			   std::chrono::steady_clock::now().time_since_epoch()
+	)
+		.count();
+}
+
+static double to_ms(uint64_t nanoseconds) {
+	return static_cast<double>(nanoseconds) / 1000000.0;
+}
+
+Histogram::Histogram() : buckets(bucket_total, 0) {}
+
+uint32_t Histogram::get_bucket_index(uint64_t value) {
+	value = std::min(value, max_trackable_value);
+	if (value < sub_bucket_count) {
+		return static_cast<uint32_t>(value);
+	}
+	uint32_t shift = static_cast<uint32_t>(std::bit_width(value)) - 1 - sub_bucket_bits;
+	return shift * sub_bucket_count + static_cast<uint32_t>(value >> shift);
+}
+
+uint64_t Histogram::get_bucket_lower_bound(uint32_t index) {
+	if (index < sub_bucket_count * 2) {
+		return index;
+	}
+	uint32_t shift = index / sub_bucket_count - 1;
+	uint64_t sub_bucket = index - shift * sub_bucket_count;
+	return sub_bucket << shift;
+}
+
+uint64_t Histogram::get_bucket_upper_bound(uint32_t index) {
+	if (index < sub_bucket_count * 2) {
+		return index;
+	}
+	uint32_t shift = index / sub_bucket_count - 1;
+	return get_bucket_lower_bound(index) + (uint64_t(1) << shift) - 1;
+}
+
+void Histogram::add(uint64_t value) {
+	++buckets[get_bucket_index(value)];
+	++count;
+}
+
+void Histogram::remove(uint64_t value) {
+	uint32_t &bucket = buckets[get_bucket_index(value)];
+	if (bucket > 0) {
+		--bucket;
+		--count;
+	}
+}
+
+void Histogram::clear() {
+	std::ranges::fill(buckets, 0);
+	count = 0;
+}
+
+uint64_t Histogram::get_percentile(double percentile) const {
+	if (count == 0) {
+		return 0;
+	}
+
+	double fraction = std::clamp(percentile, 0.0, 100.0) / 100.0;
+	auto target = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(fraction * count)), 1);
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < buckets.size(); ++i) {
+		seen += buckets[i];
+		if (seen >= target) {
+			return (get_bucket_lower_bound(i) + get_bucket_upper_bound(i)) / 2;
+		}
+	}
+	return get_max();
+}
+
+uint64_t Histogram::get_max() const {
+	for (uint32_t i = static_cast<uint32_t>(buckets.size()); i > 0; --i) {
+		if (buckets[i - 1] > 0) {
+			return get_bucket_upper_bound(i - 1);
+		}
+	}
+	return 0;
+}
+
+FrameTelemetry::FrameTelemetry(std::vector<std::string> phase_names, uint32_t window_size)
+	: current_phases(phase_names.size(), 0), window_size(std::max(window_size, 1u)) {
+	metrics.reserve(phase_names.size() + 1);
+	metrics.push_back({.name = "frame"});
+	for (auto &name : phase_names) {
+		metrics.push_back({.name = std::move(name)});
+	}
+	for (auto &metric : metrics) {
+		metric.window_samples.assign(this->window_size, 0);
+	}
+}
+
+void FrameTelemetry::begin_frame() {
+	std::ranges::fill(current_phases, 0);
+	frame_begin_ns = steady_now_ns();
+}
+
+void FrameTelemetry::end_frame() {
+	push_sample(metrics[0], steady_now_ns() - frame_begin_ns);
+	for (uint32_t i = 0; i < current_phases.size(); ++i) {
+		push_sample(metrics[i + 1], current_phases[i]);
+	}
+
+	++frame_count;
+	window_cursor = (window_cursor + 1) % window_size;
+}
+
+void FrameTelemetry::add_phase_time(uint32_t phase, uint64_t nanoseconds) {
+	current_phases[phase] += nanoseconds;
+}
+
+void FrameTelemetry::push_sample(Metric &metric, uint64_t value) {
+	uint64_t &slot = metric.window_samples[window_cursor];
+	bool is_full = frame_count >= window_size;
+	uint64_t evicted = slot;
+	if (is_full) {
+		metric.window.remove(evicted);
+		metric.window_sum -= evicted;
+	}
+
+	slot = value;
+	metric.window.add(value);
+	metric.window_sum += value;
+	if (value >= metric.window_max) {
+		metric.window_max = value;
+	} else if (is_full && evicted == metric.window_max) {
+		uint64_t filled = std::min<uint64_t>(frame_count + 1, window_size);
+		metric.window_max = *std::ranges::max_element(
+			metric.window_samples.begin(),
+			metric.window_samples.begin() + static_cast<std::ptrdiff_t>(filled)
+		);
+	}
+
+	metric.session.add(value);
+	metric.session_sum += value;
+	metric.session_max = std::max(metric.session_max, value);
+}
+
+static PercentileSummary summarize(const Histogram &histogram, uint64_t sum, uint64_t max) {
+	uint64_t count = histogram.get_count();
+	if (count == 0) {
+		return {};
+	}
+	return {
+		.count = count,
+		.mean_ms = to_ms(sum) / static_cast<double>(count),
+		.p50_ms = to_ms(histogram.get_percentile(50.0)),
+		.p95_ms = to_ms(histogram.get_percentile(95.0)),
+		.p99_ms = to_ms(histogram.get_percentile(99.0)),
+		.max_ms = to_ms(max),
+	};
+}
+
+PercentileSummary FrameTelemetry::get_window_summary(uint32_t metric) const {
+	const Metric &entry = metrics[metric];
+	return summarize(entry.window, entry.window_sum, entry.window_max);
+}
+
+PercentileSummary FrameTelemetry::get_session_summary(uint32_t metric) const {
+	const Metric &entry = metrics[metric];
+	return summarize(entry.session, entry.session_sum, entry.session_max);
+}
+
+static std::string summary_to_json(const PercentileSummary &summary) {
+	return std::format(
+		"{{\"count\":{},\"mean_ms\":{:.4f},\"p50_ms\":{:.4f},\"p95_ms\":{:.4f},"
+		"\"p99_ms\":{:.4f},\"max_ms\":{:.4f}}}",
+		summary.count,
+		summary.mean_ms,
+		summary.p50_ms,
+		summary.p95_ms,
+		summary.p99_ms,
+		summary.max_ms
+	);
+}
+
+static std::string summary_to_csv(
+	std::string_view metric,
+	std::string_view scope,
+	const PercentileSummary &summary
+) {
+	return std::format(
+		"{},{},{},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f}\n",
+		metric,
+		scope,
+		summary.count,
+		summary.mean_ms,
+		summary.p50_ms,
+		summary.p95_ms,
+		summary.p99_ms,
+		summary.max_ms
+	);
+}
+
+static Result<> write_file(const char *filepath, const std::string &content) {
+	std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		return Error("Failed to open telemetry file");
+	}
+	file.write(content.data(), static_cast<std::streamsize>(content.size()));
+	if (!file) {
+		return Error("Failed to write telemetry file");
+	}
+	return {};
+}
+
+Result<> FrameTelemetry::export_json(const char *filepath) const {
+	std::string json = std::format(
+		"{{\"frames\":{},\"window_size\":{},\"metrics\":[",
+		frame_count,
+		window_size
+	);
+	for (uint32_t i = 0; i < metrics.size(); ++i) {
+		if (i > 0) {
+			json += ",";
+		}
+		json += std::format(
+			"\n{{\"name\":\"{}\",\"window\":{},\"session\":{}}}",
+			metrics[i].name,
+			summary_to_json(get_window_summary(i)),
+			summary_to_json(get_session_summary(i))
+		);
+	}
+	json += "\n]}\n";
+
+	return write_file(filepath, json);
+}
+
+Result<> FrameTelemetry::export_csv(const char *filepath) const {
+	std::string csv = "metric,scope,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+	for (uint32_t i = 0; i < metrics.size(); ++i) {
+		csv += summary_to_csv(metrics[i].name, "window", get_window_summary(i));
+		csv += summary_to_csv(metrics[i].name, "session", get_session_summary(i));
+	}
+
+	return write_file(filepath, csv);
+}
+
+FrameTelemetry::ScopedPhase::ScopedPhase(FrameTelemetry &telemetry, uint32_t phase)
+	: telemetry(telemetry), phase(phase), begin_ns(steady_now_ns()) {}
+
+FrameTelemetry::ScopedPhase::~ScopedPhase() {
+	telemetry.add_phase_time(phase, steady_now_ns() - begin_ns);
+}
+
+} // namespace tramogi::core::telemetry
@@ -0,0 +1,131 @@
+#include "tramogi/core/threading/thread_pool.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace tramogi::core::threading {
+
+namespace {
+
+thread_local uint32_t thread_index = 0;
+
+} // namespace
+
+uint32_t ThreadPool::get_default_thread_count() {
+	uint32_t hardware_threads = std::thread::hardware_concurrency();
+	return std::max(hardware_threads, 2u) - 1;
+}
+
+ThreadPool::ThreadPool(uint32_t thread_count) {
+	workers.reserve(thread_count);
+	for (uint32_t i = 0; i < thread_count; ++i) {
+		workers.emplace_back(&ThreadPool::run_worker, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(mutex);
+		is_stopping = true;
+	}
+	condition.notify_all();
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::enqueue(std::move_only_function<void()> task) {
+	{
+		std::lock_guard lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	condition.notify_one();
+}
+
+void ThreadPool::parallel_for(uint32_t count, const std::function<void(uint32_t)> &fn) {
+	if (count == 0) {
+		return;
+	}
+
+	// Every participant pulls indices until none are left, so uneven calls balance out. Helpers
+	// stuck behind other tasks find nothing left once they start, so only the calls themselves are
+	// waited for. The state outlives this call for their sake.
+	struct State {
+		std::atomic<uint32_t> next_index {0};
+		std::atomic<uint32_t> completed_count {0};
+		uint32_t count = 0;
+		const std::function<void(uint32_t)> *fn = nullptr;
+		std::mutex mutex;
+		// The first thrown, rethrown by the caller. Calls that threw still count as completed.
+		std::exception_ptr exception;
+
+		void run() {
+			for (uint32_t i = next_index++; i < count; i = next_index++) {
+				try {
+					(*fn)(i);
+				} catch (...) {
+					std::lock_guard lock(mutex);
+					if (!exception) {
+						exception = std::current_exception();
+					}
+				}
+				if (++completed_count == count) {
+					completed_count.notify_all();
+				}
+			}
+		}
+	};
+	auto state = std::make_shared<State>();
+	state->count = count;
+	state->fn = &fn;
+
+	uint32_t helper_count = std::min(get_thread_count(), count - 1);
+	for (uint32_t i = 0; i < helper_count; ++i) {
+		enqueue([state]() {
+			state->run();
+		});
+	}
+	state->run();
+
+	for (uint32_t completed = state->completed_count; completed < count;
+		 completed = state->completed_count) {
+		state->completed_count.wait(completed);
+	}
+	if (state->exception) {
+		std::rethrow_exception(state->exception);
+	}
+}
+
+uint32_t ThreadPool::get_thread_index() {
+	return thread_index;
+}
+
+void ThreadPool::run_worker(uint32_t index) {
+	thread_index = index + 1;
+	TRAMOGI_PROFILE_THREAD("worker");
+
+	while (true) {
+		std::move_only_function<void()> task;
+		{
+			std::unique_lock lock(mutex);
+			condition.wait(lock, [this]() {
+				return is_stopping || !tasks.empty();
+			});
+			if (tasks.empty()) {
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+} // namespace tramogi::core::threading
@@ -1,8 +1,21 @@
 #include "allocator.h"
 #include "device.h"
+#include "host_allocator.h"
+#include "memory_accounting.h"
 #include "physical_device.h"
+#include "tlsf.h"
 #include "tramogi/core/errors.h"
+#include "tramogi/core/logging/logging.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_raii.hpp>
 
 namespace tramogi::graphics {
@@ -10,12 +23,275 @@ namespace tramogi::graphics {
 using core::Error;
 using core::Result;
 
-Result<uint32_t> find_memory_type(
-	const PhysicalDevice &physical_device,
+constexpr std::array<const char *, static_cast<size_t>(ResourceKind::Count)> resource_kind_names {
+	"vertex",
+	"index",
+	"uniform",
+	"storage",
+	"staging",
+	"texture",
+	"attachment",
+	"other",
+};
+
+// Dedicated blocks and block sizes derived from the heap size are rounded to this.
+constexpr uint64_t block_alignment = 256;
+
+const char *to_string(ResourceKind kind) {
+	return resource_kind_names[static_cast<size_t>(kind)];
+}
+
+struct MemoryBlock {
+	vk::raii::DeviceMemory memory = nullptr;
+	Tlsf tlsf;
+	uint32_t memory_type_index = 0;
+	// Holds buffers and linear images only; the others hold optimally tiled images.
+	bool is_linear = true;
+	bool is_dedicated = false;
+	bool is_defragmentation_source = false;
+	void *mapped = nullptr;
+
+	uint64_t get_used_bytes() const {
+		return tlsf.get_size() - tlsf.get_free_bytes();
+	}
+};
+
+struct DeviceMemoryAllocator::Impl {
+	mutable std::mutex mutex;
+
+	MemoryAccounting *accounting = nullptr;
+	const vk::raii::Device *device = nullptr;
+	vk::PhysicalDeviceMemoryProperties memory_properties {};
+	uint64_t buffer_image_granularity = 1;
+	uint64_t non_coherent_atom_size = 1;
+	std::array<uint64_t, vk::MaxMemoryTypes> block_sizes {};
+
+	std::vector<std::unique_ptr<MemoryBlock>> blocks;
+
+	Result<MemoryBlock *> create_block(
+		uint32_t memory_type_index,
+		uint64_t size,
+		bool is_linear,
+		bool is_dedicated
+	);
+	void destroy_block(const MemoryBlock *block);
+	void free(const Allocation::Impl &allocation);
+	void *map(MemoryBlock &block);
+	bool is_coherent(const MemoryBlock &block) const;
+	vk::MappedMemoryRange get_mapped_range(
+		const Allocation::Impl &allocation,
+		uint64_t offset,
+		uint64_t size
+	) const;
+};
+
+struct Allocation::Impl {
+	DeviceMemoryAllocator::Impl *allocator = nullptr;
+	MemoryBlock *block = nullptr;
+	uint32_t node = 0;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	ResourceKind kind = ResourceKind::Other;
+
+	~Impl() {
+		if (allocator) {
+			allocator->free(*this);
+		}
+	}
+};
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint64_t align_down(uint64_t value, uint64_t alignment) {
+	return value / alignment * alignment;
+}
+
+static double to_mib(uint64_t bytes) {
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+Result<MemoryBlock *> DeviceMemoryAllocator::Impl::create_block(
+	uint32_t memory_type_index,
+	uint64_t size,
+	bool is_linear,
+	bool is_dedicated
+) {
+	vk::MemoryAllocateInfo allocate_info {
+		.allocationSize = size,
+		.memoryTypeIndex = memory_type_index,
+	};
+
+	auto block = std::make_unique<MemoryBlock>(MemoryBlock {
+		.tlsf = Tlsf(size),
+		.memory_type_index = memory_type_index,
+		.is_linear = is_linear,
+		.is_dedicated = is_dedicated,
+	});
+	try {
+		block->memory =
+			vk::raii::DeviceMemory(*device, allocate_info, get_host_allocation_callbacks());
+	} catch (const vk::SystemError &e) {
+		return Error(std::format("Failed to allocate device memory block: {}", e.what()));
+	}
+
+	accounting->record_block_allocation(memory_type_index, size);
+	TRAMOGI_LOG_DEBUG(
+		Graphics,
+		"Allocated {}{:.2f} MiB device memory block of type {}",
+		is_dedicated ? "dedicated " : "",
+		to_mib(size),
+		memory_type_index
+	);
+
+	blocks.push_back(std::move(block));
+	return blocks.back().get();
+}
+
+void DeviceMemoryAllocator::Impl::destroy_block(const MemoryBlock *block) {
+	accounting->record_block_free(block->memory_type_index, block->tlsf.get_size());
+	std::erase_if(blocks, [block](const std::unique_ptr<MemoryBlock> &candidate) {
+		return candidate.get() == block;
+	});
+}
+
+void DeviceMemoryAllocator::Impl::free(const Allocation::Impl &allocation) {
+	std::lock_guard lock(mutex);
+
+	MemoryBlock *block = allocation.block;
+	block->tlsf.free(allocation.node);
+	accounting->record_free(block->memory_type_index, allocation.kind, allocation.size);
+
+	if (!block->tlsf.is_empty()) {
+		return;
+	}
+	if (block->is_dedicated || block->is_defragmentation_source) {
+		destroy_block(block);
+		return;
+	}
+
+	// Keep a single empty block around per memory type so that a resource being recreated
+	// does not bounce between allocating and freeing a whole block.
+	bool has_spare = std::ranges::any_of(blocks, [block](const auto &other) {
+		return other.get() != block && !other->is_dedicated &&
+			   other->memory_type_index == block->memory_type_index &&
+			   other->is_linear == block->is_linear && other->tlsf.is_empty();
+	});
+	if (has_spare) {
+		destroy_block(block);
+	}
+}
+
+void *DeviceMemoryAllocator::Impl::map(MemoryBlock &block) {
+	std::lock_guard lock(mutex);
+	if (!block.mapped) {
+		block.mapped = block.memory.mapMemory(0, vk::WholeSize);
+	}
+	return block.mapped;
+}
+
+bool DeviceMemoryAllocator::Impl::is_coherent(const MemoryBlock &block) const {
+	return static_cast<bool>(
+		memory_properties.memoryTypes[block.memory_type_index].propertyFlags &
+		vk::MemoryPropertyFlagBits::eHostCoherent
+	);
+}
+
+vk::MappedMemoryRange DeviceMemoryAllocator::Impl::get_mapped_range(
+	const Allocation::Impl &allocation,
+	uint64_t offset,
+	uint64_t size
+) const {
+	// Ranges must be aligned to nonCoherentAtomSize or end at the end of the memory. Non-coherent
+	// allocations start and end on atoms, see `get_allocation_requirements`, so rounding out stays
+	// within the allocation.
+	uint64_t begin = align_down(allocation.offset + offset, non_coherent_atom_size);
+	uint64_t end = std::min(
+		align_up(allocation.offset + offset + size, non_coherent_atom_size),
+		allocation.block->tlsf.get_size()
+	);
+	return vk::MappedMemoryRange {
+		.memory = *allocation.block->memory,
+		.offset = begin,
+		.size = end - begin,
+	};
+}
+
+Allocation::Allocation() : impl(std::make_unique<Impl>()) {}
+Allocation::~Allocation() = default;
+// Moved-from allocations are left empty, the same as default constructed ones.
+Allocation::Allocation(Allocation &&other)
+	: impl(std::exchange(other.impl, std::make_unique<Impl>())) {}
+
+Allocation &Allocation::operator=(Allocation &&other) {
+	if (this != &other) {
+		// Frees what this allocation held.
+		impl = std::exchange(other.impl, std::make_unique<Impl>());
+	}
+	return *this;
+}
+
+vk::DeviceMemory Allocation::get_memory() const {
+	if (!impl->block) {
+		return nullptr;
+	}
+	return *impl->block->memory;
+}
+
+uint64_t Allocation::get_offset() const {
+	return impl->offset;
+}
+
+uint64_t Allocation::get_size() const {
+	return impl->size;
+}
+
+uint32_t Allocation::get_memory_type_index() const {
+	return impl->block ? impl->block->memory_type_index : 0;
+}
+
+ResourceKind Allocation::get_kind() const {
+	return impl->kind;
+}
+
+void *Allocation::map() {
+	assert(impl->block && "Mapping an empty allocation");
+	return static_cast<char *>(impl->allocator->map(*impl->block)) + impl->offset;
+}
+
+void Allocation::unmap() {}
+
+bool Allocation::is_coherent() const {
+	assert(impl->block && "Querying an empty allocation");
+	return impl->allocator->is_coherent(*impl->block);
+}
+
+void Allocation::flush(uint64_t offset, uint64_t size) {
+	assert(offset + size <= impl->size && "Flushing past the end of the allocation");
+	if (size == 0 || is_coherent()) {
+		return;
+	}
+	impl->allocator->device->flushMappedMemoryRanges(
+		impl->allocator->get_mapped_range(*impl, offset, size)
+	);
+}
+
+void Allocation::invalidate(uint64_t offset, uint64_t size) {
+	assert(offset + size <= impl->size && "Invalidating past the end of the allocation");
+	if (size == 0 || is_coherent()) {
+		return;
+	}
+	impl->allocator->device->invalidateMappedMemoryRanges(
+		impl->allocator->get_mapped_range(*impl, offset, size)
+	);
+}
+
+static Result<uint32_t> find_memory_type(
+	const vk::PhysicalDeviceMemoryProperties &memory_properties,
 	uint32_t type_filter,
 	vk::MemoryPropertyFlags properties
 ) {
-	auto memory_properties = physical_device.get_memory_properties();
 	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
 		if (type_filter & (1 << i) &&
 			(memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
@@ -26,32 +302,276 @@ Result<uint32_t> find_memory_type(
 	return Error("No suitable memory type");
 }
 
-core::Result<vk::raii::DeviceMemory> allocate_memory(
-	const Device &device,
-	vk::MemoryRequirements memory_requirements,
+Result<uint32_t> select_memory_type(
+	const vk::PhysicalDeviceMemoryProperties &memory_properties,
+	uint32_t memory_type_bits,
 	MemoryType memory_type
 ) {
-	auto properties = vk::MemoryPropertyFlagBits::eHostVisible |
-					  vk::MemoryPropertyFlagBits::eHostCoherent;
+	vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eHostVisible;
+	vk::MemoryPropertyFlags preferred_properties = vk::MemoryPropertyFlagBits::eHostCoherent;
 	if (memory_type == MemoryType::Gpu) {
 		properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+		preferred_properties = {};
+	} else if (memory_type == MemoryType::Lazy) {
+		properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+		preferred_properties = vk::MemoryPropertyFlagBits::eLazilyAllocated;
+	}
+
+	// Host memory falls back to non-coherent types, which mapped users flush and invalidate.
+	auto memory_index =
+		find_memory_type(memory_properties, memory_type_bits, properties | preferred_properties);
+	if (!memory_index) {
+		memory_index = find_memory_type(memory_properties, memory_type_bits, properties);
+	}
+	return memory_index;
+}
+
+uint64_t get_block_size(uint64_t heap_size, uint64_t block_size) {
+	// Small heaps, like a 256 MiB BAR heap, would be used up by a couple of full blocks.
+	return std::min(block_size, align_up(heap_size / 8, block_alignment));
+}
+
+bool uses_linear_blocks(ResourceKind kind, uint64_t buffer_image_granularity) {
+	return buffer_image_granularity <= 1 ||
+		   (kind != ResourceKind::Texture && kind != ResourceKind::Attachment);
+}
+
+vk::MemoryRequirements get_allocation_requirements(
+	vk::MemoryRequirements memory_requirements,
+	vk::MemoryPropertyFlags property_flags,
+	uint64_t non_coherent_atom_size
+) {
+	bool is_non_coherent = (property_flags & vk::MemoryPropertyFlagBits::eHostVisible) &&
+						   !(property_flags & vk::MemoryPropertyFlagBits::eHostCoherent);
+	if (is_non_coherent) {
+		memory_requirements.size = align_up(memory_requirements.size, non_coherent_atom_size);
+		memory_requirements.alignment =
+			std::max(memory_requirements.alignment, non_coherent_atom_size);
 	}
+	return memory_requirements;
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator() : impl(std::make_unique<Impl>()) {}
+DeviceMemoryAllocator::~DeviceMemoryAllocator() = default;
+
+void DeviceMemoryAllocator::init(const Device &device, uint64_t block_size) {
+	std::lock_guard lock(impl->mutex);
+	impl->accounting = &device.get_memory_accounting();
+	impl->device = &device.get_device();
 
-	auto memory_index = find_memory_type(
-		device.get_physical_device(),
+	const PhysicalDevice &physical_device = device.get_physical_device();
+	impl->memory_properties = physical_device.get_memory_properties();
+	vk::PhysicalDeviceLimits limits = physical_device.get_physical_device().getProperties().limits;
+	impl->buffer_image_granularity = limits.bufferImageGranularity;
+	impl->non_coherent_atom_size = std::max<uint64_t>(limits.nonCoherentAtomSize, 1);
+
+	for (uint32_t i = 0; i < impl->memory_properties.memoryTypeCount; ++i) {
+		uint32_t heap_index = impl->memory_properties.memoryTypes[i].heapIndex;
+		uint64_t heap_size = impl->memory_properties.memoryHeaps[heap_index].size;
+		impl->block_sizes[i] = get_block_size(heap_size, block_size);
+	}
+}
+
+Result<Allocation> DeviceMemoryAllocator::allocate(
+	vk::MemoryRequirements memory_requirements,
+	MemoryType memory_type,
+	ResourceKind kind
+) {
+	std::lock_guard lock(impl->mutex);
+	auto memory_index = select_memory_type(
+		impl->memory_properties,
 		memory_requirements.memoryTypeBits,
-		properties
+		memory_type
 	);
 	if (!memory_index) {
 		return Error(memory_index.error());
 	}
+	uint32_t memory_type_index = memory_index.value();
+	vk::MemoryPropertyFlags property_flags =
+		impl->memory_properties.memoryTypes[memory_type_index].propertyFlags;
+	memory_requirements = get_allocation_requirements(
+		memory_requirements,
+		property_flags,
+		impl->non_coherent_atom_size
+	);
 
-	vk::MemoryAllocateInfo allocate_info {
-		.allocationSize = memory_requirements.size,
-		.memoryTypeIndex = memory_index.value()
-	};
+	bool is_linear = uses_linear_blocks(kind, impl->buffer_image_granularity);
+	uint64_t block_size = impl->block_sizes[memory_type_index];
+	// A shared block of lazily allocated memory would be reported, and possibly committed, in full
+	// for a single attachment.
+	bool is_lazy = static_cast<bool>(property_flags & vk::MemoryPropertyFlagBits::eLazilyAllocated);
 
-	return vk::raii::DeviceMemory(device.get_device(), allocate_info);
+	MemoryBlock *block = nullptr;
+	core::Option<TlsfRange> range;
+	if (is_lazy || memory_requirements.size > block_size / 2) {
+		auto block_result = impl->create_block(
+			memory_type_index,
+			align_up(memory_requirements.size, block_alignment),
+			is_linear,
+			true
+		);
+		if (!block_result) {
+			return Error(block_result.error());
+		}
+		block = block_result.value();
+		range = block->tlsf.allocate(memory_requirements.size, memory_requirements.alignment);
+	} else {
+		for (const auto &candidate : impl->blocks) {
+			if (candidate->is_dedicated || candidate->is_defragmentation_source ||
+				candidate->memory_type_index != memory_type_index ||
+				candidate->is_linear != is_linear) {
+				continue;
+			}
+			range = candidate->tlsf.allocate(
+				memory_requirements.size,
+				memory_requirements.alignment
+			);
+			if (range) {
+				block = candidate.get();
+				break;
+			}
+		}
+
+		if (!block) {
+			auto block_result =
+				impl->create_block(memory_type_index, block_size, is_linear, false);
+			if (!block_result) {
+				return Error(block_result.error());
+			}
+			block = block_result.value();
+			range = block->tlsf.allocate(memory_requirements.size, memory_requirements.alignment);
+		}
+	}
+	if (!range) {
+		return Error("Failed to sub-allocate device memory");
+	}
+
+	Allocation allocation;
+	allocation.impl->allocator = impl.get();
+	allocation.impl->block = block;
+	allocation.impl->node = range->node;
+	allocation.impl->offset = range->offset;
+	allocation.impl->size = memory_requirements.size;
+	allocation.impl->kind = kind;
+
+	impl->accounting->record_allocation(memory_type_index, kind, memory_requirements.size);
+
+	return allocation;
+}
+
+static void add_block_stats(MemoryBlockStats &stats, const MemoryBlock &block) {
+	++stats.block_count;
+	stats.allocation_count += block.tlsf.get_allocation_count();
+	stats.reserved_bytes += block.tlsf.get_size();
+	stats.used_bytes += block.get_used_bytes();
+	stats.largest_free_range =
+		std::max(stats.largest_free_range, block.tlsf.get_largest_free_range());
+}
+
+MemoryBlockStats DeviceMemoryAllocator::get_stats() const {
+	std::lock_guard lock(impl->mutex);
+	MemoryBlockStats stats;
+	for (const auto &block : impl->blocks) {
+		add_block_stats(stats, *block);
+	}
+	return stats;
+}
+
+MemoryBlockStats DeviceMemoryAllocator::get_memory_type_stats(uint32_t memory_type_index) const {
+	std::lock_guard lock(impl->mutex);
+	MemoryBlockStats stats;
+	for (const auto &block : impl->blocks) {
+		if (block->memory_type_index == memory_type_index) {
+			add_block_stats(stats, *block);
+		}
+	}
+	return stats;
+}
+
+uint32_t DeviceMemoryAllocator::begin_defragmentation(float max_block_usage) {
+	std::lock_guard lock(impl->mutex);
+
+	std::vector<MemoryBlock *> candidates;
+	for (const auto &block : impl->blocks) {
+		if (!block->is_dedicated) {
+			candidates.push_back(block.get());
+		}
+	}
+	// Group by memory type and block class, sparsest blocks first.
+	std::ranges::sort(candidates, [](const MemoryBlock *a, const MemoryBlock *b) {
+		if (a->memory_type_index != b->memory_type_index) {
+			return a->memory_type_index < b->memory_type_index;
+		}
+		if (a->is_linear != b->is_linear) {
+			return a->is_linear < b->is_linear;
+		}
+		return a->get_used_bytes() < b->get_used_bytes();
+	});
+
+	uint32_t source_count = 0;
+	for (auto group_begin = candidates.begin(); group_begin != candidates.end();) {
+		auto group_end = std::find_if(group_begin, candidates.end(), [&](const MemoryBlock *block) {
+			return block->memory_type_index != (*group_begin)->memory_type_index ||
+				   block->is_linear != (*group_begin)->is_linear;
+		});
+
+		uint64_t target_free_bytes = 0;
+		for (auto it = group_begin; it != group_end; ++it) {
+			target_free_bytes += (*it)->tlsf.get_free_bytes();
+		}
+
+		// The densest block of a group always stays a target.
+		for (auto it = group_begin; it + 1 < group_end; ++it) {
+			MemoryBlock *block = *it;
+			uint64_t used_bytes = block->get_used_bytes();
+			if (static_cast<double>(used_bytes) >=
+				static_cast<double>(block->tlsf.get_size()) * max_block_usage) {
+				break;
+			}
+
+			target_free_bytes -= block->tlsf.get_free_bytes();
+			if (used_bytes > target_free_bytes) {
+				break;
+			}
+			target_free_bytes -= used_bytes;
+
+			block->is_defragmentation_source = true;
+			++source_count;
+		}
+
+		group_begin = group_end;
+	}
+
+	return source_count;
+}
+
+void DeviceMemoryAllocator::end_defragmentation() {
+	std::lock_guard lock(impl->mutex);
+	for (const auto &block : impl->blocks) {
+		block->is_defragmentation_source = false;
+	}
+}
+
+bool DeviceMemoryAllocator::is_defragmentation_source(const Allocation &allocation) const {
+	std::lock_guard lock(impl->mutex);
+	return allocation.impl->block && allocation.impl->block->is_defragmentation_source;
+}
+
+double get_fragmentation(const MemoryBlockStats &stats) {
+	uint64_t free_bytes = stats.reserved_bytes - stats.used_bytes;
+	if (free_bytes == 0) {
+		return 0.0;
+	}
+	return 1.0 - static_cast<double>(stats.largest_free_range) / static_cast<double>(free_bytes);
+}
+
+core::Result<Allocation> allocate_memory(
+	const Device &device,
+	vk::MemoryRequirements memory_requirements,
+	MemoryType memory_type,
+	ResourceKind kind
+) {
+	return device.get_memory_allocator().allocate(memory_requirements, memory_type, kind);
 }
 
 } // namespace tramogi::graphics
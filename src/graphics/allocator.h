@@ -1,29 +1,162 @@
 #pragma once
 
 #include "tramogi/core/errors.h"
+#include <cstdint>
+#include <memory>
 
 namespace vk {
+class DeviceMemory;
 class PhysicalDevice;
 class MemoryRequirements;
-namespace raii {
-class DeviceMemory;
-} // namespace raii
+class PhysicalDeviceMemoryProperties;
 } // namespace vk
 
 namespace tramogi::graphics {
 
 class Device;
+class MemoryAccounting;
+class DeviceMemoryAllocator;
 
 enum class MemoryType {
 	Host,
-	Gpu
+	Gpu,
+	// Lazily allocated where the device has such memory, typically tilers, so that images with
+	// eTransientAttachment usage only get backing memory if their content has to leave the tile.
+	// Gpu memory otherwise.
+	Lazy,
+};
+
+enum class ResourceKind {
+	Vertex,
+	Index,
+	Uniform,
+	Storage,
+	Staging,
+	Texture,
+	Attachment,
+	Other,
+	Count,
+};
+
+const char *to_string(ResourceKind kind);
+
+// Owns a range of a device memory block and keeps the device's memory accounting up to date for as
+// long as it lives. Resources must be bound with `get_memory()` and `get_offset()`. Default
+// constructed and moved-from allocations are empty, with no memory and a size of 0.
+class Allocation {
+public:
+	Allocation();
+	~Allocation();
+	Allocation(const Allocation &) = delete;
+	Allocation &operator=(const Allocation &) = delete;
+	Allocation(Allocation &&);
+	Allocation &operator=(Allocation &&);
+
+	vk::DeviceMemory get_memory() const;
+	uint64_t get_offset() const;
+	uint64_t get_size() const;
+	uint32_t get_memory_type_index() const;
+	ResourceKind get_kind() const;
+
+	// Host visible blocks are mapped once and stay mapped, so this is cheap and `unmap` only
+	// exists for symmetry.
+	void *map();
+	void unmap();
+
+	// Host memory may be non-coherent, in which case host writes must be flushed before the GPU
+	// reads them and device writes invalidated before the host reads them. Ranges are relative to
+	// the allocation and widened to nonCoherentAtomSize. Both are no-ops on coherent memory.
+	bool is_coherent() const;
+	void flush(uint64_t offset, uint64_t size);
+	void invalidate(uint64_t offset, uint64_t size);
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+
+	friend class DeviceMemoryAllocator;
+};
+
+struct MemoryBlockStats {
+	uint32_t block_count = 0;
+	uint32_t allocation_count = 0;
+	// Bytes obtained from vkAllocateMemory.
+	uint64_t reserved_bytes = 0;
+	// Bytes handed out to allocations, including alignment padding.
+	uint64_t used_bytes = 0;
+	uint64_t largest_free_range = 0;
+};
+
+// 0 when all free memory of `stats` is a single range, approaching 1 as it gets splintered.
+double get_fragmentation(const MemoryBlockStats &stats);
+
+// Sub-allocates resources from large device memory blocks, one set of blocks per memory type,
+// with a TLSF manager per block. Requests bigger than half a block, and any in lazily allocated
+// memory, get a dedicated block.
+//
+// When the device's bufferImageGranularity is bigger than 1, buffers and optimally tiled images
+// are placed in separate blocks so that they can never end up on the same granularity page.
+class DeviceMemoryAllocator {
+public:
+	static constexpr uint64_t default_block_size = 64ull * 1024 * 1024;
+
+	DeviceMemoryAllocator();
+	~DeviceMemoryAllocator();
+	DeviceMemoryAllocator(const DeviceMemoryAllocator &) = delete;
+	DeviceMemoryAllocator &operator=(const DeviceMemoryAllocator &) = delete;
+
+	void init(const Device &device, uint64_t block_size = default_block_size);
+
+	[[nodiscard]] core::Result<Allocation> allocate(
+		vk::MemoryRequirements memory_requirements,
+		MemoryType memory_type,
+		ResourceKind kind
+	);
+
+	MemoryBlockStats get_stats() const;
+	MemoryBlockStats get_memory_type_stats(uint32_t memory_type_index) const;
+
+	// Marks the sparsest blocks of each memory type, used below `max_block_usage`, as sources
+	// whose content fits in the free space of the other blocks. New allocations avoid sources and
+	// sources are released as soon as they are empty. Returns the number of blocks marked.
+	uint32_t begin_defragmentation(float max_block_usage);
+	void end_defragmentation();
+	bool is_defragmentation_source(const Allocation &allocation) const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+
+	friend class Allocation;
 };
 
-// TODO: Create an allocator and use offsets
-[[nodiscard]] core::Result<vk::raii::DeviceMemory> allocate_memory(
+// The first of `memory_type_bits` with the properties `memory_type` needs, preferring the ones it
+// benefits from: coherent host memory and lazily allocated memory.
+core::Result<uint32_t> select_memory_type(
+	const vk::PhysicalDeviceMemoryProperties &memory_properties,
+	uint32_t memory_type_bits,
+	MemoryType memory_type
+);
+// Of the blocks of a memory type in a heap of `heap_size` bytes, `block_size` unless the heap is
+// small.
+uint64_t get_block_size(uint64_t heap_size, uint64_t block_size);
+// Whether resources of `kind` go to the blocks holding buffers and linear images, rather than to
+// the ones holding optimally tiled images. There is only one kind of block with a granularity of 1.
+bool uses_linear_blocks(ResourceKind kind, uint64_t buffer_image_granularity);
+// What is actually allocated in memory with `property_flags`. Non-coherent host visible memory is
+// allocated in whole `non_coherent_atom_size` atoms, so that flushing or invalidating one
+// allocation never touches another's unflushed writes.
+vk::MemoryRequirements get_allocation_requirements(
+	vk::MemoryRequirements memory_requirements,
+	vk::MemoryPropertyFlags property_flags,
+	uint64_t non_coherent_atom_size
+);
+
+[[nodiscard]] core::Result<Allocation> allocate_memory(
 	const Device &device,
 	vk::MemoryRequirements memory_requirements,
-	MemoryType memory_type
+	MemoryType memory_type,
+	ResourceKind kind
 );
 
 } // namespace tramogi::graphics
@@ -0,0 +1,247 @@
+#include "bindless_heap.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "physical_device.h"
+#include "tramogi/core/errors.h"
+#include "tramogi/core/logging/logging.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+using core::Error;
+using core::Result;
+
+// Hands out array indices, reusing freed ones first.
+struct BindlessSlots {
+	uint32_t capacity = 0;
+	uint32_t next = 0;
+	std::vector<uint32_t> free_indices;
+
+	core::Option<uint32_t> acquire() {
+		if (!free_indices.empty()) {
+			uint32_t index = free_indices.back();
+			free_indices.pop_back();
+			return index;
+		}
+		if (next == capacity) {
+			return std::nullopt;
+		}
+		return next++;
+	}
+
+	void release(uint32_t index) {
+		assert(index < next && "Releasing a bindless slot that was never acquired");
+		free_indices.push_back(index);
+	}
+};
+
+struct BindlessHeap::Impl {
+	const Device *device = nullptr;
+	vk::raii::DescriptorSetLayout layout = nullptr;
+	vk::raii::DescriptorPool pool = nullptr;
+	vk::raii::DescriptorSet set = nullptr;
+
+	BindlessSlots textures;
+	BindlessSlots storage_buffers;
+	uint64_t write_count = 0;
+
+	void write(const vk::WriteDescriptorSet &write) {
+		device->get_device().updateDescriptorSets(write, {});
+		++write_count;
+	}
+};
+
+BindlessHeap::BindlessHeap() : impl(std::make_unique<Impl>()) {}
+BindlessHeap::~BindlessHeap() = default;
+
+Result<> BindlessHeap::init(
+	const Device &device,
+	uint32_t texture_capacity,
+	uint32_t storage_buffer_capacity
+) {
+	if (!device.get_physical_device().supports_bindless()) {
+		return Error("Device does not support descriptor indexing with update-after-bind");
+	}
+
+	auto properties = device.get_physical_device()
+						  .get_physical_device()
+						  .getProperties2<
+							  vk::PhysicalDeviceProperties2,
+							  vk::PhysicalDeviceVulkan12Properties>();
+	const auto &limits = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+	texture_capacity = std::min({
+		texture_capacity,
+		limits.maxDescriptorSetUpdateAfterBindSampledImages,
+		limits.maxDescriptorSetUpdateAfterBindSamplers,
+		limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+	});
+	storage_buffer_capacity = std::min({
+		storage_buffer_capacity,
+		limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+	});
+
+	impl->device = &device;
+	impl->textures = BindlessSlots {.capacity = texture_capacity};
+	impl->storage_buffers = BindlessSlots {.capacity = storage_buffer_capacity};
+	impl->write_count = 0;
+
+	std::array bindings {
+		vk::DescriptorSetLayoutBinding {
+			.binding = static_cast<uint32_t>(BindlessBinding::Textures),
+			.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+			.descriptorCount = texture_capacity,
+			.stageFlags = vk::ShaderStageFlagBits::eAll,
+		},
+		vk::DescriptorSetLayoutBinding {
+			.binding = static_cast<uint32_t>(BindlessBinding::StorageBuffers),
+			.descriptorType = vk::DescriptorType::eStorageBuffer,
+			.descriptorCount = storage_buffer_capacity,
+			.stageFlags = vk::ShaderStageFlagBits::eAll,
+		},
+	};
+	// Unwritten slots are fine as long as the shaders never index them.
+	vk::DescriptorBindingFlags binding_flag = vk::DescriptorBindingFlagBits::ePartiallyBound |
+											  vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+	std::array binding_flags {binding_flag, binding_flag};
+
+	vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info {
+		.bindingCount = binding_flags.size(),
+		.pBindingFlags = binding_flags.data(),
+	};
+	vk::DescriptorSetLayoutCreateInfo layout_info {
+		.pNext = &binding_flags_info,
+		.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+		.bindingCount = bindings.size(),
+		.pBindings = bindings.data(),
+	};
+	impl->layout = vk::raii::DescriptorSetLayout(
+		device.get_device(),
+		layout_info,
+		get_host_allocation_callbacks()
+	);
+
+	std::array pool_sizes {
+		vk::DescriptorPoolSize {
+			.type = vk::DescriptorType::eCombinedImageSampler,
+			.descriptorCount = texture_capacity,
+		},
+		vk::DescriptorPoolSize {
+			.type = vk::DescriptorType::eStorageBuffer,
+			.descriptorCount = storage_buffer_capacity,
+		},
+	};
+	vk::DescriptorPoolCreateInfo pool_info {
+		.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet |
+				 vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+		.maxSets = 1,
+		.poolSizeCount = pool_sizes.size(),
+		.pPoolSizes = pool_sizes.data(),
+	};
+	impl->pool =
+		vk::raii::DescriptorPool(device.get_device(), pool_info, get_host_allocation_callbacks());
+
+	vk::DescriptorSetAllocateInfo allocate_info {
+		.descriptorPool = impl->pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &*impl->layout,
+	};
+	impl->set = std::move(device.get_device().allocateDescriptorSets(allocate_info).front());
+
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Bindless heap: {} textures, {} storage buffers",
+		texture_capacity,
+		storage_buffer_capacity
+	);
+	return {};
+}
+
+Result<BindlessIndex> BindlessHeap::add_texture(vk::ImageView view, vk::Sampler sampler) {
+	auto index = impl->textures.acquire();
+	if (!index) {
+		return Error("Bindless texture array is full");
+	}
+	update_texture(index.value(), view, sampler);
+	return index.value();
+}
+
+Result<BindlessIndex> BindlessHeap::add_storage_buffer(
+	vk::Buffer buffer,
+	uint64_t offset,
+	uint64_t range
+) {
+	auto index = impl->storage_buffers.acquire();
+	if (!index) {
+		return Error("Bindless storage buffer array is full");
+	}
+	update_storage_buffer(index.value(), buffer, offset, range);
+	return index.value();
+}
+
+void BindlessHeap::update_texture(BindlessIndex index, vk::ImageView view, vk::Sampler sampler) {
+	vk::DescriptorImageInfo image_info {
+		.sampler = sampler,
+		.imageView = view,
+		.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+	};
+	impl->write(vk::WriteDescriptorSet {
+		.dstSet = impl->set,
+		.dstBinding = static_cast<uint32_t>(BindlessBinding::Textures),
+		.dstArrayElement = index,
+		.descriptorCount = 1,
+		.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+		.pImageInfo = &image_info,
+	});
+}
+
+void BindlessHeap::update_storage_buffer(
+	BindlessIndex index,
+	vk::Buffer buffer,
+	uint64_t offset,
+	uint64_t range
+) {
+	vk::DescriptorBufferInfo buffer_info {
+		.buffer = buffer,
+		.offset = offset,
+		.range = range,
+	};
+	impl->write(vk::WriteDescriptorSet {
+		.dstSet = impl->set,
+		.dstBinding = static_cast<uint32_t>(BindlessBinding::StorageBuffers),
+		.dstArrayElement = index,
+		.descriptorCount = 1,
+		.descriptorType = vk::DescriptorType::eStorageBuffer,
+		.pBufferInfo = &buffer_info,
+	});
+}
+
+void BindlessHeap::remove_texture(BindlessIndex index) {
+	impl->textures.release(index);
+}
+
+void BindlessHeap::remove_storage_buffer(BindlessIndex index) {
+	impl->storage_buffers.release(index);
+}
+
+const vk::raii::DescriptorSetLayout &BindlessHeap::get_layout() const {
+	return impl->layout;
+}
+
+const vk::raii::DescriptorSet &BindlessHeap::get_set() const {
+	return impl->set;
+}
+
+uint64_t BindlessHeap::get_write_count() const {
+	return impl->write_count;
+}
+
+} // namespace tramogi::graphics
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <cstdint>
+#include <memory>
+
+namespace vk {
+class Buffer;
+class ImageView;
+class Sampler;
+namespace raii {
+class DescriptorSet;
+class DescriptorSetLayout;
+} // namespace raii
+} // namespace vk
+
+namespace tramogi::graphics {
+
+class Device;
+
+// Matches the bindings of the bindless descriptor set in the shaders.
+enum class BindlessBinding : uint32_t {
+	Textures = 0,
+	StorageBuffers = 1,
+};
+
+using BindlessIndex = uint32_t;
+
+// A single descriptor set holding one large array of combined image samplers and one of storage
+// buffers, bound once and indexed by the shaders. Slots are written when a resource is added and
+// can be rewritten while the set is bound, as long as no frame in flight uses the slot.
+class BindlessHeap {
+public:
+	static constexpr uint32_t default_texture_capacity = 4096;
+	static constexpr uint32_t default_storage_buffer_capacity = 1024;
+
+	BindlessHeap();
+	~BindlessHeap();
+	BindlessHeap(const BindlessHeap &) = delete;
+	BindlessHeap &operator=(const BindlessHeap &) = delete;
+
+	// Capacities are clamped to the device's update-after-bind limits.
+	core::Result<> init(
+		const Device &device,
+		uint32_t texture_capacity = default_texture_capacity,
+		uint32_t storage_buffer_capacity = default_storage_buffer_capacity
+	);
+
+	[[nodiscard]] core::Result<BindlessIndex> add_texture(vk::ImageView view, vk::Sampler sampler);
+	[[nodiscard]] core::Result<BindlessIndex> add_storage_buffer(
+		vk::Buffer buffer,
+		uint64_t offset,
+		uint64_t range
+	);
+	// Rewrites an existing slot, e.g. after the resource was recreated or moved.
+	void update_texture(BindlessIndex index, vk::ImageView view, vk::Sampler sampler);
+	void update_storage_buffer(
+		BindlessIndex index,
+		vk::Buffer buffer,
+		uint64_t offset,
+		uint64_t range
+	);
+	// The slot may be handed out again, so the frames in flight must be done with it.
+	void remove_texture(BindlessIndex index);
+	void remove_storage_buffer(BindlessIndex index);
+
+	const vk::raii::DescriptorSetLayout &get_layout() const;
+	const vk::raii::DescriptorSet &get_set() const;
+
+	// Descriptors written since `init`.
+	uint64_t get_write_count() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
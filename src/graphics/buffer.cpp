@@ -1,10 +1,14 @@
 #include "tramogi/graphics/buffer.h"
 #include "allocator.h"
+#include "buffer_impl.h"
 #include "device.h"
+#include "host_allocator.h"
 #include "tramogi/core/errors.h"
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <span>
 #include <string.h>
 #include <utility>
 #include <vulkan/vulkan.hpp>
@@ -15,28 +19,36 @@ namespace tramogi::graphics {
 using core::Error;
 using core::Result;
 
-struct Buffer::Impl {
-	vk::raii::Buffer buffer = nullptr;
-	vk::raii::DeviceMemory memory = nullptr;
-	void *mapped_memory = nullptr;
+void Buffer::upload_data(const void *data) {
+	write(0, std::span(static_cast<const std::byte *>(data), impl->buffer_size));
+}
 
-	uint64_t buffer_size = 0;
-	MemoryType memory_type;
-};
+void Buffer::write(uint64_t offset, std::span<const std::byte> data) {
+	assert(offset + data.size() <= impl->buffer_size && "Writing past the end of the buffer");
+	assert(!impl->is_defragmented && "Writing to a buffer registered with the defragmenter");
+	memcpy(static_cast<std::byte *>(get_mapped_memory()) + offset, data.data(), data.size());
+	impl->allocation.flush(offset, data.size());
+}
 
-void Buffer::upload_data(const void *data) {
-	memcpy(get_mapped_memory(), data, impl->buffer_size);
+void Buffer::flush(uint64_t offset, uint64_t size) {
+	impl->allocation.flush(offset, size);
+}
+
+void Buffer::invalidate(uint64_t offset, uint64_t size) {
+	impl->allocation.invalidate(offset, size);
 }
 
 void Buffer::map() {
 	assert(
 		impl->memory_type == MemoryType::Host && "Should only map memory that is visible to host"
 	);
-	impl->mapped_memory = impl->memory.mapMemory(0, impl->buffer.getMemoryRequirements().size);
+	if (!impl->mapped_memory) {
+		impl->mapped_memory = impl->allocation.map();
+	}
 }
 
 void Buffer::unmap() {
-	impl->memory.unmapMemory();
+	impl->allocation.unmap();
 	impl->mapped_memory = nullptr;
 }
 
@@ -49,101 +61,135 @@ vk::raii::Buffer &Buffer::get_buffer() {
 	return impl->buffer;
 }
 
+uint64_t Buffer::get_size() const {
+	return impl->buffer_size;
+}
+
 Buffer::Buffer() : impl(std::make_unique<Impl>()) {};
 Buffer::~Buffer() = default;
 Buffer::Buffer(Buffer &&) = default;
 Buffer &Buffer::operator=(Buffer &&) = default;
 
-Result<> StagingBuffer::init(const Device &device, uint64_t size) {
+Result<> Buffer::Impl::init(
+	const Device &device,
+	uint64_t size,
+	vk::BufferUsageFlags usage,
+	MemoryType memory_type,
+	ResourceKind kind
+) {
 	vk::BufferCreateInfo create_info {
 		.size = size,
-		.usage = vk::BufferUsageFlagBits::eTransferSrc,
+		.usage = usage,
 		.sharingMode = vk::SharingMode::eExclusive,
 	};
 
-	impl->buffer = vk::raii::Buffer(device.get_device(), create_info);
-	impl->buffer_size = size;
-	impl->memory_type = MemoryType::Host;
+	buffer = vk::raii::Buffer(device.get_device(), create_info, get_host_allocation_callbacks());
+	buffer_size = size;
+	this->usage = usage;
+	this->memory_type = memory_type;
 
 	auto allocation_result =
-		allocate_memory(device, impl->buffer.getMemoryRequirements(), impl->memory_type);
+		allocate_memory(device, buffer.getMemoryRequirements(), memory_type, kind);
 	if (!allocation_result) {
 		return Error(allocation_result.error());
 	}
 
-	impl->memory = std::move(allocation_result.value());
-	impl->buffer.bindMemory(impl->memory, 0);
+	allocation = std::move(allocation_result.value());
+	buffer.bindMemory(allocation.get_memory(), allocation.get_offset());
+	if (memory_type == MemoryType::Host) {
+		mapped_memory = allocation.map();
+	}
 
 	return {};
 }
 
-Result<> VertexBuffer::init(const Device &device, uint64_t size) {
-	vk::BufferCreateInfo create_info {
-		.size = size,
-		.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-		.sharingMode = vk::SharingMode::eExclusive,
-	};
-
-	impl->buffer = vk::raii::Buffer(device.get_device(), create_info);
-	impl->buffer_size = size;
-	impl->memory_type = MemoryType::Gpu;
-
-	auto allocation_result =
-		allocate_memory(device, impl->buffer.getMemoryRequirements(), impl->memory_type);
-	if (!allocation_result) {
-		return Error(allocation_result.error());
-	}
-
-	impl->memory = std::move(allocation_result.value());
-	impl->buffer.bindMemory(impl->memory, 0);
+Result<> StagingBuffer::init(const Device &device, uint64_t size) {
+	return impl->init(
+		device,
+		size,
+		vk::BufferUsageFlagBits::eTransferSrc,
+		MemoryType::Host,
+		ResourceKind::Staging
+	);
+}
 
-	return {};
+Result<> VertexBuffer::init(const Device &device, uint64_t size) {
+	return impl->init(
+		device,
+		size,
+		vk::BufferUsageFlagBits::eVertexBuffer |
+			vk::BufferUsageFlagBits::eTransferSrc |
+			vk::BufferUsageFlagBits::eTransferDst,
+		MemoryType::Gpu,
+		ResourceKind::Vertex
+	);
 }
 
 Result<> IndexBuffer::init(const Device &device, uint64_t size) {
-	vk::BufferCreateInfo create_info {
-		.size = size,
-		.usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-		.sharingMode = vk::SharingMode::eExclusive,
-	};
+	return impl->init(
+		device,
+		size,
+		vk::BufferUsageFlagBits::eIndexBuffer |
+			vk::BufferUsageFlagBits::eTransferSrc |
+			vk::BufferUsageFlagBits::eTransferDst,
+		MemoryType::Gpu,
+		ResourceKind::Index
+	);
+}
 
-	impl->buffer = vk::raii::Buffer(device.get_device(), create_info);
-	impl->buffer_size = size;
-	impl->memory_type = MemoryType::Gpu;
+Result<> StorageBuffer::init(const Device &device, uint64_t size) {
+	return impl->init(
+		device,
+		size,
+		vk::BufferUsageFlagBits::eStorageBuffer |
+			vk::BufferUsageFlagBits::eTransferSrc |
+			vk::BufferUsageFlagBits::eTransferDst,
+		MemoryType::Gpu,
+		ResourceKind::Storage
+	);
+}
 
-	auto allocation_result =
-		allocate_memory(device, impl->buffer.getMemoryRequirements(), impl->memory_type);
-	if (!allocation_result) {
-		return Error(allocation_result.error());
-	}
+Result<> HostStorageBuffer::init(const Device &device, uint64_t size) {
+	return impl->init(
+		device,
+		size,
+		vk::BufferUsageFlagBits::eStorageBuffer,
+		MemoryType::Host,
+		ResourceKind::Storage
+	);
+}
 
-	impl->memory = std::move(allocation_result.value());
-	impl->buffer.bindMemory(impl->memory, 0);
+Result<> IndirectBuffer::init(const Device &device, uint64_t size) {
+	return impl->init(
+		device,
+		size,
+		vk::BufferUsageFlagBits::eStorageBuffer |
+			vk::BufferUsageFlagBits::eIndirectBuffer |
+			vk::BufferUsageFlagBits::eTransferSrc |
+			vk::BufferUsageFlagBits::eTransferDst,
+		MemoryType::Gpu,
+		ResourceKind::Storage
+	);
+}
 
-	return {};
+Result<> ReadbackBuffer::init(const Device &device, uint64_t size) {
+	return impl->init(
+		device,
+		size,
+		vk::BufferUsageFlagBits::eTransferDst,
+		MemoryType::Host,
+		ResourceKind::Staging
+	);
 }
 
 Result<> UniformBuffer::init(const Device &device, uint64_t size) {
-	vk::BufferCreateInfo create_info {
-		.size = size,
-		.usage = vk::BufferUsageFlagBits::eUniformBuffer,
-		.sharingMode = vk::SharingMode::eExclusive,
-	};
-
-	impl->buffer = vk::raii::Buffer(device.get_device(), create_info);
-	impl->buffer_size = size;
-	impl->memory_type = MemoryType::Host;
-
-	auto allocation_result =
-		allocate_memory(device, impl->buffer.getMemoryRequirements(), impl->memory_type);
-	if (!allocation_result) {
-		return Error(allocation_result.error());
-	}
-
-	impl->memory = std::move(allocation_result.value());
-	impl->buffer.bindMemory(impl->memory, 0);
-
-	return {};
+	return impl->init(
+		device,
+		size,
+		vk::BufferUsageFlagBits::eUniformBuffer,
+		MemoryType::Host,
+		ResourceKind::Uniform
+	);
 }
 
 } // namespace tramogi::graphics
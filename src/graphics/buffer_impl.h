@@ -0,0 +1,38 @@
+#pragma once
+
+#include "allocator.h"
+#include "tramogi/core/errors.h"
+#include "tramogi/graphics/buffer.h"
+#include <cstdint>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+class Device;
+
+// Shared with the defragmenter, which swaps the buffer and its allocation when moving it.
+struct Buffer::Impl {
+	Allocation allocation;
+	vk::raii::Buffer buffer = nullptr;
+	void *mapped_memory = nullptr;
+
+	uint64_t buffer_size = 0;
+	vk::BufferUsageFlags usage;
+	MemoryType memory_type;
+
+	// While registered, the defragmenter may copy the buffer at any time and swap to the copy
+	// frames later, which would lose any write in between.
+	bool is_defragmented = false;
+
+	// Creates the buffer and binds it to new memory, mapped when it is host memory.
+	core::Result<> init(
+		const Device &device,
+		uint64_t size,
+		vk::BufferUsageFlags usage,
+		MemoryType memory_type,
+		ResourceKind kind
+	);
+};
+
+} // namespace tramogi::graphics
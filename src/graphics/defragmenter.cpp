@@ -0,0 +1,316 @@
+#include "defragmenter.h"
+#include "allocator.h"
+#include "buffer_impl.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "tramogi/core/logging/logging.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+struct Defragmenter::Impl {
+	struct Move {
+		Buffer *buffer = nullptr;
+		Allocation allocation;
+		vk::raii::Buffer new_buffer = nullptr;
+		uint32_t frame_index = 0;
+	};
+
+	struct RetiredBuffer {
+		Allocation allocation;
+		vk::raii::Buffer buffer = nullptr;
+		// One bit per frame index that must still be waited for.
+		uint32_t pending_frames = 0;
+	};
+
+	const Device *device = nullptr;
+	uint32_t frame_count = 0;
+	uint64_t bytes_per_frame = 0;
+
+	std::vector<Buffer *> buffers;
+	MoveCallback move_callback;
+
+	bool is_running = false;
+	uint32_t frame_index = 0;
+	std::vector<Move> moves;
+	std::vector<RetiredBuffer> retired_buffers;
+
+	DefragmentationStats running_stats;
+	DefragmentationStats stats;
+
+	bool is_moving(const Buffer *buffer) const {
+		return std::ranges::any_of(moves, [buffer](const Move &move) {
+			return move.buffer == buffer;
+		});
+	}
+};
+
+static double to_mib(uint64_t bytes) {
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+Defragmenter::Defragmenter() : impl(std::make_unique<Impl>()) {}
+Defragmenter::~Defragmenter() = default;
+
+void Defragmenter::init(const Device &device, uint32_t frame_count, uint64_t bytes_per_frame) {
+	assert(frame_count <= 32 && "Frames in flight are tracked in a 32 bit mask");
+	impl->device = &device;
+	impl->frame_count = frame_count;
+	impl->bytes_per_frame = bytes_per_frame;
+}
+
+void Defragmenter::add(Buffer &buffer) {
+	assert(
+		buffer.impl->usage & vk::BufferUsageFlagBits::eTransferSrc &&
+		"Defragmented buffers need transfer source usage"
+	);
+	assert(!buffer.impl->is_defragmented && "Buffer is already registered");
+	buffer.impl->is_defragmented = true;
+	impl->buffers.push_back(&buffer);
+}
+
+void Defragmenter::remove(Buffer &buffer) {
+	std::erase(impl->buffers, &buffer);
+	buffer.impl->is_defragmented = false;
+
+	// A copy into the move target may still be in flight.
+	for (Impl::Move &move : impl->moves) {
+		if (move.buffer == &buffer) {
+			impl->retired_buffers.push_back({
+				.allocation = std::move(move.allocation),
+				.buffer = std::move(move.new_buffer),
+				.pending_frames = 1u << move.frame_index,
+			});
+			move.buffer = nullptr;
+		}
+	}
+	std::erase_if(impl->moves, [](const Impl::Move &move) {
+		return move.buffer == nullptr;
+	});
+}
+
+void Defragmenter::set_move_callback(MoveCallback callback) {
+	impl->move_callback = std::move(callback);
+}
+
+void Defragmenter::start(float max_block_usage) {
+	if (impl->is_running) {
+		return;
+	}
+
+	DeviceMemoryAllocator &allocator = impl->device->get_memory_allocator();
+	MemoryBlockStats block_stats = allocator.get_stats();
+
+	uint32_t source_count = allocator.begin_defragmentation(max_block_usage);
+	if (source_count == 0) {
+		allocator.end_defragmentation();
+		TRAMOGI_LOG_INFO(Graphics, "Defragmentation: no sparse memory blocks to evacuate");
+		return;
+	}
+
+	impl->is_running = true;
+	impl->running_stats = DefragmentationStats {
+		.source_block_count = source_count,
+		.block_count_before = block_stats.block_count,
+		.reserved_bytes_before = block_stats.reserved_bytes,
+		.fragmentation_before = get_fragmentation(block_stats),
+	};
+
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Defragmentation started: {} of {} blocks to evacuate, {:.2f} MiB reserved, "
+		"fragmentation {:.3f}",
+		source_count,
+		block_stats.block_count,
+		to_mib(block_stats.reserved_bytes),
+		impl->running_stats.fragmentation_before
+	);
+}
+
+bool Defragmenter::is_running() const {
+	return impl->is_running;
+}
+
+void Defragmenter::begin_frame(uint32_t frame_index) {
+	impl->frame_index = frame_index;
+	uint32_t frame_bit = 1u << frame_index;
+
+	for (Impl::RetiredBuffer &retired : impl->retired_buffers) {
+		retired.pending_frames &= ~frame_bit;
+	}
+	std::erase_if(impl->retired_buffers, [](const Impl::RetiredBuffer &retired) {
+		return retired.pending_frames == 0;
+	});
+
+	// Copies recorded the last time this frame index was used have completed. The old buffers
+	// may still be used by the other frames in flight.
+	uint32_t other_frames = ((1u << impl->frame_count) - 1) & ~frame_bit;
+	for (Impl::Move &move : impl->moves) {
+		if (move.frame_index != frame_index) {
+			continue;
+		}
+
+		Buffer::Impl &buffer = *move.buffer->impl;
+		impl->retired_buffers.push_back({
+			.allocation = std::move(buffer.allocation),
+			.buffer = std::move(buffer.buffer),
+			.pending_frames = other_frames,
+		});
+		buffer.allocation = std::move(move.allocation);
+		buffer.buffer = std::move(move.new_buffer);
+		if (buffer.mapped_memory) {
+			buffer.mapped_memory = buffer.allocation.map();
+		}
+
+		++impl->running_stats.moved_buffer_count;
+		impl->running_stats.moved_bytes += buffer.buffer_size;
+		if (impl->move_callback) {
+			impl->move_callback(*move.buffer);
+		}
+		move.buffer = nullptr;
+	}
+	std::erase_if(impl->retired_buffers, [](const Impl::RetiredBuffer &retired) {
+		return retired.pending_frames == 0;
+	});
+	std::erase_if(impl->moves, [](const Impl::Move &move) {
+		return move.buffer == nullptr;
+	});
+
+	// Waiting for the retired buffers as well lets their source blocks go before the stats are
+	// taken.
+	if (!impl->is_running || !impl->moves.empty() || !impl->retired_buffers.empty()) {
+		return;
+	}
+
+	// Finished once none of the registered buffers is left in a source block. Anything else, like
+	// images, keeps its block alive until it is freed.
+	DeviceMemoryAllocator &allocator = impl->device->get_memory_allocator();
+	bool has_pending = std::ranges::any_of(impl->buffers, [&allocator](const Buffer *buffer) {
+		return allocator.is_defragmentation_source(buffer->impl->allocation);
+	});
+	if (!has_pending) {
+		finish();
+	}
+}
+
+void Defragmenter::record(const vk::raii::CommandBuffer &command_buffer) {
+	if (!impl->is_running) {
+		return;
+	}
+
+	DeviceMemoryAllocator &allocator = impl->device->get_memory_allocator();
+	uint64_t budget = impl->bytes_per_frame;
+	bool has_copies = false;
+
+	for (Buffer *buffer : impl->buffers) {
+		Buffer::Impl &source = *buffer->impl;
+		if (impl->is_moving(buffer) || !allocator.is_defragmentation_source(source.allocation)) {
+			continue;
+		}
+		// The first move of a frame may exceed the budget, so that large buffers still move.
+		if (has_copies && source.buffer_size > budget) {
+			break;
+		}
+
+		vk::BufferCreateInfo create_info {
+			.size = source.buffer_size,
+			.usage = source.usage | vk::BufferUsageFlagBits::eTransferDst,
+			.sharingMode = vk::SharingMode::eExclusive,
+		};
+		vk::raii::Buffer new_buffer(
+			impl->device->get_device(),
+			create_info,
+			get_host_allocation_callbacks()
+		);
+
+		auto allocation_result = allocator.allocate(
+			new_buffer.getMemoryRequirements(),
+			source.memory_type,
+			source.allocation.get_kind()
+		);
+		if (!allocation_result) {
+			TRAMOGI_LOG_WARNING(
+				Graphics,
+				"Defragmentation: failed to allocate a move target: {}",
+				allocation_result.error()
+			);
+			break;
+		}
+		Allocation allocation = std::move(allocation_result.value());
+		new_buffer.bindMemory(allocation.get_memory(), allocation.get_offset());
+
+		command_buffer.copyBuffer(
+			source.buffer,
+			new_buffer,
+			vk::BufferCopy {
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = source.buffer_size,
+			}
+		);
+
+		impl->moves.push_back({
+			.buffer = buffer,
+			.allocation = std::move(allocation),
+			.new_buffer = std::move(new_buffer),
+			.frame_index = impl->frame_index,
+		});
+		budget -= std::min(budget, source.buffer_size);
+		has_copies = true;
+	}
+
+	if (!has_copies) {
+		return;
+	}
+
+	vk::MemoryBarrier2 barrier {
+		.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+		.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+		.dstAccessMask = vk::AccessFlagBits2::eMemoryRead,
+	};
+	vk::DependencyInfo dependency_info {
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &barrier,
+	};
+	command_buffer.pipelineBarrier2(dependency_info);
+}
+
+const DefragmentationStats &Defragmenter::get_stats() const {
+	return impl->stats;
+}
+
+void Defragmenter::finish() {
+	DeviceMemoryAllocator &allocator = impl->device->get_memory_allocator();
+	allocator.end_defragmentation();
+
+	MemoryBlockStats block_stats = allocator.get_stats();
+	impl->running_stats.block_count_after = block_stats.block_count;
+	impl->running_stats.reserved_bytes_after = block_stats.reserved_bytes;
+	impl->running_stats.fragmentation_after = get_fragmentation(block_stats);
+	impl->stats = impl->running_stats;
+	impl->is_running = false;
+
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Defragmentation finished: moved {} buffers ({:.2f} MiB), blocks {} -> {}, reserved "
+		"{:.2f} -> {:.2f} MiB, fragmentation {:.3f} -> {:.3f}",
+		impl->stats.moved_buffer_count,
+		to_mib(impl->stats.moved_bytes),
+		impl->stats.block_count_before,
+		impl->stats.block_count_after,
+		to_mib(impl->stats.reserved_bytes_before),
+		to_mib(impl->stats.reserved_bytes_after),
+		impl->stats.fragmentation_before,
+		impl->stats.fragmentation_after
+	);
+}
+
+} // namespace tramogi::graphics
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace vk {
+namespace raii {
+class CommandBuffer;
+} // namespace raii
+} // namespace vk
+
+namespace tramogi::graphics {
+
+class Buffer;
+class Device;
+
+struct DefragmentationStats {
+	uint32_t source_block_count = 0;
+	uint32_t moved_buffer_count = 0;
+	uint64_t moved_bytes = 0;
+	uint32_t block_count_before = 0;
+	uint32_t block_count_after = 0;
+	uint64_t reserved_bytes_before = 0;
+	uint64_t reserved_bytes_after = 0;
+	double fragmentation_before = 0.0;
+	double fragmentation_after = 0.0;
+};
+
+// Incrementally evacuates sparse device memory blocks by moving the buffers registered with it
+// into denser blocks. Each frame copies at most `bytes_per_frame` on the GPU, as part of the
+// frame's own command buffer. A moved buffer swaps to its new handle when its frame index comes
+// around again, and the old one is kept alive until every other frame in flight was waited on.
+//
+// Buffers are re-bound by whoever records them, from `Buffer::get_buffer()`. Descriptors that
+// reference a buffer must be rewritten from the move callback.
+class Defragmenter {
+public:
+	using MoveCallback = std::function<void(Buffer &)>;
+
+	static constexpr uint64_t default_bytes_per_frame = 8ull * 1024 * 1024;
+
+	Defragmenter();
+	~Defragmenter();
+	Defragmenter(const Defragmenter &) = delete;
+	Defragmenter &operator=(const Defragmenter &) = delete;
+
+	void init(
+		const Device &device,
+		uint32_t frame_count,
+		uint64_t bytes_per_frame = default_bytes_per_frame
+	);
+
+	// Registered buffers must have been created with transfer source usage, and are read-only
+	// until removed: a move copies the buffer in one frame and only swaps to the copy when that
+	// frame index comes around again, so writes in between would be lost. `Buffer::write` asserts
+	// on them, GPU writes such as staging uploads are not checked. To update a registered buffer,
+	// remove it, which cancels its pending move, write to it, then add it again.
+	void add(Buffer &buffer);
+	void remove(Buffer &buffer);
+	void set_move_callback(MoveCallback callback);
+
+	// Marks the blocks used below `max_block_usage` as sources and starts moving their buffers
+	// out. Does nothing if a defragmentation is already running.
+	void start(float max_block_usage = 0.5f);
+	bool is_running() const;
+
+	// Call once per frame, after `frame_index` has been waited for.
+	void begin_frame(uint32_t frame_index);
+	// Records this frame's copies. Call before any command reading the registered buffers.
+	void record(const vk::raii::CommandBuffer &command_buffer);
+
+	// Of the last finished defragmentation.
+	const DefragmentationStats &get_stats() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+
+	void finish();
+};
+
+} // namespace tramogi::graphics
@@ -0,0 +1,325 @@
+#include "descriptor_allocator.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "tramogi/core/errors.h"
+#include "tramogi/core/logging/logging.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+using core::Error;
+using core::Result;
+
+namespace {
+
+struct BindingKey {
+	uint32_t binding = 0;
+	vk::DescriptorType type = vk::DescriptorType::eSampler;
+	uint32_t count = 0;
+	vk::ShaderStageFlags stages;
+	vk::DescriptorBindingFlags binding_flags;
+	std::vector<vk::Sampler> immutable_samplers;
+
+	bool operator==(const BindingKey &) const = default;
+};
+
+struct LayoutKey {
+	vk::DescriptorSetLayoutCreateFlags flags;
+	std::vector<BindingKey> bindings;
+
+	bool operator==(const LayoutKey &) const = default;
+};
+
+template <typename T> void hash_combine(size_t &seed, const T &value) {
+	seed ^= std::hash<T> {}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+size_t hash_layout_key(const LayoutKey &key) {
+	size_t seed = 0;
+	hash_combine(seed, static_cast<uint32_t>(key.flags));
+	for (const BindingKey &binding : key.bindings) {
+		hash_combine(seed, binding.binding);
+		hash_combine(seed, static_cast<uint32_t>(binding.type));
+		hash_combine(seed, binding.count);
+		hash_combine(seed, static_cast<uint32_t>(binding.stages));
+		hash_combine(seed, static_cast<uint32_t>(binding.binding_flags));
+		for (vk::Sampler sampler : binding.immutable_samplers) {
+			hash_combine(seed, static_cast<VkSampler>(sampler));
+		}
+	}
+	return seed;
+}
+
+LayoutKey make_layout_key(const vk::DescriptorSetLayoutCreateInfo &create_info) {
+	const vk::DescriptorSetLayoutBindingFlagsCreateInfo *binding_flags_info = nullptr;
+	for (auto *next = static_cast<const vk::BaseInStructure *>(create_info.pNext); next;
+		 next = next->pNext) {
+		if (next->sType == vk::StructureType::eDescriptorSetLayoutBindingFlagsCreateInfo) {
+			binding_flags_info =
+				reinterpret_cast<const vk::DescriptorSetLayoutBindingFlagsCreateInfo *>(next);
+		} else {
+			assert(false && "Unsupported structure chained to a cached descriptor set layout");
+		}
+	}
+
+	LayoutKey key {.flags = create_info.flags};
+	for (uint32_t i = 0; i < create_info.bindingCount; ++i) {
+		const vk::DescriptorSetLayoutBinding &binding = create_info.pBindings[i];
+		BindingKey binding_key {
+			.binding = binding.binding,
+			.type = binding.descriptorType,
+			.count = binding.descriptorCount,
+			.stages = binding.stageFlags,
+		};
+		if (binding_flags_info && binding_flags_info->bindingCount > 0) {
+			binding_key.binding_flags = binding_flags_info->pBindingFlags[i];
+		}
+		if (binding.pImmutableSamplers) {
+			binding_key.immutable_samplers.assign(
+				binding.pImmutableSamplers,
+				binding.pImmutableSamplers + binding.descriptorCount
+			);
+		}
+		key.bindings.push_back(std::move(binding_key));
+	}
+	// Binding order in the create info does not matter to Vulkan.
+	std::ranges::sort(key.bindings, {}, &BindingKey::binding);
+	return key;
+}
+
+} // namespace
+
+struct DescriptorLayoutCache::Impl {
+	struct Entry {
+		LayoutKey key;
+		vk::raii::DescriptorSetLayout layout = nullptr;
+	};
+
+	const Device *device = nullptr;
+	std::unordered_map<size_t, std::vector<Entry>> entries;
+	uint32_t layout_count = 0;
+	uint64_t hit_count = 0;
+};
+
+DescriptorLayoutCache::DescriptorLayoutCache() : impl(std::make_unique<Impl>()) {}
+DescriptorLayoutCache::~DescriptorLayoutCache() = default;
+
+void DescriptorLayoutCache::init(const Device &device) {
+	impl->device = &device;
+}
+
+vk::DescriptorSetLayout DescriptorLayoutCache::get(
+	const vk::DescriptorSetLayoutCreateInfo &create_info
+) {
+	LayoutKey key = make_layout_key(create_info);
+	std::vector<Impl::Entry> &bucket = impl->entries[hash_layout_key(key)];
+
+	for (const Impl::Entry &entry : bucket) {
+		if (entry.key == key) {
+			++impl->hit_count;
+			return *entry.layout;
+		}
+	}
+
+	bucket.push_back({
+		.key = std::move(key),
+		.layout = vk::raii::DescriptorSetLayout(
+			impl->device->get_device(),
+			create_info,
+			get_host_allocation_callbacks()
+		),
+	});
+	++impl->layout_count;
+	return *bucket.back().layout;
+}
+
+uint32_t DescriptorLayoutCache::get_layout_count() const {
+	return impl->layout_count;
+}
+
+uint64_t DescriptorLayoutCache::get_hit_count() const {
+	return impl->hit_count;
+}
+
+struct DescriptorAllocator::Impl {
+	struct PoolChain {
+		// The last one is allocated from, the others are full.
+		std::vector<vk::raii::DescriptorPool> pools;
+		// Pools that were reset and can be made current again.
+		std::vector<vk::raii::DescriptorPool> free_pools;
+		uint32_t next_set_count = 0;
+	};
+
+	const Device *device = nullptr;
+	std::vector<DescriptorPoolRatio> pool_ratios;
+
+	PoolChain persistent;
+	std::vector<PoolChain> frames;
+	uint32_t frame_index = 0;
+
+	DescriptorAllocatorStats stats;
+
+	vk::raii::DescriptorPool create_pool(PoolChain &chain) {
+		uint32_t set_count = chain.next_set_count;
+		chain.next_set_count = std::min(set_count + set_count / 2, max_sets_per_pool);
+
+		std::vector<vk::DescriptorPoolSize> pool_sizes;
+		for (const DescriptorPoolRatio &ratio : pool_ratios) {
+			auto descriptor_count =
+				static_cast<uint32_t>(ratio.ratio * static_cast<float>(set_count));
+			pool_sizes.push_back({
+				.type = ratio.type,
+				.descriptorCount = std::max(descriptor_count, 1u),
+			});
+		}
+
+		vk::DescriptorPoolCreateInfo pool_info {
+			.maxSets = set_count,
+			.poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+			.pPoolSizes = pool_sizes.data(),
+		};
+		return vk::raii::DescriptorPool(
+			device->get_device(),
+			pool_info,
+			get_host_allocation_callbacks()
+		);
+	}
+
+	core::Option<vk::DescriptorSet> try_allocate(
+		const vk::raii::DescriptorPool &pool,
+		vk::DescriptorSetLayout layout
+	) {
+		vk::DescriptorSetAllocateInfo allocate_info {
+			.descriptorPool = pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &layout,
+		};
+		try {
+			auto sets = device->get_device().allocateDescriptorSets(allocate_info);
+			// The pool owns the set and frees it on destruction or reset.
+			return sets.front().release();
+		} catch (const vk::OutOfPoolMemoryError &) {
+		} catch (const vk::FragmentedPoolError &) {
+		}
+		return std::nullopt;
+	}
+
+	Result<vk::DescriptorSet> allocate(PoolChain &chain, vk::DescriptorSetLayout layout) {
+		if (!chain.pools.empty()) {
+			auto set = try_allocate(chain.pools.back(), layout);
+			if (set) {
+				return set.value();
+			}
+			++stats.exhausted_pool_count;
+		}
+
+		chain.pools.push_back(next_pool(chain));
+		auto set = try_allocate(chain.pools.back(), layout);
+		if (!set) {
+			// The ratios are missing one of the layout's descriptor types.
+			return Error("Descriptor set does not fit in an empty pool");
+		}
+		return set.value();
+	}
+
+	vk::raii::DescriptorPool next_pool(PoolChain &chain) {
+		if (!chain.free_pools.empty()) {
+			vk::raii::DescriptorPool pool = std::move(chain.free_pools.back());
+			chain.free_pools.pop_back();
+			return pool;
+		}
+		return create_pool(chain);
+	}
+};
+
+DescriptorAllocator::DescriptorAllocator() : impl(std::make_unique<Impl>()) {}
+DescriptorAllocator::~DescriptorAllocator() = default;
+
+void DescriptorAllocator::init(
+	const Device &device,
+	uint32_t frame_count,
+	std::span<const DescriptorPoolRatio> pool_ratios,
+	uint32_t sets_per_pool
+) {
+	impl->device = &device;
+	impl->pool_ratios.assign(pool_ratios.begin(), pool_ratios.end());
+	impl->persistent = {.next_set_count = sets_per_pool};
+	impl->frames.clear();
+	impl->frames.resize(frame_count);
+	for (Impl::PoolChain &frame : impl->frames) {
+		frame.next_set_count = sets_per_pool;
+	}
+	impl->frame_index = 0;
+	impl->stats = {};
+}
+
+Result<vk::DescriptorSet> DescriptorAllocator::allocate(vk::DescriptorSetLayout layout) {
+	auto set = impl->allocate(impl->persistent, layout);
+	if (set) {
+		++impl->stats.persistent_set_count;
+	}
+	return set;
+}
+
+Result<vk::DescriptorSet> DescriptorAllocator::allocate_transient(vk::DescriptorSetLayout layout) {
+	auto set = impl->allocate(impl->frames[impl->frame_index], layout);
+	if (set) {
+		++impl->stats.transient_set_count;
+		++impl->stats.frame_transient_set_count;
+	}
+	return set;
+}
+
+void DescriptorAllocator::begin_frame(uint32_t frame_index) {
+	assert(frame_index < impl->frames.size() && "Frame index out of range");
+	impl->frame_index = frame_index;
+	impl->stats.frame_transient_set_count = 0;
+
+	Impl::PoolChain &frame = impl->frames[frame_index];
+	for (vk::raii::DescriptorPool &pool : frame.pools) {
+		pool.reset();
+		++impl->stats.pool_reset_count;
+		frame.free_pools.push_back(std::move(pool));
+	}
+	frame.pools.clear();
+}
+
+DescriptorAllocatorStats DescriptorAllocator::get_stats() const {
+	DescriptorAllocatorStats stats = impl->stats;
+	stats.persistent_pool_count = static_cast<uint32_t>(impl->persistent.pools.size());
+	stats.transient_pool_count = 0;
+	for (const Impl::PoolChain &frame : impl->frames) {
+		stats.transient_pool_count +=
+			static_cast<uint32_t>(frame.pools.size() + frame.free_pools.size());
+	}
+	return stats;
+}
+
+void DescriptorAllocator::log_stats() const {
+	DescriptorAllocatorStats stats = get_stats();
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Descriptors: {} persistent sets in {} pools, {} transient sets ({} this frame) in {} "
+		"pools, {} pools exhausted, {} pool resets",
+		stats.persistent_set_count,
+		stats.persistent_pool_count,
+		stats.transient_set_count,
+		stats.frame_transient_set_count,
+		stats.transient_pool_count,
+		stats.exhausted_pool_count,
+		stats.pool_reset_count
+	);
+}
+
+} // namespace tramogi::graphics
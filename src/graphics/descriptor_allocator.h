@@ -0,0 +1,96 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace vk {
+class DescriptorSet;
+class DescriptorSetLayout;
+struct DescriptorSetLayoutCreateInfo;
+enum class DescriptorType;
+} // namespace vk
+
+namespace tramogi::graphics {
+
+class Device;
+
+// Creates every descriptor set layout once. Layouts whose bindings, flags and binding flags
+// (from a chained DescriptorSetLayoutBindingFlagsCreateInfo) are equal share a handle, which
+// stays valid for the lifetime of the cache.
+class DescriptorLayoutCache {
+public:
+	DescriptorLayoutCache();
+	~DescriptorLayoutCache();
+	DescriptorLayoutCache(const DescriptorLayoutCache &) = delete;
+	DescriptorLayoutCache &operator=(const DescriptorLayoutCache &) = delete;
+
+	void init(const Device &device);
+
+	vk::DescriptorSetLayout get(const vk::DescriptorSetLayoutCreateInfo &create_info);
+
+	uint32_t get_layout_count() const;
+	// Requests answered with an existing layout.
+	uint64_t get_hit_count() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+// Descriptors of a type reserved per set when a pool is created.
+struct DescriptorPoolRatio {
+	vk::DescriptorType type;
+	float ratio = 1.0f;
+};
+
+struct DescriptorAllocatorStats {
+	uint64_t persistent_set_count = 0;
+	uint64_t transient_set_count = 0;
+	// Transient sets allocated since the current frame began.
+	uint32_t frame_transient_set_count = 0;
+	uint32_t persistent_pool_count = 0;
+	uint32_t transient_pool_count = 0;
+	// Pools that filled up and had to be followed by a new one.
+	uint32_t exhausted_pool_count = 0;
+	uint64_t pool_reset_count = 0;
+};
+
+// Allocates descriptor sets from chains of pools that grow as they fill. Persistent sets live as
+// long as the allocator. Transient sets come from pools owned by a frame in flight, which are
+// reset as a whole when that frame comes around again, so they must be written every frame.
+class DescriptorAllocator {
+public:
+	static constexpr uint32_t default_sets_per_pool = 64;
+	static constexpr uint32_t max_sets_per_pool = 4096;
+
+	DescriptorAllocator();
+	~DescriptorAllocator();
+	DescriptorAllocator(const DescriptorAllocator &) = delete;
+	DescriptorAllocator &operator=(const DescriptorAllocator &) = delete;
+
+	void init(
+		const Device &device,
+		uint32_t frame_count,
+		std::span<const DescriptorPoolRatio> pool_ratios,
+		uint32_t sets_per_pool = default_sets_per_pool
+	);
+
+	[[nodiscard]] core::Result<vk::DescriptorSet> allocate(vk::DescriptorSetLayout layout);
+	[[nodiscard]] core::Result<vk::DescriptorSet> allocate_transient(
+		vk::DescriptorSetLayout layout
+	);
+
+	// Resets the transient pools of `frame_index`. Only call once the frame has completed.
+	void begin_frame(uint32_t frame_index);
+
+	DescriptorAllocatorStats get_stats() const;
+	void log_stats() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
@@ -1,8 +1,16 @@
 #include "device.h"
+#include "allocator.h"
 #include "dispatch_loader.h"
+#include "host_allocator.h"
 #include "instance.h"
+#include "memory_accounting.h"
 #include "physical_device.h"
 #include "tramogi/core/errors.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <stdint.h>
@@ -16,13 +24,40 @@ using core::Error;
 using core::Result;
 
 struct Device::Impl {
+	struct Timeline {
+		vk::raii::Semaphore semaphore = nullptr;
+		uint64_t last_submitted = 0;
+		// Cached, refreshed whenever a newer point is polled.
+		uint64_t last_completed = 0;
+	};
+
 	vk::raii::Device device = nullptr;
 	vk::raii::Queue graphics_queue = nullptr;
 	vk::raii::Queue present_queue = nullptr;
+	vk::raii::Queue transfer_queue = nullptr;
 
 	std::vector<vk::raii::Semaphore> render_semaphores;
 	std::vector<vk::raii::Semaphore> present_semaphores;
-	std::vector<vk::raii::Fence> fences;
+	std::array<Timeline, 2> timelines;
+	std::vector<TimelinePoint> frame_points;
+	bool is_transfer_dedicated = false;
+
+	uint32_t frame_count = 0;
+	std::vector<const char *> enabled_extensions;
+	MemoryAccounting memory_accounting;
+	DeviceMemoryAllocator memory_allocator;
+
+	QueueType resolve(QueueType queue) const {
+		return is_transfer_dedicated ? queue : QueueType::Graphics;
+	}
+
+	Timeline &get_timeline(QueueType queue) {
+		return timelines[static_cast<size_t>(resolve(queue))];
+	}
+
+	const vk::raii::Queue &get_queue(QueueType queue) const {
+		return resolve(queue) == QueueType::Transfer ? transfer_queue : graphics_queue;
+	}
 };
 
 Device::Device(const PhysicalDevice &physical_device)
@@ -31,58 +66,173 @@ Device::~Device() = default;
 Device::Device(Device &&) = default;
 // Device &Device::operator=(Device &&) = default;
 
-void Device::init(const Instance &instance) {
+void Device::init(const Instance &instance, uint32_t frame_count) {
+	impl->frame_count = frame_count;
+	impl->is_transfer_dedicated = physical_device.has_dedicated_transfer_queue();
+
 	float priority = 0.0f;
-	vk::DeviceQueueCreateInfo device_queue_create_info {
-		.queueFamilyIndex = physical_device.get_graphics_queue_index(),
-		.queueCount = 1,
-		.pQueuePriorities = &priority,
+	std::vector<uint32_t> queue_family_indices {
+		physical_device.get_graphics_queue_index(),
+		physical_device.get_present_queue_index(),
+		physical_device.get_transfer_queue_index(),
 	};
+	std::ranges::sort(queue_family_indices);
+	auto duplicates = std::ranges::unique(queue_family_indices);
+	queue_family_indices.erase(duplicates.begin(), duplicates.end());
+
+	std::vector<vk::DeviceQueueCreateInfo> device_queue_create_infos;
+	for (uint32_t queue_family_index : queue_family_indices) {
+		device_queue_create_infos.push_back({
+			.queueFamilyIndex = queue_family_index,
+			.queueCount = 1,
+			.pQueuePriorities = &priority,
+		});
+	}
+	bool bindless = physical_device.supports_bindless();
+	bool indirect_count = physical_device.supports_indirect_count();
 	vk::StructureChain<
 		vk::PhysicalDeviceFeatures2,
 		vk::PhysicalDeviceVulkan11Features,
+		vk::PhysicalDeviceVulkan12Features,
 		vk::PhysicalDeviceVulkan13Features,
 		vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>
 		feature_chain {
-			{.features = {.samplerAnisotropy = vk::True}},
+			{
+				.features =
+					{
+						.multiDrawIndirect = indirect_count,
+						.drawIndirectFirstInstance = indirect_count,
+						.samplerAnisotropy = vk::True,
+					},
+			},
 			{.shaderDrawParameters = true},
+			{
+				.drawIndirectCount = indirect_count,
+				.descriptorIndexing = bindless,
+				.descriptorBindingSampledImageUpdateAfterBind = bindless,
+				.descriptorBindingStorageBufferUpdateAfterBind = bindless,
+				.descriptorBindingPartiallyBound = bindless,
+				.runtimeDescriptorArray = bindless,
+				.hostQueryReset = true,
+				.timelineSemaphore = true,
+			},
 			{.synchronization2 = true, .dynamicRendering = true},
 			{.extendedDynamicState = true},
 		};
 
+	impl->enabled_extensions = PhysicalDevice::required_device_extensions;
+	for (const char *extension : PhysicalDevice::optional_device_extensions) {
+		if (physical_device.supports_extension(extension)) {
+			impl->enabled_extensions.push_back(extension);
+		}
+	}
+
 	vk::DeviceCreateInfo device_create_info {
 		.pNext = &feature_chain.get<vk::PhysicalDeviceFeatures2>(),
-		.queueCreateInfoCount = 1,
-		.pQueueCreateInfos = &device_queue_create_info,
-		.enabledExtensionCount =
-			static_cast<uint32_t>(PhysicalDevice::required_device_extensions.size()),
-		.ppEnabledExtensionNames = PhysicalDevice::required_device_extensions.data(),
+		.queueCreateInfoCount = static_cast<uint32_t>(device_queue_create_infos.size()),
+		.pQueueCreateInfos = device_queue_create_infos.data(),
+		.enabledExtensionCount = static_cast<uint32_t>(impl->enabled_extensions.size()),
+		.ppEnabledExtensionNames = impl->enabled_extensions.data(),
 	};
 
-	impl->device = vk::raii::Device(physical_device.get_physical_device(), device_create_info);
+	impl->device = vk::raii::Device(
+		physical_device.get_physical_device(),
+		device_create_info,
+		get_host_allocation_callbacks()
+	);
 	impl->graphics_queue =
 		vk::raii::Queue(impl->device, physical_device.get_graphics_queue_index(), 0);
 	impl->present_queue =
 		vk::raii::Queue(impl->device, physical_device.get_present_queue_index(), 0);
+	impl->transfer_queue =
+		vk::raii::Queue(impl->device, physical_device.get_transfer_queue_index(), 0);
+
+	impl->memory_accounting.init(
+		physical_device,
+		is_extension_enabled(vk::EXTMemoryBudgetExtensionName)
+	);
+	impl->memory_allocator.init(*this);
 
 	create_sync_objects();
 
 	init_loader(instance.get_instance(), impl->device);
 }
 
-void Device::submit_graphics(
-	vk::SubmitInfo submit_info,
-	uint32_t frame_index,
-	bool wait_for_fence
-) {
-	if (wait_for_fence) {
-		impl->graphics_queue.submit(submit_info, impl->fences[frame_index]);
-	} else {
-		impl->graphics_queue.submit(submit_info, nullptr);
+TimelinePoint Device::submit(QueueType queue, const QueueSubmission &submission) {
+	TRAMOGI_PROFILE_ZONE("submit");
+
+	// Fixed size so that submitting every frame does not allocate.
+	constexpr size_t max_semaphore_count = 8;
+	std::array<vk::SemaphoreSubmitInfo, max_semaphore_count> waits;
+	std::array<vk::SemaphoreSubmitInfo, max_semaphore_count> signals;
+	std::array<vk::CommandBufferSubmitInfo, max_semaphore_count> command_buffers;
+	assert(
+		submission.wait_points.size() + submission.wait_semaphores.size() <= waits.size() &&
+		"Too many semaphores to wait for"
+	);
+	assert(
+		submission.signal_semaphores.size() < signals.size() && "Too many semaphores to signal"
+	);
+	assert(
+		submission.command_buffers.size() <= command_buffers.size() && "Too many command buffers"
+	);
+
+	uint32_t wait_count = 0;
+	for (TimelinePoint point : submission.wait_points) {
+		if (point.value == 0) {
+			continue;
+		}
+		waits[wait_count++] = {
+			.semaphore = impl->get_timeline(point.queue).semaphore,
+			.value = point.value,
+			.stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+		};
 	}
+	for (const vk::SemaphoreSubmitInfo &wait : submission.wait_semaphores) {
+		waits[wait_count++] = wait;
+	}
+
+	Impl::Timeline &timeline = impl->get_timeline(queue);
+	TimelinePoint point {.queue = impl->resolve(queue), .value = timeline.last_submitted + 1};
+
+	uint32_t signal_count = 0;
+	for (const vk::SemaphoreSubmitInfo &signal : submission.signal_semaphores) {
+		signals[signal_count++] = signal;
+	}
+	signals[signal_count++] = {
+		.semaphore = timeline.semaphore,
+		.value = point.value,
+		.stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+	};
+
+	uint32_t command_buffer_count = 0;
+	for (vk::CommandBuffer command_buffer : submission.command_buffers) {
+		command_buffers[command_buffer_count++] = {.commandBuffer = command_buffer};
+	}
+
+	vk::SubmitInfo2 submit_info {
+		.waitSemaphoreInfoCount = wait_count,
+		.pWaitSemaphoreInfos = waits.data(),
+		.commandBufferInfoCount = command_buffer_count,
+		.pCommandBufferInfos = command_buffers.data(),
+		.signalSemaphoreInfoCount = signal_count,
+		.pSignalSemaphoreInfos = signals.data(),
+	};
+	impl->get_queue(queue).submit2(submit_info, nullptr);
+
+	timeline.last_submitted = point.value;
+	return point;
+}
+
+TimelinePoint Device::submit_frame(uint32_t frame_index, const QueueSubmission &submission) {
+	TimelinePoint point = submit(QueueType::Graphics, submission);
+	impl->frame_points[frame_index] = point;
+	return point;
 }
 
 Result<> Device::present(vk::PresentInfoKHR present_info) {
+	TRAMOGI_PROFILE_ZONE("present");
+
 	try {
 		vk::Result result = impl->present_queue.presentKHR(present_info);
 		if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR) {
@@ -99,50 +249,126 @@ Result<> Device::present(vk::PresentInfoKHR present_info) {
 	return {};
 }
 
-void Device::wait_idle(uint32_t frame_index) const {
-	impl->device.waitIdle();
-	while (vk::Result::eTimeout == impl->device.waitForFences(
-									   *impl->fences[frame_index],
-									   vk::True,
-									   std::numeric_limits<uint64_t>().max()
-								   ))
+bool Device::is_complete(TimelinePoint point) const {
+	Impl::Timeline &timeline = impl->get_timeline(point.queue);
+	if (point.value > timeline.last_completed) {
+		timeline.last_completed = timeline.semaphore.getCounterValue();
+	}
+	return point.value <= timeline.last_completed;
+}
+
+void Device::wait(TimelinePoint point) const {
+	if (is_complete(point)) {
+		return;
+	}
+	TRAMOGI_PROFILE_ZONE("wait_timeline");
+
+	Impl::Timeline &timeline = impl->get_timeline(point.queue);
+	assert(
+		point.value <= timeline.last_submitted && "Waiting for a point that was never submitted"
+	);
+	vk::Semaphore semaphore = timeline.semaphore;
+	vk::SemaphoreWaitInfo wait_info {
+		.semaphoreCount = 1,
+		.pSemaphores = &semaphore,
+		.pValues = &point.value,
+	};
+	while (vk::Result::eTimeout ==
+		   impl->device.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max()))
 		;
+	timeline.last_completed = std::max(timeline.last_completed, point.value);
 }
 
-void Device::wait_graphics_queue() const {
-	impl->graphics_queue.waitIdle();
+void Device::wait_frame(uint32_t frame_index) const {
+	TRAMOGI_PROFILE_ZONE("wait_frame");
+
+	wait(impl->frame_points[frame_index]);
 }
 
-void Device::reset_fence(uint32_t frame_index) {
-	impl->device.resetFences(*impl->fences[frame_index]);
+void Device::wait_idle() const {
+	impl->device.waitIdle();
+	for (Impl::Timeline &timeline : impl->timelines) {
+		timeline.last_completed = timeline.last_submitted;
+	}
+}
+
+TimelinePoint Device::get_last_submitted(QueueType queue) const {
+	return {
+		.queue = impl->resolve(queue),
+		.value = impl->get_timeline(queue).last_submitted,
+	};
+}
+
+bool Device::is_extension_enabled(const char *extension_name) const {
+	return std::ranges::any_of(impl->enabled_extensions, [extension_name](const char *extension) {
+		return std::strcmp(extension, extension_name) == 0;
+	});
+}
+
+uint32_t Device::get_frame_count() const {
+	return impl->frame_count;
 }
 
 const vk::raii::Device &Device::get_device() const {
 	return impl->device;
 }
 
-const vk::raii::Semaphore &Device::get_render_semaphore(uint32_t frame_index) const {
-	return impl->render_semaphores[frame_index];
+MemoryAccounting &Device::get_memory_accounting() const {
+	return impl->memory_accounting;
+}
+
+DeviceMemoryAllocator &Device::get_memory_allocator() const {
+	return impl->memory_allocator;
+}
+
+const vk::raii::Semaphore &Device::get_render_semaphore(uint32_t image_index) const {
+	return impl->render_semaphores[image_index];
 }
 
 const vk::raii::Semaphore &Device::get_present_semaphore(uint32_t frame_index) const {
 	return impl->present_semaphores[frame_index];
 }
 
+const vk::raii::Semaphore &Device::get_timeline_semaphore(QueueType queue) const {
+	return impl->get_timeline(queue).semaphore;
+}
+
+void Device::create_swapchain_semaphores(uint32_t image_count) {
+	impl->render_semaphores.clear();
+	for (uint32_t i = 0; i < image_count; ++i) {
+		impl->render_semaphores.emplace_back(
+			impl->device,
+			vk::SemaphoreCreateInfo(),
+			get_host_allocation_callbacks()
+		);
+	}
+}
+
 void Device::create_sync_objects() {
 	impl->present_semaphores.clear();
-	impl->render_semaphores.clear();
-	impl->fences.clear();
+	impl->frame_points.assign(impl->frame_count, {});
 
-	// TODO: Change 2 to MAX_FRAME_IN_FLIGHT
-	for (uint32_t i = 0; i < 2; ++i) {
-		impl->present_semaphores.emplace_back(impl->device, vk::SemaphoreCreateInfo());
-		impl->render_semaphores.emplace_back(impl->device, vk::SemaphoreCreateInfo());
-		impl->fences.emplace_back(
+	for (uint32_t i = 0; i < impl->frame_count; ++i) {
+		impl->present_semaphores.emplace_back(
 			impl->device,
-			vk::FenceCreateInfo {.flags = vk::FenceCreateFlagBits::eSignaled}
+			vk::SemaphoreCreateInfo(),
+			get_host_allocation_callbacks()
 		);
 	}
+
+	vk::SemaphoreTypeCreateInfo timeline_info {
+		.semaphoreType = vk::SemaphoreType::eTimeline,
+		.initialValue = 0,
+	};
+	for (Impl::Timeline &timeline : impl->timelines) {
+		timeline = {
+			.semaphore = vk::raii::Semaphore(
+				impl->device,
+				vk::SemaphoreCreateInfo {.pNext = &timeline_info},
+				get_host_allocation_callbacks()
+			),
+		};
+	}
 }
 
 } // namespace tramogi::graphics
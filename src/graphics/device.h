@@ -2,12 +2,13 @@
 
 #include "tramogi/core/errors.h"
 #include <memory>
+#include <span>
 #include <stdint.h>
 
 namespace vk {
-class Fence;
+class CommandBuffer;
 class PresentInfoKHR;
-class SubmitInfo;
+struct SemaphoreSubmitInfo;
 namespace raii {
 class Device;
 class Semaphore;
@@ -16,9 +17,33 @@ class Semaphore;
 
 namespace tramogi::graphics {
 
+class DeviceMemoryAllocator;
 class Instance;
+class MemoryAccounting;
 class PhysicalDevice;
 
+enum class QueueType {
+	Graphics,
+	Transfer,
+};
+
+// A value on the timeline semaphore of a queue. Every submission to a queue signals the next
+// value, so a point is reached once that submission and every earlier one on the queue have
+// completed. A value of 0 is always reached.
+struct TimelinePoint {
+	QueueType queue = QueueType::Graphics;
+	uint64_t value = 0;
+};
+
+struct QueueSubmission {
+	std::span<const vk::CommandBuffer> command_buffers;
+	// Points on other queues to wait for before any command runs.
+	std::span<const TimelinePoint> wait_points;
+	// Binary semaphores, for the swapchain.
+	std::span<const vk::SemaphoreSubmitInfo> wait_semaphores;
+	std::span<const vk::SemaphoreSubmitInfo> signal_semaphores;
+};
+
 class Device {
 public:
 	Device(const PhysicalDevice &physical_device);
@@ -28,26 +53,44 @@ public:
 	Device(Device &&);
 	Device &operator=(Device &&) = delete;
 
-	void init(const Instance &instance);
+	static constexpr uint32_t default_frame_count = 2;
 
-	void submit_graphics(
-		vk::SubmitInfo submit_info,
-		uint32_t frame_index = 0,
-		bool wait_for_fence = false
-	);
+	// `frame_count` is the number of frames in flight, each with its own acquire semaphore.
+	void init(const Instance &instance, uint32_t frame_count = default_frame_count);
+	// Render semaphores are per swapchain image, since presentation of an image may still be
+	// waiting on one after its frame's timeline point has been reached. Call whenever the
+	// swapchain changes.
+	void create_swapchain_semaphores(uint32_t image_count);
+
+	// Returns the point signalled once the submission has completed. Transfer submissions go to
+	// the graphics queue when there is no dedicated transfer queue, and share its timeline.
+	TimelinePoint submit(QueueType queue, const QueueSubmission &submission);
+	// Same as submit to the graphics queue, and remembers the point for `wait_frame`.
+	TimelinePoint submit_frame(uint32_t frame_index, const QueueSubmission &submission);
 	core::Result<> present(vk::PresentInfoKHR present_info);
 
-	void wait_idle(uint32_t frame_index) const;
-	void wait_graphics_queue() const;
-	void reset_fence(uint32_t frame_index);
+	// Polls without blocking. Completed values are cached, so this is cheap for old points.
+	bool is_complete(TimelinePoint point) const;
+	void wait(TimelinePoint point) const;
+	// Waits for the last submission of `frame_index` only.
+	void wait_frame(uint32_t frame_index) const;
+	void wait_idle() const;
+	// The point of the last submission to `queue`.
+	TimelinePoint get_last_submitted(QueueType queue) const;
 
 	const PhysicalDevice &get_physical_device() const {
 		return physical_device;
 	}
 
+	bool is_extension_enabled(const char *extension_name) const;
+	uint32_t get_frame_count() const;
+
 	const vk::raii::Device &get_device() const;
-	const vk::raii::Semaphore &get_render_semaphore(uint32_t frame_index) const;
+	MemoryAccounting &get_memory_accounting() const;
+	DeviceMemoryAllocator &get_memory_allocator() const;
+	const vk::raii::Semaphore &get_render_semaphore(uint32_t image_index) const;
 	const vk::raii::Semaphore &get_present_semaphore(uint32_t frame_index) const;
+	const vk::raii::Semaphore &get_timeline_semaphore(QueueType queue) const;
 
 private:
 	struct Impl;
@@ -0,0 +1,206 @@
+#include "frame_graph.h"
+#include "gpu_profiler.h"
+#include "render_graph.h"
+#include <cstdint>
+#include <functional>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+namespace {
+
+void transition_image_layout(
+	const vk::raii::CommandBuffer &command_buffer,
+	vk::Image image,
+	vk::ImageAspectFlags aspect,
+	const ResourceState &before,
+	const ResourceState &after
+) {
+	vk::ImageMemoryBarrier2 barrier {
+		.srcStageMask = before.stages,
+		.srcAccessMask = before.access,
+		.dstStageMask = after.stages,
+		.dstAccessMask = after.access,
+		.oldLayout = before.layout,
+		.newLayout = after.layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = {
+			.aspectMask = aspect,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		}
+	};
+	command_buffer.pipelineBarrier2(
+		{.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier}
+	);
+}
+
+} // namespace
+
+void declare_frame_graph(RenderGraph &graph, const FrameGraphDesc &desc) {
+	graph.reset();
+	// Acquiring the image makes the submission wait at this stage.
+	RenderResource swapchain_image = graph.import_image(
+		"swapchain",
+		desc.swapchain_image,
+		vk::ImageAspectFlagBits::eColor,
+		{.stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput}
+	);
+	graph.export_resource(
+		swapchain_image,
+		{
+			.stages = vk::PipelineStageFlagBits2::eBottomOfPipe,
+			.layout = vk::ImageLayout::ePresentSrcKHR,
+		}
+	);
+	RenderResource depth = graph.create_image(
+		"depth",
+		{
+			.format = desc.depth_format,
+			.extent = desc.extent,
+			.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+			.aspect = vk::ImageAspectFlagBits::eDepth,
+		}
+	);
+
+	// Moves buffers with copies and barriers of its own.
+	graph.add_pass("defragment", desc.defragment).set_side_effects();
+
+	RenderResource cull_draws = 0;
+	RenderResource cull_count = 0;
+	bool has_cull = desc.cull_draws && desc.cull_count;
+	if (has_cull) {
+		// Last read by the previous frame of this frame slot, which has completed.
+		cull_draws = graph.import_buffer("cull_draws", desc.cull_draws, {});
+		cull_count = graph.import_buffer("cull_count", desc.cull_count, {});
+		ResourceState cull_output {
+			.stages = vk::PipelineStageFlagBits2::eComputeShader,
+			.access = vk::AccessFlagBits2::eShaderStorageWrite,
+		};
+		graph.add_pass("cull", desc.cull)
+			.write(cull_draws, cull_output)
+			.write(cull_count, cull_output);
+	}
+
+	// Transient images only exist once compiled.
+	auto record_rendering = desc.rendering;
+	auto rendering = [&graph, depth, record_rendering](const vk::raii::CommandBuffer &commands) {
+		record_rendering(commands, graph.get_image_view(depth));
+	};
+	auto rendering_pass = graph.add_pass("rendering", rendering);
+	rendering_pass.write(
+		swapchain_image,
+		{
+			.stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+			.access = vk::AccessFlagBits2::eColorAttachmentWrite,
+			.layout = vk::ImageLayout::eColorAttachmentOptimal,
+		}
+	);
+	rendering_pass.write(
+		depth,
+		{
+			.stages = vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+					  vk::PipelineStageFlagBits2::eLateFragmentTests,
+			.access = vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+					  vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+			.layout = vk::ImageLayout::eDepthAttachmentOptimal,
+		}
+	);
+	if (has_cull && desc.use_gpu_driven) {
+		ResourceState indirect {
+			.stages = vk::PipelineStageFlagBits2::eDrawIndirect,
+			.access = vk::AccessFlagBits2::eIndirectCommandRead,
+		};
+		rendering_pass.read(cull_draws, indirect).read(cull_count, indirect);
+	}
+}
+
+uint32_t record_hand_written_frame(
+	const vk::raii::CommandBuffer &command_buffer,
+	const FrameGraphDesc &desc,
+	vk::Image depth_image,
+	vk::ImageView depth_view,
+	GpuProfiler *profiler
+) {
+	auto record_zone = [&](const char *name, const std::function<void()> &record) {
+		if (profiler != nullptr) {
+			GpuZone zone(*profiler, command_buffer, name);
+			record();
+		} else {
+			record();
+		}
+	};
+
+	uint32_t barrier_count = 0;
+	record_zone("defragment", [&] { desc.defragment(command_buffer); });
+
+	if (desc.cull_draws && desc.cull_count && desc.use_gpu_driven) {
+		record_zone("cull", [&] {
+			desc.cull(command_buffer);
+			vk::MemoryBarrier2 indirect_barrier {
+				.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+				.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+				.dstStageMask = vk::PipelineStageFlagBits2::eDrawIndirect,
+				.dstAccessMask = vk::AccessFlagBits2::eIndirectCommandRead,
+			};
+			command_buffer.pipelineBarrier2(
+				{.memoryBarrierCount = 1, .pMemoryBarriers = &indirect_barrier}
+			);
+		});
+		++barrier_count;
+	}
+
+	ResourceState color_attachment {
+		.stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+		.access = vk::AccessFlagBits2::eColorAttachmentWrite,
+		.layout = vk::ImageLayout::eColorAttachmentOptimal,
+	};
+	record_zone("transitions", [&] {
+		transition_image_layout(
+			command_buffer,
+			desc.swapchain_image,
+			vk::ImageAspectFlagBits::eColor,
+			{.stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput},
+			color_attachment
+		);
+		ResourceState depth_attachment {
+			.stages = vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+					  vk::PipelineStageFlagBits2::eLateFragmentTests,
+			.access = vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+			.layout = vk::ImageLayout::eDepthAttachmentOptimal,
+		};
+		transition_image_layout(
+			command_buffer,
+			depth_image,
+			vk::ImageAspectFlagBits::eDepth,
+			{.stages = depth_attachment.stages, .access = depth_attachment.access},
+			depth_attachment
+		);
+	});
+	barrier_count += 2;
+
+	record_zone("rendering", [&] { desc.rendering(command_buffer, depth_view); });
+
+	record_zone("present_transition", [&] {
+		transition_image_layout(
+			command_buffer,
+			desc.swapchain_image,
+			vk::ImageAspectFlagBits::eColor,
+			color_attachment,
+			{
+				.stages = vk::PipelineStageFlagBits2::eBottomOfPipe,
+				.layout = vk::ImageLayout::ePresentSrcKHR,
+			}
+		);
+	});
+	++barrier_count;
+
+	return barrier_count;
+}
+
+} // namespace tramogi::graphics
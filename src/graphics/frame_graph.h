@@ -0,0 +1,49 @@
+#pragma once
+
+#include "render_graph.h"
+#include <cstdint>
+#include <functional>
+#include <vulkan/vulkan.hpp>
+
+namespace vk::raii {
+class CommandBuffer;
+} // namespace vk::raii
+
+namespace tramogi::graphics {
+
+class GpuProfiler;
+
+struct FrameGraphDesc {
+	vk::Image swapchain_image;
+	vk::Format depth_format = vk::Format::eUndefined;
+	vk::Extent2D extent;
+	// Null when GPU culling is not supported, which leaves the cull pass out.
+	vk::Buffer cull_draws;
+	vk::Buffer cull_count;
+	// Whether the rendering pass draws the cull's output. The graph culls the cull pass otherwise.
+	bool use_gpu_driven = false;
+
+	RenderGraph::Record defragment;
+	RenderGraph::Record cull;
+	// Given the view of the graph's depth image.
+	std::function<void(const vk::raii::CommandBuffer &command_buffer, vk::ImageView depth_view)>
+		rendering;
+};
+
+// Declares the demo's frame anew: the defragmentation copies, the GPU cull, and the rendering
+// into the swapchain image and a transient depth image, with the swapchain image exported for
+// presentation.
+void declare_frame_graph(RenderGraph &graph, const FrameGraphDesc &desc);
+
+// Records the same frame with barriers written by hand, kept to compare the render graph against.
+// Renders into `depth_image` instead of a transient image. Each barrier is in a batch of its own;
+// returns how many were recorded. Zones go to `profiler` when there is one.
+uint32_t record_hand_written_frame(
+	const vk::raii::CommandBuffer &command_buffer,
+	const FrameGraphDesc &desc,
+	vk::Image depth_image,
+	vk::ImageView depth_view,
+	GpuProfiler *profiler = nullptr
+);
+
+} // namespace tramogi::graphics
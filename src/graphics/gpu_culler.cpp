@@ -0,0 +1,536 @@
+#include "gpu_culler.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "physical_device.h"
+#include "pipeline_cache.h"
+#include "tramogi/core/errors.h"
+#include "tramogi/core/logging/logging.h"
+#include "tramogi/graphics/buffer.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+using core::Error;
+using core::Result;
+
+namespace {
+
+// Matches the entry point parameters of cull_main in shader.slang.
+struct CullPushConstants {
+	uint32_t object_count = 0;
+};
+
+// Matches CullFrustum in shader.slang, with std140 layout.
+struct CullFrustum {
+	Frustum planes {};
+};
+
+float dot_plane(const std::array<float, 4> &plane, const std::array<float, 3> &point) {
+	return plane[0] * point[0] + plane[1] * point[1] + plane[2] * point[2] + plane[3];
+}
+
+} // namespace
+
+Frustum extract_frustum(std::span<const float, 16> view_projection) {
+	// Row `i` of the matrix, read from column-major storage.
+	auto row = [view_projection](uint32_t i) {
+		return std::array {
+			view_projection[i],
+			view_projection[4 + i],
+			view_projection[8 + i],
+			view_projection[12 + i],
+		};
+	};
+	auto combine = [](const std::array<float, 4> &a, const std::array<float, 4> &b, float sign) {
+		return std::array {
+			a[0] + sign * b[0],
+			a[1] + sign * b[1],
+			a[2] + sign * b[2],
+			a[3] + sign * b[3],
+		};
+	};
+
+	std::array<float, 4> x = row(0);
+	std::array<float, 4> y = row(1);
+	std::array<float, 4> z = row(2);
+	std::array<float, 4> w = row(3);
+	Frustum frustum {
+		combine(w, x, 1.0f),
+		combine(w, x, -1.0f),
+		combine(w, y, 1.0f),
+		combine(w, y, -1.0f),
+		z,
+		combine(w, z, -1.0f),
+	};
+	for (std::array<float, 4> &plane : frustum) {
+		float length =
+			std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		for (float &value : plane) {
+			value /= length;
+		}
+	}
+	return frustum;
+}
+
+bool is_visible(const CullObject &object, const Frustum &frustum) {
+	const std::array<float, 16> &m = object.model;
+	const std::array<float, 4> &bounds = object.bounds;
+	std::array center {
+		m[0] * bounds[0] + m[4] * bounds[1] + m[8] * bounds[2] + m[12],
+		m[1] * bounds[0] + m[5] * bounds[1] + m[9] * bounds[2] + m[13],
+		m[2] * bounds[0] + m[6] * bounds[1] + m[10] * bounds[2] + m[14],
+	};
+
+	// The largest axis scale keeps the sphere conservative under non-uniform scaling.
+	float scale_squared = 0.0f;
+	for (uint32_t axis = 0; axis < 3; ++axis) {
+		const float *column = &m[axis * 4];
+		scale_squared = std::max(
+			scale_squared,
+			column[0] * column[0] + column[1] * column[1] + column[2] * column[2]
+		);
+	}
+	float radius = bounds[3] * std::sqrt(scale_squared);
+
+	return std::ranges::all_of(frustum, [&center, radius](const std::array<float, 4> &plane) {
+		return dot_plane(plane, center) >= -radius;
+	});
+}
+
+std::vector<uint32_t> cull_objects(std::span<const CullObject> objects, const Frustum &frustum) {
+	std::vector<uint32_t> visible;
+	for (uint32_t i = 0; i < objects.size(); ++i) {
+		if (is_visible(objects[i], frustum)) {
+			visible.push_back(i);
+		}
+	}
+	return visible;
+}
+
+struct GpuCuller::Impl {
+	struct Frame {
+		IndirectBuffer draw_buffer;
+		IndirectBuffer count_buffer;
+		UniformBuffer frustum_buffer;
+		// The draw count, followed by the draws when validating.
+		ReadbackBuffer readback_buffer;
+		vk::raii::DescriptorSet set = nullptr;
+
+		Frustum frustum {};
+		bool has_results = false;
+		bool is_validating = false;
+	};
+
+	const Device *device = nullptr;
+	std::vector<CullObject> objects;
+	vk::Buffer object_buffer;
+	bool is_supported = false;
+	bool is_validation_requested = false;
+
+	vk::raii::DescriptorSetLayout set_layout = nullptr;
+	vk::raii::PipelineLayout pipeline_layout = nullptr;
+	vk::raii::Pipeline pipeline = nullptr;
+	vk::raii::DescriptorPool pool = nullptr;
+	std::vector<Frame> frames;
+	uint32_t frame_index = 0;
+
+	GpuCullerStats stats;
+
+	uint64_t get_draw_buffer_size() const {
+		return std::max<uint64_t>(objects.size(), 1) * sizeof(vk::DrawIndexedIndirectCommand);
+	}
+
+	Result<> init_frame(Frame &frame);
+	void validate(Frame &frame, uint32_t visible_count);
+};
+
+Result<> GpuCuller::Impl::init_frame(Frame &frame) {
+	uint64_t draw_buffer_size = get_draw_buffer_size();
+	Result<> result = frame.draw_buffer.init(*device, draw_buffer_size);
+	if (result) {
+		result = frame.count_buffer.init(*device, sizeof(uint32_t));
+	}
+	if (result) {
+		result = frame.frustum_buffer.init(*device, sizeof(CullFrustum));
+	}
+	if (result) {
+		result = frame.readback_buffer.init(*device, sizeof(uint32_t) + draw_buffer_size);
+	}
+	if (!result) {
+		return Error(result.error());
+	}
+
+	vk::DescriptorSetAllocateInfo allocate_info {
+		.descriptorPool = pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &*set_layout,
+	};
+	frame.set = std::move(device->get_device().allocateDescriptorSets(allocate_info).front());
+
+	std::array buffer_infos {
+		vk::DescriptorBufferInfo {.buffer = object_buffer, .offset = 0, .range = vk::WholeSize},
+		vk::DescriptorBufferInfo {
+			.buffer = frame.draw_buffer.get_buffer(),
+			.offset = 0,
+			.range = vk::WholeSize,
+		},
+		vk::DescriptorBufferInfo {
+			.buffer = frame.count_buffer.get_buffer(),
+			.offset = 0,
+			.range = vk::WholeSize,
+		},
+		vk::DescriptorBufferInfo {
+			.buffer = frame.frustum_buffer.get_buffer(),
+			.offset = 0,
+			.range = vk::WholeSize,
+		},
+	};
+	std::array<vk::WriteDescriptorSet, buffer_infos.size()> writes;
+	for (uint32_t i = 0; i < writes.size(); ++i) {
+		bool is_uniform = i == writes.size() - 1;
+		writes[i] = {
+			.dstSet = frame.set,
+			.dstBinding = 2 + i,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = is_uniform ? vk::DescriptorType::eUniformBuffer
+										 : vk::DescriptorType::eStorageBuffer,
+			.pBufferInfo = &buffer_infos[i],
+		};
+	}
+	device->get_device().updateDescriptorSets(writes, {});
+	return {};
+}
+
+void GpuCuller::Impl::validate(Frame &frame, uint32_t visible_count) {
+	std::vector<uint32_t> expected = cull_objects(objects, frame.frustum);
+
+	visible_count = std::min(visible_count, static_cast<uint32_t>(objects.size()));
+	std::vector<vk::DrawIndexedIndirectCommand> draws(visible_count);
+	std::memcpy(
+		draws.data(),
+		static_cast<const std::byte *>(frame.readback_buffer.get_mapped_memory()) +
+			sizeof(uint32_t),
+		draws.size() * sizeof(vk::DrawIndexedIndirectCommand)
+	);
+
+	// Draws are compacted in whatever order the invocations finished, so only the set of objects
+	// is compared.
+	std::vector<uint32_t> actual;
+	uint32_t malformed_count = 0;
+	for (const vk::DrawIndexedIndirectCommand &draw : draws) {
+		bool is_valid = draw.firstInstance < objects.size() && draw.instanceCount == 1;
+		if (is_valid) {
+			const CullObject &object = objects[draw.firstInstance];
+			is_valid = draw.indexCount == object.index_count &&
+					   draw.firstIndex == object.first_index &&
+					   draw.vertexOffset == object.vertex_offset;
+		}
+		if (is_valid) {
+			actual.push_back(draw.firstInstance);
+		} else {
+			++malformed_count;
+		}
+	}
+	std::ranges::sort(actual);
+	std::vector<uint32_t> mismatched;
+	std::ranges::set_symmetric_difference(actual, expected, std::back_inserter(mismatched));
+
+	++stats.validation_count;
+	if (malformed_count == 0 && mismatched.empty()) {
+		TRAMOGI_LOG_INFO(
+			Graphics,
+			"GPU culling: {} visible objects match the CPU reference",
+			expected.size()
+		);
+		return;
+	}
+	++stats.validation_failure_count;
+	TRAMOGI_LOG_WARNING(
+		Graphics,
+		"GPU culling: {} visible objects on the GPU, {} in the CPU reference, {} mismatched and {} "
+		"malformed draws",
+		visible_count,
+		expected.size(),
+		mismatched.size(),
+		malformed_count
+	);
+}
+
+GpuCuller::GpuCuller() : impl(std::make_unique<Impl>()) {}
+GpuCuller::~GpuCuller() = default;
+
+Result<> GpuCuller::init(
+	const Device &device,
+	const PipelineCache &pipeline_cache,
+	vk::ShaderModule shader_module,
+	std::span<const CullObject> objects,
+	vk::Buffer object_buffer,
+	uint32_t frame_count
+) {
+	impl->device = &device;
+	impl->objects.assign(objects.begin(), objects.end());
+	impl->object_buffer = object_buffer;
+	impl->stats.object_count = static_cast<uint32_t>(objects.size());
+	impl->is_supported = device.get_physical_device().supports_indirect_count();
+	if (!impl->is_supported) {
+		TRAMOGI_LOG_WARNING(Graphics, "GPU culling: indirect count draws are not supported");
+		return {};
+	}
+
+	const vk::raii::Device &vk_device = device.get_device();
+	std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+	for (uint32_t i = 0; i < bindings.size(); ++i) {
+		bool is_uniform = i == bindings.size() - 1;
+		bindings[i] = {
+			.binding = 2 + i,
+			.descriptorType = is_uniform ? vk::DescriptorType::eUniformBuffer
+										 : vk::DescriptorType::eStorageBuffer,
+			.descriptorCount = 1,
+			.stageFlags = vk::ShaderStageFlagBits::eCompute,
+			.pImmutableSamplers = nullptr,
+		};
+	}
+	vk::DescriptorSetLayoutCreateInfo layout_info {
+		.bindingCount = bindings.size(),
+		.pBindings = bindings.data(),
+	};
+	impl->set_layout =
+		vk::raii::DescriptorSetLayout(vk_device, layout_info, get_host_allocation_callbacks());
+
+	vk::PushConstantRange push_constant_range {
+		.stageFlags = vk::ShaderStageFlagBits::eCompute,
+		.offset = 0,
+		.size = sizeof(CullPushConstants),
+	};
+	vk::PipelineLayoutCreateInfo pipeline_layout_info {
+		.setLayoutCount = 1,
+		.pSetLayouts = &*impl->set_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant_range,
+	};
+	impl->pipeline_layout = vk::raii::PipelineLayout(
+		vk_device,
+		pipeline_layout_info,
+		get_host_allocation_callbacks()
+	);
+
+	vk::ComputePipelineCreateInfo pipeline_info {
+		.stage =
+			{
+				.stage = vk::ShaderStageFlagBits::eCompute,
+				.module = shader_module,
+				.pName = "cull_main",
+			},
+		.layout = impl->pipeline_layout,
+	};
+	impl->pipeline = vk::raii::Pipeline(
+		vk_device,
+		pipeline_cache.get_cache(),
+		pipeline_info,
+		get_host_allocation_callbacks()
+	);
+
+	std::array pool_sizes {
+		vk::DescriptorPoolSize {
+			.type = vk::DescriptorType::eStorageBuffer,
+			.descriptorCount = 3 * frame_count,
+		},
+		vk::DescriptorPoolSize {
+			.type = vk::DescriptorType::eUniformBuffer,
+			.descriptorCount = frame_count,
+		},
+	};
+	vk::DescriptorPoolCreateInfo pool_info {
+		.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+		.maxSets = frame_count,
+		.poolSizeCount = pool_sizes.size(),
+		.pPoolSizes = pool_sizes.data(),
+	};
+	impl->pool = vk::raii::DescriptorPool(vk_device, pool_info, get_host_allocation_callbacks());
+
+	impl->frames.clear();
+	impl->frames.resize(frame_count);
+	for (Impl::Frame &frame : impl->frames) {
+		auto result = impl->init_frame(frame);
+		if (!result) {
+			return Error(result.error());
+		}
+	}
+	return {};
+}
+
+void GpuCuller::begin_frame(uint32_t frame_index) {
+	if (!impl->is_supported) {
+		return;
+	}
+	impl->frame_index = frame_index;
+
+	Impl::Frame &frame = impl->frames[frame_index];
+	if (!frame.has_results) {
+		return;
+	}
+	frame.has_results = false;
+
+	frame.readback_buffer.invalidate(0, frame.readback_buffer.get_size());
+	uint32_t visible_count = 0;
+	std::memcpy(&visible_count, frame.readback_buffer.get_mapped_memory(), sizeof(uint32_t));
+	impl->stats.last_visible_count = visible_count;
+
+	if (frame.is_validating) {
+		frame.is_validating = false;
+		impl->validate(frame, visible_count);
+	}
+}
+
+void GpuCuller::update(const Frustum &frustum) {
+	if (!impl->is_supported) {
+		return;
+	}
+
+	Impl::Frame &frame = impl->frames[impl->frame_index];
+	frame.frustum = frustum;
+	frame.has_results = !impl->objects.empty();
+	CullFrustum data {.planes = frustum};
+	frame.frustum_buffer.write(0, std::as_bytes(std::span(&data, 1)));
+}
+
+void GpuCuller::record_cull(const vk::raii::CommandBuffer &command_buffer) {
+	if (!impl->is_supported || impl->objects.empty()) {
+		return;
+	}
+
+	Impl::Frame &frame = impl->frames[impl->frame_index];
+	frame.is_validating = impl->is_validation_requested;
+	impl->is_validation_requested = false;
+
+	command_buffer.fillBuffer(frame.count_buffer.get_buffer(), 0, sizeof(uint32_t), 0);
+	vk::MemoryBarrier2 clear_barrier {
+		.srcStageMask = vk::PipelineStageFlagBits2::eAllTransfer,
+		.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+		.dstAccessMask =
+			vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+	};
+	command_buffer.pipelineBarrier2({.memoryBarrierCount = 1, .pMemoryBarriers = &clear_barrier});
+
+	auto object_count = static_cast<uint32_t>(impl->objects.size());
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, impl->pipeline);
+	command_buffer.bindDescriptorSets(
+		vk::PipelineBindPoint::eCompute,
+		impl->pipeline_layout,
+		0,
+		*frame.set,
+		{}
+	);
+	command_buffer.pushConstants<CullPushConstants>(
+		impl->pipeline_layout,
+		vk::ShaderStageFlagBits::eCompute,
+		0,
+		CullPushConstants {.object_count = object_count}
+	);
+	command_buffer.dispatch((object_count + group_size - 1) / group_size, 1, 1);
+	++impl->stats.dispatch_count;
+
+	vk::MemoryBarrier2 cull_barrier {
+		.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+		.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eCopy,
+		.dstAccessMask = vk::AccessFlagBits2::eTransferRead,
+	};
+	command_buffer.pipelineBarrier2({.memoryBarrierCount = 1, .pMemoryBarriers = &cull_barrier});
+
+	command_buffer.copyBuffer(
+		frame.count_buffer.get_buffer(),
+		frame.readback_buffer.get_buffer(),
+		vk::BufferCopy {.srcOffset = 0, .dstOffset = 0, .size = sizeof(uint32_t)}
+	);
+	if (frame.is_validating) {
+		command_buffer.copyBuffer(
+			frame.draw_buffer.get_buffer(),
+			frame.readback_buffer.get_buffer(),
+			vk::BufferCopy {
+				.srcOffset = 0,
+				.dstOffset = sizeof(uint32_t),
+				.size = impl->get_draw_buffer_size(),
+			}
+		);
+	}
+	vk::MemoryBarrier2 readback_barrier {
+		.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+		.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eHost,
+		.dstAccessMask = vk::AccessFlagBits2::eHostRead,
+	};
+	command_buffer.pipelineBarrier2(
+		{.memoryBarrierCount = 1, .pMemoryBarriers = &readback_barrier}
+	);
+}
+
+void GpuCuller::record_draw(const vk::raii::CommandBuffer &command_buffer) const {
+	if (!impl->is_supported || impl->objects.empty()) {
+		return;
+	}
+
+	Impl::Frame &frame = impl->frames[impl->frame_index];
+	command_buffer.drawIndexedIndirectCount(
+		frame.draw_buffer.get_buffer(),
+		0,
+		frame.count_buffer.get_buffer(),
+		0,
+		static_cast<uint32_t>(impl->objects.size()),
+		sizeof(vk::DrawIndexedIndirectCommand)
+	);
+}
+
+vk::Buffer GpuCuller::get_draw_buffer() const {
+	return impl->frames[impl->frame_index].draw_buffer.get_buffer();
+}
+
+vk::Buffer GpuCuller::get_count_buffer() const {
+	return impl->frames[impl->frame_index].count_buffer.get_buffer();
+}
+
+void GpuCuller::request_validation() {
+	impl->is_validation_requested = true;
+}
+
+bool GpuCuller::is_validation_pending() const {
+	return impl->is_validation_requested;
+}
+
+bool GpuCuller::is_supported() const {
+	return impl->is_supported;
+}
+
+GpuCullerStats GpuCuller::get_stats() const {
+	return impl->stats;
+}
+
+void GpuCuller::log_stats() const {
+	const GpuCullerStats &stats = impl->stats;
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"GPU culling: {} of {} objects visible in the last read back frame, {} dispatches, {} of "
+		"{} validations failed",
+		stats.last_visible_count,
+		stats.object_count,
+		stats.dispatch_count,
+		stats.validation_failure_count,
+		stats.validation_count
+	);
+}
+
+} // namespace tramogi::graphics
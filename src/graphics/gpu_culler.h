@@ -0,0 +1,115 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace vk {
+class Buffer;
+class ShaderModule;
+namespace raii {
+class CommandBuffer;
+} // namespace raii
+} // namespace vk
+
+namespace tramogi::graphics {
+
+class Device;
+class PipelineCache;
+
+// Matches CullObject in shader.slang, with std430 layout.
+struct CullObject {
+	// Column-major, from object space to the space the frustum is given in.
+	std::array<float, 16> model {};
+	// Object-space bounding sphere, center in xyz and radius in w.
+	std::array<float, 4> bounds {};
+	uint32_t index_count = 0;
+	uint32_t first_index = 0;
+	int32_t vertex_offset = 0;
+	uint32_t padding = 0;
+};
+
+// Left, right, bottom, top, near and far planes as normal in xyz and distance in w, normalized,
+// with the inside on the positive side.
+using Frustum = std::array<std::array<float, 4>, 6>;
+
+// From a column-major view projection matrix with a [0, 1] depth range.
+Frustum extract_frustum(std::span<const float, 16> view_projection);
+// Same test as the cull shader, on the bounding sphere transformed by the object's model matrix.
+bool is_visible(const CullObject &object, const Frustum &frustum);
+// Reference for the cull shader: indices of the visible objects, in ascending order.
+std::vector<uint32_t> cull_objects(std::span<const CullObject> objects, const Frustum &frustum);
+
+struct GpuCullerStats {
+	uint32_t object_count = 0;
+	uint64_t dispatch_count = 0;
+	// Read back once the frame has completed.
+	uint32_t last_visible_count = 0;
+	uint32_t validation_count = 0;
+	uint32_t validation_failure_count = 0;
+};
+
+// Frustum culls objects in a compute pass and compacts the survivors into indexed indirect draw
+// commands, drawn with one `drawIndexedIndirectCount`. Each frame in flight has its own output,
+// and the draw's first instance is the object index, which the vertex shader uses to fetch the
+// object's transform from the same object buffer.
+class GpuCuller {
+public:
+	static constexpr uint32_t group_size = 64;
+
+	GpuCuller();
+	~GpuCuller();
+	GpuCuller(const GpuCuller &) = delete;
+	GpuCuller &operator=(const GpuCuller &) = delete;
+
+	// `object_buffer` must hold `objects` and outlive the culler. The objects are kept to validate
+	// the GPU output against `cull_objects`. Does nothing but log when indirect count draws are not
+	// supported.
+	core::Result<> init(
+		const Device &device,
+		const PipelineCache &pipeline_cache,
+		vk::ShaderModule shader_module,
+		std::span<const CullObject> objects,
+		vk::Buffer object_buffer,
+		uint32_t frame_count
+	);
+
+	// Reads back the results of `frame_index` and validates them if requested. Only call once the
+	// frame has been waited for.
+	void begin_frame(uint32_t frame_index);
+
+	// Sets this frame's frustum, read by the cull dispatch from a uniform buffer so that recorded
+	// command buffers stay valid while the camera moves. Call on every frame whose command buffer
+	// contains a cull, recorded or replayed.
+	void update(const Frustum &frustum);
+
+	// Records the cull dispatch, outside of a rendering pass. The draw and count buffers are
+	// last written by the compute shader, and must be made visible to indirect reads before
+	// `record_draw`.
+	void record_cull(const vk::raii::CommandBuffer &command_buffer);
+	// Draws the survivors, with the graphics pipeline and the index buffer already bound.
+	void record_draw(const vk::raii::CommandBuffer &command_buffer) const;
+
+	// Of the current frame.
+	vk::Buffer get_draw_buffer() const;
+	vk::Buffer get_count_buffer() const;
+
+	// Compares the output of the next recorded cull against the CPU reference once its frame
+	// completes. Objects touching a plane may differ by rounding.
+	void request_validation();
+	// Until the next cull is recorded; a replayed command buffer would not read the draws back.
+	bool is_validation_pending() const;
+
+	bool is_supported() const;
+	GpuCullerStats get_stats() const;
+	void log_stats() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
@@ -0,0 +1,379 @@
+#include "gpu_profiler.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "physical_device.h"
+#include "tramogi/core/logging/logging.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+namespace profiling = core::profiling;
+
+namespace {
+
+constexpr uint32_t invalid_zone = std::numeric_limits<uint32_t>::max();
+
+uint64_t get_timestamp_mask(uint32_t valid_bits) {
+	return valid_bits >= 64 ? std::numeric_limits<uint64_t>::max() : (1ull << valid_bits) - 1;
+}
+
+} // namespace
+
+struct GpuProfiler::Impl {
+	struct Zone {
+		const char *name = nullptr;
+		QueueType queue = QueueType::Graphics;
+		bool is_ended = false;
+	};
+
+	// Zone `i` owns queries 2i and 2i + 1.
+	struct Frame {
+		vk::raii::QueryPool query_pool = nullptr;
+		std::vector<Zone> zones;
+	};
+
+	struct Entry {
+		const char *name = nullptr;
+		uint64_t count = 0;
+		uint64_t last_ns = 0;
+		uint64_t total_ns = 0;
+		uint64_t max_ns = 0;
+	};
+
+	Device *device = nullptr;
+	uint32_t max_zones_per_frame = 0;
+	std::vector<Frame> frames;
+	uint32_t frame_index = 0;
+	bool is_paused = false;
+
+	// Zero when the queue does not support timestamps.
+	uint32_t graphics_valid_bits = 0;
+	uint32_t transfer_valid_bits = 0;
+	double timestamp_period = 0.0;
+
+	// A GPU timestamp and the CPU time it was written at.
+	struct Calibration {
+		uint64_t ticks = 0;
+		uint64_t ns = 0;
+	};
+
+	// Per queue, indexed by QueueType, since timestamps of different queues are not guaranteed to
+	// be comparable.
+	std::array<Calibration, 2> calibrations;
+	std::array<uint32_t, 2> tracks {};
+
+	// Value and availability of every query of a frame.
+	std::vector<uint64_t> results;
+	std::vector<Entry> entries;
+	uint64_t dropped_zone_count = 0;
+
+	uint32_t get_valid_bits(QueueType queue) const {
+		return queue == QueueType::Transfer ? transfer_valid_bits : graphics_valid_bits;
+	}
+
+	uint64_t to_cpu_ns(QueueType queue, uint64_t ticks) const {
+		const Calibration &calibration = calibrations[static_cast<size_t>(queue)];
+		auto delta = static_cast<int64_t>(ticks - calibration.ticks);
+		return calibration.ns +
+			   static_cast<uint64_t>(static_cast<double>(delta) * timestamp_period);
+	}
+
+	void read_back(Frame &frame);
+	void record(const Zone &zone, uint64_t begin_ns, uint64_t end_ns);
+	void calibrate(QueueType queue);
+};
+
+void GpuProfiler::Impl::read_back(Frame &frame) {
+	auto query_count = static_cast<uint32_t>(frame.zones.size() * 2);
+	if (query_count == 0) {
+		return;
+	}
+
+	// Without eWait this returns eNotReady instead of blocking when a query is unavailable,
+	// which the availability words already tell apart.
+	vk::Device vk_device = *device->get_device();
+	static_cast<void>(vk_device.getQueryPoolResults(
+		*frame.query_pool,
+		0,
+		query_count,
+		query_count * 2 * sizeof(uint64_t),
+		results.data(),
+		2 * sizeof(uint64_t),
+		vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability
+	));
+
+	for (size_t i = 0; i < frame.zones.size(); ++i) {
+		const Zone &zone = frame.zones[i];
+		const uint64_t *begin = &results[i * 4];
+		const uint64_t *end = &results[i * 4 + 2];
+		if (!zone.is_ended || begin[1] == 0 || end[1] == 0) {
+			continue;
+		}
+		uint64_t mask = get_timestamp_mask(get_valid_bits(zone.queue));
+		record(zone, to_cpu_ns(zone.queue, begin[0] & mask), to_cpu_ns(zone.queue, end[0] & mask));
+	}
+}
+
+void GpuProfiler::Impl::record(const Zone &zone, uint64_t begin_ns, uint64_t end_ns) {
+	uint64_t duration_ns = end_ns >= begin_ns ? end_ns - begin_ns : 0;
+
+	auto entry = std::ranges::find(entries, zone.name, &Entry::name);
+	if (entry == entries.end()) {
+		entries.push_back({.name = zone.name});
+		entry = entries.end() - 1;
+	}
+	++entry->count;
+	entry->last_ns = duration_ns;
+	entry->total_ns += duration_ns;
+	entry->max_ns = std::max(entry->max_ns, duration_ns);
+
+	if constexpr (profiling::enable_profiling) {
+		uint32_t track = tracks[static_cast<size_t>(zone.queue)];
+		profiling::record_track_zone(track, zone.name, begin_ns, begin_ns + duration_ns);
+	}
+}
+
+void GpuProfiler::Impl::calibrate(QueueType queue) {
+	const vk::raii::Device &vk_device = device->get_device();
+	const PhysicalDevice &physical_device = device->get_physical_device();
+	vk::raii::CommandPool command_pool(
+		vk_device,
+		vk::CommandPoolCreateInfo {
+			.flags = vk::CommandPoolCreateFlagBits::eTransient,
+			.queueFamilyIndex = queue == QueueType::Transfer
+									? physical_device.get_transfer_queue_index()
+									: physical_device.get_graphics_queue_index(),
+		},
+		get_host_allocation_callbacks()
+	);
+	vk::raii::CommandBuffer command_buffer = std::move(
+		vk_device
+			.allocateCommandBuffers({
+				.commandPool = command_pool,
+				.level = vk::CommandBufferLevel::ePrimary,
+				.commandBufferCount = 1,
+			})
+			.front()
+	);
+	vk::raii::QueryPool query_pool(
+		vk_device,
+		vk::QueryPoolCreateInfo {.queryType = vk::QueryType::eTimestamp, .queryCount = 1},
+		get_host_allocation_callbacks()
+	);
+	query_pool.reset(0, 1);
+
+	command_buffer.begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+	command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, query_pool, 0);
+	command_buffer.end();
+
+	vk::CommandBuffer submitted = command_buffer;
+	uint64_t submit_ns = profiling::now_ns();
+	TimelinePoint point = device->submit(queue, {.command_buffers = {&submitted, 1}});
+	device->wait(point);
+	uint64_t complete_ns = profiling::now_ns();
+
+	uint64_t ticks = query_pool
+						 .getResult<uint64_t>(
+							 0,
+							 1,
+							 sizeof(uint64_t),
+							 vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait
+						 )
+						 .second;
+	// The timestamp was written somewhere between the two CPU reads.
+	calibrations[static_cast<size_t>(queue)] = {
+		.ticks = ticks & get_timestamp_mask(get_valid_bits(queue)),
+		.ns = submit_ns + (complete_ns - submit_ns) / 2,
+	};
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"GPU clock of the {} queue calibrated to within {:.3f} ms",
+		queue == QueueType::Transfer ? "transfer" : "graphics",
+		static_cast<double>(complete_ns - submit_ns) / 2000000.0
+	);
+}
+
+GpuProfiler::GpuProfiler() : impl(std::make_unique<Impl>()) {}
+GpuProfiler::~GpuProfiler() = default;
+
+void GpuProfiler::init(Device &device, uint32_t max_zones_per_frame) {
+	impl->device = &device;
+	impl->max_zones_per_frame = max_zones_per_frame;
+
+	const PhysicalDevice &physical_device = device.get_physical_device();
+	const vk::raii::PhysicalDevice &vk_physical_device = physical_device.get_physical_device();
+	auto queue_families = vk_physical_device.getQueueFamilyProperties();
+	impl->timestamp_period = vk_physical_device.getProperties().limits.timestampPeriod;
+	if (impl->timestamp_period > 0.0) {
+		impl->graphics_valid_bits =
+			queue_families[physical_device.get_graphics_queue_index()].timestampValidBits;
+		impl->transfer_valid_bits =
+			queue_families[physical_device.get_transfer_queue_index()].timestampValidBits;
+	}
+
+	if (!is_supported()) {
+		TRAMOGI_LOG_WARNING(
+			Graphics,
+			"GPU profiling disabled, the graphics queue has no timestamps"
+		);
+		return;
+	}
+
+	uint32_t query_count = max_zones_per_frame * 2;
+	vk::QueryPoolCreateInfo pool_info {
+		.queryType = vk::QueryType::eTimestamp,
+		.queryCount = query_count,
+	};
+	impl->frames.resize(device.get_frame_count());
+	for (Impl::Frame &frame : impl->frames) {
+		frame.query_pool = vk::raii::QueryPool(
+			device.get_device(),
+			pool_info,
+			get_host_allocation_callbacks()
+		);
+		frame.query_pool.reset(0, query_count);
+		frame.zones.reserve(max_zones_per_frame);
+	}
+	impl->results.resize(query_count * 2);
+	impl->frame_index = 0;
+
+	if constexpr (profiling::enable_profiling) {
+		// Without a dedicated transfer queue, transfer zones run on the graphics queue.
+		impl->tracks.fill(profiling::create_track("GPU"));
+		if (physical_device.has_dedicated_transfer_queue()) {
+			impl->tracks[static_cast<size_t>(QueueType::Transfer)] =
+				profiling::create_track("GPU transfer");
+		}
+	}
+
+	calibrate();
+}
+
+void GpuProfiler::begin_frame(uint32_t frame_index) {
+	if (!is_supported()) {
+		return;
+	}
+	assert(frame_index < impl->frames.size() && "Frame index out of range");
+
+	Impl::Frame &frame = impl->frames[frame_index];
+	impl->read_back(frame);
+	if (!frame.zones.empty()) {
+		frame.query_pool.reset(0, static_cast<uint32_t>(frame.zones.size() * 2));
+		frame.zones.clear();
+	}
+	impl->frame_index = frame_index;
+}
+
+uint32_t GpuProfiler::begin_zone(
+	const vk::raii::CommandBuffer &command_buffer,
+	const char *name,
+	QueueType queue
+) {
+	if (impl->is_paused || !is_supported(queue)) {
+		return invalid_zone;
+	}
+
+	Impl::Frame &frame = impl->frames[impl->frame_index];
+	if (frame.zones.size() == impl->max_zones_per_frame) {
+		++impl->dropped_zone_count;
+		return invalid_zone;
+	}
+
+	auto zone = static_cast<uint32_t>(frame.zones.size());
+	frame.zones.push_back({.name = name, .queue = queue});
+	command_buffer.writeTimestamp2(
+		vk::PipelineStageFlagBits2::eAllCommands,
+		frame.query_pool,
+		zone * 2
+	);
+	return zone;
+}
+
+void GpuProfiler::end_zone(const vk::raii::CommandBuffer &command_buffer, uint32_t zone) {
+	if (zone == invalid_zone) {
+		return;
+	}
+
+	Impl::Frame &frame = impl->frames[impl->frame_index];
+	assert(zone < frame.zones.size() && "Zone ended in a different frame than it began");
+	frame.zones[zone].is_ended = true;
+	command_buffer.writeTimestamp2(
+		vk::PipelineStageFlagBits2::eAllCommands,
+		frame.query_pool,
+		zone * 2 + 1
+	);
+}
+
+void GpuProfiler::set_paused(bool is_paused) {
+	impl->is_paused = is_paused;
+}
+
+void GpuProfiler::calibrate() {
+	if (!is_supported()) {
+		return;
+	}
+	TRAMOGI_PROFILE_ZONE("gpu_calibrate");
+
+	impl->calibrate(QueueType::Graphics);
+	if (is_supported(QueueType::Transfer)) {
+		impl->calibrate(QueueType::Transfer);
+	}
+}
+
+bool GpuProfiler::is_supported(QueueType queue) const {
+	// Frame query pools only exist when the graphics queue has timestamps.
+	return impl->graphics_valid_bits > 0 && impl->get_valid_bits(queue) > 0;
+}
+
+std::vector<GpuZoneStats> GpuProfiler::get_stats() const {
+	std::vector<GpuZoneStats> stats;
+	for (const Impl::Entry &entry : impl->entries) {
+		stats.push_back({
+			.name = entry.name,
+			.count = entry.count,
+			.last_ms = static_cast<double>(entry.last_ns) / 1000000.0,
+			.average_ms = static_cast<double>(entry.total_ns) / 1000000.0 /
+						  static_cast<double>(entry.count),
+			.max_ms = static_cast<double>(entry.max_ns) / 1000000.0,
+		});
+	}
+	return stats;
+}
+
+void GpuProfiler::log_stats() const {
+	if (!is_supported()) {
+		return;
+	}
+	for (const GpuZoneStats &zone : get_stats()) {
+		TRAMOGI_LOG_INFO(
+			Graphics,
+			"GPU {}: {:.3f} ms last, {:.3f} ms average, {:.3f} ms max over {} samples",
+			zone.name,
+			zone.last_ms,
+			zone.average_ms,
+			zone.max_ms,
+			zone.count
+		);
+	}
+	if (impl->dropped_zone_count > 0) {
+		TRAMOGI_LOG_WARNING(
+			Graphics,
+			"GPU profiler dropped {} zones past {} per frame",
+			impl->dropped_zone_count,
+			impl->max_zones_per_frame
+		);
+	}
+}
+
+} // namespace tramogi::graphics
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "device.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vk::raii {
+class CommandBuffer;
+} // namespace vk::raii
+
+namespace tramogi::graphics {
+
+struct GpuZoneStats {
+	const char *name = nullptr;
+	uint64_t count = 0;
+	double last_ms = 0.0;
+	double average_ms = 0.0;
+	double max_ms = 0.0;
+};
+
+// Measures GPU time with timestamp queries written around zones of recorded commands. Each frame
+// in flight has its own query pool, which is only read back once the frame has been waited for,
+// so reading never stalls; results show up `frame_count` frames late. Queries that are still
+// unavailable are skipped rather than waited for.
+//
+// GPU timestamps are converted to the `profiling::now_ns` clock using a calibration submission on
+// each queue, and zones are recorded on a "GPU" track of the CPU profiler when profiling is
+// enabled, so both line up on one timeline. Zones of a dedicated transfer queue go to a track of
+// their own. Only core Vulkan is used; queues without timestamp support record nothing.
+class GpuProfiler {
+public:
+	static constexpr uint32_t default_max_zones_per_frame = 64;
+
+	GpuProfiler();
+	~GpuProfiler();
+	GpuProfiler(const GpuProfiler &) = delete;
+	GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+	void init(Device &device, uint32_t max_zones_per_frame = default_max_zones_per_frame);
+
+	// Reads back the zones last recorded for `frame_index` and resets its queries. Only call once
+	// the frame has been waited for. Zones recorded before the first call go to frame 0.
+	void begin_frame(uint32_t frame_index);
+
+	// `name` must outlive the profiler, string literals are expected. Returns the zone to pass to
+	// `end_zone`, which must be recorded in the same command buffer.
+	uint32_t begin_zone(
+		const vk::raii::CommandBuffer &command_buffer,
+		const char *name,
+		QueueType queue = QueueType::Graphics
+	);
+	void end_zone(const vk::raii::CommandBuffer &command_buffer, uint32_t zone);
+
+	// Zones begun while paused record nothing. Meant for command buffers that are submitted again
+	// in later frames, since their queries would not be reset in between.
+	void set_paused(bool is_paused);
+
+	// Maps GPU ticks to CPU time again by submitting a timestamp to each queue and waiting for it.
+	// Done by `init`; clocks drift slowly, so calling it again is only needed for long captures.
+	void calibrate();
+
+	bool is_supported(QueueType queue = QueueType::Graphics) const;
+	// Per zone name, in the order they were first seen.
+	std::vector<GpuZoneStats> get_stats() const;
+	void log_stats() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+// Records a zone for its lifetime, like TRAMOGI_PROFILE_ZONE does on the CPU.
+class GpuZone {
+public:
+	GpuZone(
+		GpuProfiler &profiler,
+		const vk::raii::CommandBuffer &command_buffer,
+		const char *name,
+		QueueType queue = QueueType::Graphics
+	)
+		: profiler(profiler), command_buffer(command_buffer),
+		  zone(profiler.begin_zone(command_buffer, name, queue)) {}
+	~GpuZone() {
+		profiler.end_zone(command_buffer, zone);
+	}
+
+	GpuZone(const GpuZone &) = delete;
+	GpuZone &operator=(const GpuZone &) = delete;
+
+private:
+	GpuProfiler &profiler;
+	const vk::raii::CommandBuffer &command_buffer;
+	uint32_t zone;
+};
+
+} // namespace tramogi::graphics
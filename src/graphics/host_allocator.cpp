@@ -0,0 +1,67 @@
+#include "host_allocator.h"
+#include "tramogi/core/memory/allocation_tracker.h"
+#include <cstddef>
+#include <vulkan/vulkan.hpp>
+
+namespace tramogi::graphics {
+
+using core::memory::AllocationCategory;
+
+static void *VKAPI_CALL allocate(void *, size_t size, size_t alignment, VkSystemAllocationScope) {
+	return core::memory::tracked_aligned_malloc(size, alignment, AllocationCategory::Vulkan);
+}
+
+static void *VKAPI_CALL reallocate(
+	void *,
+	void *original,
+	size_t size,
+	size_t alignment,
+	VkSystemAllocationScope
+) {
+	return core::memory::tracked_aligned_realloc(
+		original,
+		size,
+		alignment,
+		AllocationCategory::Vulkan
+	);
+}
+
+static void VKAPI_CALL free_memory(void *, void *memory) {
+	core::memory::tracked_free(memory);
+}
+
+static void VKAPI_CALL internal_allocation(
+	void *,
+	size_t size,
+	VkInternalAllocationType,
+	VkSystemAllocationScope
+) {
+	core::memory::record_allocation(AllocationCategory::Vulkan, size);
+}
+
+static void VKAPI_CALL internal_free(
+	void *,
+	size_t size,
+	VkInternalAllocationType,
+	VkSystemAllocationScope
+) {
+	core::memory::record_free(AllocationCategory::Vulkan, size);
+}
+
+const vk::AllocationCallbacks *get_host_allocation_callbacks() {
+	if constexpr (!core::memory::enable_memory_tracking) {
+		return nullptr;
+	}
+
+	static const vk::AllocationCallbacks callbacks {
+		.pUserData = nullptr,
+		.pfnAllocation = &allocate,
+		.pfnReallocation = &reallocate,
+		.pfnFree = &free_memory,
+		.pfnInternalAllocation = &internal_allocation,
+		.pfnInternalFree = &internal_free,
+	};
+	return &callbacks;
+}
+
+} // namespace tramogi::graphics
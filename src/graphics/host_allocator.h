@@ -0,0 +1,14 @@
+#pragma once
+
+namespace vk {
+class AllocationCallbacks;
+} // namespace vk
+
+namespace tramogi::graphics {
+
+// Host allocation callbacks that account Vulkan's CPU-side memory under the vulkan category of
+// the allocation tracker. Returns nullptr, meaning the driver's default allocator, when memory
+// tracking is disabled.
+const vk::AllocationCallbacks *get_host_allocation_callbacks();
+
+} // namespace tramogi::graphics
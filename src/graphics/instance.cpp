@@ -1,4 +1,5 @@
 #include "instance.h"
+#include "host_allocator.h"
 #include "tramogi/core/errors.h"
 #include "tramogi/core/logging/logging.h"
 #include "vulkan/vulkan.hpp"
@@ -16,7 +17,6 @@ namespace tramogi::graphics {
 
 using core::Error;
 using core::Result;
-using core::logging::debug_log;
 
 constexpr std::array<const char *, 1> validation_layers = {
 	"VK_LAYER_KHRONOS_validation",
@@ -46,7 +46,7 @@ bool check_extensions(
 	bool is_requirements_met = true;
 	std::vector<vk::ExtensionProperties> available_extensions =
 		context.enumerateInstanceExtensionProperties();
-	debug_log("Required Extensions:", required_extensions.size());
+	TRAMOGI_LOG_DEBUG(Graphics, "Required Extensions:", required_extensions.size());
 	for (auto required_ext : required_extensions) {
 		bool is_available = !std::ranges::none_of(
 			available_extensions,
@@ -55,7 +55,7 @@ bool check_extensions(
 			}
 		);
 		is_requirements_met = is_requirements_met && is_available;
-		debug_log("  - {}: {}", required_ext, is_available ? "OK" : "NO");
+		TRAMOGI_LOG_DEBUG(Graphics, "  - {}: {}", required_ext, is_available ? "OK" : "NO");
 	}
 	return is_requirements_met;
 }
@@ -63,7 +63,7 @@ bool check_extensions(
 bool check_layers(const vk::raii::Context &context, std::vector<const char *> required_layers) {
 	bool is_requirements_met = true;
 	std::vector<vk::LayerProperties> available_layers = context.enumerateInstanceLayerProperties();
-	debug_log("Required Layers:");
+	TRAMOGI_LOG_DEBUG(Graphics, "Required Layers:");
 	for (auto required_layer : required_layers) {
 		bool is_available = !std::ranges::none_of(
 			available_layers,
@@ -72,7 +72,7 @@ bool check_layers(const vk::raii::Context &context, std::vector<const char *> re
 			}
 		);
 		is_requirements_met = is_requirements_met && is_available;
-		debug_log("  - {}: {}", required_layer, is_available ? "OK" : "NO");
+		TRAMOGI_LOG_DEBUG(Graphics, "  - {}: {}", required_layer, is_available ? "OK" : "NO");
 	}
 	return is_requirements_met;
 }
@@ -83,12 +83,28 @@ static VKAPI_ATTR vk::Bool32 VKAPI_CALL debug_callback(
 	const vk::DebugUtilsMessengerCallbackDataEXT *data,
 	void *
 ) {
-	debug_log(
-		"Validation layer: [{}] {}: {}",
-		vk::to_string(severity),
-		vk::to_string(type),
-		data->pMessage
-	);
+	switch (severity) {
+	case vk::DebugUtilsMessageSeverityFlagBitsEXT::eError:
+		TRAMOGI_LOG_ERROR(Graphics, "Validation layer: {}: {}", vk::to_string(type), data->pMessage);
+		break;
+	case vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning:
+		TRAMOGI_LOG_WARNING(
+			Graphics,
+			"Validation layer: {}: {}",
+			vk::to_string(type),
+			data->pMessage
+		);
+		break;
+	default:
+		TRAMOGI_LOG_TRACE(
+			Graphics,
+			"Validation layer: [{}] {}: {}",
+			vk::to_string(severity),
+			vk::to_string(type),
+			data->pMessage
+		);
+		break;
+	}
 	return vk::False;
 }
 
@@ -110,7 +126,7 @@ vk::raii::DebugUtilsMessengerEXT setup_debug_messenger(const vk::raii::Instance
 		.pfnUserCallback = &debug_callback,
 	};
 
-	return instance.createDebugUtilsMessengerEXT(create_info);
+	return instance.createDebugUtilsMessengerEXT(create_info, get_host_allocation_callbacks());
 }
 
 Result<> Instance::init(const std::vector<const char *> &base_required_extensions) {
@@ -144,7 +160,8 @@ Result<> Instance::init(const std::vector<const char *> &base_required_extension
 		.ppEnabledExtensionNames = required_extensions.data(),
 	};
 
-	impl->instance = vk::raii::Instance(impl->context, create_info);
+	impl->instance =
+		vk::raii::Instance(impl->context, create_info, get_host_allocation_callbacks());
 
 	if constexpr (enable_validation_layer) {
 		impl->debug_messenger = setup_debug_messenger(impl->instance);
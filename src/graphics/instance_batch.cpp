@@ -0,0 +1,163 @@
+#include "instance_batch.h"
+#include "tramogi/core/errors.h"
+#include "tramogi/core/logging/logging.h"
+#include "tramogi/graphics/buffer.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+using core::Error;
+using core::Result;
+
+struct InstanceBatch::Impl {
+	struct Frame {
+		HostStorageBuffer buffer;
+		// Instances [changed_begin, changed_end) differ from what the buffer holds.
+		uint32_t changed_begin = 0;
+		uint32_t changed_end = 0;
+	};
+
+	std::vector<InstanceData> instances;
+	uint32_t capacity = 0;
+	std::vector<Frame> frames;
+	InstanceBatchStats stats;
+
+	void mark_changed(uint32_t begin, uint32_t end) {
+		for (Frame &frame : frames) {
+			if (frame.changed_begin == frame.changed_end) {
+				frame.changed_begin = begin;
+				frame.changed_end = end;
+			} else {
+				frame.changed_begin = std::min(frame.changed_begin, begin);
+				frame.changed_end = std::max(frame.changed_end, end);
+			}
+		}
+	}
+};
+
+InstanceBatch::InstanceBatch() : impl(std::make_unique<Impl>()) {}
+InstanceBatch::~InstanceBatch() = default;
+
+Result<> InstanceBatch::init(const Device &device, uint32_t capacity, uint32_t frame_count) {
+	assert(capacity > 0 && "Instance batch needs room for at least one instance");
+
+	impl->instances.clear();
+	impl->instances.reserve(capacity);
+	impl->capacity = capacity;
+	impl->frames.clear();
+	impl->frames.resize(frame_count);
+	for (Impl::Frame &frame : impl->frames) {
+		auto result = frame.buffer.init(device, sizeof(InstanceData) * capacity);
+		if (!result) {
+			return Error(result.error());
+		}
+	}
+	return {};
+}
+
+Result<uint32_t> InstanceBatch::add(const InstanceData &instance) {
+	if (impl->instances.size() == impl->capacity) {
+		return Error("Instance batch is full");
+	}
+
+	auto index = static_cast<uint32_t>(impl->instances.size());
+	impl->instances.push_back(instance);
+	impl->mark_changed(index, index + 1);
+	return index;
+}
+
+void InstanceBatch::set(uint32_t index, const InstanceData &instance) {
+	assert(index < impl->instances.size());
+	impl->instances[index] = instance;
+	impl->mark_changed(index, index + 1);
+}
+
+std::span<InstanceData> InstanceBatch::edit(uint32_t first, uint32_t count) {
+	assert(first + count <= impl->instances.size());
+	impl->mark_changed(first, first + count);
+	return std::span(impl->instances).subspan(first, count);
+}
+
+void InstanceBatch::clear() {
+	// Nothing to upload, draws stop reading the old instances.
+	impl->instances.clear();
+}
+
+void InstanceBatch::upload(uint32_t frame_index) {
+	Impl::Frame &frame = impl->frames[frame_index];
+	if (frame.changed_begin == frame.changed_end) {
+		return;
+	}
+
+	// Removed instances may still be marked changed.
+	uint32_t end = std::min(frame.changed_end, static_cast<uint32_t>(impl->instances.size()));
+	if (frame.changed_begin < end) {
+		std::span<const InstanceData> instances = impl->instances;
+		auto changed = instances.subspan(frame.changed_begin, end - frame.changed_begin);
+		frame.buffer.write(sizeof(InstanceData) * frame.changed_begin, changed);
+		++impl->stats.upload_count;
+		impl->stats.uploaded_bytes += changed.size_bytes();
+	}
+	frame.changed_begin = 0;
+	frame.changed_end = 0;
+}
+
+void InstanceBatch::record_draw(
+	const vk::raii::CommandBuffer &command_buffer,
+	uint32_t index_count,
+	uint32_t first_index,
+	int32_t vertex_offset
+) {
+	if (impl->instances.empty()) {
+		return;
+	}
+	command_buffer.drawIndexed(
+		index_count,
+		static_cast<uint32_t>(impl->instances.size()),
+		first_index,
+		vertex_offset,
+		0
+	);
+	++impl->stats.draw_count;
+}
+
+vk::raii::Buffer &InstanceBatch::get_buffer(uint32_t frame_index) {
+	return impl->frames[frame_index].buffer.get_buffer();
+}
+
+uint32_t InstanceBatch::get_count() const {
+	return static_cast<uint32_t>(impl->instances.size());
+}
+
+uint32_t InstanceBatch::get_capacity() const {
+	return impl->capacity;
+}
+
+InstanceBatchStats InstanceBatch::get_stats() const {
+	InstanceBatchStats stats = impl->stats;
+	stats.instance_count = get_count();
+	stats.capacity = impl->capacity;
+	return stats;
+}
+
+void InstanceBatch::log_stats() const {
+	InstanceBatchStats stats = get_stats();
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Instancing: {} of {} instances, {} uploads ({} bytes), {} instanced draws",
+		stats.instance_count,
+		stats.capacity,
+		stats.upload_count,
+		stats.uploaded_bytes,
+		stats.draw_count
+	);
+}
+
+} // namespace tramogi::graphics
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace vk {
+namespace raii {
+class Buffer;
+class CommandBuffer;
+} // namespace raii
+} // namespace vk
+
+namespace tramogi::graphics {
+
+class Device;
+
+// Matches InstanceData in shader.slang, with std430 layout.
+struct InstanceData {
+	// Column-major, from mesh space to the space of the uniform model matrix.
+	std::array<float, 16> model {};
+};
+
+struct InstanceBatchStats {
+	uint32_t instance_count = 0;
+	uint32_t capacity = 0;
+	// Writes to the per-frame buffers, one per `upload` that found changes.
+	uint64_t upload_count = 0;
+	uint64_t uploaded_bytes = 0;
+	uint64_t draw_count = 0;
+};
+
+// Instances of one mesh, drawn with a single instanced draw. The vertex shader fetches each
+// instance's transform from a storage buffer through the instance index, so N copies cost one
+// draw instead of N uniform updates and draws.
+//
+// Each frame in flight has its own host visible copy of the instances. Changes only touch the CPU
+// copy and are uploaded in batches: `upload` writes the range changed since the frame's copy was
+// last written with a single copy and flush.
+class InstanceBatch {
+public:
+	InstanceBatch();
+	~InstanceBatch();
+	InstanceBatch(const InstanceBatch &) = delete;
+	InstanceBatch &operator=(const InstanceBatch &) = delete;
+
+	core::Result<> init(const Device &device, uint32_t capacity, uint32_t frame_count);
+
+	// Returns the index of the new instance, or an error once the batch is full.
+	core::Result<uint32_t> add(const InstanceData &instance);
+	void set(uint32_t index, const InstanceData &instance);
+	// Instances [first, first + count), all marked changed.
+	std::span<InstanceData> edit(uint32_t first, uint32_t count);
+	void clear();
+
+	// Only call once the frame has been waited for.
+	void upload(uint32_t frame_index);
+
+	// Draws every instance with the pipeline, descriptor sets and index buffer already bound. The
+	// instance count is recorded into the command buffer, so recorded command buffers must be
+	// recorded again when it changes.
+	void record_draw(
+		const vk::raii::CommandBuffer &command_buffer,
+		uint32_t index_count,
+		uint32_t first_index = 0,
+		int32_t vertex_offset = 0
+	);
+
+	// Holds `get_capacity` instances, to bind as the frame's instance storage buffer.
+	vk::raii::Buffer &get_buffer(uint32_t frame_index);
+	uint32_t get_count() const;
+	uint32_t get_capacity() const;
+	InstanceBatchStats get_stats() const;
+	void log_stats() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
@@ -0,0 +1,282 @@
+#include "memory_accounting.h"
+#include "allocator.h"
+#include "physical_device.h"
+#include "tramogi/core/logging/logging.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+#include <vulkan/vulkan_to_string.hpp>
+
+namespace tramogi::graphics {
+
+// Without VK_EXT_memory_budget we assume the process may use this much of a heap.
+constexpr uint64_t fallback_budget_percent = 80;
+
+struct MemoryAccounting::Impl {
+	mutable std::mutex mutex;
+
+	const PhysicalDevice *physical_device = nullptr;
+	vk::PhysicalDeviceMemoryProperties memory_properties {};
+	bool has_memory_budget = false;
+
+	std::array<MemoryUsage, static_cast<size_t>(ResourceKind::Count)> kind_usage {};
+	std::array<MemoryUsage, vk::MaxMemoryTypes> type_usage {};
+	std::array<MemoryUsage, vk::MaxMemoryHeaps> heap_usage {};
+	std::array<MemoryUsage, vk::MaxMemoryTypes> type_reserved {};
+	std::array<MemoryUsage, vk::MaxMemoryHeaps> heap_reserved {};
+
+	float pressure_threshold = 0.9f;
+	std::array<bool, vk::MaxMemoryHeaps> heap_under_pressure {};
+	PressureCallback pressure_callback;
+};
+
+static double to_mib(uint64_t bytes) {
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+MemoryAccounting::MemoryAccounting() : impl(std::make_unique<Impl>()) {}
+MemoryAccounting::~MemoryAccounting() = default;
+
+void MemoryAccounting::init(const PhysicalDevice &physical_device, bool has_memory_budget) {
+	std::lock_guard lock(impl->mutex);
+	impl->physical_device = &physical_device;
+	impl->memory_properties = physical_device.get_memory_properties();
+	impl->has_memory_budget = has_memory_budget;
+}
+
+void MemoryAccounting::record_allocation(
+	uint32_t memory_type_index,
+	ResourceKind kind,
+	uint64_t size
+) {
+	std::lock_guard lock(impl->mutex);
+	uint32_t heap_index = impl->memory_properties.memoryTypes[memory_type_index].heapIndex;
+	for (MemoryUsage *usage : {
+			 &impl->kind_usage[static_cast<size_t>(kind)],
+			 &impl->type_usage[memory_type_index],
+			 &impl->heap_usage[heap_index],
+		 }) {
+		usage->bytes += size;
+		++usage->allocation_count;
+		usage->peak_bytes = std::max(usage->peak_bytes, usage->bytes);
+	}
+}
+
+void MemoryAccounting::record_free(uint32_t memory_type_index, ResourceKind kind, uint64_t size) {
+	std::lock_guard lock(impl->mutex);
+	uint32_t heap_index = impl->memory_properties.memoryTypes[memory_type_index].heapIndex;
+	for (MemoryUsage *usage : {
+			 &impl->kind_usage[static_cast<size_t>(kind)],
+			 &impl->type_usage[memory_type_index],
+			 &impl->heap_usage[heap_index],
+		 }) {
+		usage->bytes -= size;
+		--usage->allocation_count;
+	}
+}
+
+void MemoryAccounting::record_block_allocation(uint32_t memory_type_index, uint64_t size) {
+	uint32_t heap_index = 0;
+	{
+		std::lock_guard lock(impl->mutex);
+		heap_index = impl->memory_properties.memoryTypes[memory_type_index].heapIndex;
+		for (MemoryUsage *usage : {
+				 &impl->type_reserved[memory_type_index],
+				 &impl->heap_reserved[heap_index],
+			 }) {
+			usage->bytes += size;
+			++usage->allocation_count;
+			usage->peak_bytes = std::max(usage->peak_bytes, usage->bytes);
+		}
+	}
+
+	check_budget(heap_index);
+}
+
+void MemoryAccounting::record_block_free(uint32_t memory_type_index, uint64_t size) {
+	uint32_t heap_index = 0;
+	{
+		std::lock_guard lock(impl->mutex);
+		heap_index = impl->memory_properties.memoryTypes[memory_type_index].heapIndex;
+		for (MemoryUsage *usage : {
+				 &impl->type_reserved[memory_type_index],
+				 &impl->heap_reserved[heap_index],
+			 }) {
+			usage->bytes -= size;
+			--usage->allocation_count;
+		}
+	}
+
+	check_budget(heap_index);
+}
+
+MemoryUsage MemoryAccounting::get_usage(ResourceKind kind) const {
+	std::lock_guard lock(impl->mutex);
+	return impl->kind_usage[static_cast<size_t>(kind)];
+}
+
+MemoryUsage MemoryAccounting::get_memory_type_usage(uint32_t memory_type_index) const {
+	std::lock_guard lock(impl->mutex);
+	return impl->type_usage[memory_type_index];
+}
+
+MemoryUsage MemoryAccounting::get_heap_usage(uint32_t heap_index) const {
+	std::lock_guard lock(impl->mutex);
+	return impl->heap_usage[heap_index];
+}
+
+MemoryUsage MemoryAccounting::get_heap_reserved(uint32_t heap_index) const {
+	std::lock_guard lock(impl->mutex);
+	return impl->heap_reserved[heap_index];
+}
+
+std::vector<HeapBudget> MemoryAccounting::get_budgets() const {
+	vk::PhysicalDeviceMemoryBudgetPropertiesEXT budget_properties {};
+	if (impl->has_memory_budget && impl->physical_device) {
+		auto chain = impl->physical_device->get_physical_device()
+						 .getMemoryProperties2<
+							 vk::PhysicalDeviceMemoryProperties2,
+							 vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+		budget_properties = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+	}
+
+	std::lock_guard lock(impl->mutex);
+	std::vector<HeapBudget> budgets;
+	budgets.reserve(impl->memory_properties.memoryHeapCount);
+	for (uint32_t i = 0; i < impl->memory_properties.memoryHeapCount; ++i) {
+		const auto &heap = impl->memory_properties.memoryHeaps[i];
+		HeapBudget budget {
+			.heap_index = i,
+			.is_device_local =
+				static_cast<bool>(heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal),
+			.heap_size = heap.size,
+			.budget = heap.size * fallback_budget_percent / 100,
+			.usage = impl->heap_reserved[i].bytes,
+			.reserved_bytes = impl->heap_reserved[i].bytes,
+			.tracked_bytes = impl->heap_usage[i].bytes,
+		};
+		if (impl->has_memory_budget) {
+			budget.budget = budget_properties.heapBudget[i];
+			budget.usage = std::max(budget.usage, budget_properties.heapUsage[i]);
+		}
+		budgets.push_back(budget);
+	}
+
+	return budgets;
+}
+
+void MemoryAccounting::set_pressure_threshold(float fraction) {
+	std::lock_guard lock(impl->mutex);
+	impl->pressure_threshold = fraction;
+}
+
+void MemoryAccounting::set_pressure_callback(PressureCallback callback) {
+	std::lock_guard lock(impl->mutex);
+	impl->pressure_callback = std::move(callback);
+}
+
+void MemoryAccounting::check_budget(uint32_t heap_index) {
+	auto budgets = get_budgets();
+	if (heap_index >= budgets.size()) {
+		return;
+	}
+	const HeapBudget &budget = budgets[heap_index];
+
+	PressureCallback callback;
+	{
+		std::lock_guard lock(impl->mutex);
+		bool is_under_pressure =
+			static_cast<double>(budget.usage) >=
+			static_cast<double>(budget.budget) * impl->pressure_threshold;
+		bool was_under_pressure = std::exchange(
+			impl->heap_under_pressure[heap_index],
+			is_under_pressure
+		);
+		if (!is_under_pressure || was_under_pressure) {
+			return;
+		}
+		callback = impl->pressure_callback;
+	}
+
+	TRAMOGI_LOG_WARNING(
+		Graphics,
+		"Memory heap {} under pressure: {:.2f} MiB used of {:.2f} MiB budget",
+		heap_index,
+		to_mib(budget.usage),
+		to_mib(budget.budget)
+	);
+	if (callback) {
+		callback(budget);
+	}
+}
+
+std::string MemoryAccounting::dump() const {
+	auto budgets = get_budgets();
+
+	std::lock_guard lock(impl->mutex);
+	std::string out = std::format(
+		"Device memory ({}):\n",
+		impl->has_memory_budget ? "VK_EXT_memory_budget" : "estimated budget"
+	);
+	for (const HeapBudget &budget : budgets) {
+		const MemoryUsage &usage = impl->heap_usage[budget.heap_index];
+		out += std::format(
+			"  Heap {}{}: {:.2f} MiB used of {:.2f} MiB budget ({:.2f} MiB heap), reserved "
+			"{:.2f} MiB in {} blocks, tracked {:.2f} MiB in {} allocations\n",
+			budget.heap_index,
+			budget.is_device_local ? " (device local)" : "",
+			to_mib(budget.usage),
+			to_mib(budget.budget),
+			to_mib(budget.heap_size),
+			to_mib(budget.reserved_bytes),
+			impl->heap_reserved[budget.heap_index].allocation_count,
+			to_mib(usage.bytes),
+			usage.allocation_count
+		);
+		for (uint32_t i = 0; i < impl->memory_properties.memoryTypeCount; ++i) {
+			const auto &memory_type = impl->memory_properties.memoryTypes[i];
+			const MemoryUsage &type_usage = impl->type_usage[i];
+			const MemoryUsage &type_reserved = impl->type_reserved[i];
+			if (memory_type.heapIndex != budget.heap_index || type_reserved.allocation_count == 0) {
+				continue;
+			}
+			out += std::format(
+				"    Type {} {}: {:.2f} MiB in {} blocks, {:.2f} MiB in {} allocations\n",
+				i,
+				vk::to_string(memory_type.propertyFlags),
+				to_mib(type_reserved.bytes),
+				type_reserved.allocation_count,
+				to_mib(type_usage.bytes),
+				type_usage.allocation_count
+			);
+		}
+	}
+
+	out += "  By resource kind:\n";
+	for (size_t i = 0; i < impl->kind_usage.size(); ++i) {
+		const MemoryUsage &usage = impl->kind_usage[i];
+		out += std::format(
+			"    {}: {:.2f} MiB in {} allocations, peak {:.2f} MiB\n",
+			to_string(static_cast<ResourceKind>(i)),
+			to_mib(usage.bytes),
+			usage.allocation_count,
+			to_mib(usage.peak_bytes)
+		);
+	}
+
+	return out;
+}
+
+void MemoryAccounting::log_dump() const {
+	TRAMOGI_LOG_INFO(Graphics, "{}", dump());
+}
+
+} // namespace tramogi::graphics
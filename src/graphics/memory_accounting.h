@@ -0,0 +1,77 @@
+#pragma once
+
+#include "allocator.h"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tramogi::graphics {
+
+class PhysicalDevice;
+
+struct MemoryUsage {
+	uint64_t bytes = 0;
+	uint64_t allocation_count = 0;
+	// Highest `bytes` so far.
+	uint64_t peak_bytes = 0;
+};
+
+struct HeapBudget {
+	uint32_t heap_index = 0;
+	bool is_device_local = false;
+	uint64_t heap_size = 0;
+	// Reported by VK_EXT_memory_budget when available, estimated from the heap size otherwise.
+	uint64_t budget = 0;
+	// Process-wide usage reported by the driver, or the reserved bytes without the extension.
+	uint64_t usage = 0;
+	// Bytes of the memory blocks allocated from this heap.
+	uint64_t reserved_bytes = 0;
+	// Bytes of the resources sub-allocated from those blocks.
+	uint64_t tracked_bytes = 0;
+};
+
+// Central bookkeeping of every device memory allocation, by heap, memory type and resource kind.
+// Memory blocks are recorded separately from the resources placed in them, as only the former count
+// against the heap budgets.
+class MemoryAccounting {
+public:
+	using PressureCallback = std::function<void(const HeapBudget &)>;
+
+	MemoryAccounting();
+	~MemoryAccounting();
+	MemoryAccounting(const MemoryAccounting &) = delete;
+	MemoryAccounting &operator=(const MemoryAccounting &) = delete;
+
+	void init(const PhysicalDevice &physical_device, bool has_memory_budget);
+
+	void record_allocation(uint32_t memory_type_index, ResourceKind kind, uint64_t size);
+	void record_free(uint32_t memory_type_index, ResourceKind kind, uint64_t size);
+	void record_block_allocation(uint32_t memory_type_index, uint64_t size);
+	void record_block_free(uint32_t memory_type_index, uint64_t size);
+
+	MemoryUsage get_usage(ResourceKind kind) const;
+	MemoryUsage get_memory_type_usage(uint32_t memory_type_index) const;
+	MemoryUsage get_heap_usage(uint32_t heap_index) const;
+	// Reserved bytes and block count of a heap.
+	MemoryUsage get_heap_reserved(uint32_t heap_index) const;
+	std::vector<HeapBudget> get_budgets() const;
+
+	// Fires once a heap's usage crosses `fraction` of its budget, and again only after it dropped
+	// back below. A warning is logged either way.
+	void set_pressure_threshold(float fraction);
+	void set_pressure_callback(PressureCallback callback);
+
+	std::string dump() const;
+	void log_dump() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+
+	void check_budget(uint32_t heap_index);
+};
+
+} // namespace tramogi::graphics
@@ -0,0 +1,183 @@
+#include "parallel_recorder.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "physical_device.h"
+#include "tramogi/core/logging/logging.h"
+#include "tramogi/core/profiling/profiler.h"
+#include "tramogi/core/threading/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+namespace profiling = core::profiling;
+using core::threading::ThreadPool;
+
+struct ParallelRecorder::Impl {
+	struct ThreadCommands {
+		vk::raii::CommandPool pool = nullptr;
+		std::vector<vk::raii::CommandBuffer> buffers;
+		uint32_t used_count = 0;
+	};
+
+	const Device *device = nullptr;
+	ThreadPool *thread_pool = nullptr;
+	// Indexed by frame, then by `ThreadPool::get_thread_index`.
+	std::vector<std::vector<ThreadCommands>> frames;
+	uint32_t frame_index = 0;
+
+	std::vector<vk::CommandBuffer> recorded;
+	ParallelRecorderStats stats;
+	std::atomic<uint32_t> allocated_count {0};
+
+	// Only touches the calling thread's pool, so it is safe to call from every thread at once.
+	const vk::raii::CommandBuffer &acquire_command_buffer() {
+		uint32_t thread_index = ThreadPool::get_thread_index();
+		assert(thread_index < frames[frame_index].size());
+		ThreadCommands &commands = frames[frame_index][thread_index];
+
+		if (commands.used_count == commands.buffers.size()) {
+			vk::CommandBufferAllocateInfo allocate_info {
+				.commandPool = commands.pool,
+				.level = vk::CommandBufferLevel::eSecondary,
+				.commandBufferCount = 1,
+			};
+			commands.buffers.push_back(
+				std::move(device->get_device().allocateCommandBuffers(allocate_info).front())
+			);
+			++allocated_count;
+		}
+		return commands.buffers[commands.used_count++];
+	}
+};
+
+ParallelRecorder::ParallelRecorder() : impl(std::make_unique<Impl>()) {}
+ParallelRecorder::~ParallelRecorder() = default;
+
+void ParallelRecorder::init(const Device &device, ThreadPool &thread_pool, uint32_t frame_count) {
+	impl->device = &device;
+	impl->thread_pool = &thread_pool;
+	impl->frame_index = 0;
+
+	vk::CommandPoolCreateInfo pool_info {
+		.flags = vk::CommandPoolCreateFlagBits::eTransient,
+		.queueFamilyIndex = device.get_physical_device().get_graphics_queue_index(),
+	};
+	impl->frames.clear();
+	impl->frames.resize(frame_count);
+	for (auto &frame : impl->frames) {
+		frame.resize(thread_pool.get_thread_count() + 1);
+		for (Impl::ThreadCommands &commands : frame) {
+			commands.pool = vk::raii::CommandPool(
+				device.get_device(),
+				pool_info,
+				get_host_allocation_callbacks()
+			);
+		}
+	}
+}
+
+void ParallelRecorder::begin_frame(uint32_t frame_index) {
+	impl->frame_index = frame_index;
+	for (Impl::ThreadCommands &commands : impl->frames[frame_index]) {
+		if (commands.used_count > 0) {
+			commands.pool.reset();
+			commands.used_count = 0;
+		}
+	}
+}
+
+std::span<const vk::CommandBuffer> ParallelRecorder::record(
+	uint32_t count,
+	const RenderingInheritance &inheritance,
+	const RecordRange &record_range,
+	uint32_t min_batch_size
+) {
+	TRAMOGI_PROFILE_ZONE("parallel_record");
+	if (count == 0) {
+		return {};
+	}
+	uint64_t begin_ns = profiling::now_ns();
+
+	// One batch per participating thread at most; fewer when there is too little to record for
+	// the overhead of another command buffer to pay off.
+	min_batch_size = std::max(min_batch_size, 1u);
+	uint32_t batch_count = std::clamp(
+		(count + min_batch_size - 1) / min_batch_size,
+		1u,
+		impl->thread_pool->get_thread_count() + 1
+	);
+	uint32_t batch_size = (count + batch_count - 1) / batch_count;
+	batch_count = (count + batch_size - 1) / batch_size;
+
+	vk::CommandBufferInheritanceRenderingInfo rendering_info {
+		.colorAttachmentCount = static_cast<uint32_t>(inheritance.color_formats.size()),
+		.pColorAttachmentFormats = inheritance.color_formats.data(),
+		.depthAttachmentFormat = inheritance.depth_format,
+		.rasterizationSamples = vk::SampleCountFlagBits::e1,
+	};
+	vk::CommandBufferInheritanceInfo inheritance_info {.pNext = &rendering_info};
+	vk::CommandBufferBeginInfo begin_info {
+		.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+				 vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+		.pInheritanceInfo = &inheritance_info,
+	};
+
+	impl->recorded.resize(batch_count);
+	impl->thread_pool->parallel_for(batch_count, [&](uint32_t batch) {
+		TRAMOGI_PROFILE_ZONE("record_batch");
+		uint32_t begin = batch * batch_size;
+		uint32_t end = std::min(begin + batch_size, count);
+
+		const vk::raii::CommandBuffer &command_buffer = impl->acquire_command_buffer();
+		command_buffer.begin(begin_info);
+		record_range(command_buffer, begin, end);
+		command_buffer.end();
+		impl->recorded[batch] = command_buffer;
+	});
+
+	++impl->stats.record_count;
+	impl->stats.item_count += count;
+	impl->stats.secondary_count += batch_count;
+	impl->stats.record_ns += profiling::now_ns() - begin_ns;
+	return impl->recorded;
+}
+
+uint32_t ParallelRecorder::get_thread_count() const {
+	return impl->thread_pool->get_thread_count() + 1;
+}
+
+ParallelRecorderStats ParallelRecorder::get_stats() const {
+	ParallelRecorderStats stats = impl->stats;
+	stats.allocated_count = impl->allocated_count;
+	return stats;
+}
+
+void ParallelRecorder::log_stats() const {
+	ParallelRecorderStats stats = get_stats();
+	if (stats.record_count == 0) {
+		TRAMOGI_LOG_INFO(Graphics, "Parallel recording: unused");
+		return;
+	}
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Parallel recording: {} items in {} secondary command buffers over {} calls on {} "
+		"threads, {:.3f} ms per call, {} command buffers allocated",
+		stats.item_count,
+		stats.secondary_count,
+		stats.record_count,
+		get_thread_count(),
+		static_cast<double>(stats.record_ns) / 1000000.0 / stats.record_count,
+		stats.allocated_count
+	);
+}
+
+} // namespace tramogi::graphics
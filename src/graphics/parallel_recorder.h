@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+
+namespace vk {
+class CommandBuffer;
+enum class Format;
+namespace raii {
+class CommandBuffer;
+} // namespace raii
+} // namespace vk
+
+namespace tramogi::core::threading {
+class ThreadPool;
+} // namespace tramogi::core::threading
+
+namespace tramogi::graphics {
+
+class Device;
+
+// Attachment formats of the dynamic rendering pass the secondary command buffers continue.
+struct RenderingInheritance {
+	std::span<const vk::Format> color_formats;
+	vk::Format depth_format;
+};
+
+struct ParallelRecorderStats {
+	uint32_t record_count = 0;
+	uint32_t item_count = 0;
+	uint32_t secondary_count = 0;
+	// Secondary command buffers allocated over all frames and threads; stays flat once warm.
+	uint32_t allocated_count = 0;
+	// Wall time of the `record` calls.
+	uint64_t record_ns = 0;
+};
+
+// Records draws into secondary command buffers on a thread pool. Every thread has its own command
+// pool per frame in flight, so recording needs no locking, and a frame's pools are reset as a
+// whole once the frame has been waited for instead of freeing buffers one by one.
+class ParallelRecorder {
+public:
+	// Records items [begin, end) into a secondary command buffer that is already begun, which
+	// inherits no state: pipelines, descriptor sets and dynamic state must be bound again.
+	using RecordRange = std::function<
+		void(const vk::raii::CommandBuffer &command_buffer, uint32_t begin, uint32_t end)>;
+
+	static constexpr uint32_t default_min_batch_size = 256;
+
+	ParallelRecorder();
+	~ParallelRecorder();
+	ParallelRecorder(const ParallelRecorder &) = delete;
+	ParallelRecorder &operator=(const ParallelRecorder &) = delete;
+
+	void init(
+		const Device &device,
+		core::threading::ThreadPool &thread_pool,
+		uint32_t frame_count
+	);
+
+	// Resets the command pools of `frame_index`. Only call once the frame has been waited for.
+	void begin_frame(uint32_t frame_index);
+
+	// Splits items [0, count) into batches of at least `min_batch_size` and records them on the
+	// thread pool and the calling thread. Returns the secondary command buffers in item order, to
+	// execute inside a rendering pass begun with `eContentsSecondaryCommandBuffers`; the span
+	// stays valid until the next call.
+	std::span<const vk::CommandBuffer> record(
+		uint32_t count,
+		const RenderingInheritance &inheritance,
+		const RecordRange &record_range,
+		uint32_t min_batch_size = default_min_batch_size
+	);
+
+	uint32_t get_thread_count() const;
+	ParallelRecorderStats get_stats() const;
+	void log_stats() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
@@ -5,6 +5,7 @@
 #include "tramogi/core/logging/logging.h"
 #include <algorithm>
 #include <array>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <memory>
@@ -18,7 +19,6 @@ namespace tramogi::graphics {
 
 using core::Error;
 using core::Result;
-using core::logging::debug_log;
 
 struct PhysicalDevice::Impl {
 	vk::raii::PhysicalDevice physical_device = nullptr;
@@ -31,6 +31,13 @@ const std::vector<const char *> PhysicalDevice::required_device_extensions {
 	vk::KHRCreateRenderpass2ExtensionName,
 };
 
+// Set to anything but "0" to disable the dedicated transfer queue, see
+// `disable_dedicated_transfer_queue`.
+
+const std::vector<const char *> PhysicalDevice::optional_device_extensions {
+	vk::EXTMemoryBudgetExtensionName,
+};
+
 PhysicalDevice::PhysicalDevice() : impl(std::make_unique<Impl>()) {}
 PhysicalDevice::~PhysicalDevice() = default;
 PhysicalDevice::PhysicalDevice(PhysicalDevice &&) = default;
@@ -86,40 +93,69 @@ DeviceSuitableness get_device_suitableness(
 			graphics_queue_index = i;
 		}
 
-		if (present_queue_index == queue_families.size() &&
+		if (present_queue_index == queue_families.size() && surface &&
 			physical_device.getSurfaceSupportKHR(i, surface)) {
 			present_queue_index = i;
 		}
 	}
+	// Nothing is presented without a surface, the graphics queue stands in.
+	if (!surface) {
+		present_queue_index = graphics_queue_index;
+	}
 
 	if (graphics_queue_index == queue_families.size() ||
 		present_queue_index == queue_families.size()) {
 		is_suitable = false;
 	}
 
-	debug_log("Physical Device: {}", std::string(property.deviceName));
-	debug_log("  Vulkan API v1.3 Support: {}", is_api_supported);
-	debug_log("  Extensions:");
+	// Prefer a family made for DMA, without graphics or compute, then anything without graphics.
+	uint32_t transfer_queue_index = graphics_queue_index;
+	uint32_t transfer_queue_score = 0;
+	for (uint32_t i = 0; i < queue_families.size(); ++i) {
+		vk::QueueFlags flags = queue_families.at(i).queueFlags;
+		if (!(flags & vk::QueueFlagBits::eTransfer) || (flags & vk::QueueFlagBits::eGraphics)) {
+			continue;
+		}
+
+		uint32_t score = flags & vk::QueueFlagBits::eCompute ? 1 : 2;
+		if (score > transfer_queue_score) {
+			transfer_queue_index = i;
+			transfer_queue_score = score;
+		}
+	}
+
+	TRAMOGI_LOG_DEBUG(Graphics, "Physical Device: {}", std::string(property.deviceName));
+	TRAMOGI_LOG_DEBUG(Graphics, "  Vulkan API v1.3 Support: {}", is_api_supported);
+	TRAMOGI_LOG_DEBUG(Graphics, "  Extensions:");
 	for ([[maybe_unused]] auto entry : extension_support_map) {
-		debug_log("    - {}: {}", entry.first, entry.second ? "Yes" : "No");
+		TRAMOGI_LOG_DEBUG(Graphics, "    - {}: {}", entry.first, entry.second ? "Yes" : "No");
 	}
-	debug_log("  Anisotropy Support: {}", anisotropy_support);
-	debug_log("  Queue:");
-	debug_log(
+	TRAMOGI_LOG_DEBUG(Graphics, "  Anisotropy Support: {}", anisotropy_support);
+	TRAMOGI_LOG_DEBUG(Graphics, "  Queue:");
+	TRAMOGI_LOG_DEBUG(
+		Graphics,
 		"    Graphics Queue Index: {}",
 		graphics_queue_index == queue_families.size() ? "Not Found"
 													  : std::to_string(graphics_queue_index)
 	);
-	debug_log(
+	TRAMOGI_LOG_DEBUG(
+		Graphics,
 		"    Present Queue Index: {}",
 		present_queue_index == queue_families.size() ? "Not Found"
 													 : std::to_string(present_queue_index)
 	);
+	TRAMOGI_LOG_DEBUG(
+		Graphics,
+		"    Transfer Queue Index: {}{}",
+		transfer_queue_index,
+		transfer_queue_index == graphics_queue_index ? " (graphics)" : ""
+	);
 
 	return {
 		.is_suitable = is_suitable,
 		.graphics_queue_index = graphics_queue_index,
-		.present_queue_index = present_queue_index
+		.present_queue_index = present_queue_index,
+		.transfer_queue_index = transfer_queue_index,
 	};
 }
 
@@ -140,7 +176,21 @@ uint32_t get_device_score(vk::raii::PhysicalDevice device) {
 
 Result<> PhysicalDevice::init(const Instance &instance, const vk::SurfaceKHR &surface_khr) {
 	surface.init(instance, surface_khr);
+	return select_device(instance);
+}
+
+Result<> PhysicalDevice::init_headless(const Instance &instance) {
+	return select_device(instance);
+}
+
+void PhysicalDevice::disable_dedicated_transfer_queue() {
+	if (has_dedicated_transfer_queue()) {
+		TRAMOGI_LOG_INFO(Graphics, "Uploads use the graphics queue, transfer queue disabled");
+	}
+	device_suitableness.transfer_queue_index = device_suitableness.graphics_queue_index;
+}
 
+Result<> PhysicalDevice::select_device(const Instance &instance) {
 	auto physical_devices = instance.get_physical_devices();
 	if (physical_devices.empty()) {
 		return Error("No GPU that supports Vulkan found");
@@ -174,7 +224,16 @@ Result<> PhysicalDevice::init(const Instance &instance, const vk::SurfaceKHR &su
 		return Error("No suitable device found");
 	}
 
-	debug_log("Using: {}", impl->physical_device.getProperties().deviceName.data());
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Using: {}",
+		impl->physical_device.getProperties().deviceName.data()
+	);
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Uploads use {}",
+		has_dedicated_transfer_queue() ? "a dedicated transfer queue" : "the graphics queue"
+	);
 
 	return {};
 }
@@ -198,6 +257,33 @@ Result<vk::Format> PhysicalDevice::get_depth_format() {
 	return Error("Failed to find a suitable depth format");
 }
 
+bool PhysicalDevice::supports_extension(const char *extension_name) const {
+	auto available_extensions = impl->physical_device.enumerateDeviceExtensionProperties();
+	return std::ranges::any_of(available_extensions, [extension_name](const auto &extension) {
+		return std::strcmp(extension.extensionName, extension_name) == 0;
+	});
+}
+
+bool PhysicalDevice::supports_bindless() const {
+	auto features = impl->physical_device.getFeatures2<
+		vk::PhysicalDeviceFeatures2,
+		vk::PhysicalDeviceVulkan12Features>();
+	const auto &vulkan12_features = features.get<vk::PhysicalDeviceVulkan12Features>();
+	return vulkan12_features.descriptorIndexing && vulkan12_features.runtimeDescriptorArray &&
+		   vulkan12_features.descriptorBindingPartiallyBound &&
+		   vulkan12_features.descriptorBindingSampledImageUpdateAfterBind &&
+		   vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind;
+}
+
+bool PhysicalDevice::supports_indirect_count() const {
+	auto features = impl->physical_device.getFeatures2<
+		vk::PhysicalDeviceFeatures2,
+		vk::PhysicalDeviceVulkan12Features>();
+	const auto &core_features = features.get<vk::PhysicalDeviceFeatures2>().features;
+	return core_features.multiDrawIndirect && core_features.drawIndirectFirstInstance &&
+		   features.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+}
+
 const vk::raii::PhysicalDevice &PhysicalDevice::get_physical_device() const {
 	return impl->physical_device;
 }
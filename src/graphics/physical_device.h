@@ -26,11 +26,15 @@ struct DeviceSuitableness {
 	bool is_suitable = false;
 	uint32_t graphics_queue_index = 0;
 	uint32_t present_queue_index = 0;
+	// Same as the graphics queue index when there is no transfer-only family.
+	uint32_t transfer_queue_index = 0;
 };
 
 class PhysicalDevice {
 public:
 	static const std::vector<const char *> required_device_extensions;
+	// Enabled by the logical device whenever the physical device supports them.
+	static const std::vector<const char *> optional_device_extensions;
 
 	PhysicalDevice();
 	~PhysicalDevice();
@@ -40,6 +44,9 @@ public:
 	PhysicalDevice &operator=(PhysicalDevice &&);
 
 	core::Result<> init(const Instance &instance, const vk::SurfaceKHR &surface_khr);
+	// Without a surface, for tests and benchmarks. Nothing can be presented, the present queue is
+	// the graphics queue and the surface queries must not be used.
+	core::Result<> init_headless(const Instance &instance);
 
 	uint32_t get_graphics_queue_index() const {
 		return device_suitableness.graphics_queue_index;
@@ -47,9 +54,25 @@ public:
 	uint32_t get_present_queue_index() const {
 		return device_suitableness.present_queue_index;
 	}
+	uint32_t get_transfer_queue_index() const {
+		return device_suitableness.transfer_queue_index;
+	}
+	bool has_dedicated_transfer_queue() const {
+		return device_suitableness.transfer_queue_index !=
+			   device_suitableness.graphics_queue_index;
+	}
+	// Uploads through the graphics queue even when a dedicated transfer queue family exists,
+	// which exercises the fallback path on any device. Call before creating the device.
+	void disable_dedicated_transfer_queue();
 
 	core::Result<vk::Format> get_depth_format();
 
+	bool supports_extension(const char *extension_name) const;
+	// Descriptor indexing with partially bound, update-after-bind image and buffer arrays.
+	bool supports_bindless() const;
+	// Multi-draw indirect with the draw count read from a buffer and a first instance per draw.
+	bool supports_indirect_count() const;
+
 	const vk::raii::PhysicalDevice &get_physical_device() const;
 	const vk::raii::SurfaceKHR &get_surface() const {
 		return surface.get_surface();
@@ -65,6 +88,8 @@ private:
 	std::unique_ptr<Impl> impl;
 	Surface surface;
 	DeviceSuitableness device_suitableness;
+
+	core::Result<> select_device(const Instance &instance);
 };
 
 } // namespace tramogi::graphics
@@ -0,0 +1,191 @@
+#include "pipeline_cache.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "physical_device.h"
+#include "tramogi/core/errors.h"
+#include "tramogi/core/logging/logging.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+using core::Error;
+using core::Result;
+
+namespace {
+
+// Layout of VkPipelineCacheHeaderVersionOne, read field by field since the data has no alignment
+// guarantees.
+struct CacheHeader {
+	uint32_t header_size = 0;
+	uint32_t header_version = 0;
+	uint32_t vendor_id = 0;
+	uint32_t device_id = 0;
+	std::array<uint8_t, vk::UuidSize> uuid {};
+};
+
+constexpr size_t cache_header_size = 16 + vk::UuidSize;
+
+std::vector<std::byte> read_file(const std::filesystem::path &filepath) {
+	std::ifstream file(filepath, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		return {};
+	}
+
+	std::vector<std::byte> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+	if (!file) {
+		return {};
+	}
+	return data;
+}
+
+core::Option<CacheHeader> read_header(const std::vector<std::byte> &data) {
+	if (data.size() < cache_header_size) {
+		return std::nullopt;
+	}
+
+	CacheHeader header;
+	std::memcpy(&header.header_size, data.data(), 4);
+	std::memcpy(&header.header_version, data.data() + 4, 4);
+	std::memcpy(&header.vendor_id, data.data() + 8, 4);
+	std::memcpy(&header.device_id, data.data() + 12, 4);
+	std::memcpy(header.uuid.data(), data.data() + 16, vk::UuidSize);
+	return header;
+}
+
+// Drivers are not required to survive garbage, so anything that does not look like a cache
+// written by this exact device and driver is rejected before reaching them.
+Result<> validate(
+	const std::vector<std::byte> &data,
+	const vk::PhysicalDeviceProperties &properties
+) {
+	auto header = read_header(data);
+	if (!header) {
+		return Error("File is too small");
+	}
+	if (header->header_size < cache_header_size || header->header_size > data.size()) {
+		return Error("Invalid header size");
+	}
+	if (header->header_version != static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne)) {
+		return Error("Unknown header version");
+	}
+	if (header->vendor_id != properties.vendorID || header->device_id != properties.deviceID) {
+		return Error("Written by a different device");
+	}
+	if (!std::ranges::equal(header->uuid, properties.pipelineCacheUUID)) {
+		return Error("Written by a different driver version");
+	}
+	return {};
+}
+
+} // namespace
+
+struct PipelineCache::Impl {
+	const Device *device = nullptr;
+	std::filesystem::path filepath;
+	vk::raii::PipelineCache cache = nullptr;
+	uint64_t loaded_size = 0;
+
+	vk::raii::PipelineCache create_cache(const std::vector<std::byte> &data) const {
+		vk::PipelineCacheCreateInfo cache_info {
+			.initialDataSize = data.size(),
+			.pInitialData = data.data(),
+		};
+		return vk::raii::PipelineCache(
+			device->get_device(),
+			cache_info,
+			get_host_allocation_callbacks()
+		);
+	}
+};
+
+PipelineCache::PipelineCache() : impl(std::make_unique<Impl>()) {}
+PipelineCache::~PipelineCache() = default;
+
+void PipelineCache::init(const Device &device, std::filesystem::path filepath) {
+	impl->device = &device;
+	impl->filepath = std::move(filepath);
+	impl->loaded_size = 0;
+
+	std::vector<std::byte> data = read_file(impl->filepath);
+	if (data.empty()) {
+		TRAMOGI_LOG_INFO(Graphics, "Pipeline cache: none found, starting cold");
+		impl->cache = impl->create_cache({});
+		return;
+	}
+
+	auto properties = device.get_physical_device().get_physical_device().getProperties();
+	auto result = validate(data, properties);
+	if (!result) {
+		TRAMOGI_LOG_WARNING(Graphics, "Pipeline cache: ignoring file, {}", result.error());
+		impl->cache = impl->create_cache({});
+		return;
+	}
+
+	try {
+		impl->cache = impl->create_cache(data);
+		impl->loaded_size = data.size();
+		TRAMOGI_LOG_INFO(Graphics, "Pipeline cache: loaded {} bytes", data.size());
+	} catch (const vk::SystemError &e) {
+		TRAMOGI_LOG_WARNING(Graphics, "Pipeline cache: rejected by the driver, {}", e.what());
+		impl->cache = impl->create_cache({});
+	}
+}
+
+Result<> PipelineCache::save() const {
+	std::vector<uint8_t> data = impl->cache.getData();
+
+	std::filesystem::path temporary_path = impl->filepath;
+	temporary_path += ".tmp";
+	{
+		std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return Error("Failed to open the temporary pipeline cache file");
+		}
+		file.write(
+			reinterpret_cast<const char *>(data.data()),
+			static_cast<std::streamsize>(data.size())
+		);
+		file.close();
+		if (!file) {
+			return Error("Failed to write the temporary pipeline cache file");
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary_path, impl->filepath, error);
+	if (error) {
+		std::filesystem::remove(temporary_path, error);
+		return Error("Failed to replace the pipeline cache file");
+	}
+
+	TRAMOGI_LOG_INFO(Graphics, "Pipeline cache: saved {} bytes", data.size());
+	return {};
+}
+
+bool PipelineCache::is_warm() const {
+	return impl->loaded_size > 0;
+}
+
+uint64_t PipelineCache::get_loaded_size() const {
+	return impl->loaded_size;
+}
+
+const vk::raii::PipelineCache &PipelineCache::get_cache() const {
+	return impl->cache;
+}
+
+} // namespace tramogi::graphics
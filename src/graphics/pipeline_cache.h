@@ -0,0 +1,42 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+namespace vk::raii {
+class PipelineCache;
+} // namespace vk::raii
+
+namespace tramogi::graphics {
+
+class Device;
+
+// A pipeline cache persisted to a file between runs, so the driver can skip compiling pipelines it
+// has seen before. The file is only used when its header matches the device (vendor, device and
+// pipeline cache UUID); a missing, stale or corrupt file just means starting with an empty cache.
+class PipelineCache {
+public:
+	PipelineCache();
+	~PipelineCache();
+	PipelineCache(const PipelineCache &) = delete;
+	PipelineCache &operator=(const PipelineCache &) = delete;
+
+	void init(const Device &device, std::filesystem::path filepath);
+	// Writes to a temporary file first and renames it over the cache, so an interrupted save
+	// never leaves a truncated file behind.
+	core::Result<> save() const;
+
+	// Whether data from a previous run was loaded.
+	bool is_warm() const;
+	uint64_t get_loaded_size() const;
+
+	const vk::raii::PipelineCache &get_cache() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
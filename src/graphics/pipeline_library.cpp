@@ -0,0 +1,362 @@
+#include "pipeline_library.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "pipeline_cache.h"
+#include "tramogi/core/errors.h"
+#include "tramogi/core/logging/logging.h"
+#include "tramogi/core/profiling/profiler.h"
+#include "tramogi/core/threading/thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+using core::Error;
+using core::Result;
+
+namespace profiling = core::profiling;
+
+namespace {
+
+template <typename T> void hash_combine(size_t &seed, const T &value) {
+	seed ^= std::hash<T> {}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+vk::raii::Pipeline create_pipeline(
+	const Device &device,
+	const PipelineCache &pipeline_cache,
+	const PipelineDesc &desc
+) {
+	std::vector<vk::SpecializationMapEntry> map_entries;
+	std::vector<uint32_t> specialization_data;
+	for (const SpecializationConstant &constant : desc.specialization_constants) {
+		map_entries.push_back({
+			.constantID = constant.id,
+			.offset = static_cast<uint32_t>(specialization_data.size() * sizeof(uint32_t)),
+			.size = sizeof(uint32_t),
+		});
+		specialization_data.push_back(constant.value);
+	}
+	vk::SpecializationInfo specialization_info {
+		.mapEntryCount = static_cast<uint32_t>(map_entries.size()),
+		.pMapEntries = map_entries.data(),
+		.dataSize = specialization_data.size() * sizeof(uint32_t),
+		.pData = specialization_data.data(),
+	};
+	const vk::SpecializationInfo *specialization =
+		map_entries.empty() ? nullptr : &specialization_info;
+
+	std::array<vk::PipelineShaderStageCreateInfo, 2> shader_stages {
+		vk::PipelineShaderStageCreateInfo {
+			.stage = vk::ShaderStageFlagBits::eVertex,
+			.module = desc.shader_module,
+			.pName = desc.vertex_entry.c_str(),
+			.pSpecializationInfo = specialization,
+		},
+		vk::PipelineShaderStageCreateInfo {
+			.stage = vk::ShaderStageFlagBits::eFragment,
+			.module = desc.shader_module,
+			.pName = desc.fragment_entry.c_str(),
+			.pSpecializationInfo = specialization,
+		},
+	};
+
+	std::array<vk::DynamicState, 2> dynamic_states {
+		vk::DynamicState::eViewport,
+		vk::DynamicState::eScissor,
+	};
+	vk::PipelineDynamicStateCreateInfo dynamic_state_info {
+		.dynamicStateCount = dynamic_states.size(),
+		.pDynamicStates = dynamic_states.data(),
+	};
+
+	vk::VertexInputBindingDescription binding_description {
+		.binding = 0,
+		.stride = desc.vertex_stride,
+		.inputRate = vk::VertexInputRate::eVertex,
+	};
+	std::vector<vk::VertexInputAttributeDescription> attribute_descriptions;
+	for (const VertexAttribute &attribute : desc.vertex_attributes) {
+		attribute_descriptions.push_back({
+			.location = attribute.location,
+			.binding = 0,
+			.format = attribute.format,
+			.offset = attribute.offset,
+		});
+	}
+	vk::PipelineVertexInputStateCreateInfo vertex_input_info {
+		.vertexBindingDescriptionCount = desc.vertex_attributes.empty() ? 0u : 1u,
+		.pVertexBindingDescriptions = &binding_description,
+		.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size()),
+		.pVertexAttributeDescriptions = attribute_descriptions.data(),
+	};
+	vk::PipelineInputAssemblyStateCreateInfo input_assembly_info {.topology = desc.topology};
+
+	vk::PipelineViewportStateCreateInfo viewport_state_info {
+		.viewportCount = 1,
+		.scissorCount = 1,
+	};
+	vk::PipelineRasterizationStateCreateInfo rasterization_state_info {
+		.depthClampEnable = vk::False,
+		.rasterizerDiscardEnable = vk::False,
+		.polygonMode = desc.polygon_mode,
+		.cullMode = desc.cull_mode,
+		.frontFace = desc.front_face,
+		.depthBiasEnable = vk::False,
+		.depthBiasSlopeFactor = 1,
+		.lineWidth = 1,
+	};
+	vk::PipelineMultisampleStateCreateInfo multisample_info {
+		.rasterizationSamples = vk::SampleCountFlagBits::e1,
+		.sampleShadingEnable = vk::False,
+	};
+
+	bool is_blended = desc.blend_mode == BlendMode::Alpha;
+	vk::PipelineColorBlendAttachmentState color_blend_attachment {
+		.blendEnable = is_blended,
+		.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+		.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+		.colorBlendOp = vk::BlendOp::eAdd,
+		.srcAlphaBlendFactor = vk::BlendFactor::eOne,
+		.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+		.alphaBlendOp = vk::BlendOp::eAdd,
+		.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+						  vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+	};
+	vk::PipelineDepthStencilStateCreateInfo depth_stencil_info {
+		.depthTestEnable = desc.depth_test,
+		.depthWriteEnable = desc.depth_write,
+		.depthCompareOp = desc.depth_compare,
+		.depthBoundsTestEnable = vk::False,
+		.stencilTestEnable = vk::False,
+	};
+	uint32_t color_attachment_count = desc.color_format == vk::Format::eUndefined ? 0u : 1u;
+	vk::PipelineColorBlendStateCreateInfo color_blending {
+		.logicOpEnable = vk::False,
+		.logicOp = vk::LogicOp::eCopy,
+		.attachmentCount = color_attachment_count,
+		.pAttachments = &color_blend_attachment,
+	};
+
+	vk::PipelineRenderingCreateInfo pipeline_rendering_info {
+		.colorAttachmentCount = color_attachment_count,
+		.pColorAttachmentFormats = &desc.color_format,
+		.depthAttachmentFormat = desc.depth_format,
+	};
+
+	vk::GraphicsPipelineCreateInfo pipeline_info {
+		.pNext = &pipeline_rendering_info,
+		.stageCount = desc.fragment_entry.empty() ? 1u : 2u,
+		.pStages = shader_stages.data(),
+		.pVertexInputState = &vertex_input_info,
+		.pInputAssemblyState = &input_assembly_info,
+		.pViewportState = &viewport_state_info,
+		.pRasterizationState = &rasterization_state_info,
+		.pMultisampleState = &multisample_info,
+		.pDepthStencilState = &depth_stencil_info,
+		.pColorBlendState = &color_blending,
+		.pDynamicState = &dynamic_state_info,
+		.layout = desc.layout,
+		.renderPass = nullptr,
+	};
+
+	return vk::raii::Pipeline(
+		device.get_device(),
+		pipeline_cache.get_cache(),
+		pipeline_info,
+		get_host_allocation_callbacks()
+	);
+}
+
+} // namespace
+
+size_t hash_pipeline_desc(const PipelineDesc &desc) {
+	size_t seed = 0;
+	hash_combine(seed, static_cast<VkShaderModule>(desc.shader_module));
+	hash_combine(seed, desc.vertex_entry);
+	hash_combine(seed, desc.fragment_entry);
+	for (const SpecializationConstant &constant : desc.specialization_constants) {
+		hash_combine(seed, constant.id);
+		hash_combine(seed, constant.value);
+	}
+	hash_combine(seed, static_cast<VkPipelineLayout>(desc.layout));
+	hash_combine(seed, desc.vertex_stride);
+	for (const VertexAttribute &attribute : desc.vertex_attributes) {
+		hash_combine(seed, attribute.location);
+		hash_combine(seed, static_cast<uint32_t>(attribute.format));
+		hash_combine(seed, attribute.offset);
+	}
+	hash_combine(seed, static_cast<uint32_t>(desc.topology));
+	hash_combine(seed, static_cast<uint32_t>(desc.polygon_mode));
+	hash_combine(seed, static_cast<uint32_t>(desc.cull_mode));
+	hash_combine(seed, static_cast<uint32_t>(desc.front_face));
+	hash_combine(seed, desc.depth_test);
+	hash_combine(seed, desc.depth_write);
+	hash_combine(seed, static_cast<uint32_t>(desc.depth_compare));
+	hash_combine(seed, static_cast<uint32_t>(desc.blend_mode));
+	hash_combine(seed, static_cast<uint32_t>(desc.color_format));
+	hash_combine(seed, static_cast<uint32_t>(desc.depth_format));
+	return seed;
+}
+
+struct PipelineLibrary::Impl {
+	// Written by the compiling worker, read by others only after `compiled` is ready.
+	struct Entry {
+		PipelineDesc desc;
+		const char *name = nullptr;
+		vk::raii::Pipeline pipeline = nullptr;
+		std::string error;
+		uint64_t compile_ns = 0;
+		std::shared_future<void> compiled;
+	};
+
+	const Device *device = nullptr;
+	const PipelineCache *pipeline_cache = nullptr;
+	core::threading::ThreadPool *thread_pool = nullptr;
+
+	std::vector<std::unique_ptr<Entry>> entries;
+	std::unordered_map<size_t, std::vector<PipelineId>> ids_by_hash;
+	uint32_t request_count = 0;
+
+	static bool is_compiled(const Entry &entry) {
+		return entry.compiled.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	// Runs on a worker.
+	void compile(Entry &entry) const {
+		TRAMOGI_PROFILE_ZONE("compile_pipeline");
+		uint64_t begin_ns = profiling::now_ns();
+		try {
+			entry.pipeline = create_pipeline(*device, *pipeline_cache, entry.desc);
+		} catch (const vk::SystemError &e) {
+			entry.error = e.what();
+		}
+		entry.compile_ns = profiling::now_ns() - begin_ns;
+	}
+};
+
+PipelineLibrary::PipelineLibrary() : impl(std::make_unique<Impl>()) {}
+
+PipelineLibrary::~PipelineLibrary() {
+	wait_all();
+}
+
+void PipelineLibrary::init(
+	const Device &device,
+	const PipelineCache &pipeline_cache,
+	core::threading::ThreadPool &thread_pool
+) {
+	impl->device = &device;
+	impl->pipeline_cache = &pipeline_cache;
+	impl->thread_pool = &thread_pool;
+}
+
+PipelineId PipelineLibrary::request(const PipelineDesc &desc, const char *name) {
+	++impl->request_count;
+
+	std::vector<PipelineId> &bucket = impl->ids_by_hash[hash_pipeline_desc(desc)];
+	for (PipelineId id : bucket) {
+		if (impl->entries[id]->desc == desc) {
+			return id;
+		}
+	}
+
+	auto id = static_cast<PipelineId>(impl->entries.size());
+	bucket.push_back(id);
+	auto &entry = impl->entries.emplace_back(std::make_unique<Impl::Entry>());
+	entry->desc = desc;
+	entry->name = name;
+
+	Impl::Entry *compiling = entry.get();
+	std::future<void> compiled = impl->thread_pool->submit([this, compiling]() {
+		impl->compile(*compiling);
+	});
+	entry->compiled = compiled.share();
+	return id;
+}
+
+Result<vk::Pipeline> PipelineLibrary::wait(PipelineId id) const {
+	const Impl::Entry &entry = *impl->entries[id];
+	if (!Impl::is_compiled(entry)) {
+		TRAMOGI_PROFILE_ZONE("wait_pipeline");
+		entry.compiled.wait();
+	}
+	if (!entry.error.empty()) {
+		return Error(std::format("Failed to compile pipeline {}: {}", entry.name, entry.error));
+	}
+	return *entry.pipeline;
+}
+
+void PipelineLibrary::wait_all() const {
+	for (const auto &entry : impl->entries) {
+		entry->compiled.wait();
+	}
+}
+
+vk::Pipeline PipelineLibrary::get(PipelineId id) const {
+	const Impl::Entry &entry = *impl->entries[id];
+	if (!Impl::is_compiled(entry)) {
+		return nullptr;
+	}
+	return *entry.pipeline;
+}
+
+bool PipelineLibrary::is_ready(PipelineId id) const {
+	return static_cast<bool>(get(id));
+}
+
+uint32_t PipelineLibrary::get_pending_count() const {
+	return static_cast<uint32_t>(std::ranges::count_if(impl->entries, [](const auto &entry) {
+		return !Impl::is_compiled(*entry);
+	}));
+}
+
+PipelineLibraryStats PipelineLibrary::get_stats() const {
+	PipelineLibraryStats stats {
+		.request_count = impl->request_count,
+		.deduplicated_count =
+			impl->request_count - static_cast<uint32_t>(impl->entries.size()),
+	};
+	for (const auto &entry : impl->entries) {
+		if (!Impl::is_compiled(*entry)) {
+			continue;
+		}
+		if (entry->error.empty()) {
+			++stats.compiled_count;
+		} else {
+			++stats.failed_count;
+		}
+		stats.compile_ns += entry->compile_ns;
+		stats.max_compile_ns = std::max(stats.max_compile_ns, entry->compile_ns);
+	}
+	return stats;
+}
+
+void PipelineLibrary::log_stats() const {
+	PipelineLibraryStats stats = get_stats();
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Pipelines: {} requests, {} deduplicated, {} compiled, {} failed, {} pending, {:.2f} ms "
+		"of compile time (slowest {:.2f} ms)",
+		stats.request_count,
+		stats.deduplicated_count,
+		stats.compiled_count,
+		stats.failed_count,
+		get_pending_count(),
+		static_cast<double>(stats.compile_ns) / 1000000.0,
+		static_cast<double>(stats.max_compile_ns) / 1000000.0
+	);
+}
+
+} // namespace tramogi::graphics
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace tramogi::core::threading {
+class ThreadPool;
+} // namespace tramogi::core::threading
+
+namespace tramogi::graphics {
+
+class Device;
+class PipelineCache;
+
+using PipelineId = uint32_t;
+
+struct VertexAttribute {
+	uint32_t location = 0;
+	vk::Format format = vk::Format::eUndefined;
+	uint32_t offset = 0;
+
+	bool operator==(const VertexAttribute &) const = default;
+};
+
+// Set on both shader stages, as 32-bit values.
+struct SpecializationConstant {
+	uint32_t id = 0;
+	uint32_t value = 0;
+
+	bool operator==(const SpecializationConstant &) const = default;
+};
+
+enum class BlendMode {
+	Opaque,
+	// Non-premultiplied alpha.
+	Alpha,
+};
+
+// Everything that varies between the graphics pipelines of the renderer. Viewport and scissor are
+// always dynamic, rendering is always dynamic with one color attachment and a single vertex
+// binding. An empty fragment entry and an undefined color format make a depth-only pipeline
+// instead. The shader module and layout must outlive the pipeline library.
+struct PipelineDesc {
+	vk::ShaderModule shader_module;
+	std::string vertex_entry = "vert_main";
+	std::string fragment_entry = "frag_main";
+	std::vector<SpecializationConstant> specialization_constants;
+	vk::PipelineLayout layout;
+
+	uint32_t vertex_stride = 0;
+	std::vector<VertexAttribute> vertex_attributes;
+	vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+
+	vk::PolygonMode polygon_mode = vk::PolygonMode::eFill;
+	vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eBack;
+	vk::FrontFace front_face = vk::FrontFace::eCounterClockwise;
+
+	bool depth_test = true;
+	bool depth_write = true;
+	vk::CompareOp depth_compare = vk::CompareOp::eLess;
+	BlendMode blend_mode = BlendMode::Opaque;
+
+	vk::Format color_format = vk::Format::eUndefined;
+	vk::Format depth_format = vk::Format::eUndefined;
+
+	bool operator==(const PipelineDesc &) const = default;
+};
+
+size_t hash_pipeline_desc(const PipelineDesc &desc);
+
+struct PipelineLibraryStats {
+	uint32_t request_count = 0;
+	// Requests answered with the pipeline of an equal desc.
+	uint32_t deduplicated_count = 0;
+	uint32_t compiled_count = 0;
+	uint32_t failed_count = 0;
+	// Summed over the worker threads.
+	uint64_t compile_ns = 0;
+	uint64_t max_compile_ns = 0;
+};
+
+// Compiles graphics pipelines from descs on a thread pool, through the pipeline cache. Requests
+// return at once and compiling starts in the background, in request order, so pipelines needed
+// for the first frame should be requested first and waited for, while the others finish later.
+class PipelineLibrary {
+public:
+	PipelineLibrary();
+	// Waits for the pipelines still compiling.
+	~PipelineLibrary();
+	PipelineLibrary(const PipelineLibrary &) = delete;
+	PipelineLibrary &operator=(const PipelineLibrary &) = delete;
+
+	void init(
+		const Device &device,
+		const PipelineCache &pipeline_cache,
+		core::threading::ThreadPool &thread_pool
+	);
+
+	// `name` must outlive the library, string literals are expected.
+	PipelineId request(const PipelineDesc &desc, const char *name);
+
+	// Blocks until the pipeline has compiled.
+	core::Result<vk::Pipeline> wait(PipelineId id) const;
+	void wait_all() const;
+	// Null until the pipeline has compiled, and if compiling failed.
+	vk::Pipeline get(PipelineId id) const;
+	bool is_ready(PipelineId id) const;
+	uint32_t get_pending_count() const;
+
+	PipelineLibraryStats get_stats() const;
+	void log_stats() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
@@ -0,0 +1,702 @@
+#include "render_graph.h"
+#include "allocator.h"
+#include "device.h"
+#include "gpu_profiler.h"
+#include "host_allocator.h"
+#include "physical_device.h"
+#include "tramogi/core/errors.h"
+#include "tramogi/core/logging/logging.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+using core::Error;
+using core::Result;
+
+namespace {
+
+constexpr uint32_t no_pass = std::numeric_limits<uint32_t>::max();
+
+// Only writes need an availability operation, reads only need to be waited for.
+constexpr vk::AccessFlags2 write_access_mask =
+	vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+	vk::AccessFlagBits2::eColorAttachmentWrite |
+	vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eTransferWrite |
+	vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite;
+
+// An image used for nothing else can be a transient attachment.
+constexpr vk::ImageUsageFlags attachment_usage_mask =
+	vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment |
+	vk::ImageUsageFlagBits::eInputAttachment;
+
+} // namespace
+
+struct RenderGraph::Impl {
+	// What later accesses of a resource have to wait for, while barriers are derived.
+	struct SyncState {
+		// Of the last write or layout transition.
+		vk::PipelineStageFlags2 write_stages;
+		vk::AccessFlags2 write_access;
+		// Reads since then, which already wait for it.
+		vk::PipelineStageFlags2 read_stages;
+		vk::AccessFlags2 read_access;
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+	};
+
+	struct BarrierBatch {
+		std::vector<vk::ImageMemoryBarrier2> image_barriers;
+		std::optional<vk::MemoryBarrier2> memory_barrier;
+
+		bool is_empty() const {
+			return image_barriers.empty() && !memory_barrier;
+		}
+
+		void record(const vk::raii::CommandBuffer &command_buffer) const {
+			vk::DependencyInfo dependency_info {
+				.memoryBarrierCount = memory_barrier ? 1u : 0u,
+				.pMemoryBarriers = memory_barrier ? &*memory_barrier : nullptr,
+				.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size()),
+				.pImageMemoryBarriers = image_barriers.data(),
+			};
+			command_buffer.pipelineBarrier2(dependency_info);
+		}
+	};
+
+	struct Access {
+		RenderResource resource = 0;
+		ResourceState state;
+		bool is_write = false;
+	};
+
+	struct Pass {
+		const char *name = nullptr;
+		Record record;
+		std::vector<Access> accesses;
+		bool has_side_effects = false;
+		bool is_alive = false;
+		// Recorded before the pass.
+		BarrierBatch barriers;
+	};
+
+	struct Resource {
+		const char *name = nullptr;
+		bool is_image = false;
+		bool is_transient = false;
+		vk::Image image;
+		vk::ImageView view;
+		vk::Buffer buffer;
+		vk::ImageAspectFlags aspect;
+		ResourceState initial_state;
+		std::optional<ResourceState> final_state;
+		TransientImageDesc desc;
+
+		// Over the passes that are not culled.
+		uint32_t first_pass = no_pass;
+		uint32_t last_pass = no_pass;
+		// Union of the accesses of the last pass.
+		ResourceState last_state;
+		// Transient images in the same slot share memory.
+		uint32_t slot = 0;
+	};
+
+	// Everything created for one set of transient images.
+	struct TransientSet {
+		// Per used transient image in declaration order, with its slot.
+		std::vector<std::pair<TransientImageDesc, uint32_t>> layout;
+		// Per slot, destroyed after the images bound to them.
+		std::vector<Allocation> allocations;
+		std::vector<vk::raii::Image> images;
+		std::vector<vk::raii::ImageView> views;
+	};
+
+	const Device *device = nullptr;
+	GpuProfiler *profiler = nullptr;
+
+	std::vector<Pass> passes;
+	std::vector<Resource> resources;
+	BarrierBatch final_barriers;
+
+	TransientSet transients;
+	// Indexed by the frame they were retired in.
+	std::vector<std::vector<TransientSet>> retired;
+	uint32_t frame_index = 0;
+
+	RenderGraphStats stats;
+
+	void cull_passes();
+	void compute_lifetimes();
+	Result<> create_transients();
+	void derive_barriers();
+	void add_barrier(
+		BarrierBatch &batch,
+		const Resource &resource,
+		SyncState &state,
+		const ResourceState &state_to,
+		bool is_write
+	) const;
+};
+
+// Walks the passes backwards from the exported resources, keeping those that write something a
+// kept pass reads.
+void RenderGraph::Impl::cull_passes() {
+	std::vector<bool> is_needed(resources.size());
+	for (size_t i = 0; i < resources.size(); ++i) {
+		is_needed[i] = resources[i].final_state.has_value();
+	}
+
+	for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass) {
+		pass->is_alive =
+			pass->has_side_effects ||
+			std::ranges::any_of(pass->accesses, [&is_needed](const Access &access) {
+				return access.is_write && is_needed[access.resource];
+			});
+		if (!pass->is_alive) {
+			continue;
+		}
+		for (const Access &access : pass->accesses) {
+			if (!access.is_write) {
+				is_needed[access.resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::Impl::compute_lifetimes() {
+	for (uint32_t i = 0; i < passes.size(); ++i) {
+		if (!passes[i].is_alive) {
+			continue;
+		}
+		for (const Access &access : passes[i].accesses) {
+			Resource &resource = resources[access.resource];
+			if (resource.first_pass == no_pass) {
+				resource.first_pass = i;
+			}
+			if (resource.last_pass != i) {
+				resource.last_pass = i;
+				resource.last_state = access.state;
+			} else {
+				resource.last_state.stages |= access.state.stages;
+				resource.last_state.access |= access.state.access;
+			}
+		}
+	}
+}
+
+// Transient images share a slot when the passes using them do not overlap, first come first
+// served in the order their first passes run.
+Result<> RenderGraph::Impl::create_transients() {
+	std::vector<RenderResource> used;
+	for (RenderResource i = 0; i < resources.size(); ++i) {
+		if (resources[i].is_transient && resources[i].first_pass != no_pass) {
+			used.push_back(i);
+		}
+	}
+	std::ranges::stable_sort(used, {}, [this](RenderResource i) {
+		return resources[i].first_pass;
+	});
+	std::vector<uint32_t> slot_last_passes;
+	for (RenderResource i : used) {
+		Resource &resource = resources[i];
+		auto slot = std::ranges::find_if(slot_last_passes, [&resource](uint32_t last_pass) {
+			return last_pass < resource.first_pass;
+		});
+		resource.slot = static_cast<uint32_t>(slot - slot_last_passes.begin());
+		if (slot == slot_last_passes.end()) {
+			slot_last_passes.push_back(resource.last_pass);
+		} else {
+			*slot = resource.last_pass;
+		}
+	}
+
+	// See `init_without_device`.
+	if (device == nullptr) {
+		stats.transient_image_count = static_cast<uint32_t>(used.size());
+		stats.transient_allocation_count = static_cast<uint32_t>(slot_last_passes.size());
+		return {};
+	}
+
+	std::vector<std::pair<TransientImageDesc, uint32_t>> layout;
+	std::ranges::sort(used);
+	for (RenderResource i : used) {
+		layout.emplace_back(resources[i].desc, resources[i].slot);
+	}
+
+	if (layout != transients.layout) {
+		if (!transients.images.empty()) {
+			retired[frame_index].push_back(std::move(transients));
+		}
+		transients = {};
+
+		const vk::raii::Device &vk_device = device->get_device();
+		std::vector<vk::MemoryRequirements> slot_requirements(
+			slot_last_passes.size(),
+			vk::MemoryRequirements {.size = 0, .alignment = 1, .memoryTypeBits = ~0u}
+		);
+		// Slots whose images are all transient attachments can be lazily allocated.
+		std::vector<bool> slot_lazy(slot_last_passes.size(), true);
+		stats.unaliased_transient_bytes = 0;
+		for (RenderResource i : used) {
+			const Resource &resource = resources[i];
+			vk::ImageUsageFlags usage = resource.desc.usage;
+			bool is_attachment_only = !(usage & ~attachment_usage_mask);
+			if (is_attachment_only) {
+				usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+			}
+			slot_lazy[resource.slot] = slot_lazy[resource.slot] && is_attachment_only;
+			vk::ImageCreateInfo image_info {
+				.imageType = vk::ImageType::e2D,
+				.format = resource.desc.format,
+				.extent = {resource.desc.extent.width, resource.desc.extent.height, 1},
+				.mipLevels = 1,
+				.arrayLayers = 1,
+				.samples = vk::SampleCountFlagBits::e1,
+				.tiling = vk::ImageTiling::eOptimal,
+				.usage = usage,
+				.sharingMode = vk::SharingMode::eExclusive,
+				.initialLayout = vk::ImageLayout::eUndefined,
+			};
+			transients.images.emplace_back(vk_device, image_info, get_host_allocation_callbacks());
+
+			vk::MemoryRequirements requirements = transients.images.back().getMemoryRequirements();
+			vk::MemoryRequirements &slot_requirement = slot_requirements[resource.slot];
+			slot_requirement.size = std::max(slot_requirement.size, requirements.size);
+			slot_requirement.alignment =
+				std::max(slot_requirement.alignment, requirements.alignment);
+			slot_requirement.memoryTypeBits &= requirements.memoryTypeBits;
+			stats.unaliased_transient_bytes += requirements.size;
+		}
+
+		vk::PhysicalDeviceMemoryProperties memory_properties =
+			device->get_physical_device().get_memory_properties();
+		stats.transient_bytes = 0;
+		stats.lazily_allocated_bytes = 0;
+		for (size_t slot = 0; slot < slot_requirements.size(); ++slot) {
+			const vk::MemoryRequirements &requirements = slot_requirements[slot];
+			if (requirements.memoryTypeBits == 0) {
+				return Error("Transient images sharing memory have no memory type in common");
+			}
+			auto allocation = allocate_memory(
+				*device,
+				requirements,
+				slot_lazy[slot] ? MemoryType::Lazy : MemoryType::Gpu,
+				ResourceKind::Attachment
+			);
+			if (!allocation) {
+				return Error(allocation.error());
+			}
+			stats.transient_bytes += allocation->get_size();
+			vk::MemoryPropertyFlags properties =
+				memory_properties.memoryTypes[allocation->get_memory_type_index()].propertyFlags;
+			if (properties & vk::MemoryPropertyFlagBits::eLazilyAllocated) {
+				stats.lazily_allocated_bytes += allocation->get_size();
+			}
+			transients.allocations.push_back(std::move(allocation.value()));
+		}
+
+		for (size_t i = 0; i < used.size(); ++i) {
+			const Resource &resource = resources[used[i]];
+			const Allocation &allocation = transients.allocations[resource.slot];
+			transients.images[i].bindMemory(allocation.get_memory(), allocation.get_offset());
+
+			vk::ImageViewCreateInfo view_info {
+				.image = transients.images[i],
+				.viewType = vk::ImageViewType::e2D,
+				.format = resource.desc.format,
+				.subresourceRange = {
+					.aspectMask = resource.desc.aspect,
+					.baseMipLevel = 0,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+			};
+			transients.views.emplace_back(vk_device, view_info, get_host_allocation_callbacks());
+		}
+
+		// Only once complete, a failed set is created again by the next compile.
+		transients.layout = std::move(layout);
+		stats.transient_image_count = static_cast<uint32_t>(used.size());
+		stats.transient_allocation_count = static_cast<uint32_t>(slot_requirements.size());
+		++stats.transient_generation;
+	}
+
+	for (size_t i = 0; i < used.size(); ++i) {
+		resources[used[i]].image = transients.images[i];
+		resources[used[i]].view = transients.views[i];
+	}
+	return {};
+}
+
+void RenderGraph::Impl::derive_barriers() {
+	std::vector<SyncState> states(resources.size());
+	for (size_t i = 0; i < resources.size(); ++i) {
+		const Resource &resource = resources[i];
+		if (!resource.is_transient) {
+			states[i] = {
+				.write_stages = resource.initial_state.stages,
+				.write_access = resource.initial_state.access & write_access_mask,
+				.layout = resource.initial_state.layout,
+			};
+			continue;
+		}
+		if (resource.first_pass == no_pass) {
+			continue;
+		}
+
+		// The content is discarded, but the memory must no longer be in use by the previous
+		// image in the slot, or by the last one of the previous frame.
+		const Resource *previous = nullptr;
+		const Resource *last = nullptr;
+		for (const Resource &other : resources) {
+			if (!other.is_transient || other.first_pass == no_pass || other.slot != resource.slot) {
+				continue;
+			}
+			if (last == nullptr || other.first_pass > last->first_pass) {
+				last = &other;
+			}
+			if (other.first_pass < resource.first_pass &&
+				(previous == nullptr || other.first_pass > previous->first_pass)) {
+				previous = &other;
+			}
+		}
+		if (previous == nullptr) {
+			previous = last;
+		}
+		states[i] = {
+			.write_stages = previous->last_state.stages,
+			.write_access = previous->last_state.access & write_access_mask,
+			.layout = vk::ImageLayout::eUndefined,
+		};
+	}
+
+	for (Pass &pass : passes) {
+		pass.barriers = {};
+		if (!pass.is_alive) {
+			continue;
+		}
+
+		std::vector<Access> accesses;
+		for (const Access &access : pass.accesses) {
+			auto merged = std::ranges::find(accesses, access.resource, &Access::resource);
+			if (merged == accesses.end()) {
+				accesses.push_back(access);
+				continue;
+			}
+			assert(
+				merged->state.layout == access.state.layout &&
+				"A pass must access an image in a single layout"
+			);
+			merged->state.stages |= access.state.stages;
+			merged->state.access |= access.state.access;
+			merged->is_write = merged->is_write || access.is_write;
+		}
+		for (const Access &access : accesses) {
+			add_barrier(
+				pass.barriers,
+				resources[access.resource],
+				states[access.resource],
+				access.state,
+				access.is_write
+			);
+		}
+	}
+
+	final_barriers = {};
+	for (size_t i = 0; i < resources.size(); ++i) {
+		if (resources[i].final_state) {
+			add_barrier(final_barriers, resources[i], states[i], *resources[i].final_state, false);
+		}
+	}
+}
+
+void RenderGraph::Impl::add_barrier(
+	BarrierBatch &batch,
+	const Resource &resource,
+	SyncState &state,
+	const ResourceState &state_to,
+	bool is_write
+) const {
+	bool is_transition = resource.is_image && state.layout != state_to.layout;
+	vk::ImageLayout old_layout = state.layout;
+	vk::PipelineStageFlags2 src_stages;
+	vk::AccessFlags2 src_access;
+
+	if (is_write || is_transition) {
+		// Waits for the last write and for the reads since, which have nothing to make available.
+		src_stages = state.write_stages | state.read_stages;
+		src_access = state.write_access;
+		if (is_write) {
+			state = {
+				.write_stages = state_to.stages,
+				.write_access = state_to.access & write_access_mask,
+				.layout = state_to.layout,
+			};
+		} else {
+			state = {
+				.write_stages = state_to.stages,
+				.read_stages = state_to.stages,
+				.read_access = state_to.access,
+				.layout = state_to.layout,
+			};
+		}
+		if (!is_transition && !src_stages) {
+			return;
+		}
+	} else {
+		bool is_waited_for = (state_to.stages & ~state.read_stages) == vk::PipelineStageFlags2 {} &&
+							 (state_to.access & ~state.read_access) == vk::AccessFlags2 {};
+		src_stages = state.write_stages;
+		src_access = state.write_access;
+		state.read_stages |= state_to.stages;
+		state.read_access |= state_to.access;
+		if (!src_stages || is_waited_for) {
+			return;
+		}
+	}
+
+	if (resource.is_image) {
+		batch.image_barriers.push_back({
+			.srcStageMask = src_stages,
+			.srcAccessMask = src_access,
+			.dstStageMask = state_to.stages,
+			.dstAccessMask = state_to.access,
+			.oldLayout = old_layout,
+			.newLayout = state_to.layout,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = resource.image,
+			.subresourceRange = {
+				.aspectMask = resource.aspect,
+				.baseMipLevel = 0,
+				.levelCount = vk::RemainingMipLevels,
+				.baseArrayLayer = 0,
+				.layerCount = vk::RemainingArrayLayers,
+			},
+		});
+		return;
+	}
+
+	if (!batch.memory_barrier) {
+		batch.memory_barrier = vk::MemoryBarrier2 {};
+	}
+	batch.memory_barrier->srcStageMask |= src_stages;
+	batch.memory_barrier->srcAccessMask |= src_access;
+	batch.memory_barrier->dstStageMask |= state_to.stages;
+	batch.memory_barrier->dstAccessMask |= state_to.access;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::read(
+	RenderResource resource,
+	const ResourceState &state
+) {
+	graph.impl->passes[pass].accesses.push_back({
+		.resource = resource,
+		.state = state,
+		.is_write = false,
+	});
+	return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::write(
+	RenderResource resource,
+	const ResourceState &state
+) {
+	graph.impl->passes[pass].accesses.push_back({
+		.resource = resource,
+		.state = state,
+		.is_write = true,
+	});
+	return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::set_side_effects() {
+	graph.impl->passes[pass].has_side_effects = true;
+	return *this;
+}
+
+RenderGraph::RenderGraph() : impl(std::make_unique<Impl>()) {}
+RenderGraph::~RenderGraph() = default;
+
+void RenderGraph::init(const Device &device, uint32_t frame_count, GpuProfiler *profiler) {
+	impl->device = &device;
+	impl->profiler = profiler;
+	impl->retired.clear();
+	impl->retired.resize(frame_count);
+	impl->frame_index = 0;
+}
+
+void RenderGraph::init_without_device(uint32_t frame_count) {
+	impl->device = nullptr;
+	impl->profiler = nullptr;
+	impl->retired.clear();
+	impl->retired.resize(frame_count);
+	impl->frame_index = 0;
+}
+
+void RenderGraph::begin_frame(uint32_t frame_index) {
+	impl->frame_index = frame_index;
+	impl->retired[frame_index].clear();
+}
+
+void RenderGraph::release_transients() {
+	for (std::vector<Impl::TransientSet> &sets : impl->retired) {
+		sets.clear();
+	}
+	impl->transients = {};
+}
+
+void RenderGraph::reset() {
+	impl->passes.clear();
+	impl->resources.clear();
+	impl->final_barriers = {};
+}
+
+RenderResource RenderGraph::import_image(
+	const char *name,
+	vk::Image image,
+	vk::ImageAspectFlags aspect,
+	const ResourceState &initial_state
+) {
+	impl->resources.push_back({
+		.name = name,
+		.is_image = true,
+		.image = image,
+		.aspect = aspect,
+		.initial_state = initial_state,
+	});
+	return static_cast<RenderResource>(impl->resources.size() - 1);
+}
+
+RenderResource RenderGraph::import_buffer(
+	const char *name,
+	vk::Buffer buffer,
+	const ResourceState &initial_state
+) {
+	impl->resources.push_back({
+		.name = name,
+		.buffer = buffer,
+		.initial_state = initial_state,
+	});
+	return static_cast<RenderResource>(impl->resources.size() - 1);
+}
+
+RenderResource RenderGraph::create_image(const char *name, const TransientImageDesc &desc) {
+	impl->resources.push_back({
+		.name = name,
+		.is_image = true,
+		.is_transient = true,
+		.aspect = desc.aspect,
+		.desc = desc,
+	});
+	return static_cast<RenderResource>(impl->resources.size() - 1);
+}
+
+void RenderGraph::export_resource(RenderResource resource, const ResourceState &final_state) {
+	impl->resources[resource].final_state = final_state;
+}
+
+RenderGraph::PassBuilder RenderGraph::add_pass(const char *name, Record record) {
+	impl->passes.push_back({.name = name, .record = std::move(record)});
+	return PassBuilder(*this, static_cast<uint32_t>(impl->passes.size() - 1));
+}
+
+Result<> RenderGraph::compile() {
+	TRAMOGI_PROFILE_ZONE("render_graph_compile");
+
+	impl->cull_passes();
+	impl->compute_lifetimes();
+	auto result = impl->create_transients();
+	if (!result) {
+		return result;
+	}
+	impl->derive_barriers();
+
+	RenderGraphStats &stats = impl->stats;
+	stats.pass_count = static_cast<uint32_t>(impl->passes.size());
+	stats.culled_pass_count = 0;
+	stats.barrier_batch_count = 0;
+	stats.image_barrier_count = 0;
+	stats.memory_barrier_count = 0;
+	auto count_batch = [&stats](const Impl::BarrierBatch &batch) {
+		if (!batch.is_empty()) {
+			++stats.barrier_batch_count;
+			stats.image_barrier_count += static_cast<uint32_t>(batch.image_barriers.size());
+			stats.memory_barrier_count += batch.memory_barrier ? 1 : 0;
+		}
+	};
+	for (const Impl::Pass &pass : impl->passes) {
+		if (!pass.is_alive) {
+			++stats.culled_pass_count;
+		}
+		count_batch(pass.barriers);
+	}
+	count_batch(impl->final_barriers);
+	return {};
+}
+
+void RenderGraph::execute(const vk::raii::CommandBuffer &command_buffer) {
+	TRAMOGI_PROFILE_ZONE("render_graph_execute");
+	assert(impl->device != nullptr && "A graph without a device can not be executed");
+
+	for (const Impl::Pass &pass : impl->passes) {
+		if (!pass.is_alive) {
+			continue;
+		}
+		if (!pass.barriers.is_empty()) {
+			pass.barriers.record(command_buffer);
+		}
+		if (impl->profiler != nullptr) {
+			GpuZone zone(*impl->profiler, command_buffer, pass.name);
+			pass.record(command_buffer);
+		} else {
+			pass.record(command_buffer);
+		}
+	}
+	if (!impl->final_barriers.is_empty()) {
+		impl->final_barriers.record(command_buffer);
+	}
+}
+
+vk::Image RenderGraph::get_image(RenderResource resource) const {
+	return impl->resources[resource].image;
+}
+
+vk::ImageView RenderGraph::get_image_view(RenderResource resource) const {
+	return impl->resources[resource].view;
+}
+
+RenderGraphStats RenderGraph::get_stats() const {
+	return impl->stats;
+}
+
+void RenderGraph::log_stats() const {
+	const RenderGraphStats &stats = impl->stats;
+	TRAMOGI_LOG_INFO(
+		Graphics,
+		"Render graph: {} of {} passes culled, {} barrier batches with {} image and {} memory "
+		"barriers, {} transient images in {} allocations ({} bytes, {} lazily allocated, {} "
+		"without aliasing)",
+		stats.culled_pass_count,
+		stats.pass_count,
+		stats.barrier_batch_count,
+		stats.image_barrier_count,
+		stats.memory_barrier_count,
+		stats.transient_image_count,
+		stats.transient_allocation_count,
+		stats.transient_bytes,
+		stats.lazily_allocated_bytes,
+		stats.unaliased_transient_bytes
+	);
+}
+
+} // namespace tramogi::graphics
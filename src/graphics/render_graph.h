@@ -0,0 +1,146 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vulkan/vulkan.hpp>
+
+namespace vk::raii {
+class CommandBuffer;
+} // namespace vk::raii
+
+namespace tramogi::graphics {
+
+class Device;
+class GpuProfiler;
+
+using RenderResource = uint32_t;
+
+// How a pass accesses a resource. Only images have a layout.
+struct ResourceState {
+	vk::PipelineStageFlags2 stages;
+	vk::AccessFlags2 access;
+	vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+};
+
+// Single mip, single layer 2D image with optimal tiling.
+struct TransientImageDesc {
+	vk::Format format = vk::Format::eUndefined;
+	vk::Extent2D extent;
+	vk::ImageUsageFlags usage;
+	vk::ImageAspectFlags aspect;
+
+	bool operator==(const TransientImageDesc &) const = default;
+};
+
+// Of the last compiled frame.
+struct RenderGraphStats {
+	uint32_t pass_count = 0;
+	uint32_t culled_pass_count = 0;
+	// `pipelineBarrier2` calls, each with every barrier needed before a pass.
+	uint32_t barrier_batch_count = 0;
+	uint32_t image_barrier_count = 0;
+	// Buffer dependencies of a batch are merged into one global memory barrier.
+	uint32_t memory_barrier_count = 0;
+	uint32_t transient_image_count = 0;
+	uint32_t transient_allocation_count = 0;
+	uint64_t transient_bytes = 0;
+	// Of `transient_bytes`, only backed by memory when the device needs it.
+	uint64_t lazily_allocated_bytes = 0;
+	// What the transient images would take with an allocation each.
+	uint64_t unaliased_transient_bytes = 0;
+	// Bumped whenever the transient images are created again.
+	uint32_t transient_generation = 0;
+};
+
+// Records a frame as passes that declare the resources they read and write, with the barriers
+// between them derived from those declarations. The graph is declared again for every recorded
+// frame: `compile` culls the passes whose writes are never read, and merges all layout transitions
+// and memory dependencies needed before a pass into a single `pipelineBarrier2`.
+//
+// Imported resources are owned elsewhere and start in the state they are imported with. Transient
+// images are owned by the graph and their content is undefined when a frame first accesses them.
+// Transient images whose passes do not overlap share memory. They are kept between compiles that
+// declare the same ones, and otherwise released once the frames that may still use them have
+// completed. Those only used as attachments get eTransientAttachment usage and lazily allocated
+// memory where the device has it.
+class RenderGraph {
+public:
+	using Record = std::function<void(const vk::raii::CommandBuffer &command_buffer)>;
+
+	class PassBuilder {
+	public:
+		PassBuilder &read(RenderResource resource, const ResourceState &state);
+		PassBuilder &write(RenderResource resource, const ResourceState &state);
+		// Keeps the pass even when nothing reads what it writes, for work that is consumed
+		// outside of the graph.
+		PassBuilder &set_side_effects();
+
+	private:
+		friend class RenderGraph;
+
+		PassBuilder(RenderGraph &graph, uint32_t pass) : graph(graph), pass(pass) {}
+
+		RenderGraph &graph;
+		uint32_t pass;
+	};
+
+	RenderGraph();
+	~RenderGraph();
+	RenderGraph(const RenderGraph &) = delete;
+	RenderGraph &operator=(const RenderGraph &) = delete;
+
+	// Passes are recorded in GPU zones named after them when `profiler` is given.
+	void init(const Device &device, uint32_t frame_count, GpuProfiler *profiler = nullptr);
+	// Without a device, `compile` assigns transient images to slots and derives the barriers but
+	// creates no images, so that a frame's declaration can be checked on the CPU alone. Such a
+	// graph can not be executed.
+	void init_without_device(uint32_t frame_count);
+
+	// Releases the transient images retired while `frame_index` was last recorded. Only call once
+	// the frame has been waited for.
+	void begin_frame(uint32_t frame_index);
+	// Releases every transient image now instead of once its frames have completed, such as
+	// before a swapchain recreation. Only call while the device is idle.
+	void release_transients();
+
+	// Starts declaring a new frame.
+	void reset();
+
+	// `name` must outlive the graph, string literals are expected.
+	RenderResource import_image(
+		const char *name,
+		vk::Image image,
+		vk::ImageAspectFlags aspect,
+		const ResourceState &initial_state
+	);
+	RenderResource import_buffer(
+		const char *name,
+		vk::Buffer buffer,
+		const ResourceState &initial_state
+	);
+	RenderResource create_image(const char *name, const TransientImageDesc &desc);
+	// Transitions the resource to `final_state` after the last pass, and keeps the passes writing
+	// it.
+	void export_resource(RenderResource resource, const ResourceState &final_state);
+
+	// Passes run in the order they are added.
+	PassBuilder add_pass(const char *name, Record record);
+
+	core::Result<> compile();
+	void execute(const vk::raii::CommandBuffer &command_buffer);
+
+	// Transient images only exist once compiled, and not at all when no pass uses them.
+	vk::Image get_image(RenderResource resource) const;
+	vk::ImageView get_image_view(RenderResource resource) const;
+
+	RenderGraphStats get_stats() const;
+	void log_stats() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
@@ -0,0 +1,137 @@
+#include "tramogi/graphics/ring_buffer.h"
+#include "allocator.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "physical_device.h"
+#include "tramogi/core/errors.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+using core::Error;
+using core::Result;
+
+// Upper bound of minUniformBufferOffsetAlignment and minStorageBufferOffsetAlignment, so every
+// frame region starts suitably aligned for any of the buffer's uses.
+constexpr uint64_t region_alignment = 256;
+
+struct FrameRingBuffer::Impl {
+	Allocation allocation;
+	vk::raii::Buffer buffer = nullptr;
+	std::byte *mapped_memory = nullptr;
+
+	uint32_t frame_count = 0;
+	uint64_t frame_size = 0;
+	uint64_t uniform_alignment = 1;
+
+	uint32_t frame_index = 0;
+	uint64_t head = 0;
+	uint64_t peak_usage = 0;
+};
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+FrameRingBuffer::FrameRingBuffer() : impl(std::make_unique<Impl>()) {}
+FrameRingBuffer::~FrameRingBuffer() = default;
+FrameRingBuffer::FrameRingBuffer(FrameRingBuffer &&) = default;
+FrameRingBuffer &FrameRingBuffer::operator=(FrameRingBuffer &&) = default;
+
+Result<> FrameRingBuffer::init(const Device &device, uint32_t frame_count, uint64_t frame_size) {
+	assert(frame_count > 0 && "Ring buffer needs at least one frame");
+
+	impl->frame_count = frame_count;
+	impl->frame_size = align_up(frame_size, region_alignment);
+	impl->uniform_alignment = device.get_physical_device()
+								  .get_physical_device()
+								  .getProperties()
+								  .limits.minUniformBufferOffsetAlignment;
+	impl->frame_index = 0;
+	impl->head = 0;
+	impl->peak_usage = 0;
+
+	vk::BufferCreateInfo create_info {
+		.size = impl->frame_size * frame_count,
+		.usage = vk::BufferUsageFlagBits::eUniformBuffer |
+				 vk::BufferUsageFlagBits::eStorageBuffer |
+				 vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer |
+				 vk::BufferUsageFlagBits::eTransferSrc,
+		.sharingMode = vk::SharingMode::eExclusive,
+	};
+
+	impl->buffer =
+		vk::raii::Buffer(device.get_device(), create_info, get_host_allocation_callbacks());
+
+	auto allocation_result = allocate_memory(
+		device,
+		impl->buffer.getMemoryRequirements(),
+		MemoryType::Host,
+		ResourceKind::Uniform
+	);
+	if (!allocation_result) {
+		return Error(allocation_result.error());
+	}
+
+	impl->allocation = std::move(allocation_result.value());
+	impl->buffer.bindMemory(impl->allocation.get_memory(), impl->allocation.get_offset());
+	impl->mapped_memory = static_cast<std::byte *>(impl->allocation.map());
+
+	return {};
+}
+
+void FrameRingBuffer::begin_frame(uint32_t frame_index) {
+	assert(frame_index < impl->frame_count && "Frame index out of range");
+	impl->frame_index = frame_index;
+	impl->head = 0;
+}
+
+core::Option<RingAllocation> FrameRingBuffer::allocate(uint64_t size, uint64_t alignment) {
+	uint64_t offset = align_up(impl->head, std::max<uint64_t>(alignment, 1));
+	if (offset + size > impl->frame_size) {
+		return std::nullopt;
+	}
+
+	impl->head = offset + size;
+	impl->peak_usage = std::max(impl->peak_usage, impl->head);
+
+	offset += impl->frame_index * impl->frame_size;
+	return RingAllocation {
+		.data = impl->mapped_memory + offset,
+		.offset = offset,
+		.size = size,
+	};
+}
+
+core::Option<RingAllocation> FrameRingBuffer::allocate_uniform(uint64_t size) {
+	return allocate(size, impl->uniform_alignment);
+}
+
+void FrameRingBuffer::flush() {
+	impl->allocation.flush(impl->frame_index * impl->frame_size, impl->head);
+}
+
+vk::raii::Buffer &FrameRingBuffer::get_buffer() {
+	return impl->buffer;
+}
+
+uint64_t FrameRingBuffer::get_frame_size() const {
+	return impl->frame_size;
+}
+
+uint64_t FrameRingBuffer::get_frame_usage() const {
+	return impl->head;
+}
+
+uint64_t FrameRingBuffer::get_peak_usage() const {
+	return impl->peak_usage;
+}
+
+} // namespace tramogi::graphics
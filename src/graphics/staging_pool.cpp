@@ -0,0 +1,152 @@
+#include "staging_pool.h"
+#include "device.h"
+#include "tramogi/core/errors.h"
+#include "tramogi/graphics/buffer.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+using core::Error;
+using core::Result;
+
+struct StagingPool::Impl {
+	struct Chunk {
+		StagingBuffer buffer;
+		std::byte *mapped_memory = nullptr;
+		uint64_t size = 0;
+		uint64_t head = 0;
+		// Regions handed out since the last retire, starting at `open_begin`.
+		bool has_open_regions = false;
+		uint64_t open_begin = 0;
+		std::vector<TimelinePoint> points;
+	};
+
+	const Device *device = nullptr;
+	uint64_t chunk_size = 0;
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	StagingPoolStats stats;
+
+	Result<Chunk *> create_chunk(uint64_t size);
+};
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+Result<StagingPool::Impl::Chunk *> StagingPool::Impl::create_chunk(uint64_t size) {
+	auto chunk = std::make_unique<Chunk>();
+	auto result = chunk->buffer.init(*device, size);
+	if (!result) {
+		return Error(result.error());
+	}
+	chunk->buffer.map();
+	chunk->mapped_memory = static_cast<std::byte *>(chunk->buffer.get_mapped_memory());
+	chunk->size = size;
+
+	++stats.chunk_allocation_count;
+	chunks.push_back(std::move(chunk));
+	return chunks.back().get();
+}
+
+StagingPool::StagingPool() : impl(std::make_unique<Impl>()) {}
+StagingPool::~StagingPool() = default;
+
+void StagingPool::init(const Device &device, uint64_t chunk_size) {
+	impl->device = &device;
+	impl->chunk_size = chunk_size;
+}
+
+Result<StagingRegion> StagingPool::allocate(uint64_t size, uint64_t alignment) {
+	Impl::Chunk *chunk = nullptr;
+	uint64_t offset = 0;
+	for (const auto &candidate : impl->chunks) {
+		offset = align_up(candidate->head, alignment);
+		if (offset + size <= candidate->size) {
+			chunk = candidate.get();
+			break;
+		}
+	}
+
+	if (!chunk) {
+		auto chunk_result = impl->create_chunk(std::max(impl->chunk_size, size));
+		if (!chunk_result) {
+			return Error(chunk_result.error());
+		}
+		chunk = chunk_result.value();
+		offset = 0;
+	}
+
+	if (!chunk->has_open_regions) {
+		chunk->open_begin = offset;
+	}
+	chunk->head = offset + size;
+	chunk->has_open_regions = true;
+	++impl->stats.region_count;
+
+	return StagingRegion {
+		.buffer = &chunk->buffer.get_buffer(),
+		.offset = offset,
+		.size = size,
+		.data = chunk->mapped_memory + offset,
+	};
+}
+
+Result<StagingRegion> StagingPool::upload(const void *data, uint64_t size) {
+	auto region = allocate(size);
+	if (region) {
+		std::memcpy(region->data, data, size);
+		impl->stats.uploaded_bytes += size;
+	}
+	return region;
+}
+
+void StagingPool::retire(TimelinePoint point) {
+	for (const auto &chunk : impl->chunks) {
+		if (chunk->has_open_regions) {
+			// Everything written since the last retire, in one flush per chunk.
+			chunk->buffer.flush(chunk->open_begin, chunk->head - chunk->open_begin);
+			chunk->points.push_back(point);
+			chunk->has_open_regions = false;
+		}
+	}
+}
+
+void StagingPool::collect() {
+	for (const auto &chunk : impl->chunks) {
+		std::erase_if(chunk->points, [this](TimelinePoint point) {
+			return impl->device->is_complete(point);
+		});
+		if (chunk->points.empty() && !chunk->has_open_regions) {
+			chunk->head = 0;
+		}
+	}
+}
+
+void StagingPool::trim() {
+	bool is_first_idle = true;
+	std::erase_if(impl->chunks, [&is_first_idle](const std::unique_ptr<Impl::Chunk> &chunk) {
+		if (chunk->head != 0) {
+			return false;
+		}
+		return !std::exchange(is_first_idle, false);
+	});
+}
+
+StagingPoolStats StagingPool::get_stats() const {
+	StagingPoolStats stats = impl->stats;
+	stats.chunk_count = static_cast<uint32_t>(impl->chunks.size());
+	for (const auto &chunk : impl->chunks) {
+		stats.reserved_bytes += chunk->size;
+	}
+	return stats;
+}
+
+} // namespace tramogi::graphics
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "device.h"
+#include "tramogi/core/errors.h"
+#include <cstdint>
+#include <memory>
+
+namespace vk {
+namespace raii {
+class Buffer;
+} // namespace raii
+} // namespace vk
+
+namespace tramogi::graphics {
+
+struct StagingRegion {
+	vk::raii::Buffer *buffer = nullptr;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	void *data = nullptr;
+};
+
+struct StagingPoolStats {
+	// Staging memory allocations, one per chunk created.
+	uint32_t chunk_allocation_count = 0;
+	uint32_t region_count = 0;
+	uint64_t uploaded_bytes = 0;
+	uint32_t chunk_count = 0;
+	uint64_t reserved_bytes = 0;
+};
+
+// Hands out staging regions from persistently mapped host visible chunks. Regions are bump
+// allocated, and a chunk is rewound once the timeline points of every region given out from it
+// have been reached.
+class StagingPool {
+public:
+	static constexpr uint64_t default_chunk_size = 16ull * 1024 * 1024;
+
+	StagingPool();
+	~StagingPool();
+	StagingPool(const StagingPool &) = delete;
+	StagingPool &operator=(const StagingPool &) = delete;
+
+	void init(const Device &device, uint64_t chunk_size = default_chunk_size);
+
+	[[nodiscard]] core::Result<StagingRegion> allocate(uint64_t size, uint64_t alignment = 16);
+	[[nodiscard]] core::Result<StagingRegion> upload(const void *data, uint64_t size);
+
+	// Flushes the regions allocated since the previous call, which are free to reuse once `point`
+	// has been reached. Call before submitting the commands reading them.
+	void retire(TimelinePoint point);
+	// Rewinds the chunks whose points have all been reached.
+	void collect();
+	// Releases the chunks that are not in use, except one.
+	void trim();
+
+	StagingPoolStats get_stats() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
@@ -0,0 +1,240 @@
+#include "tlsf.h"
+#include "tramogi/core/errors.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+
+namespace tramogi::graphics {
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+Tlsf::Tlsf(uint64_t size) : size(size / min_granularity * min_granularity) {
+	for (auto &lists : free_lists) {
+		lists.fill(null_node);
+	}
+
+	if (this->size > 0) {
+		first_node = create_node(0, this->size);
+		nodes[first_node].is_free = true;
+		insert_free(first_node);
+		free_bytes = this->size;
+	}
+}
+
+void Tlsf::mapping(uint64_t size, uint32_t &fl, uint32_t &sl) {
+	if (size < small_block_size) {
+		fl = 0;
+		sl = static_cast<uint32_t>(size / min_granularity);
+		return;
+	}
+
+	uint32_t bit = static_cast<uint32_t>(std::bit_width(size)) - 1;
+	sl = static_cast<uint32_t>(size >> (bit - sl_bits)) ^ sl_count;
+	fl = bit - small_block_bits + 1;
+}
+
+uint32_t Tlsf::create_node(uint64_t offset, uint64_t size) {
+	Node node {.offset = offset, .size = size};
+	if (!unused_nodes.empty()) {
+		uint32_t index = unused_nodes.back();
+		unused_nodes.pop_back();
+		nodes[index] = node;
+		return index;
+	}
+
+	nodes.push_back(node);
+	return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void Tlsf::release_node(uint32_t node) {
+	unused_nodes.push_back(node);
+}
+
+void Tlsf::insert_free(uint32_t node) {
+	uint32_t fl = 0;
+	uint32_t sl = 0;
+	mapping(nodes[node].size, fl, sl);
+
+	uint32_t head = free_lists[fl][sl];
+	nodes[node].is_free = true;
+	nodes[node].prev_free = null_node;
+	nodes[node].next_free = head;
+	if (head != null_node) {
+		nodes[head].prev_free = node;
+	}
+	free_lists[fl][sl] = node;
+
+	sl_bitmap[fl] |= 1u << sl;
+	fl_bitmap |= uint64_t(1) << fl;
+}
+
+void Tlsf::remove_free(uint32_t node) {
+	uint32_t fl = 0;
+	uint32_t sl = 0;
+	mapping(nodes[node].size, fl, sl);
+
+	uint32_t prev = nodes[node].prev_free;
+	uint32_t next = nodes[node].next_free;
+	if (prev != null_node) {
+		nodes[prev].next_free = next;
+	} else {
+		free_lists[fl][sl] = next;
+	}
+	if (next != null_node) {
+		nodes[next].prev_free = prev;
+	}
+
+	if (free_lists[fl][sl] == null_node) {
+		sl_bitmap[fl] &= ~(1u << sl);
+		if (sl_bitmap[fl] == 0) {
+			fl_bitmap &= ~(uint64_t(1) << fl);
+		}
+	}
+
+	nodes[node].prev_free = null_node;
+	nodes[node].next_free = null_node;
+}
+
+uint32_t Tlsf::find_free(uint64_t size) const {
+	// Round up to the next size class so that any block of the list found is large enough.
+	if (size >= small_block_size) {
+		uint32_t bit = static_cast<uint32_t>(std::bit_width(size)) - 1;
+		size += (uint64_t(1) << (bit - sl_bits)) - 1;
+	}
+
+	uint32_t fl = 0;
+	uint32_t sl = 0;
+	mapping(size, fl, sl);
+	if (fl >= fl_count) {
+		return null_node;
+	}
+
+	uint32_t sl_map = sl < sl_count ? sl_bitmap[fl] & (~0u << sl) : 0;
+	if (sl_map == 0) {
+		uint64_t fl_map = fl + 1 < 64 ? fl_bitmap & (~uint64_t(0) << (fl + 1)) : 0;
+		if (fl_map == 0) {
+			return null_node;
+		}
+		fl = static_cast<uint32_t>(std::countr_zero(fl_map));
+		sl_map = sl_bitmap[fl];
+	}
+	sl = static_cast<uint32_t>(std::countr_zero(sl_map));
+
+	return free_lists[fl][sl];
+}
+
+void Tlsf::split_tail(uint32_t node, uint64_t size) {
+	uint32_t tail = create_node(nodes[node].offset + nodes[node].size - size, size);
+	nodes[node].size -= size;
+
+	uint32_t next = nodes[node].next_physical;
+	nodes[tail].prev_physical = node;
+	nodes[tail].next_physical = next;
+	if (next != null_node) {
+		nodes[next].prev_physical = tail;
+	}
+	nodes[node].next_physical = tail;
+
+	insert_free(tail);
+}
+
+uint32_t Tlsf::merge(uint32_t node) {
+	uint32_t prev = nodes[node].prev_physical;
+	if (prev != null_node && nodes[prev].is_free) {
+		remove_free(prev);
+		nodes[prev].size += nodes[node].size;
+		nodes[prev].next_physical = nodes[node].next_physical;
+		if (nodes[node].next_physical != null_node) {
+			nodes[nodes[node].next_physical].prev_physical = prev;
+		}
+		release_node(node);
+		node = prev;
+	}
+
+	uint32_t next = nodes[node].next_physical;
+	if (next != null_node && nodes[next].is_free) {
+		remove_free(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].next_physical = nodes[next].next_physical;
+		if (nodes[next].next_physical != null_node) {
+			nodes[nodes[next].next_physical].prev_physical = node;
+		}
+		release_node(next);
+	}
+
+	return node;
+}
+
+core::Option<TlsfRange> Tlsf::allocate(uint64_t size, uint64_t alignment) {
+	alignment = std::max(alignment, min_granularity);
+	size = align_up(std::max<uint64_t>(size, 1), min_granularity);
+
+	// Offsets are always multiples of the granularity, so this is the worst-case padding.
+	uint32_t node = find_free(size + alignment - min_granularity);
+	if (node == null_node) {
+		return std::nullopt;
+	}
+	remove_free(node);
+
+	uint64_t padding = align_up(nodes[node].offset, alignment) - nodes[node].offset;
+	if (padding > 0) {
+		// The previous physical node is never free while `node` is, so no merge is needed.
+		uint32_t head = create_node(nodes[node].offset, padding);
+		uint32_t prev = nodes[node].prev_physical;
+		nodes[head].prev_physical = prev;
+		nodes[head].next_physical = node;
+		if (prev != null_node) {
+			nodes[prev].next_physical = head;
+		} else {
+			first_node = head;
+		}
+		nodes[node].prev_physical = head;
+		nodes[node].offset += padding;
+		nodes[node].size -= padding;
+		insert_free(head);
+	}
+
+	assert(nodes[node].size >= size && "TLSF size class lookup returned a block too small");
+	if (nodes[node].size - size >= min_granularity) {
+		split_tail(node, nodes[node].size - size);
+	}
+
+	nodes[node].is_free = false;
+	free_bytes -= nodes[node].size;
+	++allocation_count;
+
+	return TlsfRange {
+		.node = node,
+		.offset = nodes[node].offset,
+		.size = nodes[node].size,
+	};
+}
+
+void Tlsf::free(uint32_t node) {
+	assert(!nodes[node].is_free && "Double free of TLSF node");
+
+	free_bytes += nodes[node].size;
+	--allocation_count;
+
+	insert_free(merge(node));
+}
+
+uint64_t Tlsf::get_largest_free_range() const {
+	if (fl_bitmap == 0) {
+		return 0;
+	}
+
+	uint32_t fl = 63 - static_cast<uint32_t>(std::countl_zero(fl_bitmap));
+	uint32_t sl = 31 - static_cast<uint32_t>(std::countl_zero(sl_bitmap[fl]));
+
+	uint64_t largest = 0;
+	for (uint32_t node = free_lists[fl][sl]; node != null_node; node = nodes[node].next_free) {
+		largest = std::max(largest, nodes[node].size);
+	}
+	return largest;
+}
+
+} // namespace tramogi::graphics
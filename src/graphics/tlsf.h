@@ -0,0 +1,96 @@
+#pragma once
+
+#include "tramogi/core/errors.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace tramogi::graphics {
+
+struct TlsfRange {
+	uint32_t node = 0;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+};
+
+// Two-level segregated fit manager for the offsets of a single memory block. It never touches the
+// memory itself, so it works the same for device memory or anything else addressed by offset.
+// Allocation and free are O(1): two bitmap scans, one split or merge per neighbour.
+class Tlsf {
+public:
+	explicit Tlsf(uint64_t size);
+
+	core::Option<TlsfRange> allocate(uint64_t size, uint64_t alignment);
+	void free(uint32_t node);
+
+	uint64_t get_size() const {
+		return size;
+	}
+	uint64_t get_free_bytes() const {
+		return free_bytes;
+	}
+	uint32_t get_allocation_count() const {
+		return allocation_count;
+	}
+	bool is_empty() const {
+		return allocation_count == 0;
+	}
+
+	uint64_t get_largest_free_range() const;
+
+	// Calls `fn(offset, size)` for every live allocation, in address order.
+	template <typename Fn> void for_each_allocation(Fn &&fn) const {
+		for (uint32_t node = first_node; node != null_node; node = nodes[node].next_physical) {
+			if (!nodes[node].is_free) {
+				fn(nodes[node].offset, nodes[node].size);
+			}
+		}
+	}
+
+private:
+	static constexpr uint32_t null_node = UINT32_MAX;
+	static constexpr uint32_t sl_bits = 5;
+	static constexpr uint32_t sl_count = 1u << sl_bits;
+	static constexpr uint32_t small_block_bits = 8;
+	static constexpr uint64_t small_block_size = uint64_t(1) << small_block_bits;
+	static constexpr uint64_t min_granularity = small_block_size / sl_count;
+	static constexpr uint32_t fl_count = 64 - small_block_bits + 1;
+
+	struct Node {
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t prev_physical = null_node;
+		uint32_t next_physical = null_node;
+		uint32_t prev_free = null_node;
+		uint32_t next_free = null_node;
+		bool is_free = false;
+	};
+
+	uint64_t size;
+	uint64_t free_bytes = 0;
+	uint32_t allocation_count = 0;
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> unused_nodes;
+	uint32_t first_node = null_node;
+
+	uint64_t fl_bitmap = 0;
+	std::array<uint32_t, fl_count> sl_bitmap {};
+	std::array<std::array<uint32_t, sl_count>, fl_count> free_lists;
+
+	static void mapping(uint64_t size, uint32_t &fl, uint32_t &sl);
+
+	uint32_t create_node(uint64_t offset, uint64_t size);
+	void release_node(uint32_t node);
+
+	void insert_free(uint32_t node);
+	void remove_free(uint32_t node);
+	uint32_t find_free(uint64_t size) const;
+
+	// Splits `size` bytes off the end of `node` into a new free node.
+	void split_tail(uint32_t node, uint64_t size);
+	// Merges the free `node` with its free physical neighbours and returns the survivor.
+	uint32_t merge(uint32_t node);
+};
+
+} // namespace tramogi::graphics
@@ -0,0 +1,262 @@
+#include "upload_context.h"
+#include "device.h"
+#include "host_allocator.h"
+#include "physical_device.h"
+#include "staging_pool.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::graphics {
+
+struct UploadContext::Impl {
+	struct Batch {
+		vk::raii::CommandBuffer command_buffer = nullptr;
+		// Only with a dedicated transfer queue, waits for `command_buffer` on the GPU.
+		vk::raii::CommandBuffer graphics_command_buffer = nullptr;
+		// Reached once the last submission of the batch has completed.
+		TimelinePoint point;
+	};
+
+	Device *device = nullptr;
+	StagingPool *staging_pool = nullptr;
+	vk::raii::CommandPool command_pool = nullptr;
+	vk::raii::CommandPool graphics_command_pool = nullptr;
+	bool is_dedicated = false;
+	uint32_t transfer_queue_index = 0;
+	uint32_t graphics_queue_index = 0;
+
+	std::vector<std::unique_ptr<Batch>> batches;
+	Batch *recording = nullptr;
+
+	TimelinePoint last_submitted;
+	uint32_t submit_count = 0;
+
+	vk::raii::CommandPool create_command_pool(uint32_t queue_family_index) const {
+		vk::CommandPoolCreateInfo pool_info {
+			.flags = vk::CommandPoolCreateFlagBits::eTransient |
+					 vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+			.queueFamilyIndex = queue_family_index,
+		};
+		return vk::raii::CommandPool(
+			device->get_device(),
+			pool_info,
+			get_host_allocation_callbacks()
+		);
+	}
+
+	vk::raii::CommandBuffer allocate_command_buffer(const vk::raii::CommandPool &pool) const {
+		vk::CommandBufferAllocateInfo allocate_info {
+			.commandPool = pool,
+			.level = vk::CommandBufferLevel::ePrimary,
+			.commandBufferCount = 1,
+		};
+		return std::move(device->get_device().allocateCommandBuffers(allocate_info).front());
+	}
+
+	Batch &begin_batch();
+	void record_hand_over(const vk::DependencyInfo &release, const vk::DependencyInfo &acquire);
+};
+
+UploadContext::Impl::Batch &UploadContext::Impl::begin_batch() {
+	if (recording) {
+		return *recording;
+	}
+
+	staging_pool->collect();
+	auto free_batch = std::ranges::find_if(batches, [this](const auto &batch) {
+		return device->is_complete(batch->point);
+	});
+
+	Batch *batch = nullptr;
+	if (free_batch != batches.end()) {
+		batch = free_batch->get();
+		batch->command_buffer.reset();
+		if (is_dedicated) {
+			batch->graphics_command_buffer.reset();
+		}
+	} else {
+		auto new_batch = std::make_unique<Batch>();
+		new_batch->command_buffer = allocate_command_buffer(command_pool);
+		if (is_dedicated) {
+			new_batch->graphics_command_buffer = allocate_command_buffer(graphics_command_pool);
+		}
+		batches.push_back(std::move(new_batch));
+		batch = batches.back().get();
+	}
+
+	vk::CommandBufferBeginInfo begin_info {
+		.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+	};
+	batch->command_buffer.begin(begin_info);
+	if (is_dedicated) {
+		batch->graphics_command_buffer.begin(begin_info);
+	}
+	recording = batch;
+	return *batch;
+}
+
+void UploadContext::Impl::record_hand_over(
+	const vk::DependencyInfo &release,
+	const vk::DependencyInfo &acquire
+) {
+	Batch &batch = begin_batch();
+	batch.command_buffer.pipelineBarrier2(release);
+	batch.graphics_command_buffer.pipelineBarrier2(acquire);
+}
+
+UploadContext::UploadContext() : impl(std::make_unique<Impl>()) {}
+
+UploadContext::~UploadContext() {
+	if (impl->device) {
+		wait(impl->last_submitted);
+	}
+}
+
+void UploadContext::init(Device &device, StagingPool &staging_pool) {
+	impl->device = &device;
+	impl->staging_pool = &staging_pool;
+
+	const PhysicalDevice &physical_device = device.get_physical_device();
+	impl->is_dedicated = physical_device.has_dedicated_transfer_queue();
+	impl->transfer_queue_index = physical_device.get_transfer_queue_index();
+	impl->graphics_queue_index = physical_device.get_graphics_queue_index();
+
+	impl->command_pool = impl->create_command_pool(impl->transfer_queue_index);
+	if (impl->is_dedicated) {
+		impl->graphics_command_pool = impl->create_command_pool(impl->graphics_queue_index);
+	}
+}
+
+const vk::raii::CommandBuffer &UploadContext::get_command_buffer() {
+	return impl->begin_batch().command_buffer;
+}
+
+const vk::raii::CommandBuffer &UploadContext::get_graphics_command_buffer() {
+	Impl::Batch &batch = impl->begin_batch();
+	return impl->is_dedicated ? batch.graphics_command_buffer : batch.command_buffer;
+}
+
+void UploadContext::hand_over(vk::BufferMemoryBarrier2 barrier) {
+	if (!impl->is_dedicated) {
+		barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+		barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+		get_command_buffer().pipelineBarrier2(
+			vk::DependencyInfo {.bufferMemoryBarrierCount = 1, .pBufferMemoryBarriers = &barrier}
+		);
+		return;
+	}
+
+	barrier.srcQueueFamilyIndex = impl->transfer_queue_index;
+	barrier.dstQueueFamilyIndex = impl->graphics_queue_index;
+
+	// Destination masks are ignored by the release and source masks by the acquire.
+	vk::BufferMemoryBarrier2 release = barrier;
+	release.dstStageMask = {};
+	release.dstAccessMask = {};
+	vk::BufferMemoryBarrier2 acquire = barrier;
+	acquire.srcStageMask = {};
+	acquire.srcAccessMask = {};
+
+	impl->record_hand_over(
+		vk::DependencyInfo {.bufferMemoryBarrierCount = 1, .pBufferMemoryBarriers = &release},
+		vk::DependencyInfo {.bufferMemoryBarrierCount = 1, .pBufferMemoryBarriers = &acquire}
+	);
+}
+
+void UploadContext::hand_over(vk::ImageMemoryBarrier2 barrier) {
+	if (!impl->is_dedicated) {
+		barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+		barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+		get_command_buffer().pipelineBarrier2(
+			vk::DependencyInfo {.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier}
+		);
+		return;
+	}
+
+	barrier.srcQueueFamilyIndex = impl->transfer_queue_index;
+	barrier.dstQueueFamilyIndex = impl->graphics_queue_index;
+
+	// Both halves must carry the same layouts; the transition happens once between them.
+	vk::ImageMemoryBarrier2 release = barrier;
+	release.dstStageMask = {};
+	release.dstAccessMask = {};
+	vk::ImageMemoryBarrier2 acquire = barrier;
+	acquire.srcStageMask = {};
+	acquire.srcAccessMask = {};
+
+	impl->record_hand_over(
+		vk::DependencyInfo {.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &release},
+		vk::DependencyInfo {.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &acquire}
+	);
+}
+
+TimelinePoint UploadContext::submit() {
+	TRAMOGI_PROFILE_ZONE("upload_submit");
+
+	Impl::Batch *batch = std::exchange(impl->recording, nullptr);
+	if (!batch) {
+		return impl->last_submitted;
+	}
+
+	batch->command_buffer.end();
+	// The batch completes at the next point on the graphics queue. Staging has to be retired
+	// before submitting, since retiring flushes it.
+	TimelinePoint point = impl->device->get_last_submitted(QueueType::Graphics);
+	++point.value;
+	impl->staging_pool->retire(point);
+
+	vk::CommandBuffer command_buffer = batch->command_buffer;
+	if (impl->is_dedicated) {
+		batch->graphics_command_buffer.end();
+
+		TimelinePoint transfer_point = impl->device->submit(
+			QueueType::Transfer,
+			{.command_buffers = {&command_buffer, 1}}
+		);
+
+		vk::CommandBuffer graphics_command_buffer = batch->graphics_command_buffer;
+		batch->point = impl->device->submit(
+			QueueType::Graphics,
+			{
+				.command_buffers = {&graphics_command_buffer, 1},
+				.wait_points = {&transfer_point, 1},
+			}
+		);
+	} else {
+		batch->point =
+			impl->device->submit(QueueType::Graphics, {.command_buffers = {&command_buffer, 1}});
+	}
+	assert(batch->point.value == point.value && "Staging retired against the wrong point");
+
+	impl->last_submitted = batch->point;
+	++impl->submit_count;
+	return batch->point;
+}
+
+bool UploadContext::is_complete(TimelinePoint point) const {
+	return impl->device->is_complete(point);
+}
+
+void UploadContext::wait(TimelinePoint point) const {
+	TRAMOGI_PROFILE_ZONE("upload_wait");
+
+	impl->device->wait(point);
+	impl->staging_pool->collect();
+}
+
+uint32_t UploadContext::get_submit_count() const {
+	return impl->submit_count;
+}
+
+bool UploadContext::has_dedicated_transfer_queue() const {
+	return impl->is_dedicated;
+}
+
+} // namespace tramogi::graphics
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "device.h"
+#include <cstdint>
+#include <memory>
+
+namespace vk {
+struct BufferMemoryBarrier2;
+struct ImageMemoryBarrier2;
+namespace raii {
+class CommandBuffer;
+} // namespace raii
+} // namespace vk
+
+namespace tramogi::graphics {
+
+class StagingPool;
+
+// Collects copies, layout transitions and mipmap generation into one batch that is submitted as
+// a whole. Staging regions allocated while recording are retired against its timeline point.
+// Several batches can be in flight; their command buffers are recycled once they have completed.
+//
+// With a dedicated transfer queue, a batch is a transfer command buffer for the copies and a
+// graphics command buffer for everything that needs the graphics queue (blits, acquiring
+// ownership), which waits on the transfer submission's timeline point. Resources written on the transfer queue
+// must be passed to the graphics queue with `hand_over`. Without one, both command buffers are
+// the same and `hand_over` is a plain barrier.
+class UploadContext {
+public:
+	UploadContext();
+	~UploadContext();
+	UploadContext(const UploadContext &) = delete;
+	UploadContext &operator=(const UploadContext &) = delete;
+
+	void init(Device &device, StagingPool &staging_pool);
+
+	// Both start a new batch if none is being recorded.
+	// For copies and the layout transitions around them.
+	const vk::raii::CommandBuffer &get_command_buffer();
+	// For commands the transfer queue cannot run, recorded after everything handed over.
+	const vk::raii::CommandBuffer &get_graphics_command_buffer();
+
+	// Releases the resource from the transfer queue and acquires it on the graphics queue. The
+	// queue family indices are filled in; the source masks are used for the release and the
+	// destination masks for the acquire. An image barrier may also change the layout.
+	void hand_over(vk::BufferMemoryBarrier2 barrier);
+	void hand_over(vk::ImageMemoryBarrier2 barrier);
+
+	// Submits the batch being recorded and returns the point on the graphics queue at which it
+	// has completed, so other submissions can wait for it on the GPU. Returns the point of the
+	// last submitted batch when nothing was recorded.
+	TimelinePoint submit();
+	bool is_complete(TimelinePoint point) const;
+	void wait(TimelinePoint point) const;
+
+	uint32_t get_submit_count() const;
+	bool has_dedicated_transfer_queue() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+} // namespace tramogi::graphics
@@ -1,9 +1,12 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <charconv>
 #include <chrono>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <exception>
 #include <expected>
@@ -11,8 +14,12 @@
 #include <functional>
 #include <limits>
 #include <print>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
 #include <vector>
 
 #include <vulkan/vk_platform.h>
@@ -36,16 +43,35 @@
 #include <glm/trigonometric.hpp>
 
 #include "graphics/allocator.h"
+#include "graphics/bindless_heap.h"
+#include "graphics/defragmenter.h"
+#include "graphics/descriptor_allocator.h"
 #include "graphics/device.h"
 #include "graphics/dispatch_loader.h"
+#include "graphics/frame_graph.h"
+#include "graphics/gpu_culler.h"
+#include "graphics/gpu_profiler.h"
 #include "graphics/instance.h"
+#include "graphics/instance_batch.h"
+#include "graphics/memory_accounting.h"
+#include "graphics/parallel_recorder.h"
 #include "graphics/physical_device.h"
+#include "graphics/pipeline_cache.h"
+#include "graphics/pipeline_library.h"
+#include "graphics/render_graph.h"
+#include "graphics/staging_pool.h"
+#include "graphics/upload_context.h"
 #include "graphics/surface.h"
 #include "tramogi/core/io/file.h"
 #include "tramogi/core/io/image_data.h"
 #include "tramogi/core/io/model.h"
 #include "tramogi/core/logging/logging.h"
+#include "tramogi/core/memory/allocation_tracker.h"
+#include "tramogi/core/profiling/profiler.h"
+#include "tramogi/core/telemetry/telemetry.h"
+#include "tramogi/core/threading/thread_pool.h"
 #include "tramogi/graphics/buffer.h"
+#include "tramogi/graphics/ring_buffer.h"
 #include "tramogi/input/keyboard.h"
 #include "tramogi/platform/window.h"
 
@@ -54,31 +80,53 @@ constexpr uint32_t HEIGHT = 720;
 const std::string MODEL_PATH = "models/viking_room.obj";
 const std::string TEXTURE_PATH = "textures/viking_room.png";
 
-constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+// Overridable with TRAMOGI_FRAMES_IN_FLIGHT, up to MAX_FRAMES_IN_FLIGHT.
+constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = tramogi::graphics::Device::default_frame_count;
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 8;
+const char *const FRAMES_IN_FLIGHT_VARIABLE = "TRAMOGI_FRAMES_IN_FLIGHT";
+// Extra draws without instances, to benchmark command recording with TRAMOGI_SYNTHETIC_DRAWS.
+constexpr uint32_t MAX_SYNTHETIC_DRAWS = 1000000;
+const char *const SYNTHETIC_DRAWS_VARIABLE = "TRAMOGI_SYNTHETIC_DRAWS";
+// Uploads through the graphics queue even with a dedicated transfer queue, when set to anything
+// but 0.
+const char *const DISABLE_TRANSFER_QUEUE_VARIABLE = "TRAMOGI_DISABLE_TRANSFER_QUEUE";
+// Copies of the model drawn by the GPU-driven path, overridable with TRAMOGI_OBJECT_COUNT.
+constexpr uint32_t DEFAULT_OBJECT_COUNT = 4096;
+constexpr uint32_t MAX_OBJECT_COUNT = 1024 * 1024;
+const char *const OBJECT_COUNT_VARIABLE = "TRAMOGI_OBJECT_COUNT";
+
+// Copies of the model for the instancing benchmark, with TRAMOGI_INSTANCE_COUNT.
+constexpr uint32_t DEFAULT_INSTANCE_COUNT = 100000;
+constexpr uint32_t MAX_INSTANCE_COUNT = 1024 * 1024;
+const char *const INSTANCE_COUNT_VARIABLE = "TRAMOGI_INSTANCE_COUNT";
+const char *const PER_DRAW_INSTANCES_ZONE = "per_draw_instances";
+const char *const INSTANCED_ZONE = "instanced";
+// GPU copies the defragmenter may issue per frame.
+constexpr uint64_t DEFRAGMENTATION_BYTES_PER_FRAME = 8 * 1024 * 1024;
+// Transient uniform, vertex and staging data of a single frame.
+constexpr uint64_t FRAME_RING_BUFFER_SIZE = 4 * 1024 * 1024;
+
+const char *const TELEMETRY_JSON_PATH = "frame_telemetry.json";
+const char *const TELEMETRY_CSV_PATH = "frame_telemetry.csv";
+const char *const PIPELINE_CACHE_PATH = "pipeline_cache.bin";
 
 using namespace tramogi::core;
 using namespace tramogi::platform;
 
 using namespace tramogi::core::logging;
 
-static vk::VertexInputBindingDescription get_binding_description() {
-	return {0, sizeof(Vertex), vk::VertexInputRate::eVertex};
-}
-
-static std::array<vk::VertexInputAttributeDescription, 2> get_attribute_description() {
+static std::vector<tramogi::graphics::VertexAttribute> get_vertex_attributes() {
 	return {
-		vk::VertexInputAttributeDescription {
-			0,
-			0,
-			vk::Format::eR32G32B32Sfloat,
-			offsetof(Vertex, position)
+		{
+			.location = 0,
+			.format = vk::Format::eR32G32B32Sfloat,
+			.offset = offsetof(Vertex, position),
+		},
+		{
+			.location = 1,
+			.format = vk::Format::eR32G32Sfloat,
+			.offset = offsetof(Vertex, tex_coord),
 		},
-		vk::VertexInputAttributeDescription {
-			1,
-			0,
-			vk::Format::eR32G32Sfloat,
-			offsetof(Vertex, tex_coord)
-		}
 	};
 }
 
@@ -88,18 +136,66 @@ struct UniformBufferObject {
 	glm::mat4 model;
 };
 
+// Matches Material in shader.slang, padded to its std430 array stride.
+struct Material {
+	glm::vec4 tint;
+	uint32_t texture;
+	uint32_t padding[3];
+};
+
+struct BindlessPushConstants {
+	uint32_t material_buffer;
+	uint32_t material_id;
+};
+
+// How the instance batch is drawn in place of the model, if at all.
+enum class InstancingMode : uint32_t {
+	Off,
+	// One draw per instance, the baseline of the benchmark.
+	PerDraw,
+	// A single instanced draw.
+	Instanced,
+};
+
+static const char *get_instancing_mode_name(InstancingMode mode) {
+	switch (mode) {
+	case InstancingMode::Off:
+		return "off";
+	case InstancingMode::PerDraw:
+		return "one draw per instance";
+	case InstancingMode::Instanced:
+		return "one instanced draw";
+	}
+	return "unknown";
+}
+
+enum class FramePhase : uint32_t {
+	Wait,
+	Acquire,
+	UpdateUniforms,
+	Record,
+	Submit,
+	Present,
+};
+
 class ProjectSkyHigh {
 public:
 	ProjectSkyHigh() : device(physical_device) {}
 
 	void run() {
+		start_ns = profiling::now_ns();
 		init_window();
 		init_vulkan();
+		memory::log_report();
+		device.get_memory_accounting().log_dump();
 		main_loop();
 		cleanup();
 	}
 
 private:
+	// Destroyed last, after everything that may still have work queued on it.
+	threading::ThreadPool thread_pool;
+
 	Window window;
 
 	tramogi::graphics::Instance instance;
@@ -112,36 +208,122 @@ private:
 	std::vector<vk::Image> swapchain_images;
 	std::vector<vk::raii::ImageView> swapchain_image_views;
 
-	vk::raii::DescriptorSetLayout descriptor_set_layout = nullptr;
+	tramogi::graphics::PipelineCache pipeline_cache;
+	tramogi::graphics::DescriptorLayoutCache descriptor_layout_cache;
+	vk::DescriptorSetLayout descriptor_set_layout;
 	vk::raii::PipelineLayout pipeline_layout = nullptr;
-	vk::raii::Pipeline graphics_pipeline = nullptr;
+	vk::raii::ShaderModule shader_module = nullptr;
+	tramogi::graphics::PipelineLibrary pipeline_library;
+	tramogi::graphics::PipelineId graphics_pipeline = 0;
+	tramogi::graphics::PipelineId bindless_pipeline = 0;
+	uint64_t pipeline_begin_ns = 0;
 
 	vk::raii::CommandPool command_pool = nullptr;
 	std::vector<vk::raii::CommandBuffer> command_buffers;
+	tramogi::graphics::ParallelRecorder parallel_recorder;
+	bool is_parallel_recording = false;
+	uint32_t synthetic_draw_count = 0;
+
+	// Everything a frame's command buffer depends on besides the scene itself.
+	struct RecordOptions {
+		uint32_t uniform_offset = 0;
+		bool use_bindless = false;
+		bool use_gpu_driven = false;
+		bool use_parallel_recording = false;
+		InstancingMode instancing = InstancingMode::Off;
+		bool use_render_graph = false;
+
+		bool operator==(const RecordOptions &) const = default;
+	};
+	// Recorded for one frame slot and swapchain image, and replayed as long as the scene
+	// generation and the options it was recorded with match.
+	struct CachedCommandBuffer {
+		vk::raii::CommandBuffer command_buffer = nullptr;
+		uint64_t generation = 0;
+		RecordOptions options;
+	};
+	// Indexed by `frame * swapchain_images.size() + image`.
+	std::vector<CachedCommandBuffer> cached_command_buffers;
+	// Bumped by anything that invalidates recorded command buffers, like moved buffers.
+	uint64_t scene_generation = 1;
+	bool is_caching_command_buffers = false;
+	uint64_t command_buffer_replay_count = 0;
+	uint64_t command_buffer_record_count = 0;
+
+	tramogi::graphics::RenderGraph render_graph;
+	bool is_render_graph = true;
+	uint32_t render_graph_transient_generation = 0;
+	// Barriers of the last frame recorded by each path, indexed by whether it was GPU-driven.
+	struct BarrierCounts {
+		uint32_t batch_count = 0;
+		uint32_t barrier_count = 0;
+	};
+	std::array<BarrierCounts, 2> graph_barriers {};
+	std::array<BarrierCounts, 2> hand_written_barriers {};
+
+	tramogi::graphics::StagingPool staging_pool;
+	tramogi::graphics::UploadContext upload_context;
+	tramogi::graphics::GpuProfiler gpu_profiler;
 
 	tramogi::graphics::VertexBuffer vertex_buffer;
 	tramogi::graphics::IndexBuffer index_buffer;
-	std::vector<tramogi::graphics::UniformBuffer> uniform_buffers;
 
-	vk::raii::DescriptorPool descriptor_pool = nullptr;
-	std::vector<vk::raii::DescriptorSet> descriptor_sets;
+	// Copies of the model on a grid, culled on the GPU and drawn with one indirect call.
+	std::vector<tramogi::graphics::CullObject> objects;
+	tramogi::graphics::StorageBuffer object_buffer;
+	tramogi::graphics::GpuCuller gpu_culler;
+	tramogi::graphics::Frustum camera_frustum {};
+	tramogi::graphics::PipelineId objects_pipeline = 0;
+	bool is_gpu_driven = false;
+
+	tramogi::graphics::InstanceBatch instance_batch;
+	tramogi::graphics::PipelineId instanced_pipeline = 0;
+	InstancingMode instancing_mode = InstancingMode::Off;
+	// CPU time spent recording the instance draws, per instancing mode.
+	struct InstancingBenchmark {
+		uint64_t record_ns = 0;
+		uint32_t record_count = 0;
+	};
+	std::array<InstancingBenchmark, 3> instancing_benchmarks {};
+	tramogi::graphics::FrameRingBuffer frame_ring_buffer;
+	tramogi::graphics::Defragmenter defragmenter;
+
+	tramogi::graphics::DescriptorAllocator descriptor_allocator;
+	std::vector<vk::DescriptorSet> descriptor_sets;
+	// Descriptors written for the per-frame sets, to compare against the bindless heap.
+	uint64_t descriptor_write_count = 0;
+
+	bool is_bindless_supported = false;
+	bool is_bindless = false;
+
+	uint64_t start_ns = 0;
+	bool has_drawn_frame = false;
+	tramogi::graphics::BindlessHeap bindless_heap;
+	tramogi::graphics::StorageBuffer material_buffer;
+	BindlessPushConstants bindless_push_constants {};
 
 	uint32_t mip_levels = 0;
+	tramogi::graphics::Allocation texture_memory;
 	vk::raii::Image texture_image = nullptr;
-	vk::raii::DeviceMemory texture_memory = nullptr;
 	vk::raii::ImageView texture_image_view = nullptr;
 	vk::raii::Sampler texture_sampler = nullptr;
 
+	vk::Format depth_format = vk::Format::eUndefined;
+	tramogi::graphics::Allocation depth_memory;
 	vk::raii::Image depth_image = nullptr;
-	vk::raii::DeviceMemory depth_memory = nullptr;
 	vk::raii::ImageView depth_image_view = nullptr;
 
+	uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
 	uint32_t current_frame = 0;
 
 	tramogi::core::Model model;
 
 	tramogi::input::Keyboard input;
 
+	telemetry::FrameTelemetry frame_telemetry {
+		{"wait", "acquire", "update_uniforms", "record", "submit", "present"}
+	};
+
 	void init_window() {
 		if (!window.init(WIDTH, HEIGHT, "Tramogi Demo")) {
 			throw std::runtime_error("Failed to initialize GLFW");
@@ -152,6 +334,9 @@ private:
 	}
 
 	void init_vulkan() {
+		TRAMOGI_PROFILE_ZONE("init_vulkan");
+		uint64_t begin_ns = profiling::now_ns();
+
 		create_instance();
 		pick_physical_device();
 		create_logical_device();
@@ -161,6 +346,10 @@ private:
 		create_descriptor_layout();
 		create_graphics_pipeline();
 		create_command_pool();
+		staging_pool.init(device);
+		upload_context.init(device, staging_pool);
+		gpu_profiler.init(device);
+		render_graph.init(device, frames_in_flight, &gpu_profiler);
 		create_depth_resources();
 		create_texture_image();
 		create_texture_image_view();
@@ -168,10 +357,46 @@ private:
 		load_model();
 		create_vertex_buffer();
 		create_index_buffer();
-		create_uniform_buffers();
-		create_descriptor_pool();
+		create_material_buffer();
+		create_object_buffer();
+		create_instance_batch();
+		// Every upload so far goes out in one submission, overlapping with the setup below.
+		auto upload_point = upload_context.submit();
+		create_frame_ring_buffer();
+		init_defragmenter();
+		create_descriptor_allocator();
 		create_descriptor_sets();
+		init_gpu_culler();
 		create_command_buffers();
+
+		auto pipeline_result = pipeline_library.wait(graphics_pipeline);
+		if (!pipeline_result) {
+			throw std::runtime_error(pipeline_result.error());
+		}
+		TRAMOGI_LOG_INFO(
+			Graphics,
+			"Critical pipelines ready {:.2f} ms after requesting them, with a {} cache",
+			static_cast<double>(profiling::now_ns() - pipeline_begin_ns) / 1000000.0,
+			pipeline_cache.is_warm() ? "warm" : "cold"
+		);
+
+		upload_context.wait(upload_point);
+		TRAMOGI_LOG_INFO(
+			Graphics,
+			"Startup took {:.2f} ms with {} upload submissions",
+			static_cast<double>(profiling::now_ns() - begin_ns) / 1000000.0,
+			upload_context.get_submit_count()
+		);
+
+		auto staging_stats = staging_pool.get_stats();
+		TRAMOGI_LOG_INFO(
+			Graphics,
+			"Staging: {} uploads ({} bytes) from {} staging allocations",
+			staging_stats.region_count,
+			staging_stats.uploaded_bytes,
+			staging_stats.chunk_allocation_count
+		);
+		staging_pool.trim();
 	}
 
 	void main_loop() {
@@ -181,6 +406,9 @@ private:
 		bool print_fps = false;
 
 		while (!window.should_close()) {
+			frame_telemetry.begin_frame();
+			memory::begin_frame();
+
 			auto now = std::chrono::high_resolution_clock().now();
 			double delta =
 				std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_time).count() /
@@ -195,15 +423,88 @@ private:
 			if (input.is_pressed(tramogi::input::Key::Q)) {
 				window.request_close();
 			}
+			if (input.is_pressed(tramogi::input::Key::F3)) {
+				device.get_memory_accounting().log_dump();
+				input.consume_key(tramogi::input::Key::F3);
+			}
+			if (input.is_pressed(tramogi::input::Key::F4)) {
+				defragmenter.start();
+				input.consume_key(tramogi::input::Key::F4);
+			}
+			if (input.is_pressed(tramogi::input::Key::F2)) {
+				export_telemetry();
+				input.consume_key(tramogi::input::Key::F2);
+			}
+			if (input.is_pressed(tramogi::input::Key::B)) {
+				toggle_bindless();
+				input.consume_key(tramogi::input::Key::B);
+			}
+			if (input.is_pressed(tramogi::input::Key::R)) {
+				toggle_parallel_recording();
+				input.consume_key(tramogi::input::Key::R);
+			}
+			if (input.is_pressed(tramogi::input::Key::C)) {
+				toggle_command_buffer_caching();
+				input.consume_key(tramogi::input::Key::C);
+			}
+			if (input.is_pressed(tramogi::input::Key::G)) {
+				toggle_gpu_driven();
+				input.consume_key(tramogi::input::Key::G);
+			}
+			if (input.is_pressed(tramogi::input::Key::V)) {
+				if (is_gpu_driven) {
+					gpu_culler.request_validation();
+				}
+				input.consume_key(tramogi::input::Key::V);
+			}
+			if (input.is_pressed(tramogi::input::Key::H)) {
+				toggle_render_graph();
+				input.consume_key(tramogi::input::Key::H);
+			}
+			if (input.is_pressed(tramogi::input::Key::I)) {
+				cycle_instancing_mode();
+				input.consume_key(tramogi::input::Key::I);
+			}
 
 			draw_frame(delta);
+			if (!has_drawn_frame) {
+				has_drawn_frame = true;
+				TRAMOGI_LOG_INFO(
+					Graphics,
+					"Time to first frame: {:.2f} ms, {} pipelines still compiling",
+					static_cast<double>(profiling::now_ns() - start_ns) / 1000000.0,
+					pipeline_library.get_pending_count()
+				);
+			}
+
+			frame_telemetry.end_frame();
+
+			auto allocation_stats = memory::end_frame();
+			if (allocation_stats.is_heavy) {
+				TRAMOGI_LOG_WARNING(
+					General,
+					"Allocation-heavy frame {}: {} allocations, {} bytes",
+					frame_telemetry.get_frame_count(),
+					allocation_stats.total_count,
+					allocation_stats.total_bytes
+				);
+			}
 
 			++frames;
 			timer += delta;
 
 			while (timer >= 1) {
 				if (print_fps) {
-					debug_log("{} FPS ({:.2f}ms)", frames, 1000.0 / frames);
+					auto summary = frame_telemetry.get_window_summary(0);
+					debug_log(
+						"{} FPS ({:.2f}ms) p50 {:.2f}ms p95 {:.2f}ms p99 {:.2f}ms max {:.2f}ms",
+						frames,
+						1000.0 / frames,
+						summary.p50_ms,
+						summary.p95_ms,
+						summary.p99_ms,
+						summary.max_ms
+					);
 				}
 				frames = 0;
 				timer -= 1;
@@ -212,14 +513,201 @@ private:
 			last_time = now;
 		}
 
-		device.wait_idle(current_frame);
+		device.wait_idle();
+
+		export_telemetry();
+		memory::log_report();
+	}
+
+	void export_telemetry() {
+		auto result = frame_telemetry.export_json(TELEMETRY_JSON_PATH);
+		if (result) {
+			result = frame_telemetry.export_csv(TELEMETRY_CSV_PATH);
+		}
+		if (!result) {
+			log("Failed to export frame telemetry: {}", result.error());
+			return;
+		}
+		debug_log(
+			"Frame telemetry written to {} and {} ({} frames)",
+			TELEMETRY_JSON_PATH,
+			TELEMETRY_CSV_PATH,
+			frame_telemetry.get_frame_count()
+		);
+
+		descriptor_allocator.log_stats();
+		debug_log(
+			"Descriptor set layouts: {} created, {} reused",
+			descriptor_layout_cache.get_layout_count(),
+			descriptor_layout_cache.get_hit_count()
+		);
+		gpu_profiler.log_stats();
+		pipeline_library.log_stats();
+		parallel_recorder.log_stats();
+		gpu_culler.log_stats();
+		instance_batch.log_stats();
+		log_instancing_benchmark();
+		render_graph.log_stats();
+		log_barrier_comparison();
+		tramogi::graphics::MemoryUsage render_targets = device.get_memory_accounting().get_usage(
+			tramogi::graphics::ResourceKind::Attachment
+		);
+		debug_log(
+			"Render target memory: {} bytes, peak {} bytes",
+			render_targets.bytes,
+			render_targets.peak_bytes
+		);
+		debug_log(
+			"Command buffer cache: {} replays, {} recordings",
+			command_buffer_replay_count,
+			command_buffer_record_count
+		);
+	}
+
+	telemetry::FrameTelemetry::ScopedPhase measure_phase(FramePhase phase) {
+		return {frame_telemetry, std::to_underlying(phase)};
 	}
 
 	void cleanup() {
+		// Pipelines still compiling would be missing from the saved cache.
+		pipeline_library.wait_all();
+		auto cache_result = pipeline_cache.save();
+		if (!cache_result) {
+			log("Failed to save the pipeline cache: {}", cache_result.error());
+		}
 		cleanup_swapchain();
 	}
 
+	void toggle_bindless() {
+		if (!is_bindless_supported) {
+			debug_log("Bindless mode is not supported by this device");
+			return;
+		}
+
+		is_bindless = !is_bindless;
+		debug_log(
+			"Bindless: {} (descriptor writes so far: {} for per-frame sets, {} for the bindless "
+			"heap, none per frame in either mode)",
+			is_bindless,
+			descriptor_write_count,
+			bindless_heap.get_write_count()
+		);
+	}
+
+	void toggle_parallel_recording() {
+		is_parallel_recording = !is_parallel_recording;
+		debug_log(
+			"Parallel recording: {} ({} draws per frame, {} threads)",
+			is_parallel_recording,
+			synthetic_draw_count + 1,
+			parallel_recorder.get_thread_count()
+		);
+	}
+
+	void toggle_gpu_driven() {
+		if (!gpu_culler.is_supported()) {
+			debug_log("GPU-driven rendering is not supported by this device");
+			return;
+		}
+
+		is_gpu_driven = !is_gpu_driven;
+		debug_log("GPU-driven rendering: {} ({} objects)", is_gpu_driven, objects.size());
+	}
+
+	void toggle_render_graph() {
+		is_render_graph = !is_render_graph;
+		// Only the depth image of the path in use is kept.
+		device.wait_idle();
+		render_graph.release_transients();
+		create_depth_resources();
+		// Recorded command buffers may reference the released images.
+		++scene_generation;
+		debug_log("Barriers: {}", is_render_graph ? "render graph" : "hand-written");
+		log_barrier_comparison();
+	}
+
+	// Once both paths have recorded a frame of the same kind, the render graph should not need
+	// more barrier batches than the hand-written path.
+	void log_barrier_comparison() {
+		for (bool gpu_driven : {false, true}) {
+			const BarrierCounts &graph = graph_barriers[gpu_driven];
+			const BarrierCounts &hand_written = hand_written_barriers[gpu_driven];
+			if (graph.batch_count == 0 || hand_written.batch_count == 0) {
+				continue;
+			}
+			debug_log(
+				"Barriers per {}frame: render graph {} batches with {} barriers, hand-written {} "
+				"batches with {} barriers",
+				gpu_driven ? "GPU-driven " : "",
+				graph.batch_count,
+				graph.barrier_count,
+				hand_written.batch_count,
+				hand_written.barrier_count
+			);
+			if (graph.batch_count > hand_written.batch_count) {
+				TRAMOGI_LOG_WARNING(
+					Graphics,
+					"The render graph records more barrier batches than the hand-written path"
+				);
+			}
+		}
+	}
+
+	void cycle_instancing_mode() {
+		instancing_mode =
+			static_cast<InstancingMode>((std::to_underlying(instancing_mode) + 1) % 3);
+		debug_log(
+			"Instancing: {} ({} instances)",
+			get_instancing_mode_name(instancing_mode),
+			instance_batch.get_count()
+		);
+		log_instancing_benchmark();
+	}
+
+	// Compares the CPU time of recording the instance draws and the GPU time of executing them,
+	// one draw per instance against a single instanced draw. Frames that draw instances are
+	// recorded every frame, even while command buffers are cached.
+	void log_instancing_benchmark() {
+		auto gpu_stats = gpu_profiler.get_stats();
+		auto gpu_average_ms = [&gpu_stats](std::string_view name) {
+			auto it = std::ranges::find_if(gpu_stats, [name](const auto &zone) {
+				return zone.name == name;
+			});
+			return it == gpu_stats.end() ? 0.0 : it->average_ms;
+		};
+		auto cpu_average_ms = [this](InstancingMode mode) {
+			const InstancingBenchmark &benchmark =
+				instancing_benchmarks[std::to_underlying(mode)];
+			if (benchmark.record_count == 0) {
+				return 0.0;
+			}
+			return static_cast<double>(benchmark.record_ns) / 1000000.0 / benchmark.record_count;
+		};
+
+		debug_log(
+			"Instancing benchmark with {} instances: one draw per instance {:.3f} ms CPU and "
+			"{:.3f} ms GPU, one instanced draw {:.3f} ms CPU and {:.3f} ms GPU",
+			instance_batch.get_count(),
+			cpu_average_ms(InstancingMode::PerDraw),
+			gpu_average_ms(PER_DRAW_INSTANCES_ZONE),
+			cpu_average_ms(InstancingMode::Instanced),
+			gpu_average_ms(INSTANCED_ZONE)
+		);
+	}
+
+	void toggle_command_buffer_caching() {
+		is_caching_command_buffers = !is_caching_command_buffers;
+		debug_log(
+			"Command buffer caching: {} ({} replays, {} recordings so far)",
+			is_caching_command_buffers,
+			command_buffer_replay_count,
+			command_buffer_record_count
+		);
+	}
+
 	void create_instance() {
+		TRAMOGI_PROFILE_ZONE("create_instance");
+
 		auto extensions = window.get_required_extensions();
 		auto result = instance.init(extensions);
 		if (!result) {
@@ -228,6 +716,8 @@ private:
 	}
 
 	void pick_physical_device() {
+		TRAMOGI_PROFILE_ZONE("pick_physical_device");
+
 		Result<vk::SurfaceKHR> surface_result = window.create_surface(instance.get_instance());
 		if (!surface_result) {
 			throw std::runtime_error(std::string(surface_result.error()));
@@ -237,13 +727,60 @@ private:
 		if (!result) {
 			throw std::runtime_error(result.error());
 		}
+		if (read_flag_variable(DISABLE_TRANSFER_QUEUE_VARIABLE)) {
+			physical_device.disable_dedicated_transfer_queue();
+		}
 	}
 
 	void create_logical_device() {
-		device.init(instance);
+		TRAMOGI_PROFILE_ZONE("create_logical_device");
+
+		frames_in_flight = read_frames_in_flight();
+		debug_log("Frames in flight: {}", frames_in_flight);
+		device.init(instance, frames_in_flight);
+		pipeline_cache.init(device, PIPELINE_CACHE_PATH);
+		pipeline_library.init(device, pipeline_cache, thread_pool);
+	}
+
+	uint32_t read_frames_in_flight() const {
+		return read_count_variable(
+			FRAMES_IN_FLIGHT_VARIABLE,
+			DEFAULT_FRAMES_IN_FLIGHT,
+			1,
+			MAX_FRAMES_IN_FLIGHT
+		);
+	}
+
+	// Set to anything but 0.
+	bool read_flag_variable(const char *variable) const {
+		const char *value = std::getenv(variable);
+		return value && std::strcmp(value, "0") != 0;
+	}
+
+	// `default_count` when the variable is unset or out of [min_count, max_count].
+	uint32_t read_count_variable(
+		const char *variable,
+		uint32_t default_count,
+		uint32_t min_count,
+		uint32_t max_count
+	) const {
+		const char *value = std::getenv(variable);
+		if (!value) {
+			return default_count;
+		}
+
+		uint32_t count = 0;
+		auto [end, error] = std::from_chars(value, value + std::strlen(value), count);
+		if (error != std::errc() || count < min_count || count > max_count) {
+			log("Ignoring {}={}, expected {} to {}", variable, value, min_count, max_count);
+			return default_count;
+		}
+		return count;
 	}
 
 	void create_swapchain() {
+		TRAMOGI_PROFILE_ZONE("create_swapchain");
+
 		auto surface_capabilities = physical_device.get_surface_capabilities();
 		std::vector<vk::SurfaceFormatKHR> available_formats = physical_device.get_surface_formats();
 		std::vector<vk::PresentModeKHR> available_present_mode =
@@ -299,6 +836,7 @@ private:
 
 		swapchain = vk::raii::SwapchainKHR(device.get_device(), swapchain_create_info);
 		swapchain_images = swapchain.getImages();
+		device.create_swapchain_semaphores(static_cast<uint32_t>(swapchain_images.size()));
 	}
 
 	vk::SurfaceFormatKHR choose_swap_surface_format(
@@ -367,6 +905,8 @@ private:
 	}
 
 	void create_image_views() {
+		TRAMOGI_PROFILE_ZONE("create_image_views");
+
 		swapchain_image_views.clear();
 		swapchain_image_views.reserve(swapchain_images.size());
 		for (const auto &image : swapchain_images) {
@@ -380,10 +920,12 @@ private:
 	}
 
 	void create_descriptor_layout() {
+		TRAMOGI_PROFILE_ZONE("create_descriptor_layout");
+
 		std::array bindings = {
 			vk::DescriptorSetLayoutBinding {
 				.binding = 0,
-				.descriptorType = vk::DescriptorType::eUniformBuffer,
+				.descriptorType = vk::DescriptorType::eUniformBufferDynamic,
 				.descriptorCount = 1,
 				.stageFlags = vk::ShaderStageFlagBits::eVertex,
 				.pImmutableSamplers = nullptr,
@@ -394,7 +936,23 @@ private:
 				.descriptorCount = 1,
 				.stageFlags = vk::ShaderStageFlagBits::eFragment,
 				.pImmutableSamplers = nullptr,
-			}
+			},
+			// Only read by vert_main_objects.
+			vk::DescriptorSetLayoutBinding {
+				.binding = 2,
+				.descriptorType = vk::DescriptorType::eStorageBuffer,
+				.descriptorCount = 1,
+				.stageFlags = vk::ShaderStageFlagBits::eVertex,
+				.pImmutableSamplers = nullptr,
+			},
+			// Only read by vert_main_instanced. Bindings 3 to 5 are taken by the cull pass.
+			vk::DescriptorSetLayoutBinding {
+				.binding = 6,
+				.descriptorType = vk::DescriptorType::eStorageBuffer,
+				.descriptorCount = 1,
+				.stageFlags = vk::ShaderStageFlagBits::eVertex,
+				.pImmutableSamplers = nullptr,
+			},
 		};
 
 		vk::DescriptorSetLayoutCreateInfo layout_info {
@@ -402,96 +960,46 @@ private:
 			.pBindings = bindings.data(),
 		};
 
-		descriptor_set_layout = vk::raii::DescriptorSetLayout(device.get_device(), layout_info);
+		descriptor_layout_cache.init(device);
+		descriptor_set_layout = descriptor_layout_cache.get(layout_info);
+
+		is_bindless_supported = physical_device.supports_bindless();
+		if (is_bindless_supported) {
+			auto result = bindless_heap.init(device);
+			if (!result) {
+				throw std::runtime_error(result.error());
+			}
+		}
 	}
 
 	void create_graphics_pipeline() {
+		TRAMOGI_PROFILE_ZONE("create_graphics_pipeline");
+
 		auto shader_code_result = read_shader_file("shaders/slang.spv");
 		if (!shader_code_result) {
 			throw std::runtime_error(shader_code_result.error());
 		}
 		auto shader_code = shader_code_result.value();
 
-		vk::raii::ShaderModule shader_module = create_shader_module(shader_code);
+		// Kept alive for the pipelines that are still compiling in the background.
+		shader_module = create_shader_module(shader_code);
 
-		vk::PipelineShaderStageCreateInfo vertex_stage_create_info {
-			.stage = vk::ShaderStageFlagBits::eVertex,
-			.module = shader_module,
-			.pName = "vert_main",
-		};
-		vk::PipelineShaderStageCreateInfo fragment_stage_create_info {
-			.stage = vk::ShaderStageFlagBits::eFragment,
-			.module = shader_module,
-			.pName = "frag_main",
-		};
-
-		std::array<vk::PipelineShaderStageCreateInfo, 2> shader_stages {
-			vertex_stage_create_info,
-			fragment_stage_create_info,
-		};
-
-		std::array<vk::DynamicState, 2> dynamic_states {
-			vk::DynamicState::eViewport,
-			vk::DynamicState::eScissor,
-		};
-		vk::PipelineDynamicStateCreateInfo dynamic_state_create_info {
-			.dynamicStateCount = dynamic_states.size(),
-			.pDynamicStates = dynamic_states.data(),
-		};
-
-		auto binding_description = get_binding_description();
-		auto attribute_description = get_attribute_description();
-		vk::PipelineVertexInputStateCreateInfo vertex_input_info {
-			.vertexBindingDescriptionCount = 1,
-			.pVertexBindingDescriptions = &binding_description,
-			.vertexAttributeDescriptionCount = attribute_description.size(),
-			.pVertexAttributeDescriptions = attribute_description.data(),
-		};
-		vk::PipelineInputAssemblyStateCreateInfo input_assembly_info {
-			.topology = vk::PrimitiveTopology::eTriangleList
-		};
-
-		vk::PipelineViewportStateCreateInfo viewport_state_info {
-			.viewportCount = 1,
-			.scissorCount = 1,
-		};
-		vk::PipelineRasterizationStateCreateInfo rasterization_state_info {
-			.depthClampEnable = vk::False,
-			.rasterizerDiscardEnable = vk::False,
-			.polygonMode = vk::PolygonMode::eFill,
-			.cullMode = vk::CullModeFlagBits::eBack,
-			.frontFace = vk::FrontFace::eCounterClockwise,
-			.depthBiasEnable = vk::False,
-			.depthBiasSlopeFactor = 1,
-			.lineWidth = 1,
-		};
-		vk::PipelineMultisampleStateCreateInfo multisample_info {
-			.rasterizationSamples = vk::SampleCountFlagBits::e1,
-			.sampleShadingEnable = vk::False,
-		};
-		vk::PipelineColorBlendAttachmentState color_blend_attachment {
-			.blendEnable = vk::False,
-			.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-							  vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
-		};
-		vk::PipelineDepthStencilStateCreateInfo depth_stencil_info {
-			.depthTestEnable = vk::True,
-			.depthWriteEnable = vk::True,
-			.depthCompareOp = vk::CompareOp::eLess,
-			.depthBoundsTestEnable = vk::False,
-			.stencilTestEnable = vk::False,
-		};
-		vk::PipelineColorBlendStateCreateInfo color_blending {
-			.logicOpEnable = vk::False,
-			.logicOp = vk::LogicOp::eCopy,
-			.attachmentCount = 1,
-			.pAttachments = &color_blend_attachment,
+		// The bindless set and material push constants are only used by frag_main_bindless.
+		std::vector<vk::DescriptorSetLayout> set_layouts {descriptor_set_layout};
+		vk::PushConstantRange push_constant_range {
+			.stageFlags = vk::ShaderStageFlagBits::eFragment,
+			.offset = 0,
+			.size = sizeof(BindlessPushConstants),
 		};
+		if (is_bindless_supported) {
+			set_layouts.push_back(*bindless_heap.get_layout());
+		}
 
 		vk::PipelineLayoutCreateInfo pipeline_layout_info {
-			.setLayoutCount = 1,
-			.pSetLayouts = &*descriptor_set_layout,
-			.pushConstantRangeCount = 0,
+			.setLayoutCount = static_cast<uint32_t>(set_layouts.size()),
+			.pSetLayouts = set_layouts.data(),
+			.pushConstantRangeCount = is_bindless_supported ? 1u : 0u,
+			.pPushConstantRanges = &push_constant_range,
 		};
 
 		pipeline_layout = vk::raii::PipelineLayout(device.get_device(), pipeline_layout_info);
@@ -501,30 +1009,28 @@ private:
 			throw std::runtime_error(depth_format.error());
 		}
 
-		vk::PipelineRenderingCreateInfo pipeline_rendering_info {
-			.colorAttachmentCount = 1,
-			.pColorAttachmentFormats = &swapchain_surface_format.format,
-			.depthAttachmentFormat = depth_format.value(),
-		};
-
-		vk::GraphicsPipelineCreateInfo graphics_pipeline_info {
-			.pNext = &pipeline_rendering_info,
-			.stageCount = 2,
-			.pStages = shader_stages.data(),
-			.pVertexInputState = &vertex_input_info,
-			.pInputAssemblyState = &input_assembly_info,
-			.pViewportState = &viewport_state_info,
-			.pRasterizationState = &rasterization_state_info,
-			.pMultisampleState = &multisample_info,
-			.pDepthStencilState = &depth_stencil_info,
-			.pColorBlendState = &color_blending,
-			.pDynamicState = &dynamic_state_create_info,
+		tramogi::graphics::PipelineDesc desc {
+			.shader_module = shader_module,
 			.layout = pipeline_layout,
-			.renderPass = nullptr,
+			.vertex_stride = sizeof(Vertex),
+			.vertex_attributes = get_vertex_attributes(),
+			.color_format = swapchain_surface_format.format,
+			.depth_format = depth_format.value(),
 		};
 
-		graphics_pipeline =
-			vk::raii::Pipeline(device.get_device(), nullptr, graphics_pipeline_info);
+		// Only the pipeline of the first frame is critical, init_vulkan waits for it after the
+		// other setup. The rest compile while rendering has already started.
+		pipeline_begin_ns = profiling::now_ns();
+		graphics_pipeline = pipeline_library.request(desc, "opaque");
+		if (is_bindless_supported) {
+			desc.fragment_entry = "frag_main_bindless";
+			bindless_pipeline = pipeline_library.request(desc, "bindless");
+		}
+		desc.vertex_entry = "vert_main_objects";
+		desc.fragment_entry = "frag_main";
+		objects_pipeline = pipeline_library.request(desc, "objects");
+		desc.vertex_entry = "vert_main_instanced";
+		instanced_pipeline = pipeline_library.request(desc, "instanced");
 	}
 
 	[[nodiscard]] vk::raii::ShaderModule create_shader_module(const std::vector<char> &code) const {
@@ -537,6 +1043,8 @@ private:
 	}
 
 	void create_command_pool() {
+		TRAMOGI_PROFILE_ZONE("create_command_pool");
+
 		vk::CommandPoolCreateInfo pool_info {
 			.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
 			.queueFamilyIndex = physical_device.get_graphics_queue_index(),
@@ -549,31 +1057,48 @@ private:
 		return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
 	}
 
+	// The dedicated depth image only exists while recording without the render graph, which has
+	// its own. Its content never outlives a frame, so it is lazily allocated where possible.
 	void create_depth_resources() {
-		Result<vk::Format> depth_format = physical_device.get_depth_format();
-		if (!depth_format) {
-			throw std::runtime_error(depth_format.error());
+		TRAMOGI_PROFILE_ZONE("create_depth_resources");
+
+		// Released first, the old and new images never take memory at the same time.
+		depth_image_view = nullptr;
+		depth_image = nullptr;
+		depth_memory = {};
+
+		Result<vk::Format> depth_format_result = physical_device.get_depth_format();
+		if (!depth_format_result) {
+			throw std::runtime_error(depth_format_result.error());
+		}
+		depth_format = depth_format_result.value();
+		if (is_render_graph) {
+			return;
 		}
 		create_image(
 			swapchain_extent.width,
 			swapchain_extent.height,
 			1,
-			depth_format.value(),
+			depth_format,
 			vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eDepthStencilAttachment,
-			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			vk::ImageUsageFlagBits::eDepthStencilAttachment |
+				vk::ImageUsageFlagBits::eTransientAttachment,
+			tramogi::graphics::MemoryType::Lazy,
+			tramogi::graphics::ResourceKind::Attachment,
 			depth_image,
 			depth_memory
 		);
 		depth_image_view = create_image_view(
 			depth_image,
-			depth_format.value(),
+			depth_format,
 			vk::ImageAspectFlagBits::eDepth,
 			1
 		);
 	}
 
 	void create_texture_image() {
+		TRAMOGI_PROFILE_ZONE("create_texture_image");
+
 		tramogi::core::ImageData image_data;
 		if (!image_data.load_from_file(TEXTURE_PATH.c_str())) {
 			// TODO: handle missing texture without throwing
@@ -585,16 +1110,11 @@ private:
 		mip_levels = image_data.get_mip_levels();
 		vk::DeviceSize image_size = image_data.get_size();
 
-		tramogi::graphics::StagingBuffer staging_buffer;
-		auto result = staging_buffer.init(device, image_size);
-		if (!result) {
-			throw std::runtime_error(result.error());
+		auto staging_region = staging_pool.upload(image_data.get_data(), image_size);
+		if (!staging_region) {
+			throw std::runtime_error(staging_region.error());
 		}
 
-		staging_buffer.map();
-		staging_buffer.upload_data(image_data.get_data());
-		staging_buffer.unmap();
-
 		create_image(
 			texture_width,
 			texture_height,
@@ -603,7 +1123,8 @@ private:
 			vk::ImageTiling::eOptimal,
 			vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst |
 				vk::ImageUsageFlagBits::eSampled,
-			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			tramogi::graphics::MemoryType::Gpu,
+			tramogi::graphics::ResourceKind::Texture,
 			texture_image,
 			texture_memory
 		);
@@ -615,11 +1136,30 @@ private:
 			mip_levels
 		);
 		copy_buffer_to_image(
-			staging_buffer.get_buffer(),
+			*staging_region->buffer,
+			staging_region->offset,
 			texture_image,
 			texture_width,
 			texture_height
 		);
+		// Mipmaps are blitted on the graphics queue.
+		upload_context.hand_over(vk::ImageMemoryBarrier2 {
+			.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eBlit,
+			.dstAccessMask = vk::AccessFlagBits2::eTransferRead |
+							 vk::AccessFlagBits2::eTransferWrite,
+			.oldLayout = vk::ImageLayout::eTransferDstOptimal,
+			.newLayout = vk::ImageLayout::eTransferDstOptimal,
+			.image = texture_image,
+			.subresourceRange = {
+				.aspectMask = vk::ImageAspectFlagBits::eColor,
+				.baseMipLevel = 0,
+				.levelCount = mip_levels,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+		});
 
 		generate_mipmaps(texture_image, texture_width, texture_height, mip_levels);
 	}
@@ -630,7 +1170,9 @@ private:
 		int32_t texture_height,
 		uint32_t mip_levels
 	) {
-		vk::raii::CommandBuffer command_buffer = begin_single_time_commands();
+		const vk::raii::CommandBuffer &command_buffer =
+			upload_context.get_graphics_command_buffer();
+		tramogi::graphics::GpuZone zone(gpu_profiler, command_buffer, "mipmaps");
 
 		vk::ImageMemoryBarrier barrier {
 			.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
@@ -741,11 +1283,11 @@ private:
 			{},
 			barrier
 		);
-
-		end_single_time_commands(command_buffer);
 	}
 
 	void create_texture_image_view() {
+		TRAMOGI_PROFILE_ZONE("create_texture_image_view");
+
 		texture_image_view = create_image_view(
 			texture_image,
 			vk::Format::eR8G8B8A8Srgb,
@@ -755,6 +1297,8 @@ private:
 	}
 
 	void create_texture_sampler() {
+		TRAMOGI_PROFILE_ZONE("create_texture_sampler");
+
 		vk::PhysicalDeviceProperties properties =
 			physical_device.get_physical_device().getProperties();
 		vk::SamplerCreateInfo sampler_info {
@@ -780,9 +1324,10 @@ private:
 		vk::Format format,
 		vk::ImageTiling tiling,
 		vk::ImageUsageFlags usage,
-		vk::MemoryPropertyFlags properties,
+		tramogi::graphics::MemoryType memory_type,
+		tramogi::graphics::ResourceKind kind,
 		vk::raii::Image &image,
-		vk::raii::DeviceMemory &image_memory
+		tramogi::graphics::Allocation &image_memory
 	) {
 		vk::ImageCreateInfo image_info {
 			.imageType = vk::ImageType::e2D,
@@ -798,58 +1343,53 @@ private:
 
 		image = vk::raii::Image(device.get_device(), image_info);
 
-		vk::MemoryRequirements memory_requirements = image.getMemoryRequirements();
-		vk::MemoryAllocateInfo allocate_info {
-			.allocationSize = memory_requirements.size,
-			.memoryTypeIndex = find_memory_type(memory_requirements.memoryTypeBits, properties),
-		};
-
-		image_memory = vk::raii::DeviceMemory(device.get_device(), allocate_info);
-		image.bindMemory(image_memory, 0);
-	}
-
-	vk::raii::CommandBuffer begin_single_time_commands() {
-		vk::CommandBufferAllocateInfo allocate_info {
-			.commandPool = command_pool,
-			.level = vk::CommandBufferLevel::ePrimary,
-			.commandBufferCount = 1,
-		};
-
-		vk::raii::CommandBuffer command_buffer = std::move(
-			device.get_device().allocateCommandBuffers(allocate_info).front()
+		auto allocation_result = tramogi::graphics::allocate_memory(
+			device,
+			image.getMemoryRequirements(),
+			memory_type,
+			kind
 		);
+		if (!allocation_result) {
+			throw std::runtime_error(allocation_result.error());
+		}
 
-		vk::CommandBufferBeginInfo begin_info {
-			.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
-		};
-		command_buffer.begin(begin_info);
-
-		return command_buffer;
+		image_memory = std::move(allocation_result.value());
+		image.bindMemory(image_memory.get_memory(), image_memory.get_offset());
 	}
 
-	void end_single_time_commands(vk::raii::CommandBuffer &command_buffer) {
-		command_buffer.end();
+	void create_command_buffers() {
+		TRAMOGI_PROFILE_ZONE("create_command_buffers");
 
-		vk::SubmitInfo submit_info {
-			.commandBufferCount = 1,
-			.pCommandBuffers = &*command_buffer,
+		vk::CommandBufferAllocateInfo allocateInfo {
+			.commandPool = command_pool,
+			.level = vk::CommandBufferLevel::ePrimary,
+			.commandBufferCount = frames_in_flight,
 		};
 
-		device.submit_graphics(submit_info);
-		device.wait_graphics_queue();
+		command_buffers = vk::raii::CommandBuffers(device.get_device(), allocateInfo);
+		create_cached_command_buffers();
+		parallel_recorder.init(device, thread_pool, frames_in_flight);
+		synthetic_draw_count =
+			read_count_variable(SYNTHETIC_DRAWS_VARIABLE, 0, 0, MAX_SYNTHETIC_DRAWS);
 	}
 
-	void create_command_buffers() {
-		vk::CommandBufferAllocateInfo allocateInfo {
+	// One per frame slot and swapchain image, all invalid until recorded.
+	void create_cached_command_buffers() {
+		vk::CommandBufferAllocateInfo allocate_info {
 			.commandPool = command_pool,
 			.level = vk::CommandBufferLevel::ePrimary,
-			.commandBufferCount = MAX_FRAMES_IN_FLIGHT,
+			.commandBufferCount = static_cast<uint32_t>(frames_in_flight * swapchain_images.size()),
 		};
 
-		command_buffers = vk::raii::CommandBuffers(device.get_device(), allocateInfo);
+		cached_command_buffers.clear();
+		for (auto &command_buffer : vk::raii::CommandBuffers(device.get_device(), allocate_info)) {
+			cached_command_buffers.push_back({.command_buffer = std::move(command_buffer)});
+		}
 	}
 
 	void load_model() {
+		TRAMOGI_PROFILE_ZONE("load_model");
+
 		model.load_from_obj_file(MODEL_PATH.c_str());
 
 		debug_log("Loading model done!");
@@ -858,97 +1398,303 @@ private:
 	}
 
 	void create_vertex_buffer() {
+		TRAMOGI_PROFILE_ZONE("create_vertex_buffer");
+
 		auto buffer_size = sizeof(model.get_vertices()[0]) * model.get_vertices().size();
 
-		tramogi::graphics::StagingBuffer staging_buffer;
-		auto result = staging_buffer.init(device, buffer_size);
-		if (!result) {
-			throw std::runtime_error(result.error());
+		auto staging_region = staging_pool.upload(model.get_vertices().data(), buffer_size);
+		if (!staging_region) {
+			throw std::runtime_error(staging_region.error());
 		}
-		staging_buffer.map();
-		staging_buffer.upload_data(model.get_vertices().data());
-		staging_buffer.unmap();
 
-		result = vertex_buffer.init(device, buffer_size);
+		auto result = vertex_buffer.init(device, buffer_size);
 		if (!result) {
 			throw std::runtime_error(result.error());
 		}
 
-		copy_buffer(staging_buffer.get_buffer(), vertex_buffer.get_buffer(), buffer_size);
+		copy_buffer(
+			*staging_region->buffer,
+			staging_region->offset,
+			vertex_buffer.get_buffer(),
+			buffer_size
+		);
+		upload_context.hand_over(vk::BufferMemoryBarrier2 {
+			.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eVertexAttributeInput,
+			.dstAccessMask = vk::AccessFlagBits2::eVertexAttributeRead,
+			.buffer = vertex_buffer.get_buffer(),
+			.offset = 0,
+			.size = vk::WholeSize,
+		});
 	}
 
 	void create_index_buffer() {
+		TRAMOGI_PROFILE_ZONE("create_index_buffer");
+
 		auto buffer_size = sizeof(model.get_indices()[0]) * model.get_indices().size();
 
-		tramogi::graphics::StagingBuffer staging_buffer;
-		auto result = staging_buffer.init(device, buffer_size);
+		auto staging_region = staging_pool.upload(model.get_indices().data(), buffer_size);
+		if (!staging_region) {
+			throw std::runtime_error(staging_region.error());
+		}
+
+		auto result = index_buffer.init(device, buffer_size);
+		if (!result) {
+			throw std::runtime_error(result.error());
+		}
+		copy_buffer(
+			*staging_region->buffer,
+			staging_region->offset,
+			index_buffer.get_buffer(),
+			buffer_size
+		);
+		upload_context.hand_over(vk::BufferMemoryBarrier2 {
+			.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eIndexInput,
+			.dstAccessMask = vk::AccessFlagBits2::eIndexRead,
+			.buffer = index_buffer.get_buffer(),
+			.offset = 0,
+			.size = vk::WholeSize,
+		});
+	}
+
+	void create_material_buffer() {
+		TRAMOGI_PROFILE_ZONE("create_material_buffer");
+
+		if (!is_bindless_supported) {
+			return;
+		}
+
+		auto texture_index = bindless_heap.add_texture(texture_image_view, texture_sampler);
+		if (!texture_index) {
+			throw std::runtime_error(texture_index.error());
+		}
+
+		std::array materials {
+			Material {
+				.tint = glm::vec4(1.0f),
+				.texture = texture_index.value(),
+			},
+		};
+		auto buffer_size = sizeof(materials);
+
+		auto staging_region = staging_pool.upload(materials.data(), buffer_size);
+		if (!staging_region) {
+			throw std::runtime_error(staging_region.error());
+		}
+
+		auto result = material_buffer.init(device, buffer_size);
 		if (!result) {
 			throw std::runtime_error(result.error());
 		}
-		staging_buffer.map();
-		staging_buffer.upload_data(model.get_indices().data());
-		staging_buffer.unmap();
+		copy_buffer(
+			*staging_region->buffer,
+			staging_region->offset,
+			material_buffer.get_buffer(),
+			buffer_size
+		);
+		upload_context.hand_over(vk::BufferMemoryBarrier2 {
+			.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader,
+			.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+			.buffer = material_buffer.get_buffer(),
+			.offset = 0,
+			.size = vk::WholeSize,
+		});
 
-		result = index_buffer.init(device, buffer_size);
+		auto buffer_index =
+			bindless_heap.add_storage_buffer(*material_buffer.get_buffer(), 0, buffer_size);
+		if (!buffer_index) {
+			throw std::runtime_error(buffer_index.error());
+		}
+		bindless_push_constants = {
+			.material_buffer = buffer_index.value(),
+			.material_id = 0,
+		};
+	}
+
+	// Center in xyz and radius in w.
+	glm::vec4 get_model_bounds() const {
+		glm::vec3 min_position(std::numeric_limits<float>::max());
+		glm::vec3 max_position(std::numeric_limits<float>::lowest());
+		for (const Vertex &vertex : model.get_vertices()) {
+			min_position = glm::min(min_position, vertex.position);
+			max_position = glm::max(max_position, vertex.position);
+		}
+		glm::vec3 center = (min_position + max_position) * 0.5f;
+		float radius = 0.0f;
+		for (const Vertex &vertex : model.get_vertices()) {
+			radius = std::max(radius, glm::length(vertex.position - center));
+		}
+		return glm::vec4(center, radius);
+	}
+
+	// Places copy `index` of `count` on a square grid around the original, `spacing` apart.
+	static glm::mat4 get_grid_transform(uint32_t index, uint32_t count, float spacing) {
+		auto side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+		glm::vec3 offset(
+			(static_cast<float>(index % side) - static_cast<float>(side - 1) * 0.5f) * spacing,
+			(static_cast<float>(index / side) - static_cast<float>(side - 1) * 0.5f) * spacing,
+			0.0f
+		);
+		return glm::translate(glm::mat4(1.0f), offset);
+	}
+
+	// Lays copies of the model out on a square grid around the original, spaced by their bounds.
+	void create_object_buffer() {
+		TRAMOGI_PROFILE_ZONE("create_object_buffer");
+
+		glm::vec4 bounds = get_model_bounds();
+		uint32_t object_count =
+			read_count_variable(OBJECT_COUNT_VARIABLE, DEFAULT_OBJECT_COUNT, 1, MAX_OBJECT_COUNT);
+		objects.clear();
+		objects.reserve(object_count);
+		for (uint32_t i = 0; i < object_count; ++i) {
+			glm::mat4 transform = get_grid_transform(i, object_count, bounds.w * 2.5f);
+
+			tramogi::graphics::CullObject object {
+				.bounds = {bounds.x, bounds.y, bounds.z, bounds.w},
+				.index_count = static_cast<uint32_t>(model.get_indices().size()),
+				.first_index = 0,
+				.vertex_offset = 0,
+			};
+			std::memcpy(object.model.data(), &transform[0][0], sizeof(object.model));
+			objects.push_back(object);
+		}
+
+		auto buffer_size = sizeof(objects[0]) * objects.size();
+		auto staging_region = staging_pool.upload(objects.data(), buffer_size);
+		if (!staging_region) {
+			throw std::runtime_error(staging_region.error());
+		}
+
+		auto result = object_buffer.init(device, buffer_size);
 		if (!result) {
 			throw std::runtime_error(result.error());
 		}
-		copy_buffer(staging_buffer.get_buffer(), index_buffer.get_buffer(), buffer_size);
+		copy_buffer(
+			*staging_region->buffer,
+			staging_region->offset,
+			object_buffer.get_buffer(),
+			buffer_size
+		);
+		upload_context.hand_over(vk::BufferMemoryBarrier2 {
+			.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader |
+							vk::PipelineStageFlagBits2::eVertexShader,
+			.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+			.buffer = object_buffer.get_buffer(),
+			.offset = 0,
+			.size = vk::WholeSize,
+		});
 	}
 
-	void create_uniform_buffers() {
-		uniform_buffers.clear();
+	// The same grid as the objects, for the instancing benchmark. Set up once, so only the first
+	// upload of every frame writes anything.
+	void create_instance_batch() {
+		TRAMOGI_PROFILE_ZONE("create_instance_batch");
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-			vk::DeviceSize buffer_size = sizeof(UniformBufferObject);
-			tramogi::graphics::UniformBuffer ubo;
-			auto result = ubo.init(device, buffer_size);
-			if (!result) {
-				throw std::runtime_error(result.error());
+		uint32_t instance_count = read_count_variable(
+			INSTANCE_COUNT_VARIABLE,
+			DEFAULT_INSTANCE_COUNT,
+			1,
+			MAX_INSTANCE_COUNT
+		);
+		auto result = instance_batch.init(device, instance_count, frames_in_flight);
+		if (!result) {
+			throw std::runtime_error(result.error());
+		}
+
+		float spacing = get_model_bounds().w * 2.5f;
+		for (uint32_t i = 0; i < instance_count; ++i) {
+			glm::mat4 transform = get_grid_transform(i, instance_count, spacing);
+			tramogi::graphics::InstanceData instance;
+			std::memcpy(instance.model.data(), &transform[0][0], sizeof(instance.model));
+			auto index = instance_batch.add(instance);
+			if (!index) {
+				throw std::runtime_error(index.error());
 			}
-			ubo.map();
+		}
+	}
+
+	void init_gpu_culler() {
+		TRAMOGI_PROFILE_ZONE("init_gpu_culler");
+
+		auto result = gpu_culler.init(
+			device,
+			pipeline_cache,
+			shader_module,
+			objects,
+			object_buffer.get_buffer(),
+			frames_in_flight
+		);
+		if (!result) {
+			throw std::runtime_error(result.error());
+		}
+	}
+
+	void create_frame_ring_buffer() {
+		TRAMOGI_PROFILE_ZONE("create_frame_ring_buffer");
 
-			uniform_buffers.emplace_back(std::move(ubo));
+		auto result = frame_ring_buffer.init(device, frames_in_flight, FRAME_RING_BUFFER_SIZE);
+		if (!result) {
+			throw std::runtime_error(result.error());
 		}
 	}
 
-	void create_descriptor_pool() {
-		std::array pool_sizes {
-			vk::DescriptorPoolSize {
-				.type = vk::DescriptorType::eUniformBuffer,
-				.descriptorCount = MAX_FRAMES_IN_FLIGHT,
+	void init_defragmenter() {
+		TRAMOGI_PROFILE_ZONE("init_defragmenter");
+
+		// Both are re-bound from their current handle on every recording and are not referenced
+		// by any descriptor, so the move callback only has to drop the cached recordings.
+		defragmenter.init(device, frames_in_flight, DEFRAGMENTATION_BYTES_PER_FRAME);
+		defragmenter.set_move_callback([this](tramogi::graphics::Buffer &) {
+			++scene_generation;
+		});
+		defragmenter.add(vertex_buffer);
+		defragmenter.add(index_buffer);
+	}
+
+	void create_descriptor_allocator() {
+		TRAMOGI_PROFILE_ZONE("create_descriptor_allocator");
+
+		// Per set, matching the layout of the per-frame sets.
+		std::array pool_ratios {
+			tramogi::graphics::DescriptorPoolRatio {
+				.type = vk::DescriptorType::eUniformBufferDynamic,
+				.ratio = 1.0f,
 			},
-			vk::DescriptorPoolSize {
+			tramogi::graphics::DescriptorPoolRatio {
 				.type = vk::DescriptorType::eCombinedImageSampler,
-				.descriptorCount = MAX_FRAMES_IN_FLIGHT,
+				.ratio = 1.0f,
+			},
+			tramogi::graphics::DescriptorPoolRatio {
+				.type = vk::DescriptorType::eStorageBuffer,
+				.ratio = 2.0f,
 			},
 		};
-
-		vk::DescriptorPoolCreateInfo pool_info {
-			.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-			.maxSets = MAX_FRAMES_IN_FLIGHT,
-			.poolSizeCount = pool_sizes.size(),
-			.pPoolSizes = pool_sizes.data(),
-		};
-
-		descriptor_pool = vk::raii::DescriptorPool(device.get_device(), pool_info);
+		descriptor_allocator.init(device, frames_in_flight, pool_ratios);
 	}
 
 	void create_descriptor_sets() {
-		descriptor_sets.clear();
+		TRAMOGI_PROFILE_ZONE("create_descriptor_sets");
 
-		std::vector<vk::DescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, *descriptor_set_layout);
-		vk::DescriptorSetAllocateInfo allocate_info {
-			.descriptorPool = descriptor_pool,
-			.descriptorSetCount = static_cast<uint32_t>(layouts.size()),
-			.pSetLayouts = layouts.data(),
-		};
-
-		descriptor_sets = device.get_device().allocateDescriptorSets(allocate_info);
+		descriptor_sets.clear();
+		for (size_t i = 0; i < frames_in_flight; ++i) {
+			auto set = descriptor_allocator.allocate(descriptor_set_layout);
+			if (!set) {
+				throw std::runtime_error(set.error());
+			}
+			descriptor_sets.push_back(set.value());
+		}
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		for (size_t i = 0; i < frames_in_flight; ++i) {
 			vk::DescriptorBufferInfo buffer_info {
-				.buffer = uniform_buffers[i].get_buffer(),
+				.buffer = frame_ring_buffer.get_buffer(),
 				.offset = 0,
 				.range = sizeof(UniformBufferObject),
 			};
@@ -957,13 +1703,23 @@ private:
 				.imageView = texture_image_view,
 				.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
 			};
+			vk::DescriptorBufferInfo object_info {
+				.buffer = object_buffer.get_buffer(),
+				.offset = 0,
+				.range = vk::WholeSize,
+			};
+			vk::DescriptorBufferInfo instance_info {
+				.buffer = instance_batch.get_buffer(i),
+				.offset = 0,
+				.range = vk::WholeSize,
+			};
 			std::array descriptor_writes {
 				vk::WriteDescriptorSet {
 					.dstSet = descriptor_sets[i],
 					.dstBinding = 0,
 					.dstArrayElement = 0,
 					.descriptorCount = 1,
-					.descriptorType = vk::DescriptorType::eUniformBuffer,
+					.descriptorType = vk::DescriptorType::eUniformBufferDynamic,
 					.pBufferInfo = &buffer_info,
 				},
 				vk::WriteDescriptorSet {
@@ -974,35 +1730,69 @@ private:
 					.descriptorType = vk::DescriptorType::eCombinedImageSampler,
 					.pImageInfo = &image_info,
 				},
+				vk::WriteDescriptorSet {
+					.dstSet = descriptor_sets[i],
+					.dstBinding = 2,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = vk::DescriptorType::eStorageBuffer,
+					.pBufferInfo = &object_info,
+				},
+				vk::WriteDescriptorSet {
+					.dstSet = descriptor_sets[i],
+					.dstBinding = 6,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = vk::DescriptorType::eStorageBuffer,
+					.pBufferInfo = &instance_info,
+				},
 			};
 			device.get_device().updateDescriptorSets(descriptor_writes, {});
+			descriptor_write_count += descriptor_writes.size();
 		}
 	}
 
-	void copy_buffer(vk::raii::Buffer &src, vk::raii::Buffer &dst, vk::DeviceSize size) {
-		vk::raii::CommandBuffer command_copy_buffer = begin_single_time_commands();
+	void copy_buffer(
+		const vk::raii::Buffer &src,
+		vk::DeviceSize src_offset,
+		const vk::raii::Buffer &dst,
+		vk::DeviceSize size
+	) {
+		const vk::raii::CommandBuffer &command_copy_buffer = upload_context.get_command_buffer();
+		tramogi::graphics::GpuZone zone(
+			gpu_profiler,
+			command_copy_buffer,
+			"upload_buffer",
+			tramogi::graphics::QueueType::Transfer
+		);
 		command_copy_buffer.copyBuffer(
 			src,
 			dst,
 			vk::BufferCopy {
-				.srcOffset = 0,
+				.srcOffset = src_offset,
 				.dstOffset = 0,
 				.size = size,
 			}
 		);
-		end_single_time_commands(command_copy_buffer);
 	}
 
 	void copy_buffer_to_image(
 		const vk::raii::Buffer &buffer,
+		vk::DeviceSize buffer_offset,
 		vk::raii::Image &image,
 		uint32_t width,
 		uint32_t height
 	) {
-		vk::raii::CommandBuffer command_buffer = begin_single_time_commands();
+		const vk::raii::CommandBuffer &command_buffer = upload_context.get_command_buffer();
+		tramogi::graphics::GpuZone zone(
+			gpu_profiler,
+			command_buffer,
+			"upload_texture",
+			tramogi::graphics::QueueType::Transfer
+		);
 
 		vk::BufferImageCopy region {
-			.bufferOffset = 0,
+			.bufferOffset = buffer_offset,
 			.bufferRowLength = 0,
 			.bufferImageHeight = 0,
 			.imageSubresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1},
@@ -1012,20 +1802,6 @@ private:
 
 		command_buffer
 			.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, region);
-
-		end_single_time_commands(command_buffer);
-	}
-
-	uint32_t find_memory_type(uint32_t type_filter, vk::MemoryPropertyFlags properties) {
-		auto memory_properties = physical_device.get_memory_properties();
-		for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
-			if (type_filter & (1 << i) &&
-				(memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
-		}
-
-		throw std::runtime_error("Failed to find suitable memory type");
 	}
 
 	void transition_image_layout(
@@ -1034,7 +1810,7 @@ private:
 		vk::ImageLayout new_layout,
 		uint32_t mip_levels
 	) {
-		auto command_buffer = begin_single_time_commands();
+		const vk::raii::CommandBuffer &command_buffer = upload_context.get_command_buffer();
 
 		vk::PipelineStageFlags source_stage;
 		vk::PipelineStageFlags destination_stage;
@@ -1071,74 +1847,284 @@ private:
 		}
 
 		command_buffer.pipelineBarrier(source_stage, destination_stage, {}, {}, nullptr, barrier);
+	}
+
+	// Binds all of its state, since secondary command buffers inherit none. Draw 0 is the model,
+	// the others are synthetic draws without instances, which only cost recording time.
+	void record_draws(
+		const vk::raii::CommandBuffer &command_buffer,
+		uint32_t begin,
+		uint32_t end,
+		uint32_t uniform_offset,
+		bool use_bindless
+	) {
+		command_buffer.bindPipeline(
+			vk::PipelineBindPoint::eGraphics,
+			pipeline_library.get(use_bindless ? bindless_pipeline : graphics_pipeline)
+		);
+		command_buffer.setViewport(
+			0,
+			vk::Viewport(0.0f, 0.0f, swapchain_extent.width, swapchain_extent.height, 0.0f, 1.0f)
+		);
+		command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapchain_extent));
+
+		command_buffer.bindVertexBuffers(0, *vertex_buffer.get_buffer(), {0});
+		command_buffer.bindIndexBuffer(*index_buffer.get_buffer(), 0, vk::IndexType::eUint32);
+
+		command_buffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eGraphics,
+			pipeline_layout,
+			0,
+			descriptor_sets[current_frame],
+			uniform_offset
+		);
+		if (use_bindless) {
+			// Bound once per command buffer; switching materials is only a push constant.
+			command_buffer.bindDescriptorSets(
+				vk::PipelineBindPoint::eGraphics,
+				pipeline_layout,
+				1,
+				*bindless_heap.get_set(),
+				{}
+			);
+			command_buffer.pushConstants<BindlessPushConstants>(
+				pipeline_layout,
+				vk::ShaderStageFlagBits::eFragment,
+				0,
+				bindless_push_constants
+			);
+		}
 
-		end_single_time_commands(command_buffer);
+		uint32_t index_count = static_cast<uint32_t>(model.get_indices().size());
+		for (uint32_t i = begin; i < end; ++i) {
+			command_buffer.drawIndexed(index_count, i == 0 ? 1 : 0, 0, 0, 0);
+		}
 	}
 
-	void transition_image_layout(
-		vk::Image image,
-		vk::ImageLayout old_layout,
-		vk::ImageLayout new_layout,
-		vk::AccessFlags2 src_access_mask,
-		vk::AccessFlags2 dst_access_mask,
-		vk::PipelineStageFlags2 src_stage_mask,
-		vk::PipelineStageFlags2 dst_stage_mask,
-		vk::ImageAspectFlags aspect_flags
+	// Draws every object that survived this frame's cull with a single indirect call.
+	void record_object_draws(
+		const vk::raii::CommandBuffer &command_buffer,
+		uint32_t uniform_offset
 	) {
-		vk::ImageMemoryBarrier2 barrier = {
-			.srcStageMask = src_stage_mask,
-			.srcAccessMask = src_access_mask,
-			.dstStageMask = dst_stage_mask,
-			.dstAccessMask = dst_access_mask,
-			.oldLayout = old_layout,
-			.newLayout = new_layout,
-			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.image = image,
-			.subresourceRange = {
-				.aspectMask = aspect_flags,
-				.baseMipLevel = 0,
-				.levelCount = 1,
-				.baseArrayLayer = 0,
-				.layerCount = 1,
+		command_buffer.bindPipeline(
+			vk::PipelineBindPoint::eGraphics,
+			pipeline_library.get(objects_pipeline)
+		);
+		command_buffer.setViewport(
+			0,
+			vk::Viewport(0.0f, 0.0f, swapchain_extent.width, swapchain_extent.height, 0.0f, 1.0f)
+		);
+		command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapchain_extent));
+
+		command_buffer.bindVertexBuffers(0, *vertex_buffer.get_buffer(), {0});
+		command_buffer.bindIndexBuffer(*index_buffer.get_buffer(), 0, vk::IndexType::eUint32);
+		command_buffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eGraphics,
+			pipeline_layout,
+			0,
+			descriptor_sets[current_frame],
+			uniform_offset
+		);
+		gpu_culler.record_draw(command_buffer);
+	}
+
+	// Draws the instance batch in place of the model, with one instanced draw or, as the baseline
+	// of the benchmark, one draw per instance.
+	void record_instance_draws(
+		const vk::raii::CommandBuffer &command_buffer,
+		uint32_t uniform_offset,
+		InstancingMode mode
+	) {
+		uint64_t begin_ns = profiling::now_ns();
+		command_buffer.bindPipeline(
+			vk::PipelineBindPoint::eGraphics,
+			pipeline_library.get(instanced_pipeline)
+		);
+		command_buffer.setViewport(
+			0,
+			vk::Viewport(0.0f, 0.0f, swapchain_extent.width, swapchain_extent.height, 0.0f, 1.0f)
+		);
+		command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapchain_extent));
+
+		command_buffer.bindVertexBuffers(0, *vertex_buffer.get_buffer(), {0});
+		command_buffer.bindIndexBuffer(*index_buffer.get_buffer(), 0, vk::IndexType::eUint32);
+		command_buffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eGraphics,
+			pipeline_layout,
+			0,
+			descriptor_sets[current_frame],
+			uniform_offset
+		);
+
+		uint32_t index_count = static_cast<uint32_t>(model.get_indices().size());
+		if (mode == InstancingMode::Instanced) {
+			tramogi::graphics::GpuZone zone(gpu_profiler, command_buffer, INSTANCED_ZONE);
+			instance_batch.record_draw(command_buffer, index_count);
+		} else {
+			tramogi::graphics::GpuZone zone(gpu_profiler, command_buffer, PER_DRAW_INSTANCES_ZONE);
+			// Each draw selects its instance through the first instance, like a per-draw uniform
+			// update would, without the cost of writing one.
+			for (uint32_t i = 0; i < instance_batch.get_count(); ++i) {
+				command_buffer.drawIndexed(index_count, 1, 0, 0, i);
 			}
-		};
+		}
+
+		InstancingBenchmark &benchmark = instancing_benchmarks[std::to_underlying(mode)];
+		benchmark.record_ns += profiling::now_ns() - begin_ns;
+		++benchmark.record_count;
+	}
 
-		vk::DependencyInfo dependency_info {
-			.dependencyFlags = {},
-			.imageMemoryBarrierCount = 1,
-			.pImageMemoryBarriers = &barrier,
+	// Replays the cached command buffer of this frame slot and swapchain image while nothing it
+	// recorded has changed, and records one otherwise. Without caching, the frame's own command
+	// buffer is recorded from scratch every frame.
+	vk::CommandBuffer get_frame_command_buffer(uint32_t image_index, uint32_t uniform_offset) {
+		// Variants may still be compiling during the first frames.
+		RecordOptions options {
+			.uniform_offset = uniform_offset,
+			.use_bindless = is_bindless && pipeline_library.is_ready(bindless_pipeline),
+			.use_gpu_driven = is_gpu_driven && pipeline_library.is_ready(objects_pipeline),
+			.use_render_graph = is_render_graph,
 		};
+		if (pipeline_library.is_ready(instanced_pipeline)) {
+			options.instancing = instancing_mode;
+		}
+		options.use_parallel_recording = is_parallel_recording && !options.use_gpu_driven &&
+										 options.instancing == InstancingMode::Off;
+		if (options.use_gpu_driven) {
+			gpu_culler.update(camera_frustum);
+		}
+
+		// Defragmentation copies differ from frame to frame, validating the culling reads back
+		// more than a replay would, and the instancing benchmark times every recording and its
+		// GPU zones.
+		if (!is_caching_command_buffers || defragmenter.is_running() ||
+			gpu_culler.is_validation_pending() || options.instancing != InstancingMode::Off) {
+			command_buffers[current_frame].reset();
+			record_command_buffer(command_buffers[current_frame], image_index, options);
+			return command_buffers[current_frame];
+		}
+
+		CachedCommandBuffer &cached =
+			cached_command_buffers[current_frame * swapchain_images.size() + image_index];
+		options.use_parallel_recording = false;
+		if (cached.generation == scene_generation && cached.options == options) {
+			++command_buffer_replay_count;
+			return cached.command_buffer;
+		}
 
-		command_buffers[current_frame].pipelineBarrier2(dependency_info);
+		// Recorded serially, since the secondary command buffers of the parallel recorder are
+		// reset with their frame. Replayed GPU zones would write queries that are never reset.
+		gpu_profiler.set_paused(true);
+		cached.command_buffer.reset();
+		record_command_buffer(cached.command_buffer, image_index, options);
+		gpu_profiler.set_paused(false);
+
+		cached.generation = scene_generation;
+		cached.options = options;
+		++command_buffer_record_count;
+		return cached.command_buffer;
 	}
 
-	void record_command_buffer(uint32_t image_index) {
-		command_buffers[current_frame].begin({});
+	void record_command_buffer(
+		const vk::raii::CommandBuffer &command_buffer,
+		uint32_t image_index,
+		const RecordOptions &options
+	) {
+		TRAMOGI_PROFILE_ZONE("record_command_buffer");
 
-		transition_image_layout(
-			swapchain_images[image_index],
-			vk::ImageLayout::eUndefined,
-			vk::ImageLayout::eColorAttachmentOptimal,
-			{},
-			vk::AccessFlagBits2::eColorAttachmentWrite,
-			vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-			vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-			vk::ImageAspectFlagBits::eColor
+		command_buffer.begin({});
+		if (options.use_render_graph) {
+			record_graph_frame(command_buffer, image_index, options);
+		} else {
+			record_hand_written_frame(command_buffer, image_index, options);
+		}
+		command_buffer.end();
+	}
+
+	// The frame of both paths, into the swapchain image of `image_index`.
+	tramogi::graphics::FrameGraphDesc get_frame_graph_desc(
+		uint32_t image_index,
+		const RecordOptions &options
+	) {
+		tramogi::graphics::FrameGraphDesc desc {
+			.swapchain_image = swapchain_images[image_index],
+			.depth_format = depth_format,
+			.extent = swapchain_extent,
+			.use_gpu_driven = options.use_gpu_driven,
+			.defragment = [this](const vk::raii::CommandBuffer &commands) {
+				defragmenter.record(commands);
+			},
+			.cull = [this](const vk::raii::CommandBuffer &commands) {
+				gpu_culler.record_cull(commands);
+			},
+			.rendering =
+				[this, image_index, options](
+					const vk::raii::CommandBuffer &commands,
+					vk::ImageView depth_view
+				) { record_rendering(commands, image_index, depth_view, options); },
+		};
+		if (gpu_culler.is_supported()) {
+			desc.cull_draws = gpu_culler.get_draw_buffer();
+			desc.cull_count = gpu_culler.get_count_buffer();
+		}
+		return desc;
+	}
+
+	// Declares the frame as render graph passes and lets the graph derive the barriers. The cull
+	// pass is culled by the graph unless the rendering pass draws its output.
+	void record_graph_frame(
+		const vk::raii::CommandBuffer &command_buffer,
+		uint32_t image_index,
+		const RecordOptions &options
+	) {
+		tramogi::graphics::declare_frame_graph(
+			render_graph,
+			get_frame_graph_desc(image_index, options)
 		);
-		transition_image_layout(
+
+		auto result = render_graph.compile();
+		if (!result) {
+			throw std::runtime_error(result.error());
+		}
+		render_graph.execute(command_buffer);
+
+		auto stats = render_graph.get_stats();
+		if (stats.transient_generation != render_graph_transient_generation) {
+			// Recorded command buffers reference the transient images that were replaced.
+			render_graph_transient_generation = stats.transient_generation;
+			++scene_generation;
+		}
+		graph_barriers[options.use_gpu_driven] = {
+			.batch_count = stats.barrier_batch_count,
+			.barrier_count = stats.image_barrier_count + stats.memory_barrier_count,
+		};
+	}
+
+	// The frame with barriers written by hand, kept to compare the render graph against.
+	void record_hand_written_frame(
+		const vk::raii::CommandBuffer &command_buffer,
+		uint32_t image_index,
+		const RecordOptions &options
+	) {
+		uint32_t barrier_count = tramogi::graphics::record_hand_written_frame(
+			command_buffer,
+			get_frame_graph_desc(image_index, options),
 			*depth_image,
-			vk::ImageLayout::eUndefined,
-			vk::ImageLayout::eDepthAttachmentOptimal,
-			vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
-			vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
-			vk::PipelineStageFlagBits2::eEarlyFragmentTests |
-				vk::PipelineStageFlagBits2::eLateFragmentTests,
-			vk::PipelineStageFlagBits2::eEarlyFragmentTests |
-				vk::PipelineStageFlagBits2::eLateFragmentTests,
-			vk::ImageAspectFlagBits::eDepth
+			*depth_image_view,
+			&gpu_profiler
 		);
+		hand_written_barriers[options.use_gpu_driven] = {
+			.batch_count = barrier_count,
+			.barrier_count = barrier_count,
+		};
+	}
 
+	void record_rendering(
+		const vk::raii::CommandBuffer &command_buffer,
+		uint32_t image_index,
+		vk::ImageView depth_view,
+		const RecordOptions &options
+	) {
 		vk::ClearValue clear_color = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
 		vk::ClearValue clear_depth = vk::ClearDepthStencilValue(1.0f, 0);
 		vk::RenderingAttachmentInfo attachment_info {
@@ -1149,7 +2135,7 @@ private:
 			.clearValue = clear_color,
 		};
 		vk::RenderingAttachmentInfo depth_attachment_info {
-			.imageView = depth_image_view,
+			.imageView = depth_view,
 			.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
 			.loadOp = vk::AttachmentLoadOp::eClear,
 			.storeOp = vk::AttachmentStoreOp::eDontCare,
@@ -1168,60 +2154,72 @@ private:
 			.pDepthAttachment = &depth_attachment_info,
 		};
 
-		command_buffers[current_frame].beginRendering(rendering_info);
-
-		command_buffers[current_frame].bindPipeline(
-			vk::PipelineBindPoint::eGraphics,
-			graphics_pipeline
-		);
-		command_buffers[current_frame].setViewport(
-			0,
-			vk::Viewport(0.0f, 0.0f, swapchain_extent.width, swapchain_extent.height, 0.0f, 1.0f)
-		);
-		command_buffers[current_frame].setScissor(
-			0,
-			vk::Rect2D(vk::Offset2D(0, 0), swapchain_extent)
-		);
-
-		command_buffers[current_frame].bindVertexBuffers(0, *vertex_buffer.get_buffer(), {0});
-		command_buffers[current_frame]
-			.bindIndexBuffer(*index_buffer.get_buffer(), 0, vk::IndexType::eUint32);
-
-		command_buffers[current_frame].bindDescriptorSets(
-			vk::PipelineBindPoint::eGraphics,
-			pipeline_layout,
-			0,
-			*descriptor_sets[current_frame],
-			nullptr
-		);
-
-		// command_buffers[current_frame].draw(3, 1, 1, 0);
-		command_buffers[current_frame].drawIndexed(model.get_indices().size(), 1, 0, 0, 0);
-		command_buffers[current_frame].endRendering();
-
-		transition_image_layout(
-			swapchain_images[image_index],
-			vk::ImageLayout::eColorAttachmentOptimal,
-			vk::ImageLayout::ePresentSrcKHR,
-			vk::AccessFlagBits2::eColorAttachmentWrite,
-			{},
-			vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-			vk::PipelineStageFlagBits2::eBottomOfPipe,
-			vk::ImageAspectFlagBits::eColor
-		);
+		if (options.use_parallel_recording) {
+			rendering_info.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
+		}
+		command_buffer.beginRendering(rendering_info);
+
+		uint32_t uniform_offset = options.uniform_offset;
+		bool use_bindless = options.use_bindless;
+		uint32_t draw_count = synthetic_draw_count + 1;
+		if (options.use_gpu_driven) {
+			record_object_draws(command_buffer, uniform_offset);
+		} else if (options.instancing != InstancingMode::Off) {
+			record_instance_draws(command_buffer, uniform_offset, options.instancing);
+		} else if (options.use_parallel_recording) {
+			std::array color_formats {swapchain_surface_format.format};
+			auto secondary_command_buffers = parallel_recorder.record(
+				draw_count,
+				{.color_formats = color_formats, .depth_format = depth_format},
+				[this, uniform_offset, use_bindless](
+					const vk::raii::CommandBuffer &secondary_command_buffer,
+					uint32_t begin,
+					uint32_t end
+				) {
+					record_draws(
+						secondary_command_buffer,
+						begin,
+						end,
+						uniform_offset,
+						use_bindless
+					);
+				}
+			);
+			command_buffer.executeCommands(secondary_command_buffers);
+		} else {
+			record_draws(command_buffer, 0, draw_count, uniform_offset, use_bindless);
+		}
 
-		command_buffers[current_frame].end();
+		command_buffer.endRendering();
 	}
 
 	void draw_frame(double delta) {
-		device.wait_idle(current_frame);
+		TRAMOGI_PROFILE_ZONE("draw_frame");
+
+		{
+			TRAMOGI_PROFILE_ZONE("wait_frame");
+			auto phase = measure_phase(FramePhase::Wait);
+			// Only the frame slot being reused; the other frames keep the GPU busy meanwhile.
+			device.wait_frame(current_frame);
+		}
+		frame_ring_buffer.begin_frame(current_frame);
+		descriptor_allocator.begin_frame(current_frame);
+		defragmenter.begin_frame(current_frame);
+		gpu_profiler.begin_frame(current_frame);
+		parallel_recorder.begin_frame(current_frame);
+		gpu_culler.begin_frame(current_frame);
+		render_graph.begin_frame(current_frame);
 
 		try {
-			auto [result, image_index] = swapchain.acquireNextImage(
-				UINT64_MAX,
-				*device.get_present_semaphore(current_frame),
-				nullptr
-			);
+			auto [result, image_index] = [this]() {
+				TRAMOGI_PROFILE_ZONE("acquireNextImage");
+				auto phase = measure_phase(FramePhase::Acquire);
+				return swapchain.acquireNextImage(
+					UINT64_MAX,
+					*device.get_present_semaphore(current_frame),
+					nullptr
+				);
+			}();
 
 			if (result == vk::Result::eErrorOutOfDateKHR) {
 				recreate_swapchain();
@@ -1232,36 +2230,54 @@ private:
 				throw std::runtime_error("Failed to acquire swapchain image");
 			}
 
-			command_buffers[current_frame].reset();
-			record_command_buffer(image_index);
-			device.reset_fence(current_frame);
+			uint32_t uniform_offset = 0;
+			{
+				auto phase = measure_phase(FramePhase::UpdateUniforms);
+				uniform_offset = update_uniform_buffer(delta);
+				frame_ring_buffer.flush();
+				instance_batch.upload(current_frame);
+			}
 
-			update_uniform_buffer(current_frame, delta);
+			vk::CommandBuffer command_buffer;
+			{
+				auto phase = measure_phase(FramePhase::Record);
+				command_buffer = get_frame_command_buffer(image_index, uniform_offset);
+			}
 
-			vk::PipelineStageFlags wait_destination_stage_mask(
-				vk::PipelineStageFlagBits::eColorAttachmentOutput
-			);
-			const vk::SubmitInfo submit_info {
-				.waitSemaphoreCount = 1,
-				.pWaitSemaphores = &*device.get_present_semaphore(current_frame),
-				.pWaitDstStageMask = &wait_destination_stage_mask,
-				.commandBufferCount = 1,
-				.pCommandBuffers = &*command_buffers[current_frame],
-				.signalSemaphoreCount = 1,
-				.pSignalSemaphores = &*device.get_render_semaphore(current_frame),
+			vk::SemaphoreSubmitInfo wait_semaphore {
+				.semaphore = device.get_present_semaphore(current_frame),
+				.stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+			};
+			vk::SemaphoreSubmitInfo signal_semaphore {
+				.semaphore = device.get_render_semaphore(image_index),
+				.stageMask = vk::PipelineStageFlagBits2::eAllCommands,
 			};
 
-			device.submit_graphics(submit_info, current_frame, true);
+			{
+				auto phase = measure_phase(FramePhase::Submit);
+				device.submit_frame(
+					current_frame,
+					{
+						.command_buffers = {&command_buffer, 1},
+						.wait_semaphores = {&wait_semaphore, 1},
+						.signal_semaphores = {&signal_semaphore, 1},
+					}
+				);
+			}
 
 			vk::PresentInfoKHR present_info {
 				.waitSemaphoreCount = 1,
-				.pWaitSemaphores = &*device.get_render_semaphore(current_frame),
+				.pWaitSemaphores = &*device.get_render_semaphore(image_index),
 				.swapchainCount = 1,
 				.pSwapchains = &*swapchain,
 				.pImageIndices = &image_index,
 			};
 
-			auto present_result = device.present(present_info);
+			Result<> present_result;
+			{
+				auto phase = measure_phase(FramePhase::Present);
+				present_result = device.present(present_info);
+			}
 			if (!present_result || window.resized) {
 				window.resized = false;
 				recreate_swapchain();
@@ -1277,10 +2293,13 @@ private:
 			}
 		}
 
-		current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+		current_frame = (current_frame + 1) % frames_in_flight;
 	}
 
-	void update_uniform_buffer(uint32_t current_image, double delta) {
+	// Writes this frame's uniforms to the ring buffer and returns their dynamic offset.
+	uint32_t update_uniform_buffer(double delta) {
+		TRAMOGI_PROFILE_ZONE("update_uniform_buffer");
+
 		static glm::mat4 pos(1.0f);
 		static auto start_time = std::chrono::high_resolution_clock::now();
 
@@ -1324,7 +2343,17 @@ private:
 		);
 		ubo.projection[1][1] *= -1;
 
-		uniform_buffers[current_image].upload_data(&ubo);
+		// The objects are placed in the space of the model matrix, so it is folded into the planes.
+		glm::mat4 object_to_clip = ubo.projection * ubo.view * ubo.model;
+		camera_frustum = tramogi::graphics::extract_frustum(
+			std::span<const float, 16>(&object_to_clip[0][0], 16)
+		);
+
+		auto allocation = frame_ring_buffer.push_uniform(ubo);
+		if (!allocation) {
+			throw std::runtime_error("Frame ring buffer exhausted");
+		}
+		return static_cast<uint32_t>(allocation->offset);
 	}
 
 	void cleanup_swapchain() {
@@ -1339,19 +2368,23 @@ private:
 			window.wait_events();
 		}
 
-		device.wait_idle(current_frame);
+		device.wait_idle();
 
 		cleanup_swapchain();
+		render_graph.release_transients();
 
 		create_swapchain();
 		create_image_views();
 		create_depth_resources();
+		// They reference the old images, and the image count may have changed.
+		create_cached_command_buffers();
 
 		debug_log("Swapchain resized to {}x{}", dimension.width, dimension.height);
 	}
 };
 
 int main() {
+	TRAMOGI_PROFILE_THREAD("main");
 	debug_log("Running in DEBUG mode");
 
 	ProjectSkyHigh skyhigh;
@@ -1366,6 +2399,22 @@ int main() {
 		return EXIT_FAILURE;
 	}
 
+	if constexpr (profiling::enable_profiling) {
+		debug_log("Profiler zone overhead: {:.1f}ns", profiling::measure_zone_overhead());
+		auto trace_result = profiling::write_chrome_trace("trace.json");
+		if (!trace_result) {
+			std::println(stderr, "Error: {}", trace_result.error());
+		}
+		if (uint64_t dropped_count = profiling::get_dropped_zone_count(); dropped_count > 0) {
+			TRAMOGI_LOG_WARNING(
+				General,
+				"Profiler dropped {} zones past {} per thread",
+				dropped_count,
+				profiling::default_max_zones_per_thread
+			);
+		}
+	}
+
 	debug_log("Exited successfully");
 	return EXIT_SUCCESS;
 }
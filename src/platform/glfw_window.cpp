@@ -14,7 +14,6 @@ namespace tramogi::platform {
 
 using core::Error;
 using core::Result;
-using core::logging::debug_log;
 
 bool Window::init(uint32_t width, uint32_t height, const char *title) {
 	// TODO: Check if llibdecor issue is solved. See: https://github.com/glfw/glfw/issues/2789
@@ -91,7 +90,7 @@ void Window::resize_callback(
 ) {
 	auto instance = reinterpret_cast<Window *>(glfwGetWindowUserPointer(window));
 	instance->resized = true;
-	debug_log("Window resized to {}x{}", width, height);
+	TRAMOGI_LOG_DEBUG(Platform, "Window resized to {}x{}", width, height);
 }
 
 } // namespace tramogi::platform
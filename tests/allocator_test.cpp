@@ -0,0 +1,94 @@
+#include "graphics/allocator.h"
+#include "memory_properties.h"
+#include "test.h"
+#include <cstdint>
+#include <vulkan/vulkan.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+using graphics::MemoryType;
+
+constexpr uint32_t all_memory_types = ~0u;
+
+uint32_t select(
+	const vk::PhysicalDeviceMemoryProperties &memory_properties,
+	uint32_t memory_type_bits,
+	MemoryType memory_type
+) {
+	auto index = graphics::select_memory_type(memory_properties, memory_type_bits, memory_type);
+	if (!index) {
+		fail(__FILE__, __LINE__, index.error());
+	}
+	return index.value();
+}
+
+} // namespace
+
+TRAMOGI_TEST(allocator_selects_desktop_memory_types) {
+	vk::PhysicalDeviceMemoryProperties memory_properties = get_desktop_memory_properties();
+	TRAMOGI_CHECK_EQ(select(memory_properties, all_memory_types, MemoryType::Gpu), 0);
+	TRAMOGI_CHECK_EQ(select(memory_properties, all_memory_types, MemoryType::Host), 1);
+	// No lazily allocated memory, plain device local memory instead.
+	TRAMOGI_CHECK_EQ(select(memory_properties, all_memory_types, MemoryType::Lazy), 0);
+
+	// Coherent memory is preferred but not required.
+	TRAMOGI_CHECK_EQ(select(memory_properties, 1u << 2, MemoryType::Host), 2);
+	TRAMOGI_CHECK_EQ(select(memory_properties, 1u << 2 | 1u << 3, MemoryType::Host), 3);
+	TRAMOGI_CHECK_EQ(select(memory_properties, 1u << 3, MemoryType::Gpu), 3);
+}
+
+TRAMOGI_TEST(allocator_selects_tiler_memory_types) {
+	vk::PhysicalDeviceMemoryProperties memory_properties = get_tiler_memory_properties();
+	TRAMOGI_CHECK_EQ(select(memory_properties, all_memory_types, MemoryType::Gpu), 0);
+	TRAMOGI_CHECK_EQ(select(memory_properties, all_memory_types, MemoryType::Host), 2);
+	TRAMOGI_CHECK_EQ(select(memory_properties, all_memory_types, MemoryType::Lazy), 1);
+	TRAMOGI_CHECK_EQ(select(memory_properties, 1u << 0 | 1u << 2, MemoryType::Lazy), 0);
+}
+
+TRAMOGI_TEST(allocator_fails_without_a_matching_memory_type) {
+	vk::PhysicalDeviceMemoryProperties memory_properties = get_desktop_memory_properties();
+	TRAMOGI_CHECK(!graphics::select_memory_type(memory_properties, 1u << 1, MemoryType::Gpu));
+	TRAMOGI_CHECK(!graphics::select_memory_type(memory_properties, 1u << 0, MemoryType::Host));
+	TRAMOGI_CHECK(!graphics::select_memory_type(memory_properties, 0, MemoryType::Gpu));
+	// Past the memory types of the device.
+	TRAMOGI_CHECK(!graphics::select_memory_type(memory_properties, 1u << 4, MemoryType::Gpu));
+}
+
+TRAMOGI_TEST(allocator_shrinks_blocks_of_small_heaps) {
+	uint64_t block_size = graphics::DeviceMemoryAllocator::default_block_size;
+	TRAMOGI_CHECK_EQ(graphics::get_block_size(8 * gib, block_size), block_size);
+	// A 256 MiB BAR heap gets blocks of an eighth of it.
+	TRAMOGI_CHECK_EQ(graphics::get_block_size(gib / 4, block_size), gib / 32);
+	// Still aligned for any resource.
+	TRAMOGI_CHECK_EQ(graphics::get_block_size(1000, block_size), 256);
+}
+
+TRAMOGI_TEST(allocator_rounds_non_coherent_allocations_to_atoms) {
+	vk::PhysicalDeviceMemoryProperties memory_properties = get_desktop_memory_properties();
+	vk::MemoryRequirements requirements {.size = 100, .alignment = 16, .memoryTypeBits = ~0u};
+	auto get_requirements = [&](uint32_t memory_type_index) {
+		return graphics::get_allocation_requirements(
+			requirements,
+			memory_properties.memoryTypes[memory_type_index].propertyFlags,
+			64
+		);
+	};
+
+	// Host visible and cached, but not coherent.
+	vk::MemoryRequirements non_coherent = get_requirements(2);
+	TRAMOGI_CHECK_EQ(non_coherent.size, 128);
+	TRAMOGI_CHECK_EQ(non_coherent.alignment, 64);
+	// Coherent and device local memory are never flushed.
+	for (uint32_t memory_type_index : {0u, 1u, 3u}) {
+		vk::MemoryRequirements unchanged = get_requirements(memory_type_index);
+		TRAMOGI_CHECK_EQ(unchanged.size, 100);
+		TRAMOGI_CHECK_EQ(unchanged.alignment, 16);
+	}
+	// Stricter alignments are kept.
+	requirements.alignment = 256;
+	TRAMOGI_CHECK_EQ(get_requirements(2).alignment, 256);
+}
+
+} // namespace tramogi::test
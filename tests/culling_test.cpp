@@ -0,0 +1,216 @@
+#include "gpu_context.h"
+#include "graphics/gpu_culler.h"
+#include "test.h"
+#include "tramogi/graphics/buffer.h"
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+using graphics::CullObject;
+using graphics::Frustum;
+
+using Matrix = std::array<float, 16>;
+
+constexpr Matrix identity = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+// Right-handed, looking down -z, with a [0, 1] depth range and a 90 degree field of view.
+Matrix perspective(float near, float far) {
+	Matrix matrix {};
+	matrix[0] = 1.0f;
+	matrix[5] = 1.0f;
+	matrix[10] = far / (near - far);
+	matrix[11] = -1.0f;
+	matrix[14] = near * far / (near - far);
+	return matrix;
+}
+
+CullObject make_object(float x, float y, float z, float radius, float scale_y = 1.0f) {
+	CullObject object {};
+	object.model = identity;
+	object.model[5] = scale_y;
+	object.model[12] = x;
+	object.model[13] = y;
+	object.model[14] = z;
+	object.bounds = {0.0f, 0.0f, 0.0f, radius};
+	return object;
+}
+
+bool is_near(const std::array<float, 4> &plane, const std::array<float, 4> &expected) {
+	for (uint32_t i = 0; i < 4; ++i) {
+		if (std::abs(plane[i] - expected[i]) > 1e-5f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+TRAMOGI_TEST(culling_extracts_normalized_planes) {
+	// Clip space itself: x and y in [-1, 1], depth in [0, 1].
+	Frustum frustum = graphics::extract_frustum(identity);
+	TRAMOGI_CHECK(is_near(frustum[0], {1, 0, 0, 1}));
+	TRAMOGI_CHECK(is_near(frustum[1], {-1, 0, 0, 1}));
+	TRAMOGI_CHECK(is_near(frustum[2], {0, 1, 0, 1}));
+	TRAMOGI_CHECK(is_near(frustum[3], {0, -1, 0, 1}));
+	TRAMOGI_CHECK(is_near(frustum[4], {0, 0, 1, 0}));
+	TRAMOGI_CHECK(is_near(frustum[5], {0, 0, -1, 1}));
+
+	frustum = graphics::extract_frustum(perspective(1.0f, 10.0f));
+	float side = 1.0f / std::sqrt(2.0f);
+	TRAMOGI_CHECK(is_near(frustum[0], {side, 0, -side, 0}));
+	TRAMOGI_CHECK(is_near(frustum[1], {-side, 0, -side, 0}));
+	TRAMOGI_CHECK(is_near(frustum[4], {0, 0, -1, -1}));
+	TRAMOGI_CHECK(is_near(frustum[5], {0, 0, 1, 10}));
+}
+
+TRAMOGI_TEST(culling_keeps_inside_and_straddling_objects) {
+	Frustum frustum = graphics::extract_frustum(identity);
+	TRAMOGI_CHECK(graphics::is_visible(make_object(0.0f, 0.0f, 0.5f, 0.1f), frustum));
+	TRAMOGI_CHECK(graphics::is_visible(make_object(-0.5f, 0.5f, 0.5f, 0.4f), frustum));
+	// Centers outside, spheres across the right and top planes.
+	TRAMOGI_CHECK(graphics::is_visible(make_object(1.15f, 0.0f, 0.5f, 0.2f), frustum));
+	TRAMOGI_CHECK(graphics::is_visible(make_object(0.0f, 1.15f, 0.5f, 0.2f), frustum));
+	// Conservative near corners: within the radius of both planes, though not of the corner.
+	TRAMOGI_CHECK(graphics::is_visible(make_object(1.15f, 1.15f, 0.5f, 0.2f), frustum));
+	// Bigger than the whole frustum.
+	TRAMOGI_CHECK(graphics::is_visible(make_object(0.0f, 0.0f, 0.5f, 10.0f), frustum));
+}
+
+TRAMOGI_TEST(culling_rejects_outside_objects) {
+	Frustum frustum = graphics::extract_frustum(identity);
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(3.0f, 0.0f, 0.5f, 0.5f), frustum));
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(0.0f, -3.0f, 0.5f, 0.5f), frustum));
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(1.25f, 0.0f, 0.5f, 0.2f), frustum));
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(1.3f, 1.3f, 0.5f, 0.2f), frustum));
+}
+
+TRAMOGI_TEST(culling_scales_the_radius_by_the_largest_axis) {
+	Frustum frustum = graphics::extract_frustum(identity);
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(1.5f, 0.0f, 0.5f, 0.1f), frustum));
+	// Stretched along y only, yet its sphere grows in x too, so it stays conservative.
+	TRAMOGI_CHECK(graphics::is_visible(make_object(1.5f, 0.0f, 0.5f, 0.1f, 10.0f), frustum));
+
+	// The bounds center is transformed along with the radius.
+	CullObject object = make_object(0.0f, 0.0f, 0.5f, 0.1f, 4.0f);
+	object.bounds = {0.0f, 0.5f, 0.0f, 0.1f};
+	TRAMOGI_CHECK(!graphics::is_visible(object, frustum));
+	// At 1.2, across the top plane with the scaled radius.
+	object.bounds = {0.0f, 0.3f, 0.0f, 0.1f};
+	TRAMOGI_CHECK(graphics::is_visible(object, frustum));
+}
+
+TRAMOGI_TEST(culling_uses_a_zero_to_one_depth_range) {
+	Frustum frustum = graphics::extract_frustum(identity);
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(0.0f, 0.0f, -0.5f, 0.1f), frustum));
+	TRAMOGI_CHECK(graphics::is_visible(make_object(0.0f, 0.0f, -0.05f, 0.1f), frustum));
+	TRAMOGI_CHECK(graphics::is_visible(make_object(0.0f, 0.0f, 1.05f, 0.1f), frustum));
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(0.0f, 0.0f, 1.5f, 0.1f), frustum));
+
+	// Near at 1 and far at 10 along -z.
+	frustum = graphics::extract_frustum(perspective(1.0f, 10.0f));
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(0.0f, 0.0f, -0.5f, 0.1f), frustum));
+	TRAMOGI_CHECK(graphics::is_visible(make_object(0.0f, 0.0f, -1.05f, 0.1f), frustum));
+	TRAMOGI_CHECK(graphics::is_visible(make_object(0.0f, 0.0f, -5.0f, 0.1f), frustum));
+	TRAMOGI_CHECK(graphics::is_visible(make_object(0.0f, 0.0f, -10.05f, 0.1f), frustum));
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(0.0f, 0.0f, -10.5f, 0.1f), frustum));
+	// Behind the camera.
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(0.0f, 0.0f, 5.0f, 0.1f), frustum));
+	// Inside at this depth, outside closer to the camera where the frustum is narrower.
+	TRAMOGI_CHECK(graphics::is_visible(make_object(4.0f, 0.0f, -5.0f, 0.1f), frustum));
+	TRAMOGI_CHECK(!graphics::is_visible(make_object(4.0f, 0.0f, -2.0f, 0.1f), frustum));
+}
+
+TRAMOGI_TEST(culling_returns_visible_indices_in_order) {
+	Frustum frustum = graphics::extract_frustum(identity);
+	std::vector<CullObject> objects = {
+		make_object(0.0f, 0.0f, 0.5f, 0.1f),
+		make_object(3.0f, 0.0f, 0.5f, 0.1f),
+		make_object(1.05f, 0.0f, 0.5f, 0.1f),
+		make_object(0.0f, 0.0f, 2.0f, 0.1f),
+		make_object(-0.9f, -0.9f, 0.9f, 0.1f),
+	};
+	std::vector<uint32_t> visible = graphics::cull_objects(objects, frustum);
+	TRAMOGI_CHECK(visible == std::vector<uint32_t>({0, 2, 4}));
+	TRAMOGI_CHECK(graphics::cull_objects({}, frustum).empty());
+}
+
+TRAMOGI_TEST(culling_on_the_gpu_matches_the_cpu_reference) {
+	auto context = create_gpu_context({.frame_count = 1});
+	vk::raii::ShaderModule shader_module = context->create_shader_module();
+
+	// A grid reaching past every plane of clip space. The centers are 1/30 away from a multiple of
+	// 0.1 and the radii are 0.05 or 0.1, so no sphere touches a plane and rounding cannot flip a
+	// result.
+	std::vector<CullObject> objects;
+	for (uint32_t z = 0; z < 5; ++z) {
+		for (uint32_t y = 0; y < 40; ++y) {
+			for (uint32_t x = 0; x < 40; ++x) {
+				// Every third object stretched, for a scaled radius.
+				objects.push_back(make_object(
+					-2.0f + 0.1f * static_cast<float>(x) + 1.0f / 30.0f,
+					-2.0f + 0.1f * static_cast<float>(y) + 1.0f / 30.0f,
+					-0.5f + 0.4f * static_cast<float>(z) + 1.0f / 30.0f,
+					0.05f,
+					objects.size() % 3 == 0 ? 2.0f : 1.0f
+				));
+			}
+		}
+	}
+	Frustum frustum = graphics::extract_frustum(identity);
+	std::vector<uint32_t> expected = graphics::cull_objects(objects, frustum);
+	TRAMOGI_CHECK(!expected.empty());
+	TRAMOGI_CHECK(expected.size() < objects.size());
+
+	graphics::StorageBuffer object_buffer;
+	auto result = object_buffer.init(context->device, objects.size() * sizeof(CullObject));
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+	context->write_buffer(object_buffer, std::as_bytes(std::span(objects)));
+
+	graphics::GpuCuller culler;
+	result = culler.init(
+		context->device,
+		context->pipeline_cache,
+		shader_module,
+		objects,
+		object_buffer.get_buffer(),
+		1
+	);
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+	if (!culler.is_supported()) {
+		skip("No indirect count draws");
+	}
+
+	culler.begin_frame(0);
+	culler.update(frustum);
+	culler.request_validation();
+	context->submit_and_wait(
+		graphics::QueueType::Graphics,
+		[&culler](const vk::raii::CommandBuffer &command_buffer) {
+			culler.record_cull(command_buffer);
+		}
+	);
+	// Reads back the draws and compares them against `cull_objects`.
+	culler.begin_frame(0);
+
+	graphics::GpuCullerStats stats = culler.get_stats();
+	TRAMOGI_CHECK_EQ(stats.object_count, objects.size());
+	TRAMOGI_CHECK_EQ(stats.dispatch_count, 1);
+	TRAMOGI_CHECK_EQ(stats.validation_count, 1);
+	TRAMOGI_CHECK_EQ(stats.validation_failure_count, 0);
+	TRAMOGI_CHECK_EQ(stats.last_visible_count, expected.size());
+}
+
+} // namespace tramogi::test
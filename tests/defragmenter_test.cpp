@@ -0,0 +1,122 @@
+#include "gpu_context.h"
+#include "graphics/defragmenter.h"
+#include "test.h"
+#include "tramogi/graphics/buffer.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+using graphics::Defragmenter;
+using graphics::StorageBuffer;
+
+constexpr uint32_t frame_count = 2;
+constexpr uint32_t word_count = 64 * 1024;
+
+std::vector<uint32_t> create_words(uint32_t first) {
+	std::vector<uint32_t> words(word_count);
+	std::iota(words.begin(), words.end(), first);
+	return words;
+}
+
+void init_buffer(GpuContext &context, StorageBuffer &buffer, const std::vector<uint32_t> &words) {
+	auto result = buffer.init(context.device, words.size() * sizeof(uint32_t));
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+	context.write_buffer(buffer, std::as_bytes(std::span(words)));
+}
+
+bool has_words(GpuContext &context, StorageBuffer &buffer, const std::vector<uint32_t> &words) {
+	std::vector<std::byte> data = context.read_buffer(buffer);
+	return std::ranges::equal(data, std::as_bytes(std::span(words)));
+}
+
+// Like the frame loop, where each frame index is waited for before it is reused.
+void run_frame(GpuContext &context, Defragmenter &defragmenter, uint32_t frame) {
+	defragmenter.begin_frame(frame % frame_count);
+	context.submit_and_wait(
+		graphics::QueueType::Graphics,
+		[&defragmenter](const vk::raii::CommandBuffer &commands) {
+			defragmenter.record(commands);
+		}
+	);
+}
+
+} // namespace
+
+TRAMOGI_TEST(defragmenter_moves_buffers_with_their_contents) {
+	auto context = create_gpu_context({.frame_count = frame_count});
+	std::vector<uint32_t> first_words = create_words(0);
+	std::vector<uint32_t> second_words = create_words(word_count);
+	StorageBuffer first_buffer;
+	StorageBuffer second_buffer;
+	init_buffer(*context, first_buffer, first_words);
+	init_buffer(*context, second_buffer, second_words);
+
+	Defragmenter defragmenter;
+	defragmenter.init(context->device, frame_count);
+	std::vector<graphics::Buffer *> moved_buffers;
+	defragmenter.set_move_callback([&moved_buffers](graphics::Buffer &buffer) {
+		moved_buffers.push_back(&buffer);
+	});
+	defragmenter.add(first_buffer);
+	defragmenter.add(second_buffer);
+
+	// Everything is sparse in blocks much bigger than the buffers.
+	defragmenter.start(1.0f);
+	TRAMOGI_CHECK(defragmenter.is_running());
+	for (uint32_t frame = 0; frame < 16 && defragmenter.is_running(); ++frame) {
+		run_frame(*context, defragmenter, frame);
+	}
+	TRAMOGI_CHECK(!defragmenter.is_running());
+
+	TRAMOGI_CHECK_EQ(defragmenter.get_stats().moved_buffer_count, 2);
+	TRAMOGI_CHECK_EQ(moved_buffers.size(), 2);
+	TRAMOGI_CHECK(has_words(*context, first_buffer, first_words));
+	TRAMOGI_CHECK(has_words(*context, second_buffer, second_words));
+
+	defragmenter.remove(first_buffer);
+	defragmenter.remove(second_buffer);
+}
+
+TRAMOGI_TEST(defragmenter_keeps_writes_made_while_removed) {
+	auto context = create_gpu_context({.frame_count = frame_count});
+	StorageBuffer buffer;
+	init_buffer(*context, buffer, create_words(0));
+
+	Defragmenter defragmenter;
+	defragmenter.init(context->device, frame_count);
+	defragmenter.add(buffer);
+	defragmenter.start(1.0f);
+
+	// Copied but not swapped yet.
+	run_frame(*context, defragmenter, 0);
+	TRAMOGI_CHECK(defragmenter.is_running());
+	TRAMOGI_CHECK_EQ(defragmenter.get_stats().moved_buffer_count, 0);
+
+	// Cancels the pending move, so the write lands in the buffer that stays.
+	defragmenter.remove(buffer);
+	std::vector<uint32_t> words = create_words(word_count);
+	context->write_buffer(buffer, std::as_bytes(std::span(words)));
+	defragmenter.add(buffer);
+
+	for (uint32_t frame = 1; frame < 16 && defragmenter.is_running(); ++frame) {
+		run_frame(*context, defragmenter, frame);
+	}
+	TRAMOGI_CHECK(!defragmenter.is_running());
+	TRAMOGI_CHECK_EQ(defragmenter.get_stats().moved_buffer_count, 1);
+	TRAMOGI_CHECK(has_words(*context, buffer, words));
+
+	defragmenter.remove(buffer);
+}
+
+} // namespace tramogi::test
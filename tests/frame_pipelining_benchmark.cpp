@@ -0,0 +1,112 @@
+#include "gpu_context.h"
+#include "test.h"
+#include "tramogi/core/profiling/profiler.h"
+#include "tramogi/graphics/buffer.h"
+#include <cstdint>
+#include <format>
+#include <initializer_list>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+using graphics::StorageBuffer;
+
+constexpr uint32_t frame_total = 200;
+// Recording and simulation on the CPU, and rendering on the GPU, of comparable lengths so that
+// overlapping them roughly halves the frame time.
+constexpr uint64_t cpu_work_ns = 2'000'000;
+constexpr uint64_t copy_size = 32ull * 1024 * 1024;
+
+void spin(uint64_t duration_ns) {
+	uint64_t end_ns = core::profiling::now_ns() + duration_ns;
+	while (core::profiling::now_ns() < end_ns) {
+	}
+}
+
+enum class FrameWait {
+	// The device is idle before every frame, which serializes the CPU and the GPU.
+	Idle,
+	// Only the frame slot about to be reused is waited for.
+	Frame,
+	// Only the GPU work, waited for right after each submission.
+	GpuOnly,
+};
+
+double measure_ms_per_frame(uint32_t frame_count, FrameWait frame_wait) {
+	auto context = create_gpu_context({.frame_count = frame_count});
+	graphics::Device &device = context->device;
+	StorageBuffer source;
+	StorageBuffer destination;
+	for (StorageBuffer *buffer : {&source, &destination}) {
+		auto result = buffer->init(device, copy_size);
+		if (!result) {
+			fail(__FILE__, __LINE__, result.error());
+		}
+	}
+
+	vk::CommandPoolCreateInfo pool_info {
+		.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		.queueFamilyIndex = context->physical_device.get_graphics_queue_index(),
+	};
+	vk::raii::CommandPool command_pool(device.get_device(), pool_info);
+	vk::CommandBufferAllocateInfo allocate_info {
+		.commandPool = command_pool,
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = frame_count,
+	};
+	vk::raii::CommandBuffers command_buffers(device.get_device(), allocate_info);
+
+	uint64_t begin_ns = core::profiling::now_ns();
+	for (uint32_t frame = 0; frame < frame_total; ++frame) {
+		uint32_t frame_index = frame % frame_count;
+		if (frame_wait == FrameWait::Idle) {
+			device.wait_idle();
+		} else {
+			device.wait_frame(frame_index);
+		}
+		if (frame_wait != FrameWait::GpuOnly) {
+			spin(cpu_work_ns);
+		}
+
+		const vk::raii::CommandBuffer &command_buffer = command_buffers[frame_index];
+		command_buffer.reset();
+		command_buffer.begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+		command_buffer.copyBuffer(
+			source.get_buffer(),
+			destination.get_buffer(),
+			vk::BufferCopy {.srcOffset = 0, .dstOffset = 0, .size = copy_size}
+		);
+		command_buffer.end();
+
+		vk::CommandBuffer submitted = command_buffer;
+		graphics::TimelinePoint point =
+			device.submit_frame(frame_index, {.command_buffers = {&submitted, 1}});
+		if (frame_wait == FrameWait::GpuOnly) {
+			device.wait(point);
+		}
+	}
+	device.wait_idle();
+
+	return static_cast<double>(core::profiling::now_ns() - begin_ns) / frame_total / 1e6;
+}
+
+} // namespace
+
+// Frames of a fixed CPU and GPU cost, waiting on an idle device against waiting on the frame slot.
+TRAMOGI_TEST(frame_pipelining) {
+	report("cpu work", static_cast<double>(cpu_work_ns) / 1e6, "ms/frame");
+	report("gpu work", measure_ms_per_frame(1, FrameWait::GpuOnly), "ms/frame");
+	report("wait_idle", measure_ms_per_frame(2, FrameWait::Idle), "ms/frame");
+	for (uint32_t frame_count = 1; frame_count <= 3; ++frame_count) {
+		report(
+			std::format("wait_frame, {} frames in flight", frame_count).c_str(),
+			measure_ms_per_frame(frame_count, FrameWait::Frame),
+			"ms/frame"
+		);
+	}
+}
+
+} // namespace tramogi::test
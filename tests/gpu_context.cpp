@@ -0,0 +1,126 @@
+#include "gpu_context.h"
+#include "test.h"
+#include "tramogi/core/io/file.h"
+#include "tramogi/graphics/buffer.h"
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+void GpuContext::submit_and_wait(
+	graphics::QueueType queue,
+	const std::function<void(const vk::raii::CommandBuffer &)> &record
+) {
+	const vk::raii::Device &vk_device = device.get_device();
+	vk::CommandPoolCreateInfo pool_info {
+		.flags = vk::CommandPoolCreateFlagBits::eTransient,
+		.queueFamilyIndex = queue == graphics::QueueType::Transfer
+								? physical_device.get_transfer_queue_index()
+								: physical_device.get_graphics_queue_index(),
+	};
+	vk::raii::CommandPool command_pool(vk_device, pool_info);
+	vk::CommandBufferAllocateInfo allocate_info {
+		.commandPool = command_pool,
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = 1,
+	};
+	vk::raii::CommandBuffer command_buffer =
+		std::move(vk::raii::CommandBuffers(vk_device, allocate_info).front());
+
+	command_buffer.begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+	record(command_buffer);
+	command_buffer.end();
+
+	vk::CommandBuffer command_buffers[] = {command_buffer};
+	device.wait(device.submit(queue, {.command_buffers = command_buffers}));
+}
+
+void GpuContext::write_buffer(graphics::Buffer &buffer, std::span<const std::byte> data) {
+	graphics::StagingBuffer staging_buffer;
+	auto result = staging_buffer.init(device, data.size());
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+	staging_buffer.write(0, data);
+
+	submit_and_wait(graphics::QueueType::Graphics, [&](const vk::raii::CommandBuffer &commands) {
+		commands.copyBuffer(
+			staging_buffer.get_buffer(),
+			buffer.get_buffer(),
+			vk::BufferCopy {.srcOffset = 0, .dstOffset = 0, .size = data.size()}
+		);
+	});
+}
+
+std::vector<std::byte> GpuContext::read_buffer(graphics::Buffer &buffer) {
+	graphics::ReadbackBuffer readback_buffer;
+	auto result = readback_buffer.init(device, buffer.get_size());
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+
+	submit_and_wait(graphics::QueueType::Graphics, [&](const vk::raii::CommandBuffer &commands) {
+		commands.copyBuffer(
+			buffer.get_buffer(),
+			readback_buffer.get_buffer(),
+			vk::BufferCopy {.srcOffset = 0, .dstOffset = 0, .size = buffer.get_size()}
+		);
+	});
+
+	readback_buffer.invalidate(0, buffer.get_size());
+	std::vector<std::byte> data(buffer.get_size());
+	std::memcpy(data.data(), readback_buffer.get_mapped_memory(), data.size());
+	return data;
+}
+
+vk::raii::ShaderModule GpuContext::create_shader_module() const {
+	auto shader_code = core::read_shader_file(TRAMOGI_SHADER_PATH);
+	if (!shader_code) {
+		skip("No compiled shaders: " + shader_code.error());
+	}
+	vk::ShaderModuleCreateInfo create_info {
+		.codeSize = shader_code->size(),
+		.pCode = reinterpret_cast<const uint32_t *>(shader_code->data()),
+	};
+	return vk::raii::ShaderModule(device.get_device(), create_info);
+}
+
+std::unique_ptr<GpuContext> create_gpu_context(const GpuContextOptions &options) {
+	std::unique_ptr<GpuContext> context;
+	std::string error;
+	try {
+		context = std::make_unique<GpuContext>();
+		auto result = context->instance.init({});
+		if (result) {
+			result = context->physical_device.init_headless(context->instance);
+		}
+		if (!result) {
+			error = result.error();
+		} else {
+			if (options.disable_dedicated_transfer_queue) {
+				context->physical_device.disable_dedicated_transfer_queue();
+			}
+			context->device.init(context->instance, options.frame_count);
+			context->pipeline_cache.init(context->device, {});
+		}
+	} catch (const std::exception &exception) {
+		// Thrown without a Vulkan loader or driver.
+		error = exception.what();
+	}
+
+	if (!error.empty()) {
+		skip("No Vulkan device: " + error);
+	}
+	return context;
+}
+
+} // namespace tramogi::test
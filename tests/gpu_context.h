@@ -0,0 +1,58 @@
+#pragma once
+
+#include "graphics/device.h"
+#include "graphics/instance.h"
+#include "graphics/physical_device.h"
+#include "graphics/pipeline_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace vk::raii {
+class CommandBuffer;
+class ShaderModule;
+} // namespace vk::raii
+
+namespace tramogi::graphics {
+class Buffer;
+} // namespace tramogi::graphics
+
+namespace tramogi::test {
+
+struct GpuContextOptions {
+	uint32_t frame_count = graphics::Device::default_frame_count;
+	// See PhysicalDevice::disable_dedicated_transfer_queue.
+	bool disable_dedicated_transfer_queue = false;
+};
+
+// A device without a window, on whatever Vulkan implementation is installed. Lavapipe is enough
+// for every case that uses one.
+struct GpuContext {
+	graphics::Instance instance;
+	graphics::PhysicalDevice physical_device;
+	graphics::Device device {physical_device};
+	// Starts empty and is never saved, so that runs do not depend on each other.
+	graphics::PipelineCache pipeline_cache;
+
+	// Records into a one time command buffer, submits it and waits for it to complete.
+	void submit_and_wait(
+		graphics::QueueType queue,
+		const std::function<void(const vk::raii::CommandBuffer &)> &record
+	);
+
+	// Through a staging buffer on the graphics queue, so that `buffer` only needs transfer
+	// destination or source usage.
+	void write_buffer(graphics::Buffer &buffer, std::span<const std::byte> data);
+	std::vector<std::byte> read_buffer(graphics::Buffer &buffer);
+
+	// Of the demo's shaders. Skips the running case when they have not been compiled.
+	vk::raii::ShaderModule create_shader_module() const;
+};
+
+// Skips the running case when there is no Vulkan device to create it on.
+std::unique_ptr<GpuContext> create_gpu_context(const GpuContextOptions &options = {});
+
+} // namespace tramogi::test
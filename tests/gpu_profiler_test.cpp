@@ -0,0 +1,49 @@
+#include "gpu_context.h"
+#include "graphics/gpu_profiler.h"
+#include "test.h"
+#include "tramogi/graphics/buffer.h"
+#include <algorithm>
+#include <string>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+TRAMOGI_TEST(gpu_profiler_measures_a_zone) {
+	auto context = create_gpu_context({.frame_count = 1});
+
+	graphics::GpuProfiler gpu_profiler;
+	gpu_profiler.init(context->device);
+	if (!gpu_profiler.is_supported()) {
+		skip("No timestamps on the graphics queue");
+	}
+
+	graphics::StorageBuffer buffer;
+	auto result = buffer.init(context->device, 1024 * 1024);
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+
+	gpu_profiler.begin_frame(0);
+	context->submit_and_wait(
+		graphics::QueueType::Graphics,
+		[&](const vk::raii::CommandBuffer &command_buffer) {
+			graphics::GpuZone zone(gpu_profiler, command_buffer, "fill");
+			command_buffer.fillBuffer(buffer.get_buffer(), 0, vk::WholeSize, 0);
+		}
+	);
+	// Reads back the zone, the frame having been waited for.
+	gpu_profiler.begin_frame(0);
+
+	auto stats = gpu_profiler.get_stats();
+	auto it = std::ranges::find_if(stats, [](const graphics::GpuZoneStats &zone) {
+		return std::string(zone.name) == "fill";
+	});
+	TRAMOGI_CHECK(it != stats.end());
+	TRAMOGI_CHECK_EQ(it->count, 1);
+	TRAMOGI_CHECK(it->last_ms >= 0.0);
+	TRAMOGI_CHECK(it->average_ms >= 0.0);
+	TRAMOGI_CHECK(it->max_ms >= it->average_ms);
+}
+
+} // namespace tramogi::test
@@ -0,0 +1,119 @@
+#include "gpu_context.h"
+#include "graphics/gpu_profiler.h"
+#include "graphics/instance_batch.h"
+#include "render_context.h"
+#include "test.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+constexpr uint32_t instance_count = 100'000;
+constexpr uint32_t round_count = 10;
+
+struct Timings {
+	double cpu_ms = 0.0;
+	double gpu_ms = 0.0;
+};
+
+// Records and submits `draw` `round_count` times, timing its recording on the CPU and its
+// execution in a GPU zone named `name`.
+Timings measure(
+	GpuContext &context,
+	RenderContext &render_context,
+	graphics::GpuProfiler &gpu_profiler,
+	const char *name,
+	const std::function<void(const vk::raii::CommandBuffer &)> &draw
+) {
+	uint64_t record_ns = 0;
+	for (uint32_t round = 0; round < round_count; ++round) {
+		gpu_profiler.begin_frame(0);
+		context.submit_and_wait(
+			graphics::QueueType::Graphics,
+			[&](const vk::raii::CommandBuffer &command_buffer) {
+				uint64_t begin_ns = core::profiling::now_ns();
+				render_context.begin_rendering(command_buffer);
+				render_context.bind(command_buffer);
+				{
+					graphics::GpuZone zone(gpu_profiler, command_buffer, name);
+					draw(command_buffer);
+				}
+				command_buffer.endRendering();
+				record_ns += core::profiling::now_ns() - begin_ns;
+			}
+		);
+	}
+	// Reads back the last round.
+	gpu_profiler.begin_frame(0);
+
+	Timings timings {.cpu_ms = static_cast<double>(record_ns) / round_count / 1e6};
+	auto stats = gpu_profiler.get_stats();
+	auto it = std::ranges::find_if(stats, [name](const graphics::GpuZoneStats &zone) {
+		return std::string(zone.name) == name;
+	});
+	if (it != stats.end()) {
+		timings.gpu_ms = it->average_ms;
+	}
+	return timings;
+}
+
+} // namespace
+
+// Drawing the same cube 100k times, one draw per instance selected by its first instance, against
+// one instanced draw. Like the demo's instancing benchmark, without a window or command buffer
+// caching in the way.
+TRAMOGI_TEST(instancing_against_per_draw) {
+	auto context = create_gpu_context({.frame_count = 1});
+	auto render_context = create_render_context(*context);
+
+	graphics::InstanceBatch instance_batch;
+	auto result = instance_batch.init(context->device, instance_count, 1);
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+	add_grid_instances(instance_batch, instance_count);
+	instance_batch.upload(0);
+	render_context->set_instance_buffer(instance_batch.get_buffer(0));
+
+	graphics::GpuProfiler gpu_profiler;
+	gpu_profiler.init(context->device);
+
+	uint32_t index_count = render_context->index_count;
+	Timings per_draw = measure(
+		*context,
+		*render_context,
+		gpu_profiler,
+		"per_draw",
+		[index_count](const vk::raii::CommandBuffer &command_buffer) {
+			for (uint32_t i = 0; i < instance_count; ++i) {
+				command_buffer.drawIndexed(index_count, 1, 0, 0, i);
+			}
+		}
+	);
+	Timings instanced = measure(
+		*context,
+		*render_context,
+		gpu_profiler,
+		"instanced",
+		[&instance_batch, index_count](const vk::raii::CommandBuffer &command_buffer) {
+			instance_batch.record_draw(command_buffer, index_count);
+		}
+	);
+	TRAMOGI_CHECK_EQ(instance_batch.get_stats().draw_count, round_count);
+
+	report("one draw per instance, CPU", per_draw.cpu_ms, "ms");
+	report("one instanced draw, CPU", instanced.cpu_ms, "ms");
+	if (gpu_profiler.is_supported()) {
+		report("one draw per instance, GPU", per_draw.gpu_ms, "ms");
+		report("one instanced draw, GPU", instanced.gpu_ms, "ms");
+	}
+}
+
+} // namespace tramogi::test
@@ -0,0 +1,74 @@
+#include "test.h"
+#include "tramogi/core/logging/logging.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <cstdint>
+#include <string>
+
+namespace tramogi::test {
+
+namespace {
+
+using core::logging::Category;
+using core::logging::Level;
+
+constexpr uint32_t message_count = 10'000'000;
+
+// What a verbose message typically formats, an allocation and some work.
+std::string describe(uint32_t index) {
+	return std::to_string(index) + " bytes";
+}
+
+template <typename Fn> double measure_ns_per_message(Fn &&fn) {
+	uint64_t begin_ns = core::profiling::now_ns();
+	for (uint32_t i = 0; i < message_count; ++i) {
+		fn(i);
+	}
+	return static_cast<double>(core::profiling::now_ns() - begin_ns) / message_count;
+}
+
+} // namespace
+
+// Filtered messages should cost close to nothing, against the cost of evaluating their arguments
+// as a plain function call would.
+TRAMOGI_TEST(logging_filtered_messages) {
+	Level previous_level = core::logging::get_level(Category::Io);
+	core::logging::set_level(Category::Io, Level::Off);
+
+	uint64_t evaluated_bytes = 0;
+	report(
+		"evaluated arguments",
+		measure_ns_per_message([&evaluated_bytes](uint32_t i) {
+			evaluated_bytes += describe(i).size();
+		}),
+		"ns/message"
+	);
+	// Only in builds whose TRAMOGI_LOG_MIN_LEVEL removes debug messages, such as release builds.
+	if (!core::logging::is_compiled(Level::Debug)) {
+		report(
+			"compiled out",
+			measure_ns_per_message([](uint32_t i) {
+				TRAMOGI_LOG_DEBUG(Io, "Read {}", describe(i));
+			}),
+			"ns/message"
+		);
+	}
+	report(
+		"filtered at runtime",
+		measure_ns_per_message([](uint32_t i) {
+			TRAMOGI_LOG_INFO(Io, "Read {}", describe(i));
+		}),
+		"ns/message"
+	);
+	report(
+		"filtered at runtime by log_at",
+		measure_ns_per_message([](uint32_t i) {
+			core::logging::log_at<Level::Info, Category::Io>("Read {}", describe(i));
+		}),
+		"ns/message"
+	);
+
+	core::logging::set_level(Category::Io, previous_level);
+	TRAMOGI_CHECK(evaluated_bytes > 0);
+}
+
+} // namespace tramogi::test
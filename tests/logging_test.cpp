@@ -0,0 +1,81 @@
+#include "test.h"
+#include "tramogi/core/logging/logging.h"
+
+namespace tramogi::test {
+
+namespace {
+
+using core::logging::Category;
+using core::logging::Level;
+
+int evaluation_count = 0;
+
+int count_evaluation() {
+	return ++evaluation_count;
+}
+
+// Restores the runtime level of the category once the case is over.
+class ScopedLevel {
+public:
+	ScopedLevel(Category category, Level level)
+		: category(category), previous_level(core::logging::get_level(category)) {
+		core::logging::set_level(category, level);
+	}
+	~ScopedLevel() {
+		core::logging::set_level(category, previous_level);
+	}
+
+	ScopedLevel(const ScopedLevel &) = delete;
+	ScopedLevel &operator=(const ScopedLevel &) = delete;
+
+private:
+	Category category;
+	Level previous_level;
+};
+
+} // namespace
+
+// Against the build's own TRAMOGI_LOG_MIN_LEVEL, which only removes messages in release builds
+// unless overridden.
+TRAMOGI_TEST(logging_skips_arguments_below_compiled_level) {
+	if (core::logging::is_compiled(Level::Debug)) {
+		skip("Debug messages are compiled in this build");
+	}
+
+	ScopedLevel level(Category::Io, Level::Trace);
+	evaluation_count = 0;
+	TRAMOGI_LOG_TRACE(Io, "{}", count_evaluation());
+	TRAMOGI_LOG_DEBUG(Io, "{}", count_evaluation());
+	TRAMOGI_CHECK_EQ(evaluation_count, 0);
+
+	if (core::logging::is_compiled(Level::Error)) {
+		TRAMOGI_LOG_ERROR(Io, "{}", count_evaluation());
+		TRAMOGI_CHECK_EQ(evaluation_count, 1);
+	}
+}
+
+TRAMOGI_TEST(logging_skips_arguments_below_runtime_level) {
+	ScopedLevel level(Category::Io, Level::Error);
+	evaluation_count = 0;
+	TRAMOGI_LOG_INFO(Io, "{}", count_evaluation());
+	TRAMOGI_LOG_WARNING(Io, "{}", count_evaluation());
+	TRAMOGI_CHECK_EQ(evaluation_count, 0);
+
+	TRAMOGI_LOG_ERROR(Io, "{}", count_evaluation());
+	TRAMOGI_CHECK_EQ(evaluation_count, 1);
+}
+
+TRAMOGI_TEST(logging_filters_each_category) {
+	ScopedLevel io_level(Category::Io, Level::Off);
+	ScopedLevel graphics_level(Category::Graphics, Level::Info);
+	evaluation_count = 0;
+	TRAMOGI_LOG_ERROR(Io, "{}", count_evaluation());
+	TRAMOGI_CHECK_EQ(evaluation_count, 0);
+
+	TRAMOGI_LOG_INFO(Graphics, "{}", count_evaluation());
+	TRAMOGI_CHECK_EQ(evaluation_count, 1);
+	TRAMOGI_CHECK(!core::logging::is_enabled(Level::Error, Category::Io));
+	TRAMOGI_CHECK(core::logging::is_enabled(Level::Info, Category::Graphics));
+}
+
+} // namespace tramogi::test
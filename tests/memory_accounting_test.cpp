@@ -0,0 +1,140 @@
+#include "gpu_context.h"
+#include "graphics/allocator.h"
+#include "graphics/memory_accounting.h"
+#include "test.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+using graphics::Allocation;
+using graphics::HeapBudget;
+using graphics::MemoryAccounting;
+using graphics::MemoryType;
+using graphics::MemoryUsage;
+using graphics::ResourceKind;
+
+// Of a storage buffer of `size` bytes, for the memory types buffers may use.
+vk::MemoryRequirements get_buffer_requirements(const graphics::Device &device, uint64_t size) {
+	vk::raii::Buffer buffer(
+		device.get_device(),
+		{
+			.size = size,
+			.usage = vk::BufferUsageFlagBits::eStorageBuffer,
+			.sharingMode = vk::SharingMode::eExclusive,
+		}
+	);
+	return buffer.getMemoryRequirements();
+}
+
+Allocation allocate(const graphics::Device &device, uint64_t size, MemoryType memory_type) {
+	auto allocation = graphics::allocate_memory(
+		device,
+		get_buffer_requirements(device, size),
+		memory_type,
+		ResourceKind::Storage
+	);
+	if (!allocation) {
+		fail(__FILE__, __LINE__, allocation.error());
+	}
+	return std::move(allocation.value());
+}
+
+uint32_t get_heap_index(const graphics::Device &device, const Allocation &allocation) {
+	auto memory_properties = device.get_physical_device().get_memory_properties();
+	return memory_properties.memoryTypes[allocation.get_memory_type_index()].heapIndex;
+}
+
+} // namespace
+
+TRAMOGI_TEST(memory_accounting_tracks_allocations_by_kind_type_and_heap) {
+	auto context = create_gpu_context();
+	const MemoryAccounting &accounting = context->device.get_memory_accounting();
+	MemoryUsage kind_before = accounting.get_usage(ResourceKind::Storage);
+
+	Allocation allocation = allocate(context->device, 1024 * 1024, MemoryType::Gpu);
+	uint32_t memory_type_index = allocation.get_memory_type_index();
+	uint32_t heap_index = get_heap_index(context->device, allocation);
+	MemoryUsage kind = accounting.get_usage(ResourceKind::Storage);
+	TRAMOGI_CHECK(allocation.get_size() >= 1024 * 1024);
+	TRAMOGI_CHECK_EQ(kind.bytes, kind_before.bytes + allocation.get_size());
+	TRAMOGI_CHECK_EQ(kind.allocation_count, kind_before.allocation_count + 1);
+	TRAMOGI_CHECK(kind.peak_bytes >= kind.bytes);
+	MemoryUsage memory_type = accounting.get_memory_type_usage(memory_type_index);
+	TRAMOGI_CHECK(memory_type.bytes >= allocation.get_size());
+	TRAMOGI_CHECK(accounting.get_heap_usage(heap_index).bytes >= allocation.get_size());
+	// Sub-allocated from a block at least as big.
+	TRAMOGI_CHECK(accounting.get_heap_reserved(heap_index).bytes >= allocation.get_size());
+
+	std::vector<HeapBudget> budgets = accounting.get_budgets();
+	TRAMOGI_CHECK(heap_index < budgets.size());
+	TRAMOGI_CHECK(budgets[heap_index].tracked_bytes >= allocation.get_size());
+	TRAMOGI_CHECK(budgets[heap_index].reserved_bytes >= budgets[heap_index].tracked_bytes);
+	TRAMOGI_CHECK(budgets[heap_index].budget > 0);
+
+	std::string dump = accounting.dump();
+	TRAMOGI_CHECK(dump.find("By resource kind") != std::string::npos);
+	TRAMOGI_CHECK(dump.find("storage") != std::string::npos);
+
+	uint64_t peak_bytes = kind.peak_bytes;
+	allocation = {};
+	kind = accounting.get_usage(ResourceKind::Storage);
+	TRAMOGI_CHECK_EQ(kind.bytes, kind_before.bytes);
+	TRAMOGI_CHECK_EQ(kind.allocation_count, kind_before.allocation_count);
+	TRAMOGI_CHECK_EQ(kind.peak_bytes, peak_bytes);
+}
+
+TRAMOGI_TEST(memory_accounting_keeps_moved_allocations_accounted_once) {
+	auto context = create_gpu_context();
+	const MemoryAccounting &accounting = context->device.get_memory_accounting();
+	MemoryUsage before = accounting.get_usage(ResourceKind::Storage);
+
+	Allocation allocation = allocate(context->device, 4096, MemoryType::Host);
+	uint64_t size = allocation.get_size();
+	Allocation moved = std::move(allocation);
+	TRAMOGI_CHECK(!allocation.get_memory());
+	TRAMOGI_CHECK_EQ(allocation.get_size(), 0);
+	TRAMOGI_CHECK(moved.get_memory());
+	TRAMOGI_CHECK_EQ(moved.get_size(), size);
+	TRAMOGI_CHECK(moved.map() != nullptr);
+	TRAMOGI_CHECK_EQ(accounting.get_usage(ResourceKind::Storage).bytes, before.bytes + size);
+
+	// Assigning over a live allocation frees it.
+	moved = std::move(allocation);
+	TRAMOGI_CHECK(!moved.get_memory());
+	TRAMOGI_CHECK_EQ(accounting.get_usage(ResourceKind::Storage).bytes, before.bytes);
+}
+
+TRAMOGI_TEST(memory_accounting_reports_budget_pressure) {
+	auto context = create_gpu_context();
+	MemoryAccounting &accounting = context->device.get_memory_accounting();
+
+	std::vector<uint32_t> pressured_heaps;
+	accounting.set_pressure_callback([&pressured_heaps](const HeapBudget &budget) {
+		pressured_heaps.push_back(budget.heap_index);
+	});
+	// Any new block crosses it.
+	accounting.set_pressure_threshold(0.0f);
+
+	// Bigger than half a block, so it always gets a block of its own.
+	uint64_t size = graphics::DeviceMemoryAllocator::default_block_size;
+	Allocation allocation = allocate(context->device, size, MemoryType::Gpu);
+	uint32_t heap_index = get_heap_index(context->device, allocation);
+	TRAMOGI_CHECK_EQ(pressured_heaps.size(), 1);
+	TRAMOGI_CHECK_EQ(pressured_heaps.front(), heap_index);
+
+	// Only fires again once usage dropped back below the threshold.
+	Allocation second_allocation = allocate(context->device, size, MemoryType::Gpu);
+	TRAMOGI_CHECK_EQ(pressured_heaps.size(), 1);
+
+	accounting.set_pressure_callback({});
+	accounting.set_pressure_threshold(0.9f);
+}
+
+} // namespace tramogi::test
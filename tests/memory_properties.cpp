@@ -0,0 +1,50 @@
+#include "memory_properties.h"
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vulkan/vulkan.hpp>
+
+namespace tramogi::test {
+
+using Flags = vk::MemoryPropertyFlagBits;
+
+static vk::PhysicalDeviceMemoryProperties create_memory_properties(
+	std::initializer_list<uint64_t> heap_sizes,
+	std::initializer_list<std::pair<vk::MemoryPropertyFlags, uint32_t>> memory_types
+) {
+	vk::PhysicalDeviceMemoryProperties memory_properties {};
+	for (uint64_t heap_size : heap_sizes) {
+		memory_properties.memoryHeaps[memory_properties.memoryHeapCount++].size = heap_size;
+	}
+	for (auto [flags, heap_index] : memory_types) {
+		uint32_t index = memory_properties.memoryTypeCount++;
+		memory_properties.memoryTypes[index].propertyFlags = flags;
+		memory_properties.memoryTypes[index].heapIndex = heap_index;
+	}
+	return memory_properties;
+}
+
+vk::PhysicalDeviceMemoryProperties get_desktop_memory_properties() {
+	return create_memory_properties(
+		{8 * gib, 16 * gib, gib / 4},
+		{
+			{Flags::eDeviceLocal, 0},
+			{Flags::eHostVisible | Flags::eHostCoherent, 1},
+			{Flags::eHostVisible | Flags::eHostCached, 1},
+			{Flags::eDeviceLocal | Flags::eHostVisible | Flags::eHostCoherent, 2},
+		}
+	);
+}
+
+vk::PhysicalDeviceMemoryProperties get_tiler_memory_properties() {
+	return create_memory_properties(
+		{4 * gib},
+		{
+			{Flags::eDeviceLocal, 0},
+			{Flags::eDeviceLocal | Flags::eLazilyAllocated, 0},
+			{Flags::eDeviceLocal | Flags::eHostVisible | Flags::eHostCoherent, 0},
+		}
+	);
+}
+
+} // namespace tramogi::test
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <vulkan/vulkan.hpp>
+
+namespace tramogi::test {
+
+constexpr uint64_t gib = 1024ull * 1024 * 1024;
+
+// A discrete desktop GPU:
+// 0. device local, in an 8 GiB heap
+// 1. host visible and coherent, in a 16 GiB heap
+// 2. host visible and cached but not coherent, in the same heap
+// 3. device local and host visible, in a 256 MiB BAR heap
+vk::PhysicalDeviceMemoryProperties get_desktop_memory_properties();
+
+// A tiler with unified memory, all in one 4 GiB heap:
+// 0. device local
+// 1. device local and lazily allocated
+// 2. device local, host visible and coherent
+vk::PhysicalDeviceMemoryProperties get_tiler_memory_properties();
+
+} // namespace tramogi::test
@@ -0,0 +1,23 @@
+#include "test.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <cstdint>
+#include <thread>
+
+namespace tramogi::test {
+
+TRAMOGI_TEST(profiler_drops_zones_past_the_cap) {
+	// A single chunk, on a thread that has recorded nothing yet.
+	core::profiling::set_max_zones_per_thread(1);
+	uint64_t dropped_before = core::profiling::get_dropped_zone_count();
+	std::thread thread([]() {
+		for (uint32_t i = 0; i < 5000; ++i) {
+			core::profiling::record_zone("capped", i, i + 1);
+		}
+	});
+	thread.join();
+	core::profiling::set_max_zones_per_thread(core::profiling::default_max_zones_per_thread);
+
+	TRAMOGI_CHECK_EQ(core::profiling::get_dropped_zone_count() - dropped_before, 5000 - 4096);
+}
+
+} // namespace tramogi::test
@@ -0,0 +1,137 @@
+#include "gpu_context.h"
+#include "graphics/instance_batch.h"
+#include "graphics/parallel_recorder.h"
+#include "render_context.h"
+#include "test.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <array>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <span>
+#include <string>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+constexpr uint32_t round_count = 10;
+constexpr std::array<uint32_t, 3> draw_counts {1'000, 10'000, 100'000};
+
+// Like the demo's draws without instancing, one instance each, selected by its first instance.
+void record_draws(
+	RenderContext &render_context,
+	const vk::raii::CommandBuffer &command_buffer,
+	uint32_t begin,
+	uint32_t end
+) {
+	render_context.bind(command_buffer);
+	for (uint32_t i = begin; i < end; ++i) {
+		command_buffer.drawIndexed(render_context.index_count, 1, 0, 0, i);
+	}
+}
+
+// Records `record` into a primary command buffer `round_count` times, then submits the last
+// recording so that the commands are known to be valid.
+double measure_ms_per_recording(
+	GpuContext &context,
+	const std::function<void(const vk::raii::CommandBuffer &)> &record
+) {
+	vk::CommandPoolCreateInfo pool_info {
+		.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		.queueFamilyIndex = context.physical_device.get_graphics_queue_index(),
+	};
+	vk::raii::CommandPool command_pool(context.device.get_device(), pool_info);
+	vk::CommandBufferAllocateInfo allocate_info {
+		.commandPool = command_pool,
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = 1,
+	};
+	vk::raii::CommandBuffer command_buffer = std::move(
+		vk::raii::CommandBuffers(context.device.get_device(), allocate_info).front()
+	);
+
+	uint64_t total_ns = 0;
+	for (uint32_t round = 0; round < round_count; ++round) {
+		command_buffer.reset();
+		uint64_t begin_ns = core::profiling::now_ns();
+		command_buffer.begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+		record(command_buffer);
+		command_buffer.end();
+		total_ns += core::profiling::now_ns() - begin_ns;
+	}
+
+	vk::CommandBuffer submitted = command_buffer;
+	context.device.wait(
+		context.device.submit(graphics::QueueType::Graphics, {.command_buffers = {&submitted, 1}})
+	);
+	return static_cast<double>(total_ns) / round_count / 1e6;
+}
+
+} // namespace
+
+// Recording synthetic draws of a cube on the calling thread, against recording them into
+// secondary command buffers on every thread of the pool.
+TRAMOGI_TEST(recording_scaling) {
+	auto context = create_gpu_context({.frame_count = 1});
+	auto render_context = create_render_context(*context);
+
+	graphics::InstanceBatch instance_batch;
+	auto result = instance_batch.init(context->device, draw_counts.back(), 1);
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+	add_grid_instances(instance_batch, draw_counts.back());
+	instance_batch.upload(0);
+	render_context->set_instance_buffer(instance_batch.get_buffer(0));
+
+	graphics::ParallelRecorder parallel_recorder;
+	parallel_recorder.init(context->device, render_context->thread_pool, 1);
+
+	for (uint32_t draw_count : draw_counts) {
+		double serial_ms = measure_ms_per_recording(
+			*context,
+			[&render_context, draw_count](const vk::raii::CommandBuffer &command_buffer) {
+				render_context->begin_rendering(command_buffer);
+				record_draws(*render_context, command_buffer, 0, draw_count);
+				command_buffer.endRendering();
+			}
+		);
+		report(std::format("serial, {} draws", draw_count).c_str(), serial_ms, "ms");
+
+		double parallel_ms = measure_ms_per_recording(
+			*context,
+			[&](const vk::raii::CommandBuffer &command_buffer) {
+				// Nothing recorded by the previous round is pending.
+				parallel_recorder.begin_frame(0);
+				render_context->begin_rendering(
+					command_buffer,
+					vk::RenderingFlagBits::eContentsSecondaryCommandBuffers
+				);
+				auto secondary_command_buffers = parallel_recorder.record(
+					draw_count,
+					{.color_formats = {}, .depth_format = render_context->depth_format},
+					[&render_context](
+						const vk::raii::CommandBuffer &secondary_command_buffer,
+						uint32_t begin,
+						uint32_t end
+					) {
+						record_draws(*render_context, secondary_command_buffer, begin, end);
+					}
+				);
+				command_buffer.executeCommands(secondary_command_buffers);
+				command_buffer.endRendering();
+			}
+		);
+		std::string name = std::format(
+			"parallel on {} threads, {} draws",
+			parallel_recorder.get_thread_count(),
+			draw_count
+		);
+		report(name.c_str(), parallel_ms, "ms");
+	}
+}
+
+} // namespace tramogi::test
@@ -0,0 +1,333 @@
+#include "render_context.h"
+#include "graphics/allocator.h"
+#include "graphics/instance_batch.h"
+#include "graphics/pipeline_library.h"
+#include "test.h"
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+// Matches VertexInput in shader.slang.
+struct Vertex {
+	std::array<float, 3> position;
+	std::array<float, 2> tex_coord;
+};
+
+// Of the cube, which spans [-1, 1] on every axis.
+constexpr std::array<Vertex, 8> cube_vertices {{
+	{{-1, -1, -1}, {0, 0}},
+	{{1, -1, -1}, {1, 0}},
+	{{1, 1, -1}, {1, 1}},
+	{{-1, 1, -1}, {0, 1}},
+	{{-1, -1, 1}, {0, 0}},
+	{{1, -1, 1}, {1, 0}},
+	{{1, 1, 1}, {1, 1}},
+	{{-1, 1, 1}, {0, 1}},
+}};
+
+constexpr std::array<uint32_t, 36> cube_indices {
+	0, 1, 2, 2, 3, 0, 4, 6, 5, 6, 4, 7, 0, 4, 5, 5, 1, 0,
+	3, 2, 6, 6, 7, 3, 0, 3, 7, 7, 4, 0, 1, 5, 6, 6, 2, 1,
+};
+
+// Matches UniformBuffer in shader.slang.
+struct UniformData {
+	std::array<float, 16> projection;
+	std::array<float, 16> view;
+	std::array<float, 16> model;
+};
+
+constexpr std::array<float, 16> identity {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+template <typename T> void check(const core::Result<T> &result) {
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+}
+
+void create_pipeline(GpuContext &context, RenderContext &render_context) {
+	render_context.shader_module = context.create_shader_module();
+
+	std::array bindings {
+		vk::DescriptorSetLayoutBinding {
+			.binding = 0,
+			.descriptorType = vk::DescriptorType::eUniformBuffer,
+			.descriptorCount = 1,
+			.stageFlags = vk::ShaderStageFlagBits::eVertex,
+		},
+		vk::DescriptorSetLayoutBinding {
+			.binding = 6,
+			.descriptorType = vk::DescriptorType::eStorageBuffer,
+			.descriptorCount = 1,
+			.stageFlags = vk::ShaderStageFlagBits::eVertex,
+		},
+	};
+	render_context.descriptor_set_layout = vk::raii::DescriptorSetLayout(
+		context.device.get_device(),
+		vk::DescriptorSetLayoutCreateInfo {
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data(),
+		}
+	);
+	vk::DescriptorSetLayout set_layout = render_context.descriptor_set_layout;
+	render_context.pipeline_layout = vk::raii::PipelineLayout(
+		context.device.get_device(),
+		vk::PipelineLayoutCreateInfo {.setLayoutCount = 1, .pSetLayouts = &set_layout}
+	);
+
+	render_context.pipeline_library.init(
+		context.device,
+		context.pipeline_cache,
+		render_context.thread_pool
+	);
+	graphics::PipelineDesc desc {
+		.shader_module = render_context.shader_module,
+		.vertex_entry = "vert_main_instanced",
+		.fragment_entry = "",
+		.layout = render_context.pipeline_layout,
+		.vertex_stride = sizeof(Vertex),
+		.vertex_attributes =
+			{
+				{
+					.location = 0,
+					.format = vk::Format::eR32G32B32Sfloat,
+					.offset = offsetof(Vertex, position),
+				},
+				{
+					.location = 1,
+					.format = vk::Format::eR32G32Sfloat,
+					.offset = offsetof(Vertex, tex_coord),
+				},
+			},
+		.cull_mode = vk::CullModeFlagBits::eNone,
+		.depth_format = render_context.depth_format,
+	};
+	auto pipeline = render_context.pipeline_library.wait(
+		render_context.pipeline_library.request(desc, "test_depth_only")
+	);
+	check(pipeline);
+	render_context.pipeline = pipeline.value();
+}
+
+void create_depth_image(GpuContext &context, RenderContext &render_context) {
+	render_context.depth_image = vk::raii::Image(
+		context.device.get_device(),
+		vk::ImageCreateInfo {
+			.imageType = vk::ImageType::e2D,
+			.format = render_context.depth_format,
+			.extent = {RenderContext::extent.width, RenderContext::extent.height, 1},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = vk::SampleCountFlagBits::e1,
+			.tiling = vk::ImageTiling::eOptimal,
+			.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+			.sharingMode = vk::SharingMode::eExclusive,
+		}
+	);
+	auto memory = graphics::allocate_memory(
+		context.device,
+		render_context.depth_image.getMemoryRequirements(),
+		graphics::MemoryType::Gpu,
+		graphics::ResourceKind::Attachment
+	);
+	check(memory);
+	render_context.depth_image_memory = std::move(memory.value());
+	render_context.depth_image.bindMemory(
+		render_context.depth_image_memory.get_memory(),
+		render_context.depth_image_memory.get_offset()
+	);
+
+	render_context.depth_image_view = vk::raii::ImageView(
+		context.device.get_device(),
+		vk::ImageViewCreateInfo {
+			.image = render_context.depth_image,
+			.viewType = vk::ImageViewType::e2D,
+			.format = render_context.depth_format,
+			.subresourceRange =
+				{
+					.aspectMask = vk::ImageAspectFlagBits::eDepth,
+					.baseMipLevel = 0,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+		}
+	);
+}
+
+void create_mesh(GpuContext &context, RenderContext &render_context) {
+	check(render_context.vertex_buffer.init(context.device, sizeof(cube_vertices)));
+	context.write_buffer(render_context.vertex_buffer, std::as_bytes(std::span(cube_vertices)));
+	check(render_context.index_buffer.init(context.device, sizeof(cube_indices)));
+	context.write_buffer(render_context.index_buffer, std::as_bytes(std::span(cube_indices)));
+	render_context.index_count = static_cast<uint32_t>(cube_indices.size());
+
+	UniformData uniform_data {.projection = identity, .view = identity, .model = identity};
+	check(render_context.uniform_buffer.init(context.device, sizeof(uniform_data)));
+	render_context.uniform_buffer.upload_data(&uniform_data);
+}
+
+void create_descriptor_set(GpuContext &context, RenderContext &render_context) {
+	std::array pool_sizes {
+		vk::DescriptorPoolSize {.type = vk::DescriptorType::eUniformBuffer, .descriptorCount = 1},
+		vk::DescriptorPoolSize {.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1},
+	};
+	render_context.descriptor_pool = vk::raii::DescriptorPool(
+		context.device.get_device(),
+		vk::DescriptorPoolCreateInfo {
+			.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+			.maxSets = 1,
+			.poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+			.pPoolSizes = pool_sizes.data(),
+		}
+	);
+	vk::DescriptorSetLayout set_layout = render_context.descriptor_set_layout;
+	vk::DescriptorSetAllocateInfo allocate_info {
+		.descriptorPool = render_context.descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &set_layout,
+	};
+	render_context.descriptor_set =
+		std::move(vk::raii::DescriptorSets(context.device.get_device(), allocate_info).front());
+
+	vk::DescriptorBufferInfo buffer_info {
+		.buffer = render_context.uniform_buffer.get_buffer(),
+		.offset = 0,
+		.range = vk::WholeSize,
+	};
+	context.device.get_device().updateDescriptorSets(
+		vk::WriteDescriptorSet {
+			.dstSet = render_context.descriptor_set,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = vk::DescriptorType::eUniformBuffer,
+			.pBufferInfo = &buffer_info,
+		},
+		{}
+	);
+}
+
+} // namespace
+
+void RenderContext::set_instance_buffer(vk::Buffer buffer) {
+	vk::DescriptorBufferInfo buffer_info {.buffer = buffer, .offset = 0, .range = vk::WholeSize};
+	descriptor_set.getDevice().updateDescriptorSets(
+		vk::WriteDescriptorSet {
+			.dstSet = descriptor_set,
+			.dstBinding = 6,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = vk::DescriptorType::eStorageBuffer,
+			.pBufferInfo = &buffer_info,
+		},
+		{}
+	);
+}
+
+void RenderContext::begin_rendering(
+	const vk::raii::CommandBuffer &command_buffer,
+	vk::RenderingFlags flags
+) {
+	// Whatever the previous rendering left is cleared.
+	vk::ImageMemoryBarrier2 barrier {
+		.srcStageMask = vk::PipelineStageFlagBits2::eLateFragmentTests,
+		.srcAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+		.dstStageMask = vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+						vk::PipelineStageFlagBits2::eLateFragmentTests,
+		.dstAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+						 vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+		.oldLayout = vk::ImageLayout::eUndefined,
+		.newLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+		.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+		.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+		.image = depth_image,
+		.subresourceRange =
+			{
+				.aspectMask = vk::ImageAspectFlagBits::eDepth,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+	};
+	command_buffer.pipelineBarrier2(
+		vk::DependencyInfo {.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier}
+	);
+
+	vk::ClearValue clear_depth = vk::ClearDepthStencilValue(1.0f, 0);
+	vk::RenderingAttachmentInfo depth_attachment_info {
+		.imageView = depth_image_view,
+		.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+		.loadOp = vk::AttachmentLoadOp::eClear,
+		.storeOp = vk::AttachmentStoreOp::eDontCare,
+		.clearValue = clear_depth,
+	};
+	command_buffer.beginRendering(
+		vk::RenderingInfo {
+			.flags = flags,
+			.renderArea = {.offset = {0, 0}, .extent = extent},
+			.layerCount = 1,
+			.pDepthAttachment = &depth_attachment_info,
+		}
+	);
+}
+
+void RenderContext::bind(const vk::raii::CommandBuffer &command_buffer) {
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+	command_buffer.setViewport(
+		0,
+		vk::Viewport(0.0f, 0.0f, extent.width, extent.height, 0.0f, 1.0f)
+	);
+	command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
+	command_buffer.bindVertexBuffers(0, *vertex_buffer.get_buffer(), {0});
+	command_buffer.bindIndexBuffer(*index_buffer.get_buffer(), 0, vk::IndexType::eUint32);
+	command_buffer.bindDescriptorSets(
+		vk::PipelineBindPoint::eGraphics,
+		pipeline_layout,
+		0,
+		*descriptor_set,
+		{}
+	);
+}
+
+std::unique_ptr<RenderContext> create_render_context(GpuContext &context) {
+	auto render_context = std::make_unique<RenderContext>();
+	auto depth_format = context.physical_device.get_depth_format();
+	check(depth_format);
+	render_context->depth_format = depth_format.value();
+
+	create_pipeline(context, *render_context);
+	create_depth_image(context, *render_context);
+	create_mesh(context, *render_context);
+	create_descriptor_set(context, *render_context);
+	return render_context;
+}
+
+void add_grid_instances(graphics::InstanceBatch &instance_batch, uint32_t count) {
+	auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	float spacing = 2.0f / static_cast<float>(columns);
+	for (uint32_t i = 0; i < count; ++i) {
+		float x = -1.0f + spacing * (static_cast<float>(i % columns) + 0.5f);
+		float y = -1.0f + spacing * (static_cast<float>(i / columns) + 0.5f);
+		// Half the spacing wide, and within the [0, 1] depth range.
+		float scale = spacing / 4.0f;
+		graphics::InstanceData instance {
+			.model = {scale, 0, 0, 0, 0, scale, 0, 0, 0, 0, 0.25f, 0, x, y, 0.5f, 1},
+		};
+		check(instance_batch.add(instance));
+	}
+}
+
+} // namespace tramogi::test
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "gpu_context.h"
+#include "graphics/allocator.h"
+#include "graphics/instance_batch.h"
+#include "graphics/pipeline_library.h"
+#include "tramogi/core/threading/thread_pool.h"
+#include "tramogi/graphics/buffer.h"
+#include <cstdint>
+#include <memory>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+// Depth-only rendering of a small cube with the demo's shaders, into an offscreen depth image.
+// Each draw's instances are read from an instance buffer by vert_main_instanced. The view and
+// projection are identity, so instances are placed in clip space directly.
+struct RenderContext {
+	static constexpr vk::Extent2D extent {.width = 256, .height = 256};
+
+	// Declared before the pipeline library, which they must outlive.
+	core::threading::ThreadPool thread_pool;
+	vk::raii::ShaderModule shader_module = nullptr;
+	vk::raii::DescriptorSetLayout descriptor_set_layout = nullptr;
+	vk::raii::PipelineLayout pipeline_layout = nullptr;
+	graphics::PipelineLibrary pipeline_library;
+	vk::Pipeline pipeline;
+
+	vk::Format depth_format = vk::Format::eUndefined;
+	vk::raii::Image depth_image = nullptr;
+	graphics::Allocation depth_image_memory;
+	vk::raii::ImageView depth_image_view = nullptr;
+
+	graphics::VertexBuffer vertex_buffer;
+	graphics::IndexBuffer index_buffer;
+	uint32_t index_count = 0;
+	graphics::UniformBuffer uniform_buffer;
+
+	vk::raii::DescriptorPool descriptor_pool = nullptr;
+	vk::raii::DescriptorSet descriptor_set = nullptr;
+
+	// Binds `buffer` as the instance storage buffer of every later draw.
+	void set_instance_buffer(vk::Buffer buffer);
+	// Clears the depth image, which is only valid until the end of the rendering.
+	void begin_rendering(
+		const vk::raii::CommandBuffer &command_buffer,
+		vk::RenderingFlags flags = {}
+	);
+	// Binds the pipeline, dynamic state, mesh and descriptor set, in each command buffer that
+	// draws.
+	void bind(const vk::raii::CommandBuffer &command_buffer);
+};
+
+// Skips the running case when the shaders have not been compiled.
+std::unique_ptr<RenderContext> create_render_context(GpuContext &context);
+
+// Adds `count` instances laid out in a grid that covers the depth image, each a fraction of a
+// pixel to a few pixels big.
+void add_grid_instances(graphics::InstanceBatch &instance_batch, uint32_t count);
+
+} // namespace tramogi::test
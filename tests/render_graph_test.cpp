@@ -0,0 +1,293 @@
+#include "gpu_context.h"
+#include "graphics/allocator.h"
+#include "graphics/frame_graph.h"
+#include "graphics/render_graph.h"
+#include "test.h"
+#include "tramogi/graphics/buffer.h"
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+using graphics::RenderGraph;
+using graphics::RenderGraphStats;
+using graphics::RenderResource;
+using graphics::ResourceState;
+using graphics::TransientImageDesc;
+
+// Only compared against null, since nothing is executed.
+template <typename Handle> Handle get_fake_handle(uint64_t value) {
+	typename Handle::CType handle;
+	static_assert(sizeof(handle) == sizeof(value));
+	std::memcpy(&handle, &value, sizeof(handle));
+	return Handle(handle);
+}
+
+graphics::FrameGraphDesc get_frame_graph_desc(bool has_cull, bool use_gpu_driven) {
+	graphics::FrameGraphDesc desc {
+		.swapchain_image = get_fake_handle<vk::Image>(1),
+		.depth_format = vk::Format::eD32Sfloat,
+		.extent = {.width = 1280, .height = 720},
+		.use_gpu_driven = use_gpu_driven,
+	};
+	if (has_cull) {
+		desc.cull_draws = get_fake_handle<vk::Buffer>(2);
+		desc.cull_count = get_fake_handle<vk::Buffer>(3);
+	}
+	return desc;
+}
+
+struct Image {
+	vk::raii::Image image = nullptr;
+	graphics::Allocation memory;
+	vk::raii::ImageView view = nullptr;
+};
+
+Image create_image(
+	GpuContext &context,
+	vk::Format format,
+	vk::Extent2D extent,
+	vk::ImageUsageFlags usage,
+	vk::ImageAspectFlags aspect
+) {
+	Image image;
+	image.image = vk::raii::Image(
+		context.device.get_device(),
+		vk::ImageCreateInfo {
+			.imageType = vk::ImageType::e2D,
+			.format = format,
+			.extent = {extent.width, extent.height, 1},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = vk::SampleCountFlagBits::e1,
+			.tiling = vk::ImageTiling::eOptimal,
+			.usage = usage,
+			.sharingMode = vk::SharingMode::eExclusive,
+		}
+	);
+	auto memory = graphics::allocate_memory(
+		context.device,
+		image.image.getMemoryRequirements(),
+		graphics::MemoryType::Gpu,
+		graphics::ResourceKind::Attachment
+	);
+	if (!memory) {
+		fail(__FILE__, __LINE__, memory.error());
+	}
+	image.memory = std::move(memory.value());
+	image.image.bindMemory(image.memory.get_memory(), image.memory.get_offset());
+
+	image.view = vk::raii::ImageView(
+		context.device.get_device(),
+		vk::ImageViewCreateInfo {
+			.image = image.image,
+			.viewType = vk::ImageViewType::e2D,
+			.format = format,
+			.subresourceRange =
+				{
+					.aspectMask = aspect,
+					.baseMipLevel = 0,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+		}
+	);
+	return image;
+}
+
+RenderGraphStats compile(RenderGraph &graph) {
+	auto result = graph.compile();
+	if (!result) {
+		fail(__FILE__, __LINE__, result.error());
+	}
+	return graph.get_stats();
+}
+
+constexpr TransientImageDesc color_desc {
+	.format = vk::Format::eR8G8B8A8Unorm,
+	.extent = {.width = 64, .height = 64},
+	.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+	.aspect = vk::ImageAspectFlagBits::eColor,
+};
+
+constexpr ResourceState color_write {
+	.stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+	.access = vk::AccessFlagBits2::eColorAttachmentWrite,
+	.layout = vk::ImageLayout::eColorAttachmentOptimal,
+};
+
+constexpr ResourceState sampled {
+	.stages = vk::PipelineStageFlagBits2::eFragmentShader,
+	.access = vk::AccessFlagBits2::eShaderSampledRead,
+	.layout = vk::ImageLayout::eShaderReadOnlyOptimal,
+};
+
+} // namespace
+
+// The demo's frame: the swapchain and depth transitions are merged into the batch before the
+// rendering pass, along with the indirect barrier when drawing GPU-driven, and the present
+// transition follows it.
+TRAMOGI_TEST(render_graph_frame_barriers) {
+	RenderGraph graph;
+	graph.init_without_device(1);
+
+	graphics::declare_frame_graph(graph, get_frame_graph_desc(false, false));
+	RenderGraphStats stats = compile(graph);
+	TRAMOGI_CHECK_EQ(stats.pass_count, 2);
+	TRAMOGI_CHECK_EQ(stats.culled_pass_count, 0);
+	TRAMOGI_CHECK_EQ(stats.barrier_batch_count, 2);
+	TRAMOGI_CHECK_EQ(stats.image_barrier_count, 3);
+	TRAMOGI_CHECK_EQ(stats.memory_barrier_count, 0);
+	TRAMOGI_CHECK_EQ(stats.transient_image_count, 1);
+
+	// Nothing reads what the cull writes.
+	graphics::declare_frame_graph(graph, get_frame_graph_desc(true, false));
+	stats = compile(graph);
+	TRAMOGI_CHECK_EQ(stats.pass_count, 3);
+	TRAMOGI_CHECK_EQ(stats.culled_pass_count, 1);
+	TRAMOGI_CHECK_EQ(stats.barrier_batch_count, 2);
+	TRAMOGI_CHECK_EQ(stats.image_barrier_count, 3);
+	TRAMOGI_CHECK_EQ(stats.memory_barrier_count, 0);
+
+	graphics::declare_frame_graph(graph, get_frame_graph_desc(true, true));
+	stats = compile(graph);
+	TRAMOGI_CHECK_EQ(stats.pass_count, 3);
+	TRAMOGI_CHECK_EQ(stats.culled_pass_count, 0);
+	TRAMOGI_CHECK_EQ(stats.barrier_batch_count, 2);
+	TRAMOGI_CHECK_EQ(stats.image_barrier_count, 3);
+	// Both cull outputs in one.
+	TRAMOGI_CHECK_EQ(stats.memory_barrier_count, 1);
+}
+
+// The demo's frame recorded by both paths, with passes that record nothing. The graph records the
+// same barriers as the hand-written path in fewer batches.
+TRAMOGI_TEST(render_graph_frame_batches_fewer_barriers_than_hand_written) {
+	auto context = create_gpu_context({.frame_count = 1});
+	auto depth_format = context->physical_device.get_depth_format();
+	if (!depth_format) {
+		fail(__FILE__, __LINE__, depth_format.error());
+	}
+
+	constexpr vk::Extent2D extent {.width = 64, .height = 64};
+	// Stands in for the swapchain image.
+	Image color = create_image(
+		*context,
+		vk::Format::eR8G8B8A8Unorm,
+		extent,
+		vk::ImageUsageFlagBits::eColorAttachment,
+		vk::ImageAspectFlagBits::eColor
+	);
+	Image depth = create_image(
+		*context,
+		depth_format.value(),
+		extent,
+		vk::ImageUsageFlagBits::eDepthStencilAttachment,
+		vk::ImageAspectFlagBits::eDepth
+	);
+	graphics::StorageBuffer cull_draws;
+	graphics::StorageBuffer cull_count;
+	for (graphics::StorageBuffer *buffer : {&cull_draws, &cull_count}) {
+		auto result = buffer->init(context->device, 256);
+		if (!result) {
+			fail(__FILE__, __LINE__, result.error());
+		}
+	}
+
+	RenderGraph graph;
+	graph.init(context->device, 1);
+
+	auto check_frame = [&](bool has_cull, bool use_gpu_driven) {
+		graphics::FrameGraphDesc desc {
+			.swapchain_image = *color.image,
+			.depth_format = depth_format.value(),
+			.extent = extent,
+			.use_gpu_driven = use_gpu_driven,
+			.defragment = [](const vk::raii::CommandBuffer &) {},
+			.cull = [](const vk::raii::CommandBuffer &) {},
+			.rendering = [](const vk::raii::CommandBuffer &, vk::ImageView) {},
+		};
+		if (has_cull) {
+			desc.cull_draws = *cull_draws.get_buffer();
+			desc.cull_count = *cull_count.get_buffer();
+		}
+
+		uint32_t hand_written_count = 0;
+		context->submit_and_wait(
+			graphics::QueueType::Graphics,
+			[&](const vk::raii::CommandBuffer &command_buffer) {
+				hand_written_count = graphics::record_hand_written_frame(
+					command_buffer,
+					desc,
+					*depth.image,
+					*depth.view
+				);
+			}
+		);
+
+		graphics::declare_frame_graph(graph, desc);
+		RenderGraphStats stats = compile(graph);
+		context->submit_and_wait(
+			graphics::QueueType::Graphics,
+			[&graph](const vk::raii::CommandBuffer &command_buffer) {
+				graph.execute(command_buffer);
+			}
+		);
+
+		TRAMOGI_CHECK_EQ(
+			stats.image_barrier_count + stats.memory_barrier_count,
+			hand_written_count
+		);
+		TRAMOGI_CHECK(stats.barrier_batch_count < hand_written_count);
+	};
+
+	check_frame(false, false);
+	// The graph culls the cull pass, which the hand-written path leaves out.
+	check_frame(true, false);
+	check_frame(true, true);
+}
+
+TRAMOGI_TEST(render_graph_aliases_transients_that_do_not_overlap) {
+	RenderGraph graph;
+	graph.init_without_device(1);
+
+	// `a` is used by the first two passes and `b` by the last two, when `overlap` is false.
+	auto declare = [&graph](bool overlap) {
+		graph.reset();
+		RenderResource target = graph.import_image(
+			"target",
+			get_fake_handle<vk::Image>(1),
+			vk::ImageAspectFlagBits::eColor,
+			{}
+		);
+		graph.export_resource(target, sampled);
+		RenderResource a = graph.create_image("a", color_desc);
+		RenderResource b = graph.create_image("b", color_desc);
+		graph.add_pass("write_a", {}).write(a, color_write);
+		auto read_a = graph.add_pass("read_a", {});
+		read_a.read(a, sampled).write(target, color_write);
+		if (overlap) {
+			read_a.write(b, color_write);
+		}
+		graph.add_pass("write_b", {}).write(b, color_write);
+		graph.add_pass("read_b", {}).read(b, sampled).write(target, color_write);
+	};
+
+	declare(false);
+	RenderGraphStats stats = compile(graph);
+	TRAMOGI_CHECK_EQ(stats.culled_pass_count, 0);
+	TRAMOGI_CHECK_EQ(stats.transient_image_count, 2);
+	TRAMOGI_CHECK_EQ(stats.transient_allocation_count, 1);
+
+	declare(true);
+	stats = compile(graph);
+	TRAMOGI_CHECK_EQ(stats.transient_image_count, 2);
+	TRAMOGI_CHECK_EQ(stats.transient_allocation_count, 2);
+}
+
+} // namespace tramogi::test
@@ -0,0 +1,106 @@
+#include "test.h"
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <format>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tramogi::test {
+
+namespace {
+
+// Exit code CTest reports as skipped, see SKIP_RETURN_CODE in CMakeLists.txt.
+constexpr int skipped_exit_code = 77;
+
+struct Case {
+	const char *name;
+	TestFunction function;
+};
+
+struct Failure {
+	std::string message;
+};
+
+struct Skip {
+	std::string reason;
+};
+
+// Function local, registrations run during static initialization of other files.
+std::vector<Case> &get_cases() {
+	static std::vector<Case> cases;
+	return cases;
+}
+
+} // namespace
+
+Registration::Registration(const char *name, TestFunction function) {
+	get_cases().push_back({.name = name, .function = function});
+}
+
+void fail(const char *file, int line, const std::string &message) {
+	throw Failure {std::format("{}:{}: {}", file, line, message)};
+}
+
+void skip(const std::string &reason) {
+	throw Skip {reason};
+}
+
+void report(const char *name, double value, const char *unit) {
+	std::println("  {}: {:.3f} {}", name, value, unit);
+}
+
+} // namespace tramogi::test
+
+int main(int argc, char **argv) {
+	using namespace tramogi::test;
+
+	std::string_view filter = argc > 1 ? argv[1] : "";
+	std::vector<Case> cases = get_cases();
+	std::ranges::sort(cases, {}, [](const Case &test_case) {
+		return std::string_view(test_case.name);
+	});
+
+	uint32_t run_count = 0;
+	uint32_t skip_count = 0;
+	uint32_t failure_count = 0;
+	for (const Case &test_case : cases) {
+		if (!std::string_view(test_case.name).starts_with(filter)) {
+			continue;
+		}
+
+		++run_count;
+		std::println("[ RUN  ] {}", test_case.name);
+		try {
+			test_case.function();
+			std::println("[   OK ] {}", test_case.name);
+		} catch (const Skip &skipped) {
+			++skip_count;
+			std::println("[ SKIP ] {}: {}", test_case.name, skipped.reason);
+		} catch (const Failure &failure) {
+			++failure_count;
+			std::println("[ FAIL ] {}: {}", test_case.name, failure.message);
+		} catch (const std::exception &exception) {
+			++failure_count;
+			std::println("[ FAIL ] {}: uncaught exception: {}", test_case.name, exception.what());
+		}
+	}
+
+	if (run_count == 0) {
+		std::println("No case matches '{}'", filter);
+		return 1;
+	}
+	std::println(
+		"{} cases: {} passed, {} skipped, {} failed",
+		run_count,
+		run_count - skip_count - failure_count,
+		skip_count,
+		failure_count
+	);
+	if (failure_count > 0) {
+		return 1;
+	}
+	return skip_count == run_count ? skipped_exit_code : 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <concepts>
+#include <format>
+#include <string>
+#include <utility>
+
+namespace tramogi::test {
+
+using TestFunction = void (*)();
+
+// Adds `function` to the cases of the executable, see TRAMOGI_TEST.
+struct Registration {
+	Registration(const char *name, TestFunction function);
+};
+
+// Ends the running case, which is reported as failed.
+[[noreturn]] void fail(const char *file, int line, const std::string &message);
+// Ends the running case, which is reported as skipped. For cases that need a Vulkan device when
+// there is none, such as on CI machines without lavapipe.
+[[noreturn]] void skip(const std::string &reason);
+
+// Prints a measurement of a benchmark, one per line so that runs can be compared with diff.
+void report(const char *name, double value, const char *unit);
+
+template <typename Actual, typename Expected>
+void check_equal(
+	const Actual &actual,
+	const Expected &expected,
+	const char *file,
+	int line,
+	const char *expression
+) {
+	if constexpr (std::integral<Actual> && std::integral<Expected>) {
+		if (std::cmp_equal(actual, expected)) {
+			return;
+		}
+	} else if (actual == expected) {
+		return;
+	}
+	fail(file, line, std::format("{}: {} != {}", expression, actual, expected));
+}
+
+} // namespace tramogi::test
+
+// Defines a case. Executables run the cases whose name starts with their first argument, or all of
+// them without one.
+#define TRAMOGI_TEST(name)                                                                         \
+	static void name();                                                                            \
+	static const ::tramogi::test::Registration name##_registration(#name, name);                   \
+	static void name()
+
+#define TRAMOGI_CHECK(expression)                                                                  \
+	do {                                                                                           \
+		if (!(expression)) {                                                                       \
+			::tramogi::test::fail(__FILE__, __LINE__, #expression);                                \
+		}                                                                                          \
+	} while (0)
+
+// Both sides must be formattable with std::format, booleans go through TRAMOGI_CHECK.
+#define TRAMOGI_CHECK_EQ(actual, expected)                                                         \
+	::tramogi::test::check_equal(actual, expected, __FILE__, __LINE__, #actual " == " #expected)
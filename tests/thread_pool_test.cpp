@@ -0,0 +1,63 @@
+#include "test.h"
+#include "tramogi/core/threading/thread_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tramogi::test {
+
+namespace {
+
+using core::threading::ThreadPool;
+
+constexpr uint32_t call_count = 10'000;
+
+} // namespace
+
+TRAMOGI_TEST(thread_pool_calls_every_index_once) {
+	ThreadPool pool(3);
+	std::vector<std::atomic<uint32_t>> calls(call_count);
+	pool.parallel_for(call_count, [&calls](uint32_t i) {
+		++calls[i];
+	});
+	for (const std::atomic<uint32_t> &call : calls) {
+		TRAMOGI_CHECK_EQ(call.load(), 1);
+	}
+
+	// Without workers, everything runs on the calling thread.
+	ThreadPool empty_pool(0);
+	uint32_t sum = 0;
+	empty_pool.parallel_for(call_count, [&sum](uint32_t i) {
+		sum += i;
+	});
+	TRAMOGI_CHECK_EQ(sum, call_count * (call_count - 1) / 2);
+}
+
+TRAMOGI_TEST(thread_pool_rethrows_from_parallel_for) {
+	ThreadPool pool(3);
+	std::atomic<uint32_t> completed_count = 0;
+	std::string message;
+	try {
+		pool.parallel_for(call_count, [&completed_count](uint32_t i) {
+			++completed_count;
+			if (i % 100 == 7) {
+				throw std::runtime_error("Index " + std::to_string(i));
+			}
+		});
+	} catch (const std::runtime_error &exception) {
+		message = exception.what();
+	}
+	TRAMOGI_CHECK(message.starts_with("Index "));
+	TRAMOGI_CHECK_EQ(completed_count.load(), call_count);
+
+	// Workers survive the exceptions.
+	completed_count = 0;
+	pool.parallel_for(call_count, [&completed_count](uint32_t) {
+		++completed_count;
+	});
+	TRAMOGI_CHECK_EQ(completed_count.load(), call_count);
+}
+
+} // namespace tramogi::test
@@ -0,0 +1,109 @@
+#include "graphics/allocator.h"
+#include "graphics/tlsf.h"
+#include "memory_properties.h"
+#include "test.h"
+#include "tramogi/core/profiling/profiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <random>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+using graphics::Tlsf;
+
+constexpr uint32_t round_count = 20'000;
+// Allocations live at the end of each round, half of which are freed before the next one.
+constexpr uint32_t live_count = 256;
+
+struct Timings {
+	uint64_t allocate_ns = 0;
+	uint64_t free_ns = 0;
+	uint64_t allocation_count = 0;
+	uint64_t free_count = 0;
+	uint64_t failed_count = 0;
+};
+
+// Sizes from 256 bytes to 512 KiB, as small buffers and images would use, aligned to up to 64 KiB.
+Timings measure_churn(uint64_t block_size) {
+	std::mt19937 random(1);
+	std::uniform_int_distribution<uint32_t> size_bits(8, 18);
+	std::uniform_int_distribution<uint32_t> alignment_bits(0, 16);
+
+	Tlsf tlsf(block_size);
+	std::vector<uint32_t> live;
+	Timings timings;
+	for (uint32_t round = 0; round < round_count; ++round) {
+		while (live.size() < live_count) {
+			uint64_t size = uint64_t(1) << size_bits(random);
+			size += random() % size;
+			uint64_t alignment = uint64_t(1) << alignment_bits(random);
+
+			uint64_t begin_ns = core::profiling::now_ns();
+			auto range = tlsf.allocate(size, alignment);
+			timings.allocate_ns += core::profiling::now_ns() - begin_ns;
+			if (!range) {
+				++timings.failed_count;
+				break;
+			}
+			++timings.allocation_count;
+			live.push_back(range->node);
+		}
+
+		std::shuffle(live.begin(), live.end(), random);
+		uint64_t begin_ns = core::profiling::now_ns();
+		for (size_t i = live.size() / 2; i < live.size(); ++i) {
+			tlsf.free(live[i]);
+		}
+		timings.free_ns += core::profiling::now_ns() - begin_ns;
+		timings.free_count += live.size() - live.size() / 2;
+		live.resize(live.size() / 2);
+	}
+	return timings;
+}
+
+} // namespace
+
+// Allocate and free against the blocks the allocator would create for the heaps of a desktop GPU,
+// after the blocks got fragmented by random sizes and alignments. Timings include reading the
+// clock around each call.
+TRAMOGI_TEST(tlsf_allocate_and_free) {
+	vk::PhysicalDeviceMemoryProperties memory_properties = get_desktop_memory_properties();
+	std::vector<uint64_t> block_sizes;
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+		block_sizes.push_back(graphics::get_block_size(
+			memory_properties.memoryHeaps[i].size,
+			graphics::DeviceMemoryAllocator::default_block_size
+		));
+	}
+	std::sort(block_sizes.begin(), block_sizes.end());
+	block_sizes.erase(std::unique(block_sizes.begin(), block_sizes.end()), block_sizes.end());
+
+	for (uint64_t block_size : block_sizes) {
+		Timings timings = measure_churn(block_size);
+		uint64_t block_mib = block_size / (1024 * 1024);
+		report(
+			std::format("allocate, {} MiB block", block_mib).c_str(),
+			static_cast<double>(timings.allocate_ns) / timings.allocation_count,
+			"ns/allocation"
+		);
+		report(
+			std::format("free, {} MiB block", block_mib).c_str(),
+			static_cast<double>(timings.free_ns) / timings.free_count,
+			"ns/free"
+		);
+		report(
+			std::format("failed allocations, {} MiB block", block_mib).c_str(),
+			static_cast<double>(timings.failed_count),
+			"allocations"
+		);
+		TRAMOGI_CHECK(timings.allocation_count > 0);
+	}
+}
+
+} // namespace tramogi::test
@@ -0,0 +1,121 @@
+#include "graphics/allocator.h"
+#include "graphics/tlsf.h"
+#include "test.h"
+#include <cstdint>
+#include <vector>
+
+namespace tramogi::test {
+
+namespace {
+
+using graphics::ResourceKind;
+using graphics::Tlsf;
+using graphics::TlsfRange;
+
+TlsfRange allocate(Tlsf &tlsf, uint64_t size, uint64_t alignment) {
+	auto range = tlsf.allocate(size, alignment);
+	if (!range) {
+		fail(__FILE__, __LINE__, "Allocation failed");
+	}
+	return range.value();
+}
+
+} // namespace
+
+TRAMOGI_TEST(tlsf_aligns_offsets) {
+	Tlsf tlsf(64 * 1024);
+	TlsfRange first = allocate(tlsf, 8, 1);
+	TRAMOGI_CHECK_EQ(first.offset, 0);
+
+	TlsfRange aligned = allocate(tlsf, 100, 4096);
+	TRAMOGI_CHECK_EQ(aligned.offset, 4096);
+	// Rounded up to the granularity of 8 bytes.
+	TRAMOGI_CHECK_EQ(aligned.size, 104);
+
+	// The padding in front of the aligned range stays free.
+	TlsfRange padding = allocate(tlsf, 8, 8);
+	TRAMOGI_CHECK(padding.offset > first.offset && padding.offset < aligned.offset);
+
+	for (uint64_t alignment = 1; alignment <= 64 * 1024; alignment *= 2) {
+		auto range = tlsf.allocate(24, alignment);
+		if (range) {
+			TRAMOGI_CHECK_EQ(range->offset % alignment, 0);
+		}
+	}
+}
+
+TRAMOGI_TEST(tlsf_coalesces_neighbours) {
+	Tlsf tlsf(4096);
+	TlsfRange a = allocate(tlsf, 1024, 1);
+	TlsfRange b = allocate(tlsf, 1024, 1);
+	TlsfRange c = allocate(tlsf, 1024, 1);
+	TRAMOGI_CHECK_EQ(tlsf.get_largest_free_range(), 1024);
+
+	// Merged with the free tail.
+	tlsf.free(c.node);
+	TRAMOGI_CHECK_EQ(tlsf.get_largest_free_range(), 2048);
+	tlsf.free(a.node);
+	TRAMOGI_CHECK_EQ(tlsf.get_largest_free_range(), 2048);
+	TRAMOGI_CHECK_EQ(tlsf.get_free_bytes(), 3072);
+
+	// Merged with both neighbours.
+	tlsf.free(b.node);
+	TRAMOGI_CHECK_EQ(tlsf.get_largest_free_range(), 4096);
+	TRAMOGI_CHECK_EQ(allocate(tlsf, 4096, 1).offset, 0);
+}
+
+TRAMOGI_TEST(tlsf_fails_when_exhausted) {
+	Tlsf tlsf(4096);
+	TRAMOGI_CHECK(!tlsf.allocate(4097, 1));
+
+	for (uint32_t i = 0; i < 16; ++i) {
+		TRAMOGI_CHECK_EQ(allocate(tlsf, 256, 1).offset, i * 256);
+	}
+	TRAMOGI_CHECK_EQ(tlsf.get_free_bytes(), 0);
+	TRAMOGI_CHECK_EQ(tlsf.get_largest_free_range(), 0);
+	TRAMOGI_CHECK(!tlsf.allocate(8, 1));
+
+	Tlsf empty(0);
+	TRAMOGI_CHECK(!empty.allocate(8, 1));
+}
+
+TRAMOGI_TEST(tlsf_is_empty_after_freeing_everything) {
+	Tlsf tlsf(1024 * 1024);
+	std::vector<uint32_t> nodes;
+	for (uint64_t i = 0; i < 100; ++i) {
+		nodes.push_back(allocate(tlsf, 64 + i * 40, uint64_t(1) << (i % 9)).node);
+	}
+	TRAMOGI_CHECK_EQ(tlsf.get_allocation_count(), 100);
+
+	uint64_t previous_end = 0;
+	tlsf.for_each_allocation([&previous_end](uint64_t offset, uint64_t size) {
+		TRAMOGI_CHECK(offset >= previous_end);
+		previous_end = offset + size;
+	});
+
+	// Every other one first, so that frees merge on both sides.
+	for (size_t i = 0; i < nodes.size(); i += 2) {
+		tlsf.free(nodes[i]);
+	}
+	for (size_t i = 1; i < nodes.size(); i += 2) {
+		tlsf.free(nodes[i]);
+	}
+	TRAMOGI_CHECK(tlsf.is_empty());
+	TRAMOGI_CHECK_EQ(tlsf.get_free_bytes(), tlsf.get_size());
+	TRAMOGI_CHECK_EQ(tlsf.get_largest_free_range(), tlsf.get_size());
+}
+
+// Linear and optimally tiled resources never share a block, so they cannot end up within
+// bufferImageGranularity of each other.
+TRAMOGI_TEST(tlsf_blocks_separate_by_buffer_image_granularity) {
+	TRAMOGI_CHECK(graphics::uses_linear_blocks(ResourceKind::Storage, 1024));
+	TRAMOGI_CHECK(graphics::uses_linear_blocks(ResourceKind::Staging, 1024));
+	TRAMOGI_CHECK(!graphics::uses_linear_blocks(ResourceKind::Texture, 1024));
+	TRAMOGI_CHECK(!graphics::uses_linear_blocks(ResourceKind::Attachment, 1024));
+
+	// Nothing to separate.
+	TRAMOGI_CHECK(graphics::uses_linear_blocks(ResourceKind::Texture, 1));
+	TRAMOGI_CHECK(graphics::uses_linear_blocks(ResourceKind::Attachment, 1));
+}
+
+} // namespace tramogi::test
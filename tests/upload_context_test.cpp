@@ -0,0 +1,111 @@
+#include "gpu_context.h"
+#include "graphics/staging_pool.h"
+#include "graphics/upload_context.h"
+#include "test.h"
+#include "tramogi/graphics/buffer.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace tramogi::test {
+
+namespace {
+
+using graphics::StagingPool;
+using graphics::StorageBuffer;
+using graphics::UploadContext;
+
+constexpr uint32_t batch_count = 4;
+constexpr uint32_t word_count = 16 * 1024;
+constexpr uint64_t half_size = word_count * sizeof(uint32_t);
+
+// Per batch, uploads the first half of a buffer and fills the second half on the graphics queue,
+// after the hand over.
+void upload_and_check(GpuContext &context) {
+	StagingPool staging_pool;
+	staging_pool.init(context.device, 1024 * 1024);
+	UploadContext upload_context;
+	upload_context.init(context.device, staging_pool);
+	TRAMOGI_CHECK(
+		upload_context.has_dedicated_transfer_queue() ==
+		context.physical_device.has_dedicated_transfer_queue()
+	);
+
+	std::vector<StorageBuffer> buffers(batch_count);
+	std::vector<std::vector<uint32_t>> expected_words;
+	for (uint32_t batch = 0; batch < batch_count; ++batch) {
+		std::vector<uint32_t> words(word_count * 2, batch);
+		std::iota(words.begin(), words.begin() + word_count, batch * word_count);
+		expected_words.push_back(words);
+
+		StorageBuffer &buffer = buffers[batch];
+		auto result = buffer.init(context.device, half_size * 2);
+		if (!result) {
+			fail(__FILE__, __LINE__, result.error());
+		}
+		auto staging_region = staging_pool.upload(words.data(), half_size);
+		if (!staging_region) {
+			fail(__FILE__, __LINE__, staging_region.error());
+		}
+
+		upload_context.get_command_buffer().copyBuffer(
+			*staging_region->buffer,
+			buffer.get_buffer(),
+			vk::BufferCopy {
+				.srcOffset = staging_region->offset,
+				.dstOffset = 0,
+				.size = half_size,
+			}
+		);
+		upload_context.hand_over(vk::BufferMemoryBarrier2 {
+			.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eAllTransfer,
+			.dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.buffer = buffer.get_buffer(),
+			.offset = 0,
+			.size = vk::WholeSize,
+		});
+		upload_context.get_graphics_command_buffer().fillBuffer(
+			buffer.get_buffer(),
+			half_size,
+			half_size,
+			batch
+		);
+		upload_context.submit();
+	}
+	TRAMOGI_CHECK_EQ(upload_context.get_submit_count(), batch_count);
+
+	upload_context.wait(upload_context.submit());
+	for (uint32_t batch = 0; batch < batch_count; ++batch) {
+		std::vector<std::byte> data = context.read_buffer(buffers[batch]);
+		TRAMOGI_CHECK(std::ranges::equal(data, std::as_bytes(std::span(expected_words[batch]))));
+	}
+
+	graphics::StagingPoolStats stats = staging_pool.get_stats();
+	TRAMOGI_CHECK_EQ(stats.region_count, batch_count);
+	TRAMOGI_CHECK_EQ(stats.uploaded_bytes, batch_count * half_size);
+}
+
+} // namespace
+
+TRAMOGI_TEST(upload_context_uploads_through_the_graphics_queue) {
+	auto context = create_gpu_context({.disable_dedicated_transfer_queue = true});
+	TRAMOGI_CHECK(!context->physical_device.has_dedicated_transfer_queue());
+	upload_and_check(*context);
+}
+
+TRAMOGI_TEST(upload_context_uploads_through_a_dedicated_transfer_queue) {
+	auto context = create_gpu_context();
+	if (!context->physical_device.has_dedicated_transfer_queue()) {
+		skip("No dedicated transfer queue family");
+	}
+	upload_and_check(*context);
+}
+
+} // namespace tramogi::test